@@ -573,6 +573,17 @@ cmd_gbench() {
   )
 }
 
+cmd_api_gbench() {
+  export_env
+  (cd "${BUILD_DIR}"
+   export UBSAN_OPTIONS=print_stacktrace=1
+   lib/jxl_api_gbench \
+     --benchmark_counters_tabular=true \
+     --benchmark_out_format=json \
+     --benchmark_out=api_gbench.json "$@"
+  )
+}
+
 cmd_asanfuzz() {
   CMAKE_CXX_FLAGS+=" -fsanitize=fuzzer-no-link -DFUZZING_BUILD_MODE_UNSAFE_FOR_PRODUCTION=1"
   CMAKE_C_FLAGS+=" -fsanitize=fuzzer-no-link -DFUZZING_BUILD_MODE_UNSAFE_FOR_PRODUCTION=1"
@@ -1503,6 +1514,7 @@ Where cmd is one of:
  test      Run the tests build by opt, debug, release, asan or msan. Useful when
            building with SKIP_TEST=1.
  gbench    Run the Google benchmark tests.
+ api_gbench Run the encoder/decoder API benchmarks, writing api_gbench.json.
  fuzz      Generate the fuzzer corpus and run the fuzzer on it. Useful after
            building with asan or msan.
  benchmark Run the benchmark over the default corpus.
@@ -8,6 +8,7 @@
 
 // Decodes JPEG XL images in memory.
 
+#include <jxl/decode_stats.h>
 #include <jxl/memory_manager.h>
 #include <jxl/parallel_runner.h>
 #include <jxl/types.h>
@@ -19,12 +20,26 @@
 #include <vector>
 
 #include "lib/extras/size_constraints.h"
+#include "lib/jxl/base/status.h"
 
 namespace jxl {
 namespace extras {
 
 class PackedPixelFile;
 
+// Receives the pixels of a decoded single-frame image row by row, in
+// top-to-bottom order, instead of storing them in the frames of the
+// PackedPixelFile.
+class JXLRowConsumer {
+ public:
+  virtual ~JXLRowConsumer() = default;
+  // Called before the first row. `ppf` has the basic info and the color
+  // encoding set, but no frames.
+  virtual Status Begin(const PackedPixelFile& ppf,
+                       const JxlPixelFormat& format) = 0;
+  virtual Status WriteRow(const uint8_t* row) = 0;
+};
+
 struct JXLDecompressParams {
   // If empty, little endian float formats will be accepted.
   std::vector<JxlPixelFormat> accepted_formats;
@@ -35,6 +50,9 @@ struct JXLDecompressParams {
   std::string color_space_for_cmyk;
   // If set, performs tone mapping to this intensity target luminance.
   float display_nits = 0.0;
+  // If not negative, applies the gain map, if any, for a display with this
+  // log2 HDR headroom.
+  float display_headroom = -1.0f;
   // Whether spot colors are rendered on the image.
   bool render_spotcolors = true;
   // Whether to keep or undo the orientation given in the header.
@@ -49,6 +67,9 @@ struct JXLDecompressParams {
   // If memory_manager is set, decoder uses it.
   JxlMemoryManager* memory_manager = nullptr;
 
+  // If set, the statistics of the decoded frames are added to it.
+  JxlDecoderStats* stats = nullptr;
+
   // Whether truncated input should be treated as an error.
   bool allow_partial_input = false;
 
@@ -67,6 +88,16 @@ struct JXLDecompressParams {
 
   // Controls the effective bit depth of the output pixels.
   JxlBitDepth output_bitdepth = {JXL_BIT_DEPTH_FROM_PIXEL_FORMAT, 0, 0};
+
+  // If set, the image is decoded without a full-size output buffer: rows are
+  // passed to `row_consumer` as soon as they are complete, and `ppf` will have
+  // no frames. Only coalesced still images are supported, extra channels
+  // other than the interleaved alpha are not decoded, and partial or
+  // progressive decoding is not allowed. The image is still kept whole until
+  // its first row is rendered if it is flipped vertically or transposed by its
+  // orientation, unless `keep_orientation` is set, or if `runner` is not
+  // JxlThreadParallelRunner, which starts the groups in order.
+  JXLRowConsumer* row_consumer = nullptr;
 };
 
 bool DecodeImageJXL(const uint8_t* bytes, size_t bytes_size,
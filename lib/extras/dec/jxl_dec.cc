@@ -10,6 +10,7 @@
 #include <jxl/color_encoding.h>
 #include <jxl/decode.h>
 #include <jxl/decode_cxx.h>
+#include <jxl/thread_parallel_runner.h>
 #include <jxl/types.h>
 
 #include <cinttypes>  // PRIu32
@@ -18,11 +19,13 @@
 #include <cstdio>
 #include <cstring>
 #include <limits>
+#include <memory>
 #include <utility>
 #include <vector>
 
 #include "lib/extras/common.h"
 #include "lib/extras/dec/color_description.h"
+#include "lib/extras/dec/row_reorder_buffer.h"
 #include "lib/extras/exif.h"
 #include "lib/extras/packed_image.h"
 #include "lib/extras/size_constraints.h"
@@ -153,6 +156,7 @@ bool DecodeImageJXL(const uint8_t* bytes, size_t bytes_size,
     fprintf(stderr, "JxlEncoderSetParallelRunner failed\n");
     return false;
   }
+  if (dparams.stats != nullptr) JxlDecoderCollectStats(dec, dparams.stats);
 
   JxlPixelFormat format = {};  // Initialize to calm down clang-tidy.
   std::vector<JxlPixelFormat> accepted_formats = dparams.accepted_formats;
@@ -180,6 +184,17 @@ bool DecodeImageJXL(const uint8_t* bytes, size_t bytes_size,
     jpeg_bytes->resize(0);
   }
 
+  JXLRowConsumer* row_consumer = dparams.row_consumer;
+  std::unique_ptr<RowReorderBuffer> reorder_buffer;
+  if (row_consumer != nullptr &&
+      (jpeg_bytes != nullptr || dparams.allow_partial_input ||
+       dparams.max_passes < std::numeric_limits<uint32_t>::max() ||
+       dparams.max_downsampling > 1 || !dparams.coalescing ||
+       accepted_formats.empty())) {
+    fprintf(stderr, "Row-by-row output is not supported with these options\n");
+    return false;
+  }
+
   int events = (JXL_DEC_BASIC_INFO | JXL_DEC_FULL_IMAGE);
 
   bool max_passes_defined =
@@ -233,6 +248,12 @@ bool DecodeImageJXL(const uint8_t* bytes, size_t bytes_size,
       fprintf(stderr, "Decoder failed to set desired intensity target\n");
       return false;
     }
+    if (dparams.display_headroom >= 0 &&
+        JXL_DEC_SUCCESS !=
+            JxlDecoderSetGainMapHeadroom(dec, dparams.display_headroom)) {
+      fprintf(stderr, "JxlDecoderSetGainMapHeadroom failed\n");
+      return false;
+    }
     if (JXL_DEC_SUCCESS != JxlDecoderSetDecompressBoxes(dec, JXL_TRUE)) {
       fprintf(stderr, "JxlDecoderSetDecompressBoxes failed\n");
       return false;
@@ -338,6 +359,10 @@ bool DecodeImageJXL(const uint8_t* bytes, size_t bytes_size,
         return false;
       }
       if (accepted_formats.empty()) continue;
+      if (row_consumer != nullptr && ppf->info.have_animation) {
+        fprintf(stderr, "Row-by-row output is not supported for animations\n");
+        return false;
+      }
       if (num_color_channels != 0) {
         // Mark the change in number of color channels due to the requested
         // color space.
@@ -393,6 +418,8 @@ bool DecodeImageJXL(const uint8_t* bytes, size_t bytes_size,
           return false;
         }
         name.resize(eci.name_length);
+        // Only the interleaved alpha channel is output row by row.
+        if (row_consumer != nullptr) continue;
         ppf->extra_channels_info.push_back({eci, i, name});
       }
     } else if (status == JXL_DEC_COLOR_ENCODING) {
@@ -457,6 +484,29 @@ bool DecodeImageJXL(const uint8_t* bytes, size_t bytes_size,
         fprintf(stderr, "JxlDecoderGetFrameHeader failed\n");
         return false;
       }
+      if (row_consumer != nullptr) {
+        // Pixels go to the row consumer, do not allocate a frame.
+        if (reorder_buffer != nullptr) {
+          fprintf(stderr, "Unexpected additional frame\n");
+          return false;
+        }
+        // Enough rows for each thread to render a group of the default size,
+        // 256 pixels, ahead of the rows that are written. Output that is
+        // flipped vertically or transposed is rendered from the bottom or the
+        // side, and other runners may start the groups in any order, so all
+        // of it is kept until its first row is done.
+        const bool rows_in_order =
+            (dparams.keep_orientation ||
+             ppf->info.orientation <= JXL_ORIENT_FLIP_HORIZONTAL) &&
+            (dparams.runner_opaque == nullptr ||
+             dparams.runner == JxlThreadParallelRunner);
+        reorder_buffer = jxl::make_unique<RowReorderBuffer>(
+            row_consumer, fh.layer_info.xsize, fh.layer_info.ysize,
+            format.num_channels *
+                PackedImage::BitsPerChannel(format.data_type) / kBitsPerByte,
+            /*rows_per_thread=*/rows_in_order ? 512 : 0);
+        continue;
+      }
       JXL_ASSIGN_OR_QUIT(jxl::extras::PackedFrame frame,
                          jxl::extras::PackedFrame::Create(
                              fh.layer_info.xsize, fh.layer_info.ysize, format),
@@ -521,6 +571,32 @@ bool DecodeImageJXL(const uint8_t* bytes, size_t bytes_size,
       if (jpeg_bytes != nullptr) {
         break;
       }
+      if (row_consumer != nullptr) {
+        if (JXL_DEC_SUCCESS !=
+            JxlDecoderSetImageOutBitDepth(dec, &dparams.output_bitdepth)) {
+          fprintf(stderr, "JxlDecoderSetImageOutBitDepth failed\n");
+          return false;
+        }
+        UpdateBitDepth(dparams.output_bitdepth, format.data_type, &ppf->info);
+        if (format.num_channels == 2 || format.num_channels == 4) {
+          ppf->info.alpha_bits = ppf->info.bits_per_sample;
+          ppf->info.alpha_exponent_bits = ppf->info.exponent_bits_per_sample;
+        }
+        if (reorder_buffer == nullptr ||
+            !row_consumer->Begin(*ppf, format)) {
+          fprintf(stderr, "Failed to start row-by-row output\n");
+          return false;
+        }
+        if (JXL_DEC_SUCCESS != JxlDecoderSetMultithreadedImageOutCallback(
+                                   dec, &format, &RowReorderBuffer::Init,
+                                   &RowReorderBuffer::Run, nullptr,
+                                   reorder_buffer.get())) {
+          fprintf(stderr,
+                  "JxlDecoderSetMultithreadedImageOutCallback failed\n");
+          return false;
+        }
+        continue;
+      }
       size_t buffer_size;
       if (JXL_DEC_SUCCESS !=
           JxlDecoderImageOutBufferSize(dec, &format, &buffer_size)) {
@@ -608,6 +684,14 @@ bool DecodeImageJXL(const uint8_t* bytes, size_t bytes_size,
     } else if (status == JXL_DEC_PREVIEW_IMAGE) {
       // Nothing to do.
     } else if (status == JXL_DEC_FULL_IMAGE) {
+      if (row_consumer != nullptr) {
+        if (!reorder_buffer->Done()) {
+          fprintf(stderr, "Failed to write all rows\n");
+          return false;
+        }
+        codestream_done = true;
+        continue;
+      }
       if (jpeg_bytes != nullptr || ppf->frames.back().frame_info.is_last) {
         codestream_done = true;
       }
@@ -52,10 +52,15 @@ class ChunkedPNMDecoder {
   // Initializes `ppf` with a pointer to this `ChunkedPNMDecoder`.
   jxl::Status InitializePPF(const ColorHints& color_hints,
                             PackedPixelFile* ppf);
+  // When non-zero, every request for pixel data starts an asynchronous read of
+  // up to `bytes` bytes of the rows that follow it, so that reading the file
+  // overlaps with encoding of the current rows.
+  void SetReadAhead(size_t bytes) { read_ahead_bytes_ = bytes; }
 
  private:
   HeaderPNM header_ = {};
   size_t data_start_ = 0;
+  size_t read_ahead_bytes_ = 0;
   MemoryMappedFile pnm_;
 
   friend struct PNMChunkedInputFrame;
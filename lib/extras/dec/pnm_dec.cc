@@ -362,6 +362,10 @@ struct PNMChunkedInputFrame {
     const size_t bytes_per_pixel = num_channels * bytes_per_channel;
     *row_offset = dec->header_.xsize * bytes_per_pixel;
     const size_t offset = ypos * *row_offset + xpos * bytes_per_pixel;
+    if (dec->read_ahead_bytes_ != 0) {
+      dec->pnm_.Prefetch(dec->data_start_ + (ypos + ysize) * *row_offset,
+                         dec->read_ahead_bytes_);
+    }
     return dec->pnm_.data() + offset + dec->data_start_;
   }
 
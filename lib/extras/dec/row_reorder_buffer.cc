@@ -0,0 +1,93 @@
+// Copyright (c) the JPEG XL Project Authors. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#include "lib/extras/dec/row_reorder_buffer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+namespace jxl {
+namespace extras {
+
+RowReorderBuffer::RowReorderBuffer(JXLRowConsumer* consumer, size_t xsize,
+                                   size_t ysize, size_t pixel_stride,
+                                   size_t rows_per_thread)
+    : consumer_(consumer),
+      xsize_(xsize),
+      ysize_(ysize),
+      pixel_stride_(pixel_stride),
+      rows_per_thread_(rows_per_thread) {}
+
+void* RowReorderBuffer::Init(void* opaque, size_t num_threads,
+                             size_t num_pixels_per_thread) {
+  auto* self = static_cast<RowReorderBuffer*>(opaque);
+  std::lock_guard<std::mutex> lock(self->mutex_);
+  self->num_threads_ = std::max<size_t>(num_threads, 1);
+  return opaque;
+}
+
+void RowReorderBuffer::Run(void* opaque, size_t thread_id, size_t x, size_t y,
+                           size_t num_pixels, const void* pixels) {
+  static_cast<RowReorderBuffer*>(opaque)->AddPixels(x, y, num_pixels, pixels);
+}
+
+bool RowReorderBuffer::Done() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return !failed_ && next_y_ == ysize_;
+}
+
+size_t RowReorderBuffer::PeakPendingRows() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return peak_pending_rows_;
+}
+
+void RowReorderBuffer::AddPixels(size_t x, size_t y, size_t num_pixels,
+                                 const void* pixels) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  const size_t max_pending_rows = rows_per_thread_ * num_threads_;
+  rows_written_.wait(lock, [&] {
+    return failed_ || rows_per_thread_ == 0 || y < next_y_ + max_pending_rows;
+  });
+  if (failed_ || y < next_y_ || y >= ysize_ || x + num_pixels > xsize_) {
+    failed_ = true;
+    rows_written_.notify_all();
+    return;
+  }
+  PendingRow& row = rows_[y];
+  if (row.data.empty()) {
+    if (free_rows_.empty()) {
+      row.data.resize(xsize_ * pixel_stride_);
+    } else {
+      row.data = std::move(free_rows_.back());
+      free_rows_.pop_back();
+    }
+  }
+  peak_pending_rows_ = std::max(peak_pending_rows_, rows_.size());
+  memcpy(row.data.data() + x * pixel_stride_, pixels,
+         num_pixels * pixel_stride_);
+  row.num_pixels += num_pixels;
+  // Only one thread at a time writes rows, the others keep filling rows
+  // meanwhile.
+  if (writing_) return;
+  writing_ = true;
+  for (;;) {
+    auto it = rows_.find(next_y_);
+    if (it == rows_.end() || it->second.num_pixels < xsize_) break;
+    std::vector<uint8_t> data = std::move(it->second.data);
+    rows_.erase(it);
+    lock.unlock();
+    bool ok = static_cast<bool>(consumer_->WriteRow(data.data()));
+    lock.lock();
+    if (!ok) failed_ = true;
+    free_rows_.emplace_back(std::move(data));
+    ++next_y_;
+    rows_written_.notify_all();
+  }
+  writing_ = false;
+}
+
+}  // namespace extras
+}  // namespace jxl
@@ -0,0 +1,78 @@
+// Copyright (c) the JPEG XL Project Authors. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#ifndef LIB_EXTRAS_DEC_ROW_REORDER_BUFFER_H_
+#define LIB_EXTRAS_DEC_ROW_REORDER_BUFFER_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "lib/extras/dec/jxl.h"
+
+namespace jxl {
+namespace extras {
+
+// Collects the partial rows produced concurrently by the decoder's render
+// pipeline and passes complete rows to a JXLRowConsumer in top-to-bottom order.
+// Only rows that are complete but cannot be written yet, and rows that are
+// still being filled, are kept in memory: at most `rows_per_thread` rows per
+// thread of the decoder. A thread that brings a row further ahead waits until
+// the earlier rows are written.
+//
+// The rows that are due are then always rendered by threads that do not wait,
+// provided that the thread runner starts the groups in order and each group
+// is rendered from top to bottom. Output that is flipped vertically or
+// transposed, or other runners, require `rows_per_thread` to be 0, which
+// keeps all rows until they can be written.
+class RowReorderBuffer {
+ public:
+  RowReorderBuffer(JXLRowConsumer* consumer, size_t xsize, size_t ysize,
+                   size_t pixel_stride, size_t rows_per_thread);
+
+  // Callbacks for JxlDecoderSetMultithreadedImageOutCallback, with the
+  // RowReorderBuffer as opaque pointer.
+  static void* Init(void* opaque, size_t num_threads,
+                    size_t num_pixels_per_thread);
+  static void Run(void* opaque, size_t thread_id, size_t x, size_t y,
+                  size_t num_pixels, const void* pixels);
+
+  // Returns true if all rows were passed to the consumer successfully.
+  bool Done();
+
+  // Largest number of rows that were kept at once.
+  size_t PeakPendingRows();
+
+ private:
+  struct PendingRow {
+    std::vector<uint8_t> data;
+    size_t num_pixels = 0;
+  };
+
+  void AddPixels(size_t x, size_t y, size_t num_pixels, const void* pixels);
+
+  JXLRowConsumer* consumer_;
+  size_t xsize_;
+  size_t ysize_;
+  size_t pixel_stride_;
+  size_t rows_per_thread_;
+  std::mutex mutex_;
+  std::condition_variable rows_written_;
+  size_t num_threads_ = 1;
+  std::unordered_map<size_t, PendingRow> rows_;
+  std::vector<std::vector<uint8_t>> free_rows_;
+  size_t peak_pending_rows_ = 0;
+  size_t next_y_ = 0;
+  bool writing_ = false;
+  bool failed_ = false;
+};
+
+}  // namespace extras
+}  // namespace jxl
+
+#endif  // LIB_EXTRAS_DEC_ROW_REORDER_BUFFER_H_
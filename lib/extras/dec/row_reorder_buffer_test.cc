@@ -0,0 +1,117 @@
+// Copyright (c) the JPEG XL Project Authors. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#include "lib/extras/dec/row_reorder_buffer.h"
+
+#include <jxl/types.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "lib/extras/dec/jxl.h"
+#include "lib/extras/packed_image.h"
+#include "lib/jxl/base/data_parallel.h"
+#include "lib/jxl/base/status.h"
+#include "lib/jxl/test_utils.h"
+#include "lib/jxl/testing.h"
+
+namespace jxl {
+namespace extras {
+namespace {
+
+constexpr size_t kXSize = 64;
+constexpr size_t kYSize = 512;
+constexpr size_t kGroupXSize = 32;
+constexpr size_t kGroupYSize = 16;
+constexpr size_t kXSizeGroups = kXSize / kGroupXSize;
+constexpr size_t kNumGroups = kXSizeGroups * (kYSize / kGroupYSize);
+constexpr size_t kNumThreads = 4;
+
+uint8_t PixelValue(size_t x, size_t y) { return (x + 3 * y) & 0xFF; }
+
+class CollectRows : public JXLRowConsumer {
+ public:
+  Status Begin(const PackedPixelFile& ppf,
+               const JxlPixelFormat& format) override {
+    return true;
+  }
+  Status WriteRow(const uint8_t* row) override {
+    rows.emplace_back(row, row + kXSize);
+    return true;
+  }
+
+  std::vector<std::vector<uint8_t>> rows;
+};
+
+// Renders groups of one-byte pixels with `kNumThreads` threads, in the given
+// order of the groups, each in two halves per row.
+void RenderGroups(const std::vector<size_t>& group_order,
+                  RowReorderBuffer* buffer) {
+  test::ThreadPoolForTests pool(kNumThreads);
+  const auto init = [&](size_t num_threads) -> Status {
+    JXL_ENSURE(RowReorderBuffer::Init(buffer, num_threads, kGroupXSize) ==
+               buffer);
+    return true;
+  };
+  const auto render_group = [&](uint32_t i, size_t thread) -> Status {
+    const size_t group = group_order[i];
+    const size_t x0 = group % kXSizeGroups * kGroupXSize;
+    const size_t y0 = group / kXSizeGroups * kGroupYSize;
+    for (size_t y = y0; y < y0 + kGroupYSize; y++) {
+      for (size_t x = x0; x < x0 + kGroupXSize; x += kGroupXSize / 2) {
+        std::vector<uint8_t> pixels(kGroupXSize / 2);
+        for (size_t k = 0; k < pixels.size(); k++) {
+          pixels[k] = PixelValue(x + k, y);
+        }
+        RowReorderBuffer::Run(buffer, thread, x, y, pixels.size(),
+                              pixels.data());
+      }
+    }
+    return true;
+  };
+  ASSERT_TRUE(
+      RunOnPool(pool.get(), 0, kNumGroups, init, render_group, "RenderGroups"));
+}
+
+void ExpectRowsInOrder(const CollectRows& consumer) {
+  ASSERT_EQ(consumer.rows.size(), kYSize);
+  for (size_t y = 0; y < kYSize; y++) {
+    for (size_t x = 0; x < kXSize; x++) {
+      ASSERT_EQ(consumer.rows[y][x], PixelValue(x, y))
+          << "x = " << x << ", y = " << y;
+    }
+  }
+}
+
+// Without a bound, the rows may arrive in any order.
+TEST(RowReorderBufferTest, WritesRowsInOrder) {
+  std::vector<size_t> group_order;
+  for (size_t i = kNumGroups; i-- > 0;) group_order.push_back(i);
+  CollectRows consumer;
+  RowReorderBuffer buffer(&consumer, kXSize, kYSize, /*pixel_stride=*/1,
+                          /*rows_per_thread=*/0);
+  RenderGroups(group_order, &buffer);
+  EXPECT_TRUE(buffer.Done());
+  ExpectRowsInOrder(consumer);
+}
+
+// The pool starts the groups in order, so the threads that wait never hold
+// the rows that are due.
+TEST(RowReorderBufferTest, BoundsPendingRows) {
+  std::vector<size_t> group_order;
+  for (size_t i = 0; i < kNumGroups; i++) group_order.push_back(i);
+  CollectRows consumer;
+  RowReorderBuffer buffer(&consumer, kXSize, kYSize, /*pixel_stride=*/1,
+                          /*rows_per_thread=*/kGroupYSize);
+  RenderGroups(group_order, &buffer);
+  EXPECT_TRUE(buffer.Done());
+  ExpectRowsInOrder(consumer);
+  EXPECT_LE(buffer.PeakPendingRows(), kGroupYSize * kNumThreads);
+}
+
+}  // namespace
+}  // namespace extras
+}  // namespace jxl
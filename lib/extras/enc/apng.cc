@@ -47,6 +47,7 @@
 namespace jxl {
 namespace extras {
 std::unique_ptr<Encoder> GetAPNGEncoder() { return nullptr; }
+std::unique_ptr<StreamingEncoder> GetStreamingPNGEncoder() { return nullptr; }
 }  // namespace extras
 }  // namespace jxl
 
@@ -303,6 +304,37 @@ void MaybeAddCLLi(const JxlColorEncoding& c_enc, const float intensity_target,
   png_set_unknown_chunks(png_ptr, info_ptr, &chunk, 1);
 }
 
+void AddColorChunks(const PackedPixelFile& ppf, png_structp png_ptr,
+                    png_infop info_ptr) {
+  if (!MaybeAddSRGB(ppf.color_encoding, png_ptr, info_ptr)) {
+    if (ppf.primary_color_representation != PackedPixelFile::kIccIsPrimary) {
+      MaybeAddCICP(ppf.color_encoding, png_ptr, info_ptr);
+    }
+    if (!ppf.icc.empty()) {
+      png_set_benign_errors(png_ptr, 1);
+      png_set_iCCP(png_ptr, info_ptr, "1", 0, ppf.icc.data(), ppf.icc.size());
+    }
+    MaybeAddCHRM(ppf.color_encoding, png_ptr, info_ptr);
+    MaybeAddGAMA(ppf.color_encoding, png_ptr, info_ptr);
+  }
+  MaybeAddCLLi(ppf.color_encoding, ppf.info.intensity_target, png_ptr,
+               info_ptr);
+}
+
+Status AddMetadataChunks(const PackedMetadata& metadata, png_structp png_ptr,
+                         png_infop info_ptr) {
+  std::vector<std::string> textstrings;
+  JXL_RETURN_IF_ERROR(BlobsWriterPNG::Encode(metadata, &textstrings));
+  for (size_t kk = 0; kk + 1 < textstrings.size(); kk += 2) {
+    png_text text;
+    text.key = const_cast<png_charp>(textstrings[kk].c_str());
+    text.text = const_cast<png_charp>(textstrings[kk + 1].c_str());
+    text.compression = PNG_TEXT_COMPRESSION_zTXt;
+    png_set_text(png_ptr, info_ptr, &text, 1);
+  }
+  return true;
+}
+
 Status APNGEncoder::EncodePackedPixelFileToAPNG(
     const PackedPixelFile& ppf, ThreadPool* pool,
     std::vector<std::vector<uint8_t> >* bitstreams, bool encode_extra_channels,
@@ -426,31 +458,8 @@ Status APNGEncoder::EncodePackedPixelFileToAPNG(
                  PNG_FILTER_TYPE_BASE);
     if (count == 0 || !ppf.info.have_animation) {
       if (!encode_extra_channels) {
-        if (!MaybeAddSRGB(ppf.color_encoding, png_ptr, info_ptr)) {
-          if (ppf.primary_color_representation !=
-              PackedPixelFile::kIccIsPrimary) {
-            MaybeAddCICP(ppf.color_encoding, png_ptr, info_ptr);
-          }
-          if (!ppf.icc.empty()) {
-            png_set_benign_errors(png_ptr, 1);
-            png_set_iCCP(png_ptr, info_ptr, "1", 0, ppf.icc.data(),
-                         ppf.icc.size());
-          }
-          MaybeAddCHRM(ppf.color_encoding, png_ptr, info_ptr);
-          MaybeAddGAMA(ppf.color_encoding, png_ptr, info_ptr);
-        }
-        MaybeAddCLLi(ppf.color_encoding, ppf.info.intensity_target, png_ptr,
-                     info_ptr);
-
-        std::vector<std::string> textstrings;
-        JXL_RETURN_IF_ERROR(BlobsWriterPNG::Encode(ppf.metadata, &textstrings));
-        for (size_t kk = 0; kk + 1 < textstrings.size(); kk += 2) {
-          png_text text;
-          text.key = const_cast<png_charp>(textstrings[kk].c_str());
-          text.text = const_cast<png_charp>(textstrings[kk + 1].c_str());
-          text.compression = PNG_TEXT_COMPRESSION_zTXt;
-          png_set_text(png_ptr, info_ptr, &text, 1);
-        }
+        AddColorChunks(ppf, png_ptr, info_ptr);
+        JXL_RETURN_IF_ERROR(AddMetadataChunks(ppf.metadata, png_ptr, info_ptr));
       }
 
       png_write_info(png_ptr, info_ptr);
@@ -525,12 +534,128 @@ Status APNGEncoder::EncodePackedPixelFileToAPNG(
   return true;
 }
 
+class StreamingPNGEncoder : public StreamingEncoder {
+ public:
+  ~StreamingPNGEncoder() override {
+    if (png_ptr_ != nullptr) png_destroy_write_struct(&png_ptr_, &info_ptr_);
+  }
+
+  std::vector<JxlPixelFormat> AcceptedFormats() const override {
+    std::vector<JxlPixelFormat> formats;
+    for (const uint32_t num_channels : {1, 2, 3, 4}) {
+      for (const JxlDataType data_type : {JXL_TYPE_UINT8, JXL_TYPE_UINT16}) {
+        formats.push_back(JxlPixelFormat{num_channels, data_type,
+                                         JXL_BIG_ENDIAN, /*align=*/0});
+      }
+    }
+    return formats;
+  }
+
+  Status Begin(const PackedPixelFile& ppf, const JxlPixelFormat& format,
+               FILE* out) override {
+    JXL_RETURN_IF_ERROR(Encoder::VerifyBasicInfo(ppf.info));
+    JXL_RETURN_IF_ERROR(Encoder::VerifyBitDepth(
+        format.data_type, ppf.info.bits_per_sample,
+        ppf.info.exponent_bits_per_sample));
+    if (format.data_type != JXL_TYPE_UINT8 &&
+        (format.data_type != JXL_TYPE_UINT16 ||
+         format.endianness != JXL_BIG_ENDIAN)) {
+      return JXL_FAILURE("PNG: unsupported pixel format");
+    }
+    out_ = out;
+    bytes_per_sample_ = format.data_type == JXL_TYPE_UINT8 ? 1 : 2;
+    bits_per_sample_ = ppf.info.bits_per_sample;
+    num_samples_ = ppf.info.xsize * format.num_channels;
+
+    png_ptr_ = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr,
+                                       nullptr);
+    if (!png_ptr_) return JXL_FAILURE("Could not init png encoder");
+    info_ptr_ = png_create_info_struct(png_ptr_);
+    if (!info_ptr_) return JXL_FAILURE("Could not init png info struct");
+    png_set_compression_level(png_ptr_, 1);
+    png_set_write_fn(png_ptr_, this, &StreamingPNGEncoder::Write,
+                     &StreamingPNGEncoder::Flush);
+
+    png_byte color_type = (format.num_channels < 3 ? PNG_COLOR_TYPE_GRAY
+                                                   : PNG_COLOR_TYPE_RGB);
+    if (format.num_channels % 2 == 0) color_type |= PNG_COLOR_MASK_ALPHA;
+    png_set_IHDR(png_ptr_, info_ptr_, ppf.info.xsize, ppf.info.ysize,
+                 bytes_per_sample_ * kBitsPerByte, color_type,
+                 PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_BASE,
+                 PNG_FILTER_TYPE_BASE);
+    AddColorChunks(ppf, png_ptr_, info_ptr_);
+    png_write_info(png_ptr_, info_ptr_);
+    return !write_failed_;
+  }
+
+  Status WriteRow(const uint8_t* row) override {
+    if (bits_per_sample_ < bytes_per_sample_ * kBitsPerByte) {
+      // Rescale to the full range of the PNG sample type.
+      row_.resize(num_samples_ * bytes_per_sample_);
+      if (bytes_per_sample_ == 1) {
+        float mul = 255.0 / ((1u << bits_per_sample_) - 1);
+        for (size_t i = 0; i < num_samples_; ++i) {
+          row_[i] = static_cast<uint8_t>(std::lround(row[i] * mul));
+        }
+      } else {
+        float mul = 65535.0 / ((1u << bits_per_sample_) - 1);
+        for (size_t i = 0; i < num_samples_; ++i) {
+          StoreBE16(static_cast<uint32_t>(std::lround(LoadBE16(row + 2 * i) *
+                                                      mul)),
+                    row_.data() + 2 * i);
+        }
+      }
+      row = row_.data();
+    }
+    png_write_row(png_ptr_, const_cast<png_bytep>(row));
+    if (write_failed_) return JXL_FAILURE("PNG: failed to write row");
+    return true;
+  }
+
+  Status End(const PackedPixelFile& ppf) override {
+    // Text chunks may follow the image data.
+    JXL_RETURN_IF_ERROR(AddMetadataChunks(ppf.metadata, png_ptr_, info_ptr_));
+    png_write_end(png_ptr_, info_ptr_);
+    png_destroy_write_struct(&png_ptr_, &info_ptr_);
+    png_ptr_ = nullptr;
+    info_ptr_ = nullptr;
+    if (write_failed_) return JXL_FAILURE("PNG: failed to write file");
+    return true;
+  }
+
+ private:
+  static void Write(png_structp png_ptr, png_bytep data, png_size_t length) {
+    auto* self = static_cast<StreamingPNGEncoder*>(png_get_io_ptr(png_ptr));
+    if (fwrite(data, 1, length, self->out_) != length) {
+      self->write_failed_ = true;
+    }
+  }
+
+  static void Flush(png_structp png_ptr) {
+    auto* self = static_cast<StreamingPNGEncoder*>(png_get_io_ptr(png_ptr));
+    fflush(self->out_);
+  }
+
+  FILE* out_ = nullptr;
+  png_structp png_ptr_ = nullptr;
+  png_infop info_ptr_ = nullptr;
+  size_t bytes_per_sample_ = 1;
+  size_t bits_per_sample_ = 8;
+  size_t num_samples_ = 0;
+  std::vector<uint8_t> row_;
+  bool write_failed_ = false;
+};
+
 }  // namespace
 
 std::unique_ptr<Encoder> GetAPNGEncoder() {
   return jxl::make_unique<APNGEncoder>();
 }
 
+std::unique_ptr<StreamingEncoder> GetStreamingPNGEncoder() {
+  return jxl::make_unique<StreamingPNGEncoder>();
+}
+
 }  // namespace extras
 }  // namespace jxl
 
@@ -17,6 +17,9 @@ namespace extras {
 
 std::unique_ptr<Encoder> GetAPNGEncoder();
 
+// Returns nullptr if PNG support is disabled.
+std::unique_ptr<StreamingEncoder> GetStreamingPNGEncoder();
+
 }  // namespace extras
 }  // namespace jxl
 
@@ -12,6 +12,7 @@
 #include <jxl/types.h>
 
 #include <cstdint>
+#include <cstdio>
 #include <memory>
 #include <string>
 #include <unordered_map>
@@ -85,6 +86,32 @@ class Encoder {
   std::unordered_map<std::string, std::string> options_;
 };
 
+// Writes a single-frame image to a file row by row, in top-to-bottom order,
+// so that the full image never has to be held in memory.
+class StreamingEncoder {
+ public:
+  // Returns nullptr if the format has no streaming encoder.
+  static std::unique_ptr<StreamingEncoder> FromExtension(std::string extension);
+
+  virtual ~StreamingEncoder() = default;
+
+  // Set of pixel formats that this encoder takes as input.
+  virtual std::vector<JxlPixelFormat> AcceptedFormats() const = 0;
+
+  // Writes the header to `out`. `ppf` must have its basic info and color
+  // encoding set, its frames are not used.
+  virtual Status Begin(const PackedPixelFile& ppf, const JxlPixelFormat& format,
+                       FILE* out) = 0;
+
+  // Writes the next row of `ppf.info.xsize` pixels in the format passed to
+  // Begin().
+  virtual Status WriteRow(const uint8_t* row) = 0;
+
+  // Finishes the file after all rows were written. `ppf` may contain metadata
+  // that was not yet available when Begin() was called.
+  virtual Status End(const PackedPixelFile& ppf) = 0;
+};
+
 std::string ListOfEncodeCodecs();
 
 }  // namespace extras
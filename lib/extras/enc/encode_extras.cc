@@ -150,6 +150,18 @@ std::unique_ptr<Encoder> Encoder::FromExtension(std::string extension) {
   return nullptr;
 }
 
+std::unique_ptr<StreamingEncoder> StreamingEncoder::FromExtension(
+    std::string extension) {
+  std::transform(
+      extension.begin(), extension.end(), extension.begin(),
+      [](char c) { return std::tolower(c, std::locale::classic()); });
+  if (extension == ".png") return GetStreamingPNGEncoder();
+  if (extension == ".pgm") return GetStreamingPNMEncoder(/*num_channels=*/1);
+  if (extension == ".ppm") return GetStreamingPNMEncoder(/*num_channels=*/3);
+  if (extension == ".pnm") return GetStreamingPNMEncoder(/*num_channels=*/0);
+  return nullptr;
+}
+
 std::string ListOfEncodeCodecs() {
   std::string list_of_codecs("PPM, PNM, PFM, PAM, PGX");
   if (GetAPNGEncoder()) list_of_codecs.append(", PNG, APNG");
@@ -11,10 +11,12 @@
 #include <jxl/types.h>
 
 #include <algorithm>
+#include <cmath>
 #include <cstddef>
 #include <cstdint>
 #include <cstdio>
 #include <cstring>
+#include <utility>
 #include <vector>
 
 #include "lib/extras/packed_image.h"
@@ -398,5 +400,118 @@ bool EncodeImageJXL(const JXLCompressParams& params, const PackedPixelFile& ppf,
   return true;
 }
 
+bool EncodeImageJXLToTargetScore(const JXLCompressParams& params,
+                                 const PackedPixelFile& ppf,
+                                 const JXLScoreFunc& score,
+                                 const JXLTargetScoreParams& target,
+                                 std::vector<uint8_t>* compressed,
+                                 JXLTargetScoreResult* result) {
+  if (params.distance == 0 || params.HasOutputProcessor()) {
+    fprintf(stderr,
+            "Target score encoding needs lossy encoding to a buffer.\n");
+    return false;
+  }
+  if (!(target.min_distance > 0) ||
+      !(target.max_distance >= target.min_distance) ||
+      target.max_probes == 0 || !(target.tolerance >= 0)) {
+    fprintf(stderr, "Invalid target score parameters.\n");
+    return false;
+  }
+  // Below this ratio of bracketing distances, further probes are not worth
+  // their encode.
+  const double kMinLogStep = std::log(1.01);
+  // Step without a usable slope estimate.
+  const double kDefaultLogStep = std::log(1.5);
+  // Largest step when extrapolating.
+  const double kMaxLogStep = std::log(4.0);
+
+  struct Probe {
+    double log_distance;
+    double score;
+  };
+  const double min_x = std::log(target.min_distance);
+  const double max_x = std::log(target.max_distance);
+  // Aim at the middle of the tolerance window.
+  const double aim = target.target_score + 0.5 * target.tolerance;
+  // Largest distance that reaches the target and smallest one that does not.
+  Probe pass = {0.0, 0.0};
+  Probe fail = {0.0, 0.0};
+  bool have_pass = false;
+  bool have_fail = false;
+  Probe prev = {0.0, 0.0};
+  bool have_prev = false;
+
+  *result = JXLTargetScoreResult();
+  compressed->clear();
+  double x =
+      std::min(std::max<double>(std::log(params.distance), min_x), max_x);
+  while (result->num_probes < target.max_probes) {
+    JXLCompressParams probe_params = params;
+    probe_params.distance = std::exp(x);
+    std::vector<uint8_t> probe_bytes;
+    if (!EncodeImageJXL(probe_params, ppf, /*jpeg_bytes=*/nullptr,
+                        &probe_bytes)) {
+      return false;
+    }
+    double probe_score;
+    if (!score(probe_bytes, &probe_score)) return false;
+    result->num_probes++;
+    const Probe current = {x, probe_score};
+
+    if (probe_score >= target.target_score) {
+      if (!have_pass || x > pass.log_distance) {
+        pass = current;
+        have_pass = true;
+        *compressed = std::move(probe_bytes);
+        result->distance = probe_params.distance;
+        result->score = probe_score;
+        result->reached = true;
+      }
+      if (probe_score - target.target_score <= target.tolerance) break;
+    } else {
+      if (!have_fail || x < fail.log_distance) {
+        fail = current;
+        have_fail = true;
+      }
+      if (!result->reached &&
+          (compressed->empty() || probe_score > result->score)) {
+        *compressed = std::move(probe_bytes);
+        result->distance = probe_params.distance;
+        result->score = probe_score;
+      }
+    }
+
+    double next_x;
+    if (have_pass && have_fail) {
+      if (fail.log_distance - pass.log_distance < kMinLogStep) break;
+      // Interpolate within the bracket, but not too close to its ends, which
+      // would converge slowly where the score is not linear.
+      double t = (pass.score - aim) / (pass.score - fail.score);
+      t = std::min(std::max(t, 0.1), 0.9);
+      next_x =
+          pass.log_distance + t * (fail.log_distance - pass.log_distance);
+    } else {
+      // Extrapolate along the last two probes if the score decreases with the
+      // distance there, otherwise take a fixed step.
+      double step = probe_score >= aim ? kDefaultLogStep : -kDefaultLogStep;
+      if (have_prev && prev.log_distance != x) {
+        const double slope =
+            (probe_score - prev.score) / (x - prev.log_distance);
+        if (slope < 0) {
+          step = std::min(std::max((aim - probe_score) / slope, -kMaxLogStep),
+                          kMaxLogStep);
+        }
+      }
+      next_x = x + step;
+    }
+    next_x = std::min(std::max(next_x, min_x), max_x);
+    if (std::abs(next_x - x) < 1e-6) break;
+    prev = current;
+    have_prev = true;
+    x = next_x;
+  }
+  return true;
+}
+
 }  // namespace extras
 }  // namespace jxl
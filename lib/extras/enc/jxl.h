@@ -14,6 +14,7 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <functional>
 #include <vector>
 
 namespace jxl {
@@ -96,6 +97,43 @@ bool EncodeImageJXL(const JXLCompressParams& params, const PackedPixelFile& ppf,
                     const std::vector<uint8_t>* jpeg_bytes,
                     std::vector<uint8_t>* compressed);
 
+// Returns the quality of a compressed image in *score, higher is better, e.g.
+// the SSIMULACRA 2 score or the negated butteraugli distance of the decoded
+// image. Called once per probe encode, so anything that depends only on the
+// original image should be precomputed.
+using JXLScoreFunc =
+    std::function<bool(const std::vector<uint8_t>& compressed, double* score)>;
+
+struct JXLTargetScoreParams {
+  double target_score = 80.0;
+  // The search stops at a probe that reaches the target by at most this much.
+  double tolerance = 0.5;
+  // Range of the probed distances.
+  float min_distance = 0.1f;
+  float max_distance = 25.0f;
+  size_t max_probes = 8;
+};
+
+struct JXLTargetScoreResult {
+  float distance = 0.0f;
+  double score = 0.0;
+  size_t num_probes = 0;
+  // If no probe reached the target, the output is the best scoring probe.
+  bool reached = false;
+};
+
+// Encodes with the largest distance whose score reaches the target, which is
+// the smallest output of that quality. The search starts at params.distance
+// and interpolates in log(distance), where scores are close to linear, so it
+// typically needs three to five encodes. Not supported for lossless encoding,
+// JPEG transcoding or with an output processor.
+bool EncodeImageJXLToTargetScore(const JXLCompressParams& params,
+                                 const PackedPixelFile& ppf,
+                                 const JXLScoreFunc& score,
+                                 const JXLTargetScoreParams& target,
+                                 std::vector<uint8_t>* compressed,
+                                 JXLTargetScoreResult* result);
+
 }  // namespace extras
 }  // namespace jxl
 
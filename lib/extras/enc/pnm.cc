@@ -313,8 +313,75 @@ class PAMEncoder : public BasePNMEncoder {
   }
 };
 
+class StreamingPNMEncoder : public StreamingEncoder {
+ public:
+  explicit StreamingPNMEncoder(size_t num_channels)
+      : num_channels_(num_channels) {}
+
+  std::vector<JxlPixelFormat> AcceptedFormats() const override {
+    if (num_channels_ == 1) return PGMEncoder::kAcceptedFormats;
+    if (num_channels_ == 3) return PPMEncoder::kAcceptedFormats;
+    return PNMEncoder::kAcceptedFormats;
+  }
+
+  Status Begin(const PackedPixelFile& ppf, const JxlPixelFormat& format,
+               FILE* out) override {
+    JXL_RETURN_IF_ERROR(Encoder::VerifyBasicInfo(ppf.info));
+    JXL_RETURN_IF_ERROR(Encoder::VerifyBitDepth(
+        format.data_type, ppf.info.bits_per_sample,
+        ppf.info.exponent_bits_per_sample));
+    if (format.num_channels != 1 && format.num_channels != 3) {
+      return JXL_FAILURE("PNM: invalid number of channels");
+    }
+    if (format.data_type != JXL_TYPE_UINT8 &&
+        (format.data_type != JXL_TYPE_UINT16 ||
+         format.endianness != JXL_BIG_ENDIAN)) {
+      return JXL_FAILURE("PNM: unsupported pixel format");
+    }
+    uint32_t maxval = (1u << ppf.info.bits_per_sample) - 1;
+    char type = format.num_channels == 1 ? '5' : '6';
+    char header[kMaxHeaderSize];
+    size_t header_size =
+        snprintf(header, kMaxHeaderSize, "P%c\n%" PRIuS " %" PRIuS "\n%u\n",
+                 type, static_cast<size_t>(ppf.info.xsize),
+                 static_cast<size_t>(ppf.info.ysize), maxval);
+    JXL_RETURN_IF_ERROR(header_size < kMaxHeaderSize);
+    out_ = out;
+    row_size_ = ppf.info.xsize * format.num_channels *
+                PackedImage::BitsPerChannel(format.data_type) / kBitsPerByte;
+    if (fwrite(header, 1, header_size, out_) != header_size) {
+      return JXL_FAILURE("PNM: failed to write header");
+    }
+    return true;
+  }
+
+  Status WriteRow(const uint8_t* row) override {
+    if (fwrite(row, 1, row_size_, out_) != row_size_) {
+      return JXL_FAILURE("PNM: failed to write row");
+    }
+    return true;
+  }
+
+  Status End(const PackedPixelFile& ppf) override {
+    if (!ppf.metadata.exif.empty() || !ppf.metadata.iptc.empty() ||
+        !ppf.metadata.jumbf.empty() || !ppf.metadata.xmp.empty()) {
+      JXL_WARNING("PNM encoder ignoring metadata - use a different codec");
+    }
+    return true;
+  }
+
+ private:
+  size_t num_channels_;
+  FILE* out_ = nullptr;
+  size_t row_size_ = 0;
+};
+
 }  // namespace
 
+std::unique_ptr<StreamingEncoder> GetStreamingPNMEncoder(size_t num_channels) {
+  return jxl::make_unique<StreamingPNMEncoder>(num_channels);
+}
+
 std::unique_ptr<Encoder> GetPPMEncoder() {
   return jxl::make_unique<PPMEncoder>();
 }
@@ -10,6 +10,7 @@
 
 // TODO(janwas): workaround for incorrect Win64 codegen (cause unknown)
 #include <hwy/highway.h>
+#include <cstddef>
 #include <memory>
 
 #include "lib/extras/enc/encode.h"
@@ -23,6 +24,10 @@ std::unique_ptr<Encoder> GetPNMEncoder();
 std::unique_ptr<Encoder> GetPPMEncoder();
 std::unique_ptr<Encoder> GetPFMEncoder();
 
+// Streaming PGM (num_channels = 1), PPM (num_channels = 3) or either of them
+// (num_channels = 0) encoder.
+std::unique_ptr<StreamingEncoder> GetStreamingPNMEncoder(size_t num_channels);
+
 }  // namespace extras
 }  // namespace jxl
 
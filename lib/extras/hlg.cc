@@ -32,12 +32,19 @@ Status HlgOOTF(ImageBundle* ib, const float gamma, ThreadPool* pool) {
   JXL_RETURN_IF_ERROR(linear_rec2020.CreateICC());
   JXL_RETURN_IF_ERROR(
       ib->TransformTo(linear_rec2020, *JxlGetDefaultCms(), pool));
+  return HlgOOTF(ib->color(), gamma, pool);
+}
 
+Status HlgInverseOOTF(ImageBundle* ib, const float gamma, ThreadPool* pool) {
+  return HlgOOTF(ib, 1.f / gamma, pool);
+}
+
+Status HlgOOTF(Image3F* linear_rec2020, const float gamma, ThreadPool* pool) {
   const auto process_row = [&](const int y, const int thread) -> Status {
-    float* const JXL_RESTRICT rows[3] = {ib->color()->PlaneRow(0, y),
-                                         ib->color()->PlaneRow(1, y),
-                                         ib->color()->PlaneRow(2, y)};
-    for (size_t x = 0; x < ib->xsize(); ++x) {
+    float* const JXL_RESTRICT rows[3] = {linear_rec2020->PlaneRow(0, y),
+                                         linear_rec2020->PlaneRow(1, y),
+                                         linear_rec2020->PlaneRow(2, y)};
+    for (size_t x = 0; x < linear_rec2020->xsize(); ++x) {
       float& red = rows[0][x];
       float& green = rows[1][x];
       float& blue = rows[2][x];
@@ -52,13 +59,14 @@ Status HlgOOTF(ImageBundle* ib, const float gamma, ThreadPool* pool) {
     return true;
   };
 
-  JXL_RETURN_IF_ERROR(RunOnPool(pool, 0, ib->ysize(), ThreadPool::NoInit,
-                                process_row, "HlgOOTF"));
+  JXL_RETURN_IF_ERROR(RunOnPool(pool, 0, linear_rec2020->ysize(),
+                                ThreadPool::NoInit, process_row, "HlgOOTF"));
   return true;
 }
 
-Status HlgInverseOOTF(ImageBundle* ib, const float gamma, ThreadPool* pool) {
-  return HlgOOTF(ib, 1.f / gamma, pool);
+Status HlgInverseOOTF(Image3F* linear_rec2020, const float gamma,
+                      ThreadPool* pool) {
+  return HlgOOTF(linear_rec2020, 1.f / gamma, pool);
 }
 
 }  // namespace jxl
@@ -8,6 +8,7 @@
 
 #include "lib/jxl/base/data_parallel.h"
 #include "lib/jxl/base/status.h"
+#include "lib/jxl/image.h"
 #include "lib/jxl/image_bundle.h"
 
 namespace jxl {
@@ -18,6 +19,14 @@ Status HlgOOTF(ImageBundle* ib, float gamma, ThreadPool* pool = nullptr);
 
 Status HlgInverseOOTF(ImageBundle* ib, float gamma, ThreadPool* pool = nullptr);
 
+// Same as above, for an image that is already in linear Rec. 2020, e.g. a band
+// of rows of a larger image.
+Status HlgOOTF(Image3F* linear_rec2020, float gamma,
+               ThreadPool* pool = nullptr);
+
+Status HlgInverseOOTF(Image3F* linear_rec2020, float gamma,
+                      ThreadPool* pool = nullptr);
+
 }  // namespace jxl
 
 #endif  // LIB_EXTRAS_HLG_H_
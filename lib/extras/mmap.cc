@@ -5,6 +5,7 @@
 
 #include "mmap.h"
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
 #include <cstdio>
@@ -43,6 +44,16 @@ struct MemoryMappedFileImpl {
   const uint8_t* data() const { return reinterpret_cast<const uint8_t*>(ptr); }
   size_t size() const { return mmap_len; }
 
+  void Prefetch(size_t offset, size_t size) const {
+    if (offset >= mmap_len) return;
+    size = std::min(size, mmap_len - offset);
+    const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const size_t begin = offset - offset % page_size;
+    // This is only a hint, failures are not an error.
+    (void)madvise(static_cast<uint8_t*>(ptr) + begin, offset + size - begin,
+                  MADV_WILLNEED);
+  }
+
   ~MemoryMappedFileImpl() {
     if (fd != -1) {
       close(fd);
@@ -107,6 +118,10 @@ struct MemoryMappedFileImpl {
   const uint8_t* data() const { return reinterpret_cast<const uint8_t*>(ptr); }
   size_t size() const { return fsize.QuadPart; }
 
+  // The file is opened with FILE_FLAG_SEQUENTIAL_SCAN, which already makes
+  // the cache manager read ahead.
+  void Prefetch(size_t offset, size_t size) const {}
+
   HandleUniquePtr handle;
   HandleUniquePtr handle_mapping;
   LARGE_INTEGER fsize;
@@ -127,6 +142,7 @@ struct MemoryMappedFileImpl {
 
   const uint8_t* data() const { return nullptr; }
   size_t size() const { return 0; }
+  void Prefetch(size_t offset, size_t size) const {}
 };
 
 }  // namespace jxl
@@ -150,4 +166,7 @@ MemoryMappedFile& MemoryMappedFile::operator=(MemoryMappedFile&&) noexcept =
 
 const uint8_t* MemoryMappedFile::data() const { return impl_->data(); }
 size_t MemoryMappedFile::size() const { return impl_->size(); }
+void MemoryMappedFile::Prefetch(size_t offset, size_t size) const {
+  impl_->Prefetch(offset, size);
+}
 }  // namespace jxl
@@ -20,6 +20,9 @@ class MemoryMappedFile {
   static StatusOr<MemoryMappedFile> Init(const char* path);
   const uint8_t* data() const;
   size_t size() const;
+  // Hints the OS that bytes [offset, offset + size) will be accessed soon, so
+  // that they can be fetched asynchronously. Out-of-range parts are ignored.
+  void Prefetch(size_t offset, size_t size) const;
   MemoryMappedFile();                                        // NOLINT
   ~MemoryMappedFile();                                       // NOLINT
   MemoryMappedFile(MemoryMappedFile&&) noexcept;             // NOLINT
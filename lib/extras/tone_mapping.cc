@@ -32,8 +32,8 @@ namespace HWY_NAMESPACE {
 
 static constexpr Vector3 rec2020_luminances{0.2627f, 0.6780f, 0.0593f};
 
-Status ToneMapFrame(const Range& display_nits, ImageBundle* const ib,
-                    ThreadPool* const pool) {
+Status ToneMapLinear(const Range& source_nits, const Range& display_nits,
+                     Image3F* const color, ThreadPool* const pool) {
   // Perform tone mapping as described in Report ITU-R BT.2390-8, section 5.4
   // (pp. 23-25).
   // https://www.itu.int/pub/R-REP-BT.2390-8-2020
@@ -41,60 +41,42 @@ Status ToneMapFrame(const Range& display_nits, ImageBundle* const ib,
   HWY_FULL(float) df;
   using V = decltype(Zero(df));
 
-  ColorEncoding linear_rec2020;
-  linear_rec2020.SetColorSpace(ColorSpace::kRGB);
-  JXL_RETURN_IF_ERROR(linear_rec2020.SetPrimariesType(Primaries::k2100));
-  JXL_RETURN_IF_ERROR(linear_rec2020.SetWhitePointType(WhitePoint::kD65));
-  linear_rec2020.Tf().SetTransferFunction(TransferFunction::kLinear);
-  JXL_RETURN_IF_ERROR(linear_rec2020.CreateICC());
-  JXL_RETURN_IF_ERROR(
-      ib->TransformTo(linear_rec2020, *JxlGetDefaultCms(), pool));
-
-  Rec2408ToneMapper<decltype(df)> tone_mapper(
-      {ib->metadata()->tone_mapping.min_nits,
-       ib->metadata()->IntensityTarget()},
-      display_nits, rec2020_luminances);
+  Rec2408ToneMapper<decltype(df)> tone_mapper(source_nits, display_nits,
+                                              rec2020_luminances);
+  const LuminanceScaleTable multipliers(
+      [&](float luminance) { return tone_mapper.Multiplier(luminance); });
 
   const auto process_row = [&](const uint32_t y,
                                size_t /* thread */) -> Status {
-    float* const JXL_RESTRICT row_r = ib->color()->PlaneRow(0, y);
-    float* const JXL_RESTRICT row_g = ib->color()->PlaneRow(1, y);
-    float* const JXL_RESTRICT row_b = ib->color()->PlaneRow(2, y);
-    for (size_t x = 0; x < ib->xsize(); x += Lanes(df)) {
+    float* const JXL_RESTRICT row_r = color->PlaneRow(0, y);
+    float* const JXL_RESTRICT row_g = color->PlaneRow(1, y);
+    float* const JXL_RESTRICT row_b = color->PlaneRow(2, y);
+    for (size_t x = 0; x < color->xsize(); x += Lanes(df)) {
       V red = Load(df, row_r + x);
       V green = Load(df, row_g + x);
       V blue = Load(df, row_b + x);
-      tone_mapper.ToneMap(&red, &green, &blue);
+      tone_mapper.ToneMap(multipliers, &red, &green, &blue);
       Store(red, df, row_r + x);
       Store(green, df, row_g + x);
       Store(blue, df, row_b + x);
     }
     return true;
   };
-  JXL_RETURN_IF_ERROR(RunOnPool(pool, 0, ib->ysize(), ThreadPool::NoInit,
+  JXL_RETURN_IF_ERROR(RunOnPool(pool, 0, color->ysize(), ThreadPool::NoInit,
                                 process_row, "ToneMap"));
   return true;
 }
 
-Status GamutMapFrame(ImageBundle* const ib, float preserve_saturation,
-                     ThreadPool* const pool) {
+Status GamutMapLinear(Image3F* const color, float preserve_saturation,
+                      ThreadPool* const pool) {
   HWY_FULL(float) df;
   using V = decltype(Zero(df));
 
-  ColorEncoding linear_rec2020;
-  linear_rec2020.SetColorSpace(ColorSpace::kRGB);
-  JXL_RETURN_IF_ERROR(linear_rec2020.SetPrimariesType(Primaries::k2100));
-  JXL_RETURN_IF_ERROR(linear_rec2020.SetWhitePointType(WhitePoint::kD65));
-  linear_rec2020.Tf().SetTransferFunction(TransferFunction::kLinear);
-  JXL_RETURN_IF_ERROR(linear_rec2020.CreateICC());
-  JXL_RETURN_IF_ERROR(
-      ib->TransformTo(linear_rec2020, *JxlGetDefaultCms(), pool));
-
   const auto process_row = [&](const uint32_t y, size_t /* thread*/) -> Status {
-    float* const JXL_RESTRICT row_r = ib->color()->PlaneRow(0, y);
-    float* const JXL_RESTRICT row_g = ib->color()->PlaneRow(1, y);
-    float* const JXL_RESTRICT row_b = ib->color()->PlaneRow(2, y);
-    for (size_t x = 0; x < ib->xsize(); x += Lanes(df)) {
+    float* const JXL_RESTRICT row_r = color->PlaneRow(0, y);
+    float* const JXL_RESTRICT row_g = color->PlaneRow(1, y);
+    float* const JXL_RESTRICT row_b = color->PlaneRow(2, y);
+    for (size_t x = 0; x < color->xsize(); x += Lanes(df)) {
       V red = Load(df, row_r + x);
       V green = Load(df, row_g + x);
       V blue = Load(df, row_b + x);
@@ -106,7 +88,7 @@ Status GamutMapFrame(ImageBundle* const ib, float preserve_saturation,
     return true;
   };
 
-  JXL_RETURN_IF_ERROR(RunOnPool(pool, 0, ib->ysize(), ThreadPool::NoInit,
+  JXL_RETURN_IF_ERROR(RunOnPool(pool, 0, color->ysize(), ThreadPool::NoInit,
                                 process_row, "GamutMap"));
 
   return true;
@@ -121,15 +103,41 @@ HWY_AFTER_NAMESPACE();
 namespace jxl {
 
 namespace {
-HWY_EXPORT(ToneMapFrame);
-HWY_EXPORT(GamutMapFrame);
+HWY_EXPORT(ToneMapLinear);
+HWY_EXPORT(GamutMapLinear);
+
+Status TransformToLinearRec2020(ImageBundle* const ib, ThreadPool* const pool) {
+  ColorEncoding linear_rec2020;
+  linear_rec2020.SetColorSpace(ColorSpace::kRGB);
+  JXL_RETURN_IF_ERROR(linear_rec2020.SetPrimariesType(Primaries::k2100));
+  JXL_RETURN_IF_ERROR(linear_rec2020.SetWhitePointType(WhitePoint::kD65));
+  linear_rec2020.Tf().SetTransferFunction(TransferFunction::kLinear);
+  JXL_RETURN_IF_ERROR(linear_rec2020.CreateICC());
+  return ib->TransformTo(linear_rec2020, *JxlGetDefaultCms(), pool);
+}
+
 }  // namespace
 
+Status ToneMapImage(const Range& source_nits, const Range& display_nits,
+                    Image3F* const linear_rec2020, ThreadPool* const pool) {
+  return HWY_DYNAMIC_DISPATCH(ToneMapLinear)(source_nits, display_nits,
+                                             linear_rec2020, pool);
+}
+
+Status GamutMapImage(Image3F* const linear_rec2020, float preserve_saturation,
+                     ThreadPool* const pool) {
+  return HWY_DYNAMIC_DISPATCH(GamutMapLinear)(linear_rec2020,
+                                              preserve_saturation, pool);
+}
+
 Status ToneMapTo(const Range& display_nits, CodecInOut* const io,
                  ThreadPool* const pool) {
-  const auto tone_map_frame = HWY_DYNAMIC_DISPATCH(ToneMapFrame);
+  const Range source_nits = {io->metadata.m.tone_mapping.min_nits,
+                             io->metadata.m.IntensityTarget()};
   for (ImageBundle& ib : io->frames) {
-    JXL_RETURN_IF_ERROR(tone_map_frame(display_nits, &ib, pool));
+    JXL_RETURN_IF_ERROR(TransformToLinearRec2020(&ib, pool));
+    JXL_RETURN_IF_ERROR(
+        ToneMapImage(source_nits, display_nits, ib.color(), pool));
   }
   io->metadata.m.SetIntensityTarget(display_nits[1]);
   return true;
@@ -137,9 +145,9 @@ Status ToneMapTo(const Range& display_nits, CodecInOut* const io,
 
 Status GamutMap(CodecInOut* const io, float preserve_saturation,
                 ThreadPool* const pool) {
-  const auto gamut_map_frame = HWY_DYNAMIC_DISPATCH(GamutMapFrame);
   for (ImageBundle& ib : io->frames) {
-    JXL_RETURN_IF_ERROR(gamut_map_frame(&ib, preserve_saturation, pool));
+    JXL_RETURN_IF_ERROR(TransformToLinearRec2020(&ib, pool));
+    JXL_RETURN_IF_ERROR(GamutMapImage(ib.color(), preserve_saturation, pool));
   }
   return true;
 }
@@ -11,6 +11,7 @@
 #include "lib/extras/codec_in_out.h"
 #include "lib/jxl/base/data_parallel.h"
 #include "lib/jxl/base/status.h"
+#include "lib/jxl/image.h"
 
 namespace jxl {
 
@@ -29,6 +30,15 @@ Status ToneMapTo(const Range& display_nits, CodecInOut* io,
 Status GamutMap(CodecInOut* io, float preserve_saturation,
                 ThreadPool* pool = nullptr);
 
+// Same as ToneMapTo and GamutMap, for an image that is already in linear
+// Rec. 2020 with a D65 white point, e.g. a band of rows of a larger image.
+// `source_nits` is the luminance range of the image.
+Status ToneMapImage(const Range& source_nits, const Range& display_nits,
+                    Image3F* linear_rec2020, ThreadPool* pool = nullptr);
+
+Status GamutMapImage(Image3F* linear_rec2020, float preserve_saturation,
+                     ThreadPool* pool = nullptr);
+
 }  // namespace jxl
 
 #endif  // LIB_EXTRAS_TONE_MAPPING_H_
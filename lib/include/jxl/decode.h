@@ -16,6 +16,7 @@
 #include <jxl/cms_interface.h>
 #include <jxl/codestream_header.h>
 #include <jxl/color_encoding.h>
+#include <jxl/decode_stats.h>
 #include <jxl/jxl_export.h>
 #include <jxl/memory_manager.h>
 #include <jxl/parallel_runner.h>
@@ -381,6 +382,7 @@ typedef enum {
  * settings set by a call to
  *  - @ref JxlDecoderSetCoalescing,
  *  - @ref JxlDecoderSetDesiredIntensityTarget,
+ *  - @ref JxlDecoderSetGainMapHeadroom,
  *  - @ref JxlDecoderSetDecompressBoxes,
  *  - @ref JxlDecoderSetKeepOrientation,
  *  - @ref JxlDecoderSetUnpremultiplyAlpha,
@@ -841,6 +843,27 @@ JXL_EXPORT JxlDecoderStatus JxlDecoderSetPreferredColorProfile(
 JXL_EXPORT JxlDecoderStatus JxlDecoderSetDesiredIntensityTarget(
     JxlDecoder* dec, float desired_intensity_target);
 
+/** Requests that the decoder apply the ISO 21496-1 gain map of the image, if
+ * any, to render it for a display whose HDR headroom is @c display_headroom.
+ * The gain map is applied while rendering the pixels, row by row, in place of
+ * the tone mapping of @ref JxlDecoderSetDesiredIntensityTarget. The returned
+ * pixels are linear-light values relative to the reference white of the base
+ * image if the output color profile is linear and not PQ; other transfer
+ * functions clip them as usual.
+ * @note The gain map box ("jhgm") must precede the first frame of the
+ * codestream, as it does when added with @ref JxlEncoderAddBox before the
+ * frames. Otherwise, and if its metadata requires a newer version of the
+ * standard, the base image is returned unchanged. Must be called before
+ * decoding starts.
+ * @param dec decoder object
+ * @param display_headroom log2 of the ratio of the peak luminance of the
+ * display to its reference white, e.g. 0 for an SDR display.
+ * @return ::JXL_DEC_SUCCESS if the preference was set successfully, @ref
+ * JXL_DEC_ERROR otherwise.
+ */
+JXL_EXPORT JxlDecoderStatus JxlDecoderSetGainMapHeadroom(
+    JxlDecoder* dec, float display_headroom);
+
 /**
  * Sets the desired output color profile of the decoded image either from a
  * color encoding or an ICC profile. Valid calls of this function have either @c
@@ -1463,6 +1486,24 @@ JXL_EXPORT JxlDecoderStatus JxlDecoderFlushImage(JxlDecoder* dec);
 JXL_EXPORT JxlDecoderStatus
 JxlDecoderSetImageOutBitDepth(JxlDecoder* dec, const JxlBitDepth* bit_depth);
 
+/**
+ * Sets the given stats object for gathering statistics about the decoded
+ * frames: section sizes, groups decoded, time spent in the decoding stages,
+ * allocations and peak memory. Measuring the time adds a small overhead to
+ * decoding.
+ *
+ * The allocations are observed by forwarding the memory manager of the
+ * decoder through @p stats, so @p stats must outlive the decoder, or
+ * collection must be stopped first by calling this function with NULL. A stats
+ * object can only collect from one decoder at a time. @ref JxlDecoderReset
+ * stops the collection.
+ *
+ * @param dec decoder object
+ * @param stats object that can be used to query the gathered stats (created
+ *   by @ref JxlDecoderStatsCreate), or NULL to stop collecting
+ */
+JXL_EXPORT void JxlDecoderCollectStats(JxlDecoder* dec, JxlDecoderStats* stats);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,181 @@
+/* Copyright (c) the JPEG XL Project Authors. All rights reserved.
+ *
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ */
+
+/** @addtogroup libjxl_decoder
+ * @{
+ * @file decode_stats.h
+ * @brief API to collect various statistics from JXL decoder.
+ */
+
+#ifndef JXL_DECODE_STATS_H_
+#define JXL_DECODE_STATS_H_
+
+#include <jxl/jxl_export.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Opaque structure that holds the decoder statistics.
+ *
+ * Allocated and initialized with @ref JxlDecoderStatsCreate().
+ * Cleaned up and deallocated with @ref JxlDecoderStatsDestroy().
+ */
+typedef struct JxlDecoderStats JxlDecoderStats;
+
+/**
+ * Creates an instance of JxlDecoderStats and initializes it.
+ *
+ * @return pointer to initialized @ref JxlDecoderStats instance
+ */
+JXL_EXPORT JxlDecoderStats* JxlDecoderStatsCreate(void);
+
+/**
+ * Deinitializes and frees JxlDecoderStats instance.
+ *
+ * @param stats instance to be cleaned up and deallocated. No-op if stats is
+ * null pointer.
+ */
+JXL_EXPORT void JxlDecoderStatsDestroy(JxlDecoderStats* stats);
+
+/** Data type for querying @ref JxlDecoderStats object
+ */
+typedef enum {
+  /** Bytes of the frame headers and tables of contents.
+   */
+  JXL_DEC_STAT_HEADER_BYTES,
+  /** Bytes of the sections of each type. A frame with a single group and a
+   * single pass has only one section, which is counted as an AC group.
+   */
+  JXL_DEC_STAT_DC_GLOBAL_BYTES,
+  JXL_DEC_STAT_DC_GROUP_BYTES,
+  JXL_DEC_STAT_AC_GLOBAL_BYTES,
+  JXL_DEC_STAT_AC_GROUP_BYTES,
+  /** Number of DC groups decoded.
+   */
+  JXL_DEC_STAT_NUM_DC_GROUPS,
+  /** Number of AC group sections decoded, one per group and pass.
+   */
+  JXL_DEC_STAT_NUM_AC_GROUPS,
+  /** Time in microseconds spent reading the global sections, the DC groups,
+   * the AC coefficients and the modular group streams. Work that runs in
+   * parallel is summed over the threads, so this can exceed the wall time.
+   */
+  JXL_DEC_STAT_ENTROPY_DECODE_USEC,
+  /** Time in microseconds spent in dequantization, inverse DCT, DC smoothing
+   * and the inverse modular transforms, summed over threads.
+   */
+  JXL_DEC_STAT_TRANSFORM_USEC,
+  /** Time in microseconds spent in the render pipeline, that is filtering,
+   * upsampling, blending, color conversion and writing the output, summed
+   * over threads.
+   */
+  JXL_DEC_STAT_RENDER_USEC,
+  /** Number of allocations made through the memory manager of the decoder.
+   */
+  JXL_DEC_STAT_NUM_ALLOCATIONS,
+  /** Largest number of bytes allocated through the memory manager of the
+   * decoder at any one time. Only allocations made while the statistics are
+   * collected are accounted.
+   */
+  JXL_DEC_STAT_PEAK_MEMORY_BYTES,
+  JXL_DEC_NUM_STATS,
+} JxlDecoderStatsKey;
+
+/** Returns the value of the statistics corresponding the given key, for all
+ * frames decoded so far. Peak memory is the maximum, all other values are
+ * totals. The allocations also include those made outside of frames, e.g.
+ * while reading the image headers.
+ *
+ * @param stats object that was passed to the decoder with
+ *   @ref JxlDecoderCollectStats
+ * @param key the particular statistics to query
+ *
+ * @return the value of the statistics
+ */
+JXL_EXPORT size_t JxlDecoderStatsGet(const JxlDecoderStats* stats,
+                                     JxlDecoderStatsKey key);
+
+/** Returns the number of frames for which statistics were collected. This
+ * counts each frame of the codestream that was decoded, including frames that
+ * are not displayed by themselves, such as reference frames for patches, but
+ * not frames skipped with @ref JxlDecoderSkipFrames.
+ *
+ * @param stats object that was passed to the decoder with
+ *   @ref JxlDecoderCollectStats
+ *
+ * @return the number of frames
+ */
+JXL_EXPORT size_t JxlDecoderStatsNumFrames(const JxlDecoderStats* stats);
+
+/** Returns the value of the statistics corresponding the given key, for one
+ * frame.
+ *
+ * @param stats object that was passed to the decoder with
+ *   @ref JxlDecoderCollectStats
+ * @param frame index of the frame, in decoding order, smaller than
+ *   @ref JxlDecoderStatsNumFrames
+ * @param key the particular statistics to query
+ *
+ * @return the value of the statistics, or 0 if the frame does not exist
+ */
+JXL_EXPORT size_t JxlDecoderStatsGetFrame(const JxlDecoderStats* stats,
+                                          size_t frame,
+                                          JxlDecoderStatsKey key);
+
+/** Updates the values of the given stats object with that of an other. The
+ * frames of @p other are appended to those of @p stats.
+ *
+ * @param stats object whose values will be updated
+ * @param other stats object whose values will be merged with stats
+ */
+JXL_EXPORT void JxlDecoderStatsMerge(JxlDecoderStats* stats,
+                                     const JxlDecoderStats* other);
+
+/** Counters of the process-wide cache of ICC profiles, which all encoders and
+ * decoders share. Images often carry one of a few common profiles, which are
+ * then decoded from the codestream and parsed by the color management system
+ * only once.
+ */
+typedef struct {
+  /** Number of ICC profiles read from codestreams.
+   */
+  uint64_t decode_lookups;
+  /** Number of these that were found in the cache, so that decoding them was
+   * skipped.
+   */
+  uint64_t decode_hits;
+  /** Number of ICC profiles parsed by a color management system, e.g. to set
+   * the color encoding of the encoder or the output color profile of the
+   * decoder.
+   */
+  uint64_t parse_lookups;
+  /** Number of these that were found in the cache, so that parsing them was
+   * skipped.
+   */
+  uint64_t parse_hits;
+  /** Number of decoded and parsed profiles held by the cache.
+   */
+  uint64_t num_entries;
+} JxlICCCacheStats;
+
+/** Returns the counters of the process-wide ICC profile cache since the start
+ * of the process. The hit rate of decoding is decode_hits / decode_lookups.
+ *
+ * @param stats the counters
+ */
+JXL_EXPORT void JxlDecoderGetICCCacheStats(JxlICCCacheStats* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* JXL_DECODE_STATS_H_ */
+
+/** @}*/
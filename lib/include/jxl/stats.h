@@ -72,6 +72,17 @@ typedef enum {
   JXL_ENC_STAT_NUM_DCT32X64_BLOCKS,
   JXL_ENC_STAT_NUM_DCT64_BLOCKS,
   JXL_ENC_STAT_NUM_BUTTERAUGLI_ITERS,
+  /** Wall time in microseconds spent in the individual encoder phases.
+   * The phases do not overlap; time spent in worker threads of a phase is
+   * attributed to the phase as wall time, not CPU time.
+   */
+  JXL_ENC_STAT_INPUT_USEC,
+  JXL_ENC_STAT_HEURISTICS_USEC,
+  JXL_ENC_STAT_COEF_ORDER_USEC,
+  JXL_ENC_STAT_TOKENIZATION_USEC,
+  JXL_ENC_STAT_MODULAR_USEC,
+  JXL_ENC_STAT_HISTOGRAM_USEC,
+  JXL_ENC_STAT_GROUP_ENCODING_USEC,
   JXL_ENC_NUM_STATS,
 } JxlEncoderStatsKey;
 
@@ -86,7 +97,81 @@ typedef enum {
 JXL_EXPORT size_t JxlEncoderStatsGet(const JxlEncoderStats* stats,
                                      JxlEncoderStatsKey key);
 
-/** Updates the values of the given stats object with that of an other.
+/** Data type for querying the statistics of one group with
+ * @ref JxlEncoderStatsGetGroup.
+ */
+typedef enum {
+  /** Position and size of the group in its frame, in pixels.
+   */
+  JXL_ENC_GROUP_STAT_X0,
+  JXL_ENC_GROUP_STAT_Y0,
+  JXL_ENC_GROUP_STAT_XSIZE,
+  JXL_ENC_GROUP_STAT_YSIZE,
+  /** Time in microseconds spent on the group in the heuristics (AC strategy
+   * and quantization field search, DCT and quantization), tokenization and
+   * group encoding phases. Groups are processed in parallel, so these are
+   * thread times rather than shares of the phase wall times.
+   */
+  JXL_ENC_GROUP_STAT_HEURISTICS_USEC,
+  JXL_ENC_GROUP_STAT_TOKENIZATION_USEC,
+  JXL_ENC_GROUP_STAT_ENCODING_USEC,
+  /** Size of the AC group sections of the group, summed over all passes.
+   */
+  JXL_ENC_GROUP_STAT_BITS,
+  /** Number of varblocks of each transform size whose top-left 8x8 block is
+   * in the group.
+   */
+  JXL_ENC_GROUP_STAT_NUM_SMALL_BLOCKS,
+  JXL_ENC_GROUP_STAT_NUM_DCT4X8_BLOCKS,
+  JXL_ENC_GROUP_STAT_NUM_AFV_BLOCKS,
+  JXL_ENC_GROUP_STAT_NUM_DCT8_BLOCKS,
+  JXL_ENC_GROUP_STAT_NUM_DCT8X16_BLOCKS,
+  JXL_ENC_GROUP_STAT_NUM_DCT8X32_BLOCKS,
+  JXL_ENC_GROUP_STAT_NUM_DCT16_BLOCKS,
+  JXL_ENC_GROUP_STAT_NUM_DCT16X32_BLOCKS,
+  JXL_ENC_GROUP_STAT_NUM_DCT32_BLOCKS,
+  JXL_ENC_GROUP_STAT_NUM_DCT32X64_BLOCKS,
+  /** Includes the larger transforms.
+   */
+  JXL_ENC_GROUP_STAT_NUM_DCT64_BLOCKS,
+  /** Minimum, maximum and sum of the AC quantization field over the 8x8
+   * blocks of the group. Larger values mean finer quantization.
+   */
+  JXL_ENC_GROUP_STAT_MIN_QUANT,
+  JXL_ENC_GROUP_STAT_MAX_QUANT,
+  JXL_ENC_GROUP_STAT_QUANT_SUM,
+  JXL_ENC_GROUP_NUM_STATS,
+} JxlEncoderGroupStatsKey;
+
+/** Returns the number of groups for which statistics were collected. These
+ * are the groups of all VarDCT frames encoded so far, in encoding order and
+ * in raster order within a frame. Frames encoded in streaming mode and
+ * modular frames have no group statistics.
+ *
+ * @param stats object that was passed to the encoder with a
+ *   @ref JxlEncoderCollectStats function
+ *
+ * @return the number of groups
+ */
+JXL_EXPORT size_t JxlEncoderStatsNumGroups(const JxlEncoderStats* stats);
+
+/** Returns the value of the statistics of one group corresponding the given
+ * key.
+ *
+ * @param stats object that was passed to the encoder with a
+ *   @ref JxlEncoderCollectStats function
+ * @param group index of the group, smaller than
+ *   @ref JxlEncoderStatsNumGroups
+ * @param key the particular statistics to query
+ *
+ * @return the value of the statistics, or 0 if the group does not exist
+ */
+JXL_EXPORT size_t JxlEncoderStatsGetGroup(const JxlEncoderStats* stats,
+                                          size_t group,
+                                          JxlEncoderGroupStatsKey key);
+
+/** Updates the values of the given stats object with that of an other. The
+ * groups of @p other are appended to those of @p stats.
  *
  * @param stats object whose values will be updated (usually added together)
  * @param other stats object whose values will be merged with stats
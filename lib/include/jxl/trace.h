@@ -0,0 +1,64 @@
+/* Copyright (c) the JPEG XL Project Authors. All rights reserved.
+ *
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ */
+
+/** @addtogroup libjxl_common
+ * @{
+ * @file trace.h
+ * @brief Tracing of encoder and decoder internals, for performance analysis.
+ */
+
+#ifndef JXL_TRACE_H_
+#define JXL_TRACE_H_
+
+#include <jxl/jxl_export.h>
+#include <jxl/types.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Receives the trace as consecutive chunks of one Chrome trace event JSON
+ * document, which can be loaded in chrome://tracing or
+ * https://ui.perfetto.dev. Calls are serialized, but may happen on any thread
+ * that runs the encoder or decoder.
+ *
+ * @param opaque the value passed to @ref JxlTraceStart.
+ * @param data chunk of the document, not null-terminated.
+ * @param size size of the chunk in bytes.
+ */
+typedef void (*JxlTraceWriteFunc)(void* opaque, const char* data, size_t size);
+
+/**
+ * Starts recording, for all encoders and decoders of the process, when and on
+ * which thread the groups, passes and pipeline stages are processed.
+ *
+ * Tracing is only available if the library was built with
+ * JPEGXL_ENABLE_TRACING; otherwise this does nothing.
+ *
+ * @param write function that receives the trace.
+ * @param opaque passed to @p write.
+ * @return @ref JXL_FALSE if tracing is not built in or a trace is already
+ * being recorded, @ref JXL_TRUE otherwise.
+ */
+JXL_EXPORT JXL_BOOL JxlTraceStart(JxlTraceWriteFunc write, void* opaque);
+
+/**
+ * Stops recording and writes the remaining events and the end of the
+ * document. The write function is not called after this returns. Best called
+ * when no encoder or decoder is running, since events that are still in
+ * progress are dropped.
+ */
+JXL_EXPORT void JxlTraceStop(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* JXL_TRACE_H_ */
+
+/** @}*/
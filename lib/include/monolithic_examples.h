@@ -14,6 +14,7 @@ extern int jpegXL_decode_oneshot_main(int argc, const char** argv);
 extern int jpegXL_decompress_main(int argc, const char** argv);
 extern int jpegXL_exr_to_pq_main(int argc, const char** argv);
 extern int jpegXL_encode_oneshot_main(int argc, const char** argv);
+extern int jpegXL_encode_to_target_main(int argc, const char** argv);
 extern int jpegXL_from_tree_main(int argc, const char** argv);
 extern int jpegXL_info_main(int argc, const char** argv);
 extern int jpegXL_decode_EXIF_metadata_main(int argc, const char** argv);
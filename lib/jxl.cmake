@@ -44,6 +44,10 @@ else()
   list(APPEND JPEGXL_INTERNAL_FLAGS -DJPEGXL_ENABLE_BOXES=0)
 endif ()
 
+if (JPEGXL_ENABLE_TRACING)
+  list(APPEND JPEGXL_INTERNAL_FLAGS -DJPEGXL_ENABLE_TRACING=1)
+endif ()
+
 set(OBJ_COMPILE_DEFINITIONS
   # Used to determine if we are building the library when defined or just
   # including the library when not defined. This is public so libjxl shared
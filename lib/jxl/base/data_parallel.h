@@ -17,6 +17,7 @@
 
 #include "lib/jxl/base/compiler_specific.h"
 #include "lib/jxl/base/status.h"
+#include "lib/jxl/base/trace.h"
 #if JXL_COMPILER_MSVC
 // suppress warnings about the const & applied to function types
 #pragma warning(disable : 4180)
@@ -51,7 +52,10 @@ class ThreadPool {
              const DataFunc& data_func, const char* caller) {
     JXL_ENSURE(begin <= end);
     if (begin == end) return true;
-    RunCallState<InitFunc, DataFunc> call_state(init_func, data_func);
+#if JPEGXL_ENABLE_TRACING
+    trace::TraceScope trace_scope(caller, "pool", "tasks", end - begin);
+#endif
+    RunCallState<InitFunc, DataFunc> call_state(init_func, data_func, caller);
     // The runner_ uses the C convention and returns 0 in case of error, so we
     // convert it to a Status.
     if (!runner_) {
@@ -87,8 +91,15 @@ class ThreadPool {
   template <class InitFunc, class DataFunc>
   class RunCallState final {
    public:
-    RunCallState(const InitFunc& init_func, const DataFunc& data_func)
-        : init_func_(init_func), data_func_(data_func) {}
+    RunCallState(const InitFunc& init_func, const DataFunc& data_func,
+                 const char* caller)
+        : init_func_(init_func), data_func_(data_func) {
+#if JPEGXL_ENABLE_TRACING
+      caller_ = caller;
+#else
+      (void)caller;
+#endif
+    }
 
     // JxlParallelRunInit interface.
     static int CallInitFunc(void* jpegxl_opaque, size_t num_threads) {
@@ -109,6 +120,9 @@ class ThreadPool {
       auto* self =
           static_cast<RunCallState<InitFunc, DataFunc>*>(jpegxl_opaque);
       if (self->has_error_) return;
+#if JPEGXL_ENABLE_TRACING
+      trace::TraceScope trace_scope(self->caller_, "task", "task", value);
+#endif
       if (!self->data_func_(value, thread_id)) {
         self->has_error_ = 1;
       }
@@ -120,6 +134,9 @@ class ThreadPool {
     const InitFunc& init_func_;
     const DataFunc& data_func_;
     std::atomic<uint32_t> has_error_{0};
+#if JPEGXL_ENABLE_TRACING
+    const char* caller_;
+#endif
   };
 
   // The caller supplied runner function and its opaque void*.
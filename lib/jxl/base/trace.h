@@ -0,0 +1,287 @@
+// Copyright (c) the JPEG XL Project Authors. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#ifndef LIB_JXL_BASE_TRACE_H_
+#define LIB_JXL_BASE_TRACE_H_
+
+// Scoped trace events for the encoder and decoder hot paths, written as
+// Chrome trace event JSON (chrome://tracing, https://ui.perfetto.dev).
+// Compiled out unless JPEGXL_ENABLE_TRACING is 1; even then, events are only
+// recorded between JxlTraceStart and JxlTraceStop.
+
+#ifndef JPEGXL_ENABLE_TRACING
+#define JPEGXL_ENABLE_TRACING 0
+#endif
+
+#if JPEGXL_ENABLE_TRACING
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace jxl {
+namespace trace {
+
+// Receives consecutive chunks of one JSON document.
+using WriteFunc = void (*)(void* opaque, const char* data, size_t size);
+
+constexpr size_t kMaxArgs = 16;
+
+// A "complete" event: one interval on one thread. `name`, `category` and the
+// argument keys must outlive the trace, typically they are string literals.
+struct Event {
+  const char* name = nullptr;
+  const char* category = nullptr;
+  double start_us = 0.0;
+  double duration_us = 0.0;
+  uint32_t thread = 0;
+  size_t num_args = 0;
+  std::array<std::pair<const char*, int64_t>, kMaxArgs> args;
+};
+
+// Small sequential ids are easier to read in trace viewers than native ones.
+inline uint32_t ThreadId() {
+  static std::atomic<uint32_t> next_id{1};
+  thread_local uint32_t id = next_id.fetch_add(1, std::memory_order_relaxed);
+  return id;
+}
+
+class Tracer {
+ public:
+  static Tracer& Get() {
+    static Tracer tracer;
+    return tracer;
+  }
+
+  bool enabled() const { return enabled_.load(std::memory_order_acquire); }
+
+  // Returns false if a trace is already being written.
+  bool Start(WriteFunc write, void* opaque) {
+    {
+      std::lock_guard<std::mutex> lock(write_mutex_);
+      if (write_ != nullptr) return false;
+      write_ = write;
+      opaque_ = opaque;
+      wrote_event_ = false;
+      origin_ = std::chrono::steady_clock::now();
+      static const char kHeader[] = "{\"traceEvents\":[\n";
+      write_(opaque_, kHeader, sizeof(kHeader) - 1);
+    }
+    // Drops the events that ended after the previous trace was stopped.
+    TakeEvents();
+    enabled_.store(true, std::memory_order_release);
+    return true;
+  }
+
+  // Writes the pending events and closes the document. Events that end after
+  // this call are dropped.
+  void Stop() {
+    enabled_.store(false, std::memory_order_release);
+    Write(Format(TakeEvents()));
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    if (write_ == nullptr) return;
+    static const char kFooter[] = "\n]}\n";
+    write_(opaque_, kFooter, sizeof(kFooter) - 1);
+    write_ = nullptr;
+    opaque_ = nullptr;
+  }
+
+  double NowMicros() const {
+    return std::chrono::duration<double, std::micro>(
+               std::chrono::steady_clock::now() - origin_)
+        .count();
+  }
+
+  // Only locks the buffer of the calling thread. Every kFlushEvents events,
+  // that thread formats and writes them without holding any buffer lock.
+  void Record(const Event& event) {
+    if (!enabled()) return;
+    ThreadBuffer& buffer = LocalBuffer();
+    std::vector<Event> events;
+    {
+      std::lock_guard<std::mutex> lock(buffer.mutex);
+      buffer.events.push_back(event);
+      if (buffer.events.size() < kFlushEvents) return;
+      events.swap(buffer.events);
+    }
+    Write(Format(events));
+  }
+
+ private:
+  static constexpr size_t kFlushEvents = 1024;
+
+  // Events of one thread that are not written yet.
+  struct ThreadBuffer {
+    std::mutex mutex;
+    std::vector<Event> events;
+  };
+
+  Tracer() = default;
+
+  // Registers the buffer of the calling thread on first use. The tracer keeps
+  // it after the thread exits, until its events are taken.
+  ThreadBuffer& LocalBuffer() {
+    thread_local std::shared_ptr<ThreadBuffer> buffer;
+    if (buffer == nullptr) {
+      buffer = std::make_shared<ThreadBuffer>();
+      std::lock_guard<std::mutex> lock(buffers_mutex_);
+      buffers_.push_back(buffer);
+    }
+    return *buffer;
+  }
+
+  // Empties all buffers, and forgets those of exited threads.
+  std::vector<Event> TakeEvents() {
+    std::vector<Event> events;
+    std::lock_guard<std::mutex> lock(buffers_mutex_);
+    for (const auto& buffer : buffers_) {
+      std::lock_guard<std::mutex> buffer_lock(buffer->mutex);
+      events.insert(events.end(), buffer->events.begin(),
+                    buffer->events.end());
+      buffer->events.clear();
+    }
+    buffers_.erase(
+        std::remove_if(buffers_.begin(), buffers_.end(),
+                       [](const std::shared_ptr<ThreadBuffer>& buffer) {
+                         return buffer.use_count() == 1;
+                       }),
+        buffers_.end());
+    return events;
+  }
+
+  // Each event is preceded by a separator, which Write drops for the first
+  // one of the document.
+  static std::string Format(const std::vector<Event>& events) {
+    std::string out;
+    char buf[256];
+    for (const Event& e : events) {
+      snprintf(buf, sizeof(buf),
+               ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\","
+               "\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u,\"args\":{",
+               e.name, e.category, e.start_us, e.duration_us, e.thread);
+      out += buf;
+      for (size_t i = 0; i < e.num_args; ++i) {
+        snprintf(buf, sizeof(buf), "%s\"%s\":%lld", i == 0 ? "" : ",",
+                 e.args[i].first, static_cast<long long>(e.args[i].second));
+        out += buf;
+      }
+      out += "}}";
+    }
+    return out;
+  }
+
+  void Write(const std::string& out) {
+    if (out.empty()) return;
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    if (write_ == nullptr) return;
+    const size_t skip = wrote_event_ ? 0 : 2;
+    write_(opaque_, out.data() + skip, out.size() - skip);
+    wrote_event_ = true;
+  }
+
+  std::atomic<bool> enabled_{false};
+  std::mutex buffers_mutex_;
+  std::vector<std::shared_ptr<ThreadBuffer>> buffers_;
+  // Serializes the calls to write_.
+  std::mutex write_mutex_;
+  WriteFunc write_ = nullptr;
+  void* opaque_ = nullptr;
+  bool wrote_event_ = false;
+  std::chrono::steady_clock::time_point origin_;
+};
+
+// Records the lifetime of the object as an event, if tracing is active when it
+// is constructed.
+class TraceScope {
+ public:
+  explicit TraceScope(const char* name, const char* category = "jxl") {
+    Tracer& tracer = Tracer::Get();
+    if (!tracer.enabled()) return;
+    event_.name = name;
+    event_.category = category;
+    event_.thread = ThreadId();
+    event_.start_us = tracer.NowMicros();
+  }
+  TraceScope(const char* name, const char* category, const char* key,
+             int64_t value)
+      : TraceScope(name, category) {
+    AddArg(key, value);
+  }
+  ~TraceScope() { End(); }
+  TraceScope(const TraceScope&) = delete;
+  TraceScope& operator=(const TraceScope&) = delete;
+
+  bool active() const { return event_.name != nullptr; }
+
+  // Records the event now rather than at destruction.
+  void End() {
+    if (!active()) return;
+    Tracer& tracer = Tracer::Get();
+    event_.duration_us = tracer.NowMicros() - event_.start_us;
+    tracer.Record(event_);
+    event_.name = nullptr;
+  }
+
+  // Arguments beyond kMaxArgs are ignored.
+  void AddArg(const char* key, int64_t value) {
+    if (!active() || event_.num_args == kMaxArgs) return;
+    event_.args[event_.num_args++] = {key, value};
+  }
+
+ private:
+  Event event_;
+};
+
+// Adds the lifetime of the object to *total_us, unless total_us is null. For
+// work that is too fine-grained for individual events.
+class TraceAccumulator {
+ public:
+  explicit TraceAccumulator(double* total_us) : total_us_(total_us) {
+    if (total_us_) start_us_ = Tracer::Get().NowMicros();
+  }
+  ~TraceAccumulator() {
+    if (total_us_) *total_us_ += Tracer::Get().NowMicros() - start_us_;
+  }
+  TraceAccumulator(const TraceAccumulator&) = delete;
+  TraceAccumulator& operator=(const TraceAccumulator&) = delete;
+
+ private:
+  double* total_us_;
+  double start_us_ = 0.0;
+};
+
+}  // namespace trace
+}  // namespace jxl
+
+#define JXL_TRACE_CONCAT_INNER(a, b) a##b
+#define JXL_TRACE_CONCAT(a, b) JXL_TRACE_CONCAT_INNER(a, b)
+
+// Traces the rest of the enclosing block.
+#define JXL_TRACE_SCOPE(name)                                         \
+  ::jxl::trace::TraceScope JXL_TRACE_CONCAT(jxl_trace_scope_, __LINE__)( \
+      name)
+
+// As above, with one integer argument shown in the event details.
+#define JXL_TRACE_SCOPE_ARG(name, key, value)                         \
+  ::jxl::trace::TraceScope JXL_TRACE_CONCAT(jxl_trace_scope_, __LINE__)( \
+      name, "jxl", key, static_cast<int64_t>(value))
+
+#else  // JPEGXL_ENABLE_TRACING
+
+#define JXL_TRACE_SCOPE(name) static_cast<void>(0)
+#define JXL_TRACE_SCOPE_ARG(name, key, value) static_cast<void>(0)
+
+#endif  // JPEGXL_ENABLE_TRACING
+
+#endif  // LIB_JXL_BASE_TRACE_H_
@@ -33,6 +33,7 @@ void JxlBoxContentDecoder::StartBox(bool brob_decode, bool box_until_eof,
   }
   header_done_ = false;
   brob_decode_ = brob_decode;
+  brob_done_ = false;
   box_until_eof_ = box_until_eof;
   remaining_ = box_until_eof ? 0 : contents_size;
   pos_ = 0;
@@ -46,6 +47,7 @@ JxlDecoderStatus JxlBoxContentDecoder::Process(const uint8_t* next_in,
   avail_in -= pos_ - box_pos;
 
   if (brob_decode_) {
+    if (brob_done_) return JXL_DEC_BOX_COMPLETE;
     if (!header_done_) {
       if (avail_in < 4) return JXL_DEC_NEED_MORE_INPUT;
       if (!box_until_eof_) {
@@ -82,6 +84,10 @@ JxlDecoderStatus JxlBoxContentDecoder::Process(const uint8_t* next_in,
       return JXL_DEC_BOX_NEED_MORE_OUTPUT;
     }
     if (res == BROTLI_DECODER_RESULT_SUCCESS) {
+      // Free the window, which can be large, before the next box.
+      BrotliDecoderDestroyInstance(brotli_dec);
+      brotli_dec = nullptr;
+      brob_done_ = true;
       return JXL_DEC_BOX_COMPLETE;
     }
     // unknown Brotli result
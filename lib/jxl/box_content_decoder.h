@@ -27,15 +27,19 @@ class JxlBoxContentDecoder {
   // Outputs decoded bytes from the box, decoding with brotli if needed.
   // box_pos is the position in the box content which next_in points to.
   // Returns success, whether more input or output bytes are needed, or error.
+  // The brotli decoder is only created here, so that brob boxes whose
+  // contents are not requested are skipped without decompressing them, and
+  // is released as soon as the box is complete.
   JxlDecoderStatus Process(const uint8_t* next_in, size_t avail_in,
                            size_t box_pos, uint8_t** next_out,
                            size_t* avail_out);
 
  private:
-  BrotliDecoderState* brotli_dec;
+  BrotliDecoderState* brotli_dec = nullptr;
 
   bool header_done_;
   bool brob_decode_;
+  bool brob_done_;
   bool box_until_eof_;
   size_t remaining_;
   size_t pos_;
@@ -35,8 +35,9 @@
 
 #include "lib/jxl/base/common.h"
 #include "lib/jxl/base/compiler_specific.h"
+#include "lib/jxl/base/data_parallel.h"
 #include "lib/jxl/base/rect.h"
-#include "lib/jxl/convolve.h"
+#include "lib/jxl/gauss_blur.h"
 #include "lib/jxl/image.h"
 
 #undef HWY_TARGET_INCLUDE
@@ -85,8 +86,49 @@ std::vector<float> ComputeKernel(float sigma) {
   return kernel;
 }
 
+// Rows per task when a stage is split into row bands. Bands of the transposed
+// blur output then cover whole cache lines, which avoids false sharing.
+constexpr size_t kRowsPerBand = 32;
+
+// Runs func(task, y_begin, y_end) for each of num_tasks independent tasks on
+// bands of rows covering [0, ysize). Stencil stages read the rows around their
+// band (the halo) from the completed output of the previous stage, so func
+// must only write the rows of its own band. Without a pool, each task is
+// processed in a single call.
+template <class Func>
+Status RunOnRowBands(ThreadPool* pool, size_t num_tasks, size_t ysize,
+                     const Func& func, const char* caller) {
+  if (pool == nullptr) {
+    for (size_t task = 0; task < num_tasks; ++task) {
+      func(task, 0, ysize);
+    }
+    return true;
+  }
+  const size_t num_bands = DivCeil(ysize, kRowsPerBand);
+  const auto process_band = [&](const uint32_t i,
+                                size_t /* thread */) -> Status {
+    const size_t y_begin = (i % num_bands) * kRowsPerBand;
+    const size_t y_end = std::min(ysize, y_begin + kRowsPerBand);
+    func(i / num_bands, y_begin, y_end);
+    return true;
+  };
+  return RunOnPool(pool, 0, num_tasks * num_bands, ThreadPool::NoInit,
+                   process_band, caller);
+}
+
+// Same as above for a single task; calls func(y_begin, y_end).
+template <class Func>
+Status RunOnRowBands(ThreadPool* pool, size_t ysize, const Func& func,
+                     const char* caller) {
+  const auto band_func = [&](size_t /* task */, size_t y_begin, size_t y_end) {
+    func(y_begin, y_end);
+  };
+  return RunOnRowBands(pool, 1, ysize, band_func, caller);
+}
+
 void ConvolveBorderColumn(const ImageF& in, const std::vector<float>& kernel,
-                          const size_t x, float* BUTTERAUGLI_RESTRICT row_out) {
+                          const size_t x, size_t y_begin, size_t y_end,
+                          float* BUTTERAUGLI_RESTRICT row_out) {
   const size_t offset = kernel.size() / 2;
   int minx = x < offset ? 0 : x - offset;
   int maxx = std::min<int>(in.xsize() - 1, x + offset);
@@ -95,7 +137,7 @@ void ConvolveBorderColumn(const ImageF& in, const std::vector<float>& kernel,
     weight += kernel[j - x + offset];
   }
   float scale = 1.0f / weight;
-  for (size_t y = 0; y < in.ysize(); ++y) {
+  for (size_t y = y_begin; y < y_end; ++y) {
     const float* BUTTERAUGLI_RESTRICT row_in = in.Row(y);
     float sum = 0.0f;
     for (int j = minx; j <= maxx; ++j) {
@@ -105,13 +147,19 @@ void ConvolveBorderColumn(const ImageF& in, const std::vector<float>& kernel,
   }
 }
 
-// Computes a horizontal convolution and transposes the result.
+// Computes a horizontal convolution and transposes the result. Bands of input
+// rows are independent and may run on the pool.
 Status ConvolutionWithTranspose(const ImageF& in,
                                 const std::vector<float>& kernel,
+                                ThreadPool* pool,
                                 ImageF* BUTTERAUGLI_RESTRICT out) {
   JXL_ENSURE(out->xsize() == in.ysize());
   JXL_ENSURE(out->ysize() == in.xsize());
   const size_t len = kernel.size();
+  if (len != 7 && len != 13 && len != 15 && len != 33) {
+    return JXL_UNREACHABLE("kernel size %d not implemented",
+                           static_cast<int>(len));
+  }
   const size_t offset = len / 2;
   float weight_no_border = 0.0f;
   for (size_t j = 0; j < len; ++j) {
@@ -125,147 +173,155 @@ Status ConvolutionWithTranspose(const ImageF& in,
     scaled_kernel[i] = kernel[i] * scale_no_border;
   }
 
-  // middle
-  switch (len) {
-    case 7: {
-      const float sk0 = scaled_kernel[0];
-      const float sk1 = scaled_kernel[1];
-      const float sk2 = scaled_kernel[2];
-      const float sk3 = scaled_kernel[3];
-      for (size_t y = 0; y < in.ysize(); ++y) {
-        const float* BUTTERAUGLI_RESTRICT row_in = in.Row(y) + border1 - offset;
-        for (size_t x = border1; x < border2; ++x, ++row_in) {
-          const float sum0 = (row_in[0] + row_in[6]) * sk0;
-          const float sum1 = (row_in[1] + row_in[5]) * sk1;
-          const float sum2 = (row_in[2] + row_in[4]) * sk2;
-          const float sum = (row_in[3]) * sk3 + sum0 + sum1 + sum2;
-          float* BUTTERAUGLI_RESTRICT row_out = out->Row(x);
-          row_out[y] = sum;
+  const auto convolve_rows = [&](size_t y_begin, size_t y_end) {
+    // middle
+    switch (len) {
+      case 7: {
+        const float sk0 = scaled_kernel[0];
+        const float sk1 = scaled_kernel[1];
+        const float sk2 = scaled_kernel[2];
+        const float sk3 = scaled_kernel[3];
+        for (size_t y = y_begin; y < y_end; ++y) {
+          const float* BUTTERAUGLI_RESTRICT row_in =
+              in.Row(y) + border1 - offset;
+          for (size_t x = border1; x < border2; ++x, ++row_in) {
+            const float sum0 = (row_in[0] + row_in[6]) * sk0;
+            const float sum1 = (row_in[1] + row_in[5]) * sk1;
+            const float sum2 = (row_in[2] + row_in[4]) * sk2;
+            const float sum = (row_in[3]) * sk3 + sum0 + sum1 + sum2;
+            float* BUTTERAUGLI_RESTRICT row_out = out->Row(x);
+            row_out[y] = sum;
+          }
         }
-      }
-    } break;
-    case 13: {
-      for (size_t y = 0; y < in.ysize(); ++y) {
-        const float* BUTTERAUGLI_RESTRICT row_in = in.Row(y) + border1 - offset;
-        for (size_t x = border1; x < border2; ++x, ++row_in) {
-          float sum0 = (row_in[0] + row_in[12]) * scaled_kernel[0];
-          float sum1 = (row_in[1] + row_in[11]) * scaled_kernel[1];
-          float sum2 = (row_in[2] + row_in[10]) * scaled_kernel[2];
-          float sum3 = (row_in[3] + row_in[9]) * scaled_kernel[3];
-          sum0 += (row_in[4] + row_in[8]) * scaled_kernel[4];
-          sum1 += (row_in[5] + row_in[7]) * scaled_kernel[5];
-          const float sum = (row_in[6]) * scaled_kernel[6];
-          float* BUTTERAUGLI_RESTRICT row_out = out->Row(x);
-          row_out[y] = sum + sum0 + sum1 + sum2 + sum3;
+      } break;
+      case 13: {
+        for (size_t y = y_begin; y < y_end; ++y) {
+          const float* BUTTERAUGLI_RESTRICT row_in =
+              in.Row(y) + border1 - offset;
+          for (size_t x = border1; x < border2; ++x, ++row_in) {
+            float sum0 = (row_in[0] + row_in[12]) * scaled_kernel[0];
+            float sum1 = (row_in[1] + row_in[11]) * scaled_kernel[1];
+            float sum2 = (row_in[2] + row_in[10]) * scaled_kernel[2];
+            float sum3 = (row_in[3] + row_in[9]) * scaled_kernel[3];
+            sum0 += (row_in[4] + row_in[8]) * scaled_kernel[4];
+            sum1 += (row_in[5] + row_in[7]) * scaled_kernel[5];
+            const float sum = (row_in[6]) * scaled_kernel[6];
+            float* BUTTERAUGLI_RESTRICT row_out = out->Row(x);
+            row_out[y] = sum + sum0 + sum1 + sum2 + sum3;
+          }
         }
+        break;
       }
-      break;
-    }
-    case 15: {
-      for (size_t y = 0; y < in.ysize(); ++y) {
-        const float* BUTTERAUGLI_RESTRICT row_in = in.Row(y) + border1 - offset;
-        for (size_t x = border1; x < border2; ++x, ++row_in) {
-          float sum0 = (row_in[0] + row_in[14]) * scaled_kernel[0];
-          float sum1 = (row_in[1] + row_in[13]) * scaled_kernel[1];
-          float sum2 = (row_in[2] + row_in[12]) * scaled_kernel[2];
-          float sum3 = (row_in[3] + row_in[11]) * scaled_kernel[3];
-          sum0 += (row_in[4] + row_in[10]) * scaled_kernel[4];
-          sum1 += (row_in[5] + row_in[9]) * scaled_kernel[5];
-          sum2 += (row_in[6] + row_in[8]) * scaled_kernel[6];
-          const float sum = (row_in[7]) * scaled_kernel[7];
-          float* BUTTERAUGLI_RESTRICT row_out = out->Row(x);
-          row_out[y] = sum + sum0 + sum1 + sum2 + sum3;
+      case 15: {
+        for (size_t y = y_begin; y < y_end; ++y) {
+          const float* BUTTERAUGLI_RESTRICT row_in =
+              in.Row(y) + border1 - offset;
+          for (size_t x = border1; x < border2; ++x, ++row_in) {
+            float sum0 = (row_in[0] + row_in[14]) * scaled_kernel[0];
+            float sum1 = (row_in[1] + row_in[13]) * scaled_kernel[1];
+            float sum2 = (row_in[2] + row_in[12]) * scaled_kernel[2];
+            float sum3 = (row_in[3] + row_in[11]) * scaled_kernel[3];
+            sum0 += (row_in[4] + row_in[10]) * scaled_kernel[4];
+            sum1 += (row_in[5] + row_in[9]) * scaled_kernel[5];
+            sum2 += (row_in[6] + row_in[8]) * scaled_kernel[6];
+            const float sum = (row_in[7]) * scaled_kernel[7];
+            float* BUTTERAUGLI_RESTRICT row_out = out->Row(x);
+            row_out[y] = sum + sum0 + sum1 + sum2 + sum3;
+          }
         }
+        break;
       }
-      break;
-    }
-    case 33: {
-      for (size_t y = 0; y < in.ysize(); ++y) {
-        const float* BUTTERAUGLI_RESTRICT row_in = in.Row(y) + border1 - offset;
-        for (size_t x = border1; x < border2; ++x, ++row_in) {
-          float sum0 = (row_in[0] + row_in[32]) * scaled_kernel[0];
-          float sum1 = (row_in[1] + row_in[31]) * scaled_kernel[1];
-          float sum2 = (row_in[2] + row_in[30]) * scaled_kernel[2];
-          float sum3 = (row_in[3] + row_in[29]) * scaled_kernel[3];
-          sum0 += (row_in[4] + row_in[28]) * scaled_kernel[4];
-          sum1 += (row_in[5] + row_in[27]) * scaled_kernel[5];
-          sum2 += (row_in[6] + row_in[26]) * scaled_kernel[6];
-          sum3 += (row_in[7] + row_in[25]) * scaled_kernel[7];
-          sum0 += (row_in[8] + row_in[24]) * scaled_kernel[8];
-          sum1 += (row_in[9] + row_in[23]) * scaled_kernel[9];
-          sum2 += (row_in[10] + row_in[22]) * scaled_kernel[10];
-          sum3 += (row_in[11] + row_in[21]) * scaled_kernel[11];
-          sum0 += (row_in[12] + row_in[20]) * scaled_kernel[12];
-          sum1 += (row_in[13] + row_in[19]) * scaled_kernel[13];
-          sum2 += (row_in[14] + row_in[18]) * scaled_kernel[14];
-          sum3 += (row_in[15] + row_in[17]) * scaled_kernel[15];
-          const float sum = (row_in[16]) * scaled_kernel[16];
-          float* BUTTERAUGLI_RESTRICT row_out = out->Row(x);
-          row_out[y] = sum + sum0 + sum1 + sum2 + sum3;
+      case 33: {
+        for (size_t y = y_begin; y < y_end; ++y) {
+          const float* BUTTERAUGLI_RESTRICT row_in =
+              in.Row(y) + border1 - offset;
+          for (size_t x = border1; x < border2; ++x, ++row_in) {
+            float sum0 = (row_in[0] + row_in[32]) * scaled_kernel[0];
+            float sum1 = (row_in[1] + row_in[31]) * scaled_kernel[1];
+            float sum2 = (row_in[2] + row_in[30]) * scaled_kernel[2];
+            float sum3 = (row_in[3] + row_in[29]) * scaled_kernel[3];
+            sum0 += (row_in[4] + row_in[28]) * scaled_kernel[4];
+            sum1 += (row_in[5] + row_in[27]) * scaled_kernel[5];
+            sum2 += (row_in[6] + row_in[26]) * scaled_kernel[6];
+            sum3 += (row_in[7] + row_in[25]) * scaled_kernel[7];
+            sum0 += (row_in[8] + row_in[24]) * scaled_kernel[8];
+            sum1 += (row_in[9] + row_in[23]) * scaled_kernel[9];
+            sum2 += (row_in[10] + row_in[22]) * scaled_kernel[10];
+            sum3 += (row_in[11] + row_in[21]) * scaled_kernel[11];
+            sum0 += (row_in[12] + row_in[20]) * scaled_kernel[12];
+            sum1 += (row_in[13] + row_in[19]) * scaled_kernel[13];
+            sum2 += (row_in[14] + row_in[18]) * scaled_kernel[14];
+            sum3 += (row_in[15] + row_in[17]) * scaled_kernel[15];
+            const float sum = (row_in[16]) * scaled_kernel[16];
+            float* BUTTERAUGLI_RESTRICT row_out = out->Row(x);
+            row_out[y] = sum + sum0 + sum1 + sum2 + sum3;
+          }
         }
+        break;
       }
-      break;
+      default:
+        break;
+    }
+    // left border
+    for (size_t x = 0; x < border1; ++x) {
+      ConvolveBorderColumn(in, kernel, x, y_begin, y_end, out->Row(x));
     }
-    default:
-      return JXL_UNREACHABLE("kernel size %d not implemented",
-                             static_cast<int>(len));
-  }
-  // left border
-  for (size_t x = 0; x < border1; ++x) {
-    ConvolveBorderColumn(in, kernel, x, out->Row(x));
-  }
 
-  // right border
-  for (size_t x = border2; x < in.xsize(); ++x) {
-    ConvolveBorderColumn(in, kernel, x, out->Row(x));
-  }
-  return true;
+    // right border
+    for (size_t x = border2; x < in.xsize(); ++x) {
+      ConvolveBorderColumn(in, kernel, x, y_begin, y_end, out->Row(x));
+    }
+  };
+  return RunOnRowBands(pool, in.ysize(), convolve_rows,
+                       "ConvolutionWithTranspose");
 }
 
 // A blur somewhat similar to a 2D Gaussian blur.
 // See: https://en.wikipedia.org/wiki/Gaussian_blur
 //
-// This is a bottleneck because the sigma can be quite large (>7). We can use
-// gauss_blur.cc (runtime independent of sigma, closer to a 4*sigma truncated
-// Gaussian and our 2.25 in ComputeKernel), but its boundary conditions are
-// zero-valued. This leads to noticeable differences at the edges of diffmaps.
-// We retain a special case for 5x5 kernels (even faster than gauss_blur),
-// optionally use gauss_blur followed by fixup of the borders for large images,
-// or fall back to the previous truncated FIR followed by a transpose.
+// This is a bottleneck because the sigma can be quite large (>7). 5x5 kernels
+// go through GaussianBlur, which applies them directly with the same weights.
+// Larger ones use the truncated FIR followed by a transpose.
 Status Blur(const ImageF& in, float sigma, const ButteraugliParams& params,
-            BlurTemp* temp, ImageF* out) {
+            BlurTemp* temp, ThreadPool* pool, ImageF* out) {
   std::vector<float> kernel = ComputeKernel(sigma);
-  // Separable5 does an in-place convolution, so this fast path is not safe if
-  // in aliases out.
-  if (kernel.size() == 5 && &in != out) {
-    float sum_weights = 0.0f;
-    for (const float w : kernel) {
-      sum_weights += w;
+  if (kernel.size() == 5) {
+    // The direct 5x5 kernel only needs the temporary image in place.
+    ImageF* temp_same_size = nullptr;
+    if (&in == out) {
+      JXL_RETURN_IF_ERROR(temp->GetSameSize(in, &temp_same_size));
     }
-    const float scale = 1.0f / sum_weights;
-    const float w0 = kernel[2] * scale;
-    const float w1 = kernel[1] * scale;
-    const float w2 = kernel[0] * scale;
-    const WeightsSeparable5 weights = {
-        {HWY_REP4(w0), HWY_REP4(w1), HWY_REP4(w2)},
-        {HWY_REP4(w0), HWY_REP4(w1), HWY_REP4(w2)},
-    };
-    JXL_RETURN_IF_ERROR(
-        Separable5(in, Rect(in), weights, /*pool=*/nullptr, out));
-    return true;
+    return GaussianBlur(in, sigma, pool, temp_same_size, out);
   }
 
   ImageF* temp_t;
   JXL_RETURN_IF_ERROR(temp->GetTransposed(in, &temp_t));
-  JXL_RETURN_IF_ERROR(ConvolutionWithTranspose(in, kernel, temp_t));
-  JXL_RETURN_IF_ERROR(ConvolutionWithTranspose(*temp_t, kernel, out));
+  JXL_RETURN_IF_ERROR(ConvolutionWithTranspose(in, kernel, pool, temp_t));
+  JXL_RETURN_IF_ERROR(ConvolutionWithTranspose(*temp_t, kernel, pool, out));
   return true;
 }
 
-// Allows PaddedMaltaUnit to call either function via overloading.
+// Allows MaltaAccumulateRows to call either function via overloading.
 struct MaltaTagLF {};
 struct MaltaTag {};
 
+// Radius of the malta line kernels, and the width of the zero border around
+// the differences they are applied to.
+constexpr size_t kMaltaBorder = 4;
+
+// One malta filtered difference of lum0 and lum1, to be added to
+// *block_diff_ac.
+struct MaltaTerm {
+  const ImageF* lum0;
+  const ImageF* lum1;
+  double w_0gt1;
+  double w_0lt1;
+  double norm1;
+  // Whether to use the MaltaTagLF kernel.
+  bool lf;
+  ImageF* block_diff_ac;
+};
+
 }  // namespace jxl
 
 #endif  // JXL_BUTTERAUGLI_ONCE
@@ -340,30 +396,34 @@ HWY_INLINE void XybLowFreqToVals(const D d, const V& x, const V& y,
   *valy = Mul(y, ymul);
 }
 
-void XybLowFreqToVals(Image3F* xyb_lf) {
+Status XybLowFreqToVals(ThreadPool* pool, Image3F* xyb_lf) {
   // Modify range around zero code only concerns the high frequency
   // planes and only the X and Y channels.
   // Convert low freq xyb to vals space so that we can do a simple squared sum
   // diff on the low frequencies later.
   const HWY_FULL(float) d;
-  for (size_t y = 0; y < xyb_lf->ysize(); ++y) {
-    float* BUTTERAUGLI_RESTRICT row_x = xyb_lf->PlaneRow(0, y);
-    float* BUTTERAUGLI_RESTRICT row_y = xyb_lf->PlaneRow(1, y);
-    float* BUTTERAUGLI_RESTRICT row_b = xyb_lf->PlaneRow(2, y);
-    for (size_t x = 0; x < xyb_lf->xsize(); x += Lanes(d)) {
-      auto valx = Undefined(d);
-      auto valy = Undefined(d);
-      auto valb = Undefined(d);
-      XybLowFreqToVals(d, Load(d, row_x + x), Load(d, row_y + x),
-                       Load(d, row_b + x), &valx, &valy, &valb);
-      Store(valx, d, row_x + x);
-      Store(valy, d, row_y + x);
-      Store(valb, d, row_b + x);
+  const auto to_vals = [&](size_t y_begin, size_t y_end) {
+    for (size_t y = y_begin; y < y_end; ++y) {
+      float* BUTTERAUGLI_RESTRICT row_x = xyb_lf->PlaneRow(0, y);
+      float* BUTTERAUGLI_RESTRICT row_y = xyb_lf->PlaneRow(1, y);
+      float* BUTTERAUGLI_RESTRICT row_b = xyb_lf->PlaneRow(2, y);
+      for (size_t x = 0; x < xyb_lf->xsize(); x += Lanes(d)) {
+        auto valx = Undefined(d);
+        auto valy = Undefined(d);
+        auto valb = Undefined(d);
+        XybLowFreqToVals(d, Load(d, row_x + x), Load(d, row_y + x),
+                         Load(d, row_b + x), &valx, &valy, &valb);
+        Store(valx, d, row_x + x);
+        Store(valy, d, row_y + x);
+        Store(valb, d, row_b + x);
+      }
     }
-  }
+  };
+  return RunOnRowBands(pool, xyb_lf->ysize(), to_vals, "XybLowFreqToVals");
 }
 
-Status SuppressXByY(const ImageF& in_y, ImageF* HWY_RESTRICT inout_x) {
+Status SuppressXByY(const ImageF& in_y, ThreadPool* pool,
+                    ImageF* HWY_RESTRICT inout_x) {
   JXL_ENSURE(SameSize(*inout_x, in_y));
   const size_t xsize = in_y.xsize();
   const size_t ysize = in_y.ysize();
@@ -374,48 +434,56 @@ Status SuppressXByY(const ImageF& in_y, ImageF* HWY_RESTRICT inout_x) {
   const auto one_minus_s = Set(d, 1.0 - s);
   const auto ywv = Set(d, suppress);
 
-  for (size_t y = 0; y < ysize; ++y) {
-    const float* HWY_RESTRICT row_y = in_y.ConstRow(y);
-    float* HWY_RESTRICT row_x = inout_x->Row(y);
-    for (size_t x = 0; x < xsize; x += Lanes(d)) {
-      const auto vx = Load(d, row_x + x);
-      const auto vy = Load(d, row_y + x);
-      const auto scaler =
-          MulAdd(Div(ywv, MulAdd(vy, vy, ywv)), one_minus_s, sv);
-      Store(Mul(scaler, vx), d, row_x + x);
+  const auto suppress_rows = [&](size_t y_begin, size_t y_end) {
+    for (size_t y = y_begin; y < y_end; ++y) {
+      const float* HWY_RESTRICT row_y = in_y.ConstRow(y);
+      float* HWY_RESTRICT row_x = inout_x->Row(y);
+      for (size_t x = 0; x < xsize; x += Lanes(d)) {
+        const auto vx = Load(d, row_x + x);
+        const auto vy = Load(d, row_y + x);
+        const auto scaler =
+            MulAdd(Div(ywv, MulAdd(vy, vy, ywv)), one_minus_s, sv);
+        Store(Mul(scaler, vx), d, row_x + x);
+      }
     }
-  }
-  return true;
+  };
+  return RunOnRowBands(pool, ysize, suppress_rows, "SuppressXByY");
 }
 
-void Subtract(const ImageF& a, const ImageF& b, ImageF* c) {
+Status Subtract(const ImageF& a, const ImageF& b, ThreadPool* pool,
+                ImageF* c) {
   const HWY_FULL(float) d;
-  for (size_t y = 0; y < a.ysize(); ++y) {
-    const float* row_a = a.ConstRow(y);
-    const float* row_b = b.ConstRow(y);
-    float* row_c = c->Row(y);
-    for (size_t x = 0; x < a.xsize(); x += Lanes(d)) {
-      Store(Sub(Load(d, row_a + x), Load(d, row_b + x)), d, row_c + x);
+  const auto subtract_rows = [&](size_t y_begin, size_t y_end) {
+    for (size_t y = y_begin; y < y_end; ++y) {
+      const float* row_a = a.ConstRow(y);
+      const float* row_b = b.ConstRow(y);
+      float* row_c = c->Row(y);
+      for (size_t x = 0; x < a.xsize(); x += Lanes(d)) {
+        Store(Sub(Load(d, row_a + x), Load(d, row_b + x)), d, row_c + x);
+      }
     }
-  }
+  };
+  return RunOnRowBands(pool, a.ysize(), subtract_rows, "Subtract");
 }
 
 Status SeparateLFAndMF(const ButteraugliParams& params, const Image3F& xyb,
-                       Image3F* lf, Image3F* mf, BlurTemp* blur_temp) {
+                       Image3F* lf, Image3F* mf, BlurTemp* blur_temp,
+                       ThreadPool* pool) {
   static const double kSigmaLf = 7.15593339443;
   for (int i = 0; i < 3; ++i) {
     // Extract lf ...
     JXL_RETURN_IF_ERROR(
-        Blur(xyb.Plane(i), kSigmaLf, params, blur_temp, &lf->Plane(i)));
+        Blur(xyb.Plane(i), kSigmaLf, params, blur_temp, pool, &lf->Plane(i)));
     // ... and keep everything else in mf.
-    Subtract(xyb.Plane(i), lf->Plane(i), &mf->Plane(i));
+    JXL_RETURN_IF_ERROR(
+        Subtract(xyb.Plane(i), lf->Plane(i), pool, &mf->Plane(i)));
   }
-  XybLowFreqToVals(lf);
+  JXL_RETURN_IF_ERROR(XybLowFreqToVals(pool, lf));
   return true;
 }
 
 Status SeparateMFAndHF(const ButteraugliParams& params, Image3F* mf, ImageF* hf,
-                       BlurTemp* blur_temp) {
+                       BlurTemp* blur_temp, ThreadPool* pool) {
   const HWY_FULL(float) d;
   static const double kSigmaHf = 3.22489901262;
   const size_t xsize = mf->xsize();
@@ -426,54 +494,62 @@ Status SeparateMFAndHF(const ButteraugliParams& params, Image3F* mf, ImageF* hf,
   for (int i = 0; i < 3; ++i) {
     if (i == 2) {
       JXL_RETURN_IF_ERROR(
-          Blur(mf->Plane(i), kSigmaHf, params, blur_temp, &mf->Plane(i)));
+          Blur(mf->Plane(i), kSigmaHf, params, blur_temp, pool, &mf->Plane(i)));
       break;
     }
-    for (size_t y = 0; y < ysize; ++y) {
-      float* BUTTERAUGLI_RESTRICT row_mf = mf->PlaneRow(i, y);
-      float* BUTTERAUGLI_RESTRICT row_hf = hf[i].Row(y);
-      for (size_t x = 0; x < xsize; x += Lanes(d)) {
-        Store(Load(d, row_mf + x), d, row_hf + x);
+    const auto copy_rows = [&](size_t y_begin, size_t y_end) {
+      for (size_t y = y_begin; y < y_end; ++y) {
+        float* BUTTERAUGLI_RESTRICT row_mf = mf->PlaneRow(i, y);
+        float* BUTTERAUGLI_RESTRICT row_hf = hf[i].Row(y);
+        for (size_t x = 0; x < xsize; x += Lanes(d)) {
+          Store(Load(d, row_mf + x), d, row_hf + x);
+        }
       }
-    }
+    };
     JXL_RETURN_IF_ERROR(
-        Blur(mf->Plane(i), kSigmaHf, params, blur_temp, &mf->Plane(i)));
+        RunOnRowBands(pool, ysize, copy_rows, "SeparateMFAndHF copy"));
+    JXL_RETURN_IF_ERROR(
+        Blur(mf->Plane(i), kSigmaHf, params, blur_temp, pool, &mf->Plane(i)));
     static const double kRemoveMfRange = 0.29;
     static const double kAddMfRange = 0.1;
-    if (i == 0) {
-      for (size_t y = 0; y < ysize; ++y) {
-        float* BUTTERAUGLI_RESTRICT row_mf = mf->PlaneRow(0, y);
-        float* BUTTERAUGLI_RESTRICT row_hf = hf[0].Row(y);
-        for (size_t x = 0; x < xsize; x += Lanes(d)) {
-          auto mfv = Load(d, row_mf + x);
-          auto hfv = Sub(Load(d, row_hf + x), mfv);
-          mfv = RemoveRangeAroundZero(d, kRemoveMfRange, mfv);
-          Store(mfv, d, row_mf + x);
-          Store(hfv, d, row_hf + x);
+    const auto separate_rows = [&](size_t y_begin, size_t y_end) {
+      if (i == 0) {
+        for (size_t y = y_begin; y < y_end; ++y) {
+          float* BUTTERAUGLI_RESTRICT row_mf = mf->PlaneRow(0, y);
+          float* BUTTERAUGLI_RESTRICT row_hf = hf[0].Row(y);
+          for (size_t x = 0; x < xsize; x += Lanes(d)) {
+            auto mfv = Load(d, row_mf + x);
+            auto hfv = Sub(Load(d, row_hf + x), mfv);
+            mfv = RemoveRangeAroundZero(d, kRemoveMfRange, mfv);
+            Store(mfv, d, row_mf + x);
+            Store(hfv, d, row_hf + x);
+          }
         }
-      }
-    } else {
-      for (size_t y = 0; y < ysize; ++y) {
-        float* BUTTERAUGLI_RESTRICT row_mf = mf->PlaneRow(1, y);
-        float* BUTTERAUGLI_RESTRICT row_hf = hf[1].Row(y);
-        for (size_t x = 0; x < xsize; x += Lanes(d)) {
-          auto mfv = Load(d, row_mf + x);
-          auto hfv = Sub(Load(d, row_hf + x), mfv);
-
-          mfv = AmplifyRangeAroundZero(d, kAddMfRange, mfv);
-          Store(mfv, d, row_mf + x);
-          Store(hfv, d, row_hf + x);
+      } else {
+        for (size_t y = y_begin; y < y_end; ++y) {
+          float* BUTTERAUGLI_RESTRICT row_mf = mf->PlaneRow(1, y);
+          float* BUTTERAUGLI_RESTRICT row_hf = hf[1].Row(y);
+          for (size_t x = 0; x < xsize; x += Lanes(d)) {
+            auto mfv = Load(d, row_mf + x);
+            auto hfv = Sub(Load(d, row_hf + x), mfv);
+
+            mfv = AmplifyRangeAroundZero(d, kAddMfRange, mfv);
+            Store(mfv, d, row_mf + x);
+            Store(hfv, d, row_hf + x);
+          }
         }
       }
-    }
+    };
+    JXL_RETURN_IF_ERROR(
+        RunOnRowBands(pool, ysize, separate_rows, "SeparateMFAndHF"));
   }
   // Suppress red-green by intensity change in the high freq channels.
-  JXL_RETURN_IF_ERROR(SuppressXByY(hf[1], &hf[0]));
+  JXL_RETURN_IF_ERROR(SuppressXByY(hf[1], pool, &hf[0]));
   return true;
 }
 
 Status SeparateHFAndUHF(const ButteraugliParams& params, ImageF* hf,
-                        ImageF* uhf, BlurTemp* blur_temp) {
+                        ImageF* uhf, BlurTemp* blur_temp, ThreadPool* pool) {
   const HWY_FULL(float) d;
   const size_t xsize = hf[0].xsize();
   const size_t ysize = hf[0].ysize();
@@ -483,14 +559,19 @@ Status SeparateHFAndUHF(const ButteraugliParams& params, ImageF* hf,
   JXL_ASSIGN_OR_RETURN(uhf[1], ImageF::Create(memory_manager, xsize, ysize));
   for (int i = 0; i < 2; ++i) {
     // Divide hf into hf and uhf.
-    for (size_t y = 0; y < ysize; ++y) {
-      float* BUTTERAUGLI_RESTRICT row_uhf = uhf[i].Row(y);
-      float* BUTTERAUGLI_RESTRICT row_hf = hf[i].Row(y);
-      for (size_t x = 0; x < xsize; ++x) {
-        row_uhf[x] = row_hf[x];
+    const auto copy_rows = [&](size_t y_begin, size_t y_end) {
+      for (size_t y = y_begin; y < y_end; ++y) {
+        float* BUTTERAUGLI_RESTRICT row_uhf = uhf[i].Row(y);
+        float* BUTTERAUGLI_RESTRICT row_hf = hf[i].Row(y);
+        for (size_t x = 0; x < xsize; ++x) {
+          row_uhf[x] = row_hf[x];
+        }
       }
-    }
-    JXL_RETURN_IF_ERROR(Blur(hf[i], kSigmaUhf, params, blur_temp, &hf[i]));
+    };
+    JXL_RETURN_IF_ERROR(
+        RunOnRowBands(pool, ysize, copy_rows, "SeparateHFAndUHF copy"));
+    JXL_RETURN_IF_ERROR(
+        Blur(hf[i], kSigmaUhf, params, blur_temp, pool, &hf[i]));
     static const double kRemoveHfRange = 1.5;
     static const double kAddHfRange = 0.132;
     static const double kRemoveUhfRange = 0.04;
@@ -498,38 +579,42 @@ Status SeparateHFAndUHF(const ButteraugliParams& params, ImageF* hf,
     static const double kMaxclampUhf = 5.19175294647;
     static double kMulYHf = 2.155;
     static double kMulYUhf = 2.69313763794;
-    if (i == 0) {
-      for (size_t y = 0; y < ysize; ++y) {
-        float* BUTTERAUGLI_RESTRICT row_uhf = uhf[0].Row(y);
-        float* BUTTERAUGLI_RESTRICT row_hf = hf[0].Row(y);
-        for (size_t x = 0; x < xsize; x += Lanes(d)) {
-          auto hfv = Load(d, row_hf + x);
-          auto uhfv = Sub(Load(d, row_uhf + x), hfv);
-          hfv = RemoveRangeAroundZero(d, kRemoveHfRange, hfv);
-          uhfv = RemoveRangeAroundZero(d, kRemoveUhfRange, uhfv);
-          Store(hfv, d, row_hf + x);
-          Store(uhfv, d, row_uhf + x);
+    const auto separate_rows = [&](size_t y_begin, size_t y_end) {
+      if (i == 0) {
+        for (size_t y = y_begin; y < y_end; ++y) {
+          float* BUTTERAUGLI_RESTRICT row_uhf = uhf[0].Row(y);
+          float* BUTTERAUGLI_RESTRICT row_hf = hf[0].Row(y);
+          for (size_t x = 0; x < xsize; x += Lanes(d)) {
+            auto hfv = Load(d, row_hf + x);
+            auto uhfv = Sub(Load(d, row_uhf + x), hfv);
+            hfv = RemoveRangeAroundZero(d, kRemoveHfRange, hfv);
+            uhfv = RemoveRangeAroundZero(d, kRemoveUhfRange, uhfv);
+            Store(hfv, d, row_hf + x);
+            Store(uhfv, d, row_uhf + x);
+          }
         }
-      }
-    } else {
-      for (size_t y = 0; y < ysize; ++y) {
-        float* BUTTERAUGLI_RESTRICT row_uhf = uhf[1].Row(y);
-        float* BUTTERAUGLI_RESTRICT row_hf = hf[1].Row(y);
-        for (size_t x = 0; x < xsize; x += Lanes(d)) {
-          auto hfv = Load(d, row_hf + x);
-          hfv = MaximumClamp(d, hfv, kMaxclampHf);
-
-          auto uhfv = Sub(Load(d, row_uhf + x), hfv);
-          uhfv = MaximumClamp(d, uhfv, kMaxclampUhf);
-          uhfv = Mul(uhfv, Set(d, kMulYUhf));
-          Store(uhfv, d, row_uhf + x);
-
-          hfv = Mul(hfv, Set(d, kMulYHf));
-          hfv = AmplifyRangeAroundZero(d, kAddHfRange, hfv);
-          Store(hfv, d, row_hf + x);
+      } else {
+        for (size_t y = y_begin; y < y_end; ++y) {
+          float* BUTTERAUGLI_RESTRICT row_uhf = uhf[1].Row(y);
+          float* BUTTERAUGLI_RESTRICT row_hf = hf[1].Row(y);
+          for (size_t x = 0; x < xsize; x += Lanes(d)) {
+            auto hfv = Load(d, row_hf + x);
+            hfv = MaximumClamp(d, hfv, kMaxclampHf);
+
+            auto uhfv = Sub(Load(d, row_uhf + x), hfv);
+            uhfv = MaximumClamp(d, uhfv, kMaxclampUhf);
+            uhfv = Mul(uhfv, Set(d, kMulYUhf));
+            Store(uhfv, d, row_uhf + x);
+
+            hfv = Mul(hfv, Set(d, kMulYHf));
+            hfv = AmplifyRangeAroundZero(d, kAddHfRange, hfv);
+            Store(hfv, d, row_hf + x);
+          }
         }
       }
-    }
+    };
+    JXL_RETURN_IF_ERROR(
+        RunOnRowBands(pool, ysize, separate_rows, "SeparateHFAndUHF"));
   }
   return true;
 }
@@ -543,16 +628,19 @@ void DeallocateHFAndUHF(ImageF* hf, ImageF* uhf) {
 
 Status SeparateFrequencies(size_t xsize, size_t ysize,
                            const ButteraugliParams& params, BlurTemp* blur_temp,
-                           const Image3F& xyb, PsychoImage& ps) {
+                           const Image3F& xyb, ThreadPool* pool,
+                           PsychoImage& ps) {
   JxlMemoryManager* memory_manager = xyb.memory_manager();
   JXL_ASSIGN_OR_RETURN(
       ps.lf, Image3F::Create(memory_manager, xyb.xsize(), xyb.ysize()));
   JXL_ASSIGN_OR_RETURN(
       ps.mf, Image3F::Create(memory_manager, xyb.xsize(), xyb.ysize()));
-  JXL_RETURN_IF_ERROR(SeparateLFAndMF(params, xyb, &ps.lf, &ps.mf, blur_temp));
-  JXL_RETURN_IF_ERROR(SeparateMFAndHF(params, &ps.mf, &ps.hf[0], blur_temp));
   JXL_RETURN_IF_ERROR(
-      SeparateHFAndUHF(params, &ps.hf[0], &ps.uhf[0], blur_temp));
+      SeparateLFAndMF(params, xyb, &ps.lf, &ps.mf, blur_temp, pool));
+  JXL_RETURN_IF_ERROR(
+      SeparateMFAndHF(params, &ps.mf, &ps.hf[0], blur_temp, pool));
+  JXL_RETURN_IF_ERROR(
+      SeparateHFAndUHF(params, &ps.hf[0], &ps.uhf[0], blur_temp, pool));
   return true;
 }
 
@@ -946,66 +1034,38 @@ Vec<D> MaltaUnit(MaltaTag /*tag*/, const D df,
   return retval;
 }
 
-// Returns MaltaUnit. Avoids bounds-checks when x0 and y0 are known
-// to be far enough from the image borders. "diffs" is a packed image.
+// Computes rows [y_begin, y_end) of the weighted difference of term.lum0 and
+// term.lum1 that the malta filter is applied to. Pixel (x, y) is stored at
+// (x + kMaltaBorder, y + kMaltaBorder) of diffs, and the left and right border
+// columns of the rows are zeroed.
 template <class Tag>
-static BUTTERAUGLI_INLINE float PaddedMaltaUnit(const ImageF& diffs,
-                                                const size_t x0,
-                                                const size_t y0) {
-  const float* BUTTERAUGLI_RESTRICT d = diffs.ConstRow(y0) + x0;
-  const HWY_CAPPED(float, 1) df;
-  if ((x0 >= 4 && y0 >= 4 && x0 < (diffs.xsize() - 4) &&
-       y0 < (diffs.ysize() - 4))) {
-    return GetLane(MaltaUnit(Tag(), df, d, diffs.PixelsPerRow()));
-  }
-
-  float borderimage[12 * 9];  // round up to 4
-  for (int dy = 0; dy < 9; ++dy) {
-    int y = y0 + dy - 4;
-    if (y < 0 || static_cast<size_t>(y) >= diffs.ysize()) {
-      for (int dx = 0; dx < 12; ++dx) {
-        borderimage[dy * 12 + dx] = 0.0f;
-      }
-      continue;
-    }
-
-    const float* row_diffs = diffs.ConstRow(y);
-    for (int dx = 0; dx < 9; ++dx) {
-      int x = x0 + dx - 4;
-      if (x < 0 || static_cast<size_t>(x) >= diffs.xsize()) {
-        borderimage[dy * 12 + dx] = 0.0f;
-      } else {
-        borderimage[dy * 12 + dx] = row_diffs[x];
-      }
-    }
-    std::fill(borderimage + dy * 12 + 9, borderimage + dy * 12 + 12, 0.0f);
-  }
-  return GetLane(MaltaUnit(Tag(), df, &borderimage[4 * 12 + 4], 12));
-}
-
-template <class Tag>
-static Status MaltaDiffMapT(const Tag tag, const ImageF& lum0,
-                            const ImageF& lum1, const double w_0gt1,
-                            const double w_0lt1, const double norm1,
-                            const double len, const double mulli,
-                            ImageF* HWY_RESTRICT diffs,
-                            ImageF* HWY_RESTRICT block_diff_ac) {
-  JXL_ENSURE(SameSize(lum0, lum1) && SameSize(lum0, *diffs));
+static void MaltaDiffRows(const MaltaTerm& term, const double mulli,
+                          size_t y_begin, size_t y_end,
+                          ImageF* HWY_RESTRICT diffs) {
+  const ImageF& lum0 = *term.lum0;
+  const ImageF& lum1 = *term.lum1;
+  const double norm1 = term.norm1;
   const size_t xsize_ = lum0.xsize();
-  const size_t ysize_ = lum0.ysize();
+  const double len = 3.75;
 
   const float kWeight0 = 0.5;
   const float kWeight1 = 0.33;
 
-  const double w_pre0gt1 = mulli * std::sqrt(kWeight0 * w_0gt1) / (len * 2 + 1);
-  const double w_pre0lt1 = mulli * std::sqrt(kWeight1 * w_0lt1) / (len * 2 + 1);
+  const double w_pre0gt1 =
+      mulli * std::sqrt(kWeight0 * term.w_0gt1) / (len * 2 + 1);
+  const double w_pre0lt1 =
+      mulli * std::sqrt(kWeight1 * term.w_0lt1) / (len * 2 + 1);
   const float norm2_0gt1 = w_pre0gt1 * norm1;
   const float norm2_0lt1 = w_pre0lt1 * norm1;
 
-  for (size_t y = 0; y < ysize_; ++y) {
+  for (size_t y = y_begin; y < y_end; ++y) {
     const float* HWY_RESTRICT row0 = lum0.ConstRow(y);
     const float* HWY_RESTRICT row1 = lum1.ConstRow(y);
-    float* HWY_RESTRICT row_diffs = diffs->Row(y);
+    float* HWY_RESTRICT row_padded = diffs->Row(y + kMaltaBorder);
+    std::fill(row_padded, row_padded + kMaltaBorder, 0.0f);
+    std::fill(row_padded + kMaltaBorder + xsize_,
+              row_padded + 2 * kMaltaBorder + xsize_, 0.0f);
+    float* HWY_RESTRICT row_diffs = row_padded + kMaltaBorder;
     for (size_t x = 0; x < xsize_; ++x) {
       const float absval = 0.5f * (std::abs(row0[x]) + std::abs(row1[x]));
       const float diff = row0[x] - row1[x];
@@ -1040,74 +1100,92 @@ static Status MaltaDiffMapT(const Tag tag, const ImageF& lum0,
       }
     }
   }
+}
 
-  size_t y0 = 0;
-  // Top
-  for (; y0 < 4; ++y0) {
-    float* BUTTERAUGLI_RESTRICT row_diff = block_diff_ac->Row(y0);
-    for (size_t x0 = 0; x0 < xsize_; ++x0) {
-      row_diff[x0] += PaddedMaltaUnit<Tag>(*diffs, x0, y0);
-    }
-  }
-
+// Adds the malta filter of diffs, which has a zero border of kMaltaBorder
+// pixels, to rows [y_begin, y_end) of block_diff_ac. Reads up to four rows
+// above and below the band from diffs. Thanks to the border, every pixel is
+// computed with shifted loads of whole vectors; the last pixels of a row that
+// do not fill a vector use single lanes.
+template <class Tag>
+static void MaltaAccumulateRows(const ImageF& diffs, size_t y_begin,
+                                size_t y_end,
+                                ImageF* HWY_RESTRICT block_diff_ac) {
+  const size_t xsize = block_diff_ac->xsize();
   const HWY_FULL(float) df;
-  const size_t aligned_x = std::max(static_cast<size_t>(4), Lanes(df));
-  const intptr_t stride = diffs->PixelsPerRow();
+  const HWY_CAPPED(float, 1) d1;
+  const intptr_t stride = diffs.PixelsPerRow();
 
-  // Middle
-  for (; y0 < ysize_ - 4; ++y0) {
-    const float* BUTTERAUGLI_RESTRICT row_in = diffs->ConstRow(y0);
+  for (size_t y0 = y_begin; y0 < y_end; ++y0) {
     float* BUTTERAUGLI_RESTRICT row_diff = block_diff_ac->Row(y0);
+    const float* BUTTERAUGLI_RESTRICT row_in =
+        diffs.ConstRow(y0 + kMaltaBorder) + kMaltaBorder;
     size_t x0 = 0;
-    for (; x0 < aligned_x; ++x0) {
-      row_diff[x0] += PaddedMaltaUnit<Tag>(*diffs, x0, y0);
-    }
-    for (; x0 + Lanes(df) + 4 <= xsize_; x0 += Lanes(df)) {
+    for (; x0 + Lanes(df) <= xsize; x0 += Lanes(df)) {
       auto diff = Load(df, row_diff + x0);
       diff = Add(diff, MaltaUnit(Tag(), df, row_in + x0, stride));
       Store(diff, df, row_diff + x0);
     }
-
-    for (; x0 < xsize_; ++x0) {
-      row_diff[x0] += PaddedMaltaUnit<Tag>(*diffs, x0, y0);
+    for (; x0 < xsize; ++x0) {
+      auto diff = Load(d1, row_diff + x0);
+      diff = Add(diff, MaltaUnit(Tag(), d1, row_in + x0, stride));
+      Store(diff, d1, row_diff + x0);
     }
   }
+}
 
-  // Bottom
-  for (; y0 < ysize_; ++y0) {
-    float* BUTTERAUGLI_RESTRICT row_diff = block_diff_ac->Row(y0);
-    for (size_t x0 = 0; x0 < xsize_; ++x0) {
-      row_diff[x0] += PaddedMaltaUnit<Tag>(*diffs, x0, y0);
+// Adds the malta terms to their block_diff_ac images. diffs[i] is a temporary
+// image for terms[i], larger by kMaltaBorder on each side. The differences of
+// all terms, which are independent, are computed concurrently. The filtered
+// terms are added in order, so the result does not depend on the number of
+// threads.
+Status MaltaDiffMaps(const MaltaTerm* terms, size_t num_terms,
+                     ImageF* HWY_RESTRICT diffs, ThreadPool* pool) {
+  if (num_terms == 0) return true;
+  const size_t ysize = terms[0].lum0->ysize();
+  for (size_t i = 0; i < num_terms; ++i) {
+    const ImageF& lum0 = *terms[i].lum0;
+    JXL_ENSURE(SameSize(lum0, *terms[i].lum1));
+    JXL_ENSURE(SameSize(lum0, *terms[i].block_diff_ac));
+    JXL_ENSURE(lum0.ysize() == ysize);
+    JXL_ENSURE(diffs[i].xsize() == lum0.xsize() + 2 * kMaltaBorder);
+    JXL_ENSURE(diffs[i].ysize() == ysize + 2 * kMaltaBorder);
+    for (size_t y = 0; y < kMaltaBorder; ++y) {
+      const size_t padded_xsize = diffs[i].xsize();
+      std::fill(diffs[i].Row(y), diffs[i].Row(y) + padded_xsize, 0.0f);
+      float* row_bottom = diffs[i].Row(ysize + kMaltaBorder + y);
+      std::fill(row_bottom, row_bottom + padded_xsize, 0.0f);
     }
   }
-  return true;
-}
+  static const double kMulli = 0.39905817637;
+  static const double kMulliLF = 0.611612573796;
 
-// Need non-template wrapper functions for HWY_EXPORT.
-Status MaltaDiffMap(const ImageF& lum0, const ImageF& lum1, const double w_0gt1,
-                    const double w_0lt1, const double norm1,
-                    ImageF* HWY_RESTRICT diffs,
-                    ImageF* HWY_RESTRICT block_diff_ac) {
-  const double len = 3.75;
-  static const double mulli = 0.39905817637;
-  JXL_RETURN_IF_ERROR(MaltaDiffMapT(MaltaTag(), lum0, lum1, w_0gt1, w_0lt1,
-                                    norm1, len, mulli, diffs, block_diff_ac));
-  return true;
-}
+  const auto diff_rows = [&](size_t i, size_t y_begin, size_t y_end) {
+    if (terms[i].lf) {
+      MaltaDiffRows<MaltaTagLF>(terms[i], kMulliLF, y_begin, y_end, &diffs[i]);
+    } else {
+      MaltaDiffRows<MaltaTag>(terms[i], kMulli, y_begin, y_end, &diffs[i]);
+    }
+  };
+  JXL_RETURN_IF_ERROR(
+      RunOnRowBands(pool, num_terms, ysize, diff_rows, "MaltaDiffRows"));
 
-Status MaltaDiffMapLF(const ImageF& lum0, const ImageF& lum1,
-                      const double w_0gt1, const double w_0lt1,
-                      const double norm1, ImageF* HWY_RESTRICT diffs,
-                      ImageF* HWY_RESTRICT block_diff_ac) {
-  const double len = 3.75;
-  static const double mulli = 0.611612573796;
-  JXL_RETURN_IF_ERROR(MaltaDiffMapT(MaltaTagLF(), lum0, lum1, w_0gt1, w_0lt1,
-                                    norm1, len, mulli, diffs, block_diff_ac));
-  return true;
+  const auto accumulate_rows = [&](size_t y_begin, size_t y_end) {
+    for (size_t i = 0; i < num_terms; ++i) {
+      if (terms[i].lf) {
+        MaltaAccumulateRows<MaltaTagLF>(diffs[i], y_begin, y_end,
+                                        terms[i].block_diff_ac);
+      } else {
+        MaltaAccumulateRows<MaltaTag>(diffs[i], y_begin, y_end,
+                                      terms[i].block_diff_ac);
+      }
+    }
+  };
+  return RunOnRowBands(pool, ysize, accumulate_rows, "MaltaAccumulateRows");
 }
 
-void CombineChannelsForMasking(const ImageF* hf, const ImageF* uhf,
-                               ImageF* out) {
+Status CombineChannelsForMasking(const ImageF* hf, const ImageF* uhf,
+                                 ThreadPool* pool, ImageF* out) {
   // Only X and Y components are involved in masking. B's influence
   // is considered less important in the high frequency area, and we
   // don't model masking from lower frequency signals.
@@ -1117,34 +1195,42 @@ void CombineChannelsForMasking(const ImageF* hf, const ImageF* uhf,
       0.4f,
   };
   // Silly and unoptimized approach here. TODO(jyrki): rework this.
-  for (size_t y = 0; y < hf[0].ysize(); ++y) {
-    const float* BUTTERAUGLI_RESTRICT row_y_hf = hf[1].Row(y);
-    const float* BUTTERAUGLI_RESTRICT row_y_uhf = uhf[1].Row(y);
-    const float* BUTTERAUGLI_RESTRICT row_x_hf = hf[0].Row(y);
-    const float* BUTTERAUGLI_RESTRICT row_x_uhf = uhf[0].Row(y);
-    float* BUTTERAUGLI_RESTRICT row = out->Row(y);
-    for (size_t x = 0; x < hf[0].xsize(); ++x) {
-      float xdiff = (row_x_uhf[x] + row_x_hf[x]) * muls[0];
-      float ydiff = row_y_uhf[x] * muls[1] + row_y_hf[x] * muls[2];
-      row[x] = xdiff * xdiff + ydiff * ydiff;
-      row[x] = std::sqrt(row[x]);
+  const auto combine_rows = [&](size_t y_begin, size_t y_end) {
+    for (size_t y = y_begin; y < y_end; ++y) {
+      const float* BUTTERAUGLI_RESTRICT row_y_hf = hf[1].Row(y);
+      const float* BUTTERAUGLI_RESTRICT row_y_uhf = uhf[1].Row(y);
+      const float* BUTTERAUGLI_RESTRICT row_x_hf = hf[0].Row(y);
+      const float* BUTTERAUGLI_RESTRICT row_x_uhf = uhf[0].Row(y);
+      float* BUTTERAUGLI_RESTRICT row = out->Row(y);
+      for (size_t x = 0; x < hf[0].xsize(); ++x) {
+        float xdiff = (row_x_uhf[x] + row_x_hf[x]) * muls[0];
+        float ydiff = row_y_uhf[x] * muls[1] + row_y_hf[x] * muls[2];
+        row[x] = xdiff * xdiff + ydiff * ydiff;
+        row[x] = std::sqrt(row[x]);
+      }
     }
-  }
+  };
+  return RunOnRowBands(pool, hf[0].ysize(), combine_rows,
+                       "CombineChannelsForMasking");
 }
 
-void DiffPrecompute(const ImageF& xyb, float mul, float bias_arg, ImageF* out) {
+Status DiffPrecompute(const ImageF& xyb, float mul, float bias_arg,
+                      ThreadPool* pool, ImageF* out) {
   const size_t xsize = xyb.xsize();
   const size_t ysize = xyb.ysize();
   const float bias = mul * bias_arg;
   const float sqrt_bias = std::sqrt(bias);
-  for (size_t y = 0; y < ysize; ++y) {
-    const float* BUTTERAUGLI_RESTRICT row_in = xyb.Row(y);
-    float* BUTTERAUGLI_RESTRICT row_out = out->Row(y);
-    for (size_t x = 0; x < xsize; ++x) {
-      // kBias makes sqrt behave more linearly.
-      row_out[x] = std::sqrt(mul * std::abs(row_in[x]) + bias) - sqrt_bias;
+  const auto precompute_rows = [&](size_t y_begin, size_t y_end) {
+    for (size_t y = y_begin; y < y_end; ++y) {
+      const float* BUTTERAUGLI_RESTRICT row_in = xyb.Row(y);
+      float* BUTTERAUGLI_RESTRICT row_out = out->Row(y);
+      for (size_t x = 0; x < xsize; ++x) {
+        // kBias makes sqrt behave more linearly.
+        row_out[x] = std::sqrt(mul * std::abs(row_in[x]) + bias) - sqrt_bias;
+      }
     }
-  }
+  };
+  return RunOnRowBands(pool, ysize, precompute_rows, "DiffPrecompute");
 }
 
 // std::log(80.0) / std::log(255.0);
@@ -1170,49 +1256,52 @@ void StoreMin3(const float v, float& min0, float& min1, float& min2) {
 
 // Look for smooth areas near the area of degradation.
 // If the areas area generally smooth, don't do masking.
-void FuzzyErosion(const ImageF& from, ImageF* to) {
+Status FuzzyErosion(const ImageF& from, ThreadPool* pool, ImageF* to) {
   const size_t xsize = from.xsize();
   const size_t ysize = from.ysize();
   static const int kStep = 3;
-  for (size_t y = 0; y < ysize; ++y) {
-    for (size_t x = 0; x < xsize; ++x) {
-      float min0 = from.Row(y)[x];
-      float min1 = 2 * min0;
-      float min2 = min1;
-      if (x >= kStep) {
-        StoreMin3(from.Row(y)[x - kStep], min0, min1, min2);
-        if (y >= kStep) {
-          StoreMin3(from.Row(y - kStep)[x - kStep], min0, min1, min2);
+  const auto erode_rows = [&](size_t y_begin, size_t y_end) {
+    for (size_t y = y_begin; y < y_end; ++y) {
+      for (size_t x = 0; x < xsize; ++x) {
+        float min0 = from.Row(y)[x];
+        float min1 = 2 * min0;
+        float min2 = min1;
+        if (x >= kStep) {
+          StoreMin3(from.Row(y)[x - kStep], min0, min1, min2);
+          if (y >= kStep) {
+            StoreMin3(from.Row(y - kStep)[x - kStep], min0, min1, min2);
+          }
+          if (y < ysize - kStep) {
+            StoreMin3(from.Row(y + kStep)[x - kStep], min0, min1, min2);
+          }
         }
-        if (y < ysize - kStep) {
-          StoreMin3(from.Row(y + kStep)[x - kStep], min0, min1, min2);
+        if (x < xsize - kStep) {
+          StoreMin3(from.Row(y)[x + kStep], min0, min1, min2);
+          if (y >= kStep) {
+            StoreMin3(from.Row(y - kStep)[x + kStep], min0, min1, min2);
+          }
+          if (y < ysize - kStep) {
+            StoreMin3(from.Row(y + kStep)[x + kStep], min0, min1, min2);
+          }
         }
-      }
-      if (x < xsize - kStep) {
-        StoreMin3(from.Row(y)[x + kStep], min0, min1, min2);
         if (y >= kStep) {
-          StoreMin3(from.Row(y - kStep)[x + kStep], min0, min1, min2);
+          StoreMin3(from.Row(y - kStep)[x], min0, min1, min2);
         }
         if (y < ysize - kStep) {
-          StoreMin3(from.Row(y + kStep)[x + kStep], min0, min1, min2);
+          StoreMin3(from.Row(y + kStep)[x], min0, min1, min2);
         }
+        to->Row(y)[x] = (0.45f * min0 + 0.3f * min1 + 0.25f * min2);
       }
-      if (y >= kStep) {
-        StoreMin3(from.Row(y - kStep)[x], min0, min1, min2);
-      }
-      if (y < ysize - kStep) {
-        StoreMin3(from.Row(y + kStep)[x], min0, min1, min2);
-      }
-      to->Row(y)[x] = (0.45f * min0 + 0.3f * min1 + 0.25f * min2);
     }
-  }
+  };
+  return RunOnRowBands(pool, ysize, erode_rows, "FuzzyErosion");
 }
 
 // Compute values of local frequency and dc masking based on the activity
 // in the two images. img_diff_ac may be null.
 Status Mask(const ImageF& mask0, const ImageF& mask1,
             const ButteraugliParams& params, BlurTemp* blur_temp,
-            ImageF* BUTTERAUGLI_RESTRICT mask,
+            ThreadPool* pool, ImageF* BUTTERAUGLI_RESTRICT mask,
             ImageF* BUTTERAUGLI_RESTRICT diff_ac) {
   const size_t xsize = mask0.xsize();
   const size_t ysize = mask0.ysize();
@@ -1229,38 +1318,43 @@ Status Mask(const ImageF& mask0, const ImageF& mask1,
                        ImageF::Create(memory_manager, xsize, ysize));
   JXL_ASSIGN_OR_RETURN(ImageF blurred1,
                        ImageF::Create(memory_manager, xsize, ysize));
-  DiffPrecompute(mask0, kMul, kBias, &diff0);
-  DiffPrecompute(mask1, kMul, kBias, &diff1);
-  JXL_RETURN_IF_ERROR(Blur(diff0, kRadius, params, blur_temp, &blurred0));
-  FuzzyErosion(blurred0, &diff0);
-  JXL_RETURN_IF_ERROR(Blur(diff1, kRadius, params, blur_temp, &blurred1));
-  for (size_t y = 0; y < ysize; ++y) {
-    for (size_t x = 0; x < xsize; ++x) {
-      mask->Row(y)[x] = diff0.Row(y)[x];
-      if (diff_ac != nullptr) {
-        static const float kMaskToErrorMul = 10.0;
-        float diff = blurred0.Row(y)[x] - blurred1.Row(y)[x];
-        diff_ac->Row(y)[x] += kMaskToErrorMul * diff * diff;
+  JXL_RETURN_IF_ERROR(DiffPrecompute(mask0, kMul, kBias, pool, &diff0));
+  JXL_RETURN_IF_ERROR(DiffPrecompute(mask1, kMul, kBias, pool, &diff1));
+  JXL_RETURN_IF_ERROR(Blur(diff0, kRadius, params, blur_temp, pool, &blurred0));
+  JXL_RETURN_IF_ERROR(FuzzyErosion(blurred0, pool, &diff0));
+  JXL_RETURN_IF_ERROR(Blur(diff1, kRadius, params, blur_temp, pool, &blurred1));
+  const auto mask_rows = [&](size_t y_begin, size_t y_end) {
+    for (size_t y = y_begin; y < y_end; ++y) {
+      for (size_t x = 0; x < xsize; ++x) {
+        mask->Row(y)[x] = diff0.Row(y)[x];
+        if (diff_ac != nullptr) {
+          static const float kMaskToErrorMul = 10.0;
+          float diff = blurred0.Row(y)[x] - blurred1.Row(y)[x];
+          diff_ac->Row(y)[x] += kMaskToErrorMul * diff * diff;
+        }
       }
     }
-  }
-  return true;
+  };
+  return RunOnRowBands(pool, ysize, mask_rows, "Mask");
 }
 
 // `diff_ac` may be null.
 Status MaskPsychoImage(const PsychoImage& pi0, const PsychoImage& pi1,
                        const size_t xsize, const size_t ysize,
                        const ButteraugliParams& params, BlurTemp* blur_temp,
-                       ImageF* BUTTERAUGLI_RESTRICT mask,
+                       ThreadPool* pool, ImageF* BUTTERAUGLI_RESTRICT mask,
                        ImageF* BUTTERAUGLI_RESTRICT diff_ac) {
   JxlMemoryManager* memory_manager = pi0.hf[0].memory_manager();
   JXL_ASSIGN_OR_RETURN(ImageF mask0,
                        ImageF::Create(memory_manager, xsize, ysize));
   JXL_ASSIGN_OR_RETURN(ImageF mask1,
                        ImageF::Create(memory_manager, xsize, ysize));
-  CombineChannelsForMasking(&pi0.hf[0], &pi0.uhf[0], &mask0);
-  CombineChannelsForMasking(&pi1.hf[0], &pi1.uhf[0], &mask1);
-  JXL_RETURN_IF_ERROR(Mask(mask0, mask1, params, blur_temp, mask, diff_ac));
+  JXL_RETURN_IF_ERROR(
+      CombineChannelsForMasking(&pi0.hf[0], &pi0.uhf[0], pool, &mask0));
+  JXL_RETURN_IF_ERROR(
+      CombineChannelsForMasking(&pi1.hf[0], &pi1.uhf[0], pool, &mask1));
+  JXL_RETURN_IF_ERROR(
+      Mask(mask0, mask1, params, blur_temp, pool, mask, diff_ac));
   return true;
 }
 
@@ -1290,40 +1384,44 @@ inline float MaskColor(const float color[3], const float mask) {
 Status CombineChannelsToDiffmap(const ImageF& mask,
                                 const Image3F& block_diff_dc,
                                 const Image3F& block_diff_ac, float xmul,
-                                ImageF* result) {
+                                ThreadPool* pool, ImageF* result) {
   JXL_ENSURE(SameSize(mask, *result));
   size_t xsize = mask.xsize();
   size_t ysize = mask.ysize();
-  for (size_t y = 0; y < ysize; ++y) {
-    float* BUTTERAUGLI_RESTRICT row_out = result->Row(y);
-    for (size_t x = 0; x < xsize; ++x) {
-      float val = mask.Row(y)[x];
-      float maskval = MaskY(val);
-      float dc_maskval = MaskDcY(val);
-      float diff_dc[3];
-      float diff_ac[3];
-      for (int i = 0; i < 3; ++i) {
-        diff_dc[i] = block_diff_dc.PlaneRow(i, y)[x];
-        diff_ac[i] = block_diff_ac.PlaneRow(i, y)[x];
+  const auto combine_rows = [&](size_t y_begin, size_t y_end) {
+    for (size_t y = y_begin; y < y_end; ++y) {
+      float* BUTTERAUGLI_RESTRICT row_out = result->Row(y);
+      for (size_t x = 0; x < xsize; ++x) {
+        float val = mask.Row(y)[x];
+        float maskval = MaskY(val);
+        float dc_maskval = MaskDcY(val);
+        float diff_dc[3];
+        float diff_ac[3];
+        for (int i = 0; i < 3; ++i) {
+          diff_dc[i] = block_diff_dc.PlaneRow(i, y)[x];
+          diff_ac[i] = block_diff_ac.PlaneRow(i, y)[x];
+        }
+        diff_ac[0] *= xmul;
+        diff_dc[0] *= xmul;
+        row_out[x] = std::sqrt(MaskColor(diff_dc, dc_maskval) +
+                               MaskColor(diff_ac, maskval));
       }
-      diff_ac[0] *= xmul;
-      diff_dc[0] *= xmul;
-      row_out[x] = std::sqrt(MaskColor(diff_dc, dc_maskval) +
-                             MaskColor(diff_ac, maskval));
     }
-  }
-  return true;
+  };
+  return RunOnRowBands(pool, ysize, combine_rows, "CombineChannelsToDiffmap");
 }
 
-// Adds weighted L2 difference between i0 and i1 to diffmap.
-static void L2Diff(const ImageF& i0, const ImageF& i1, const float w,
-                   ImageF* BUTTERAUGLI_RESTRICT diffmap) {
+// Adds weighted L2 difference between rows [y_begin, y_end) of i0 and i1 to
+// diffmap.
+static void L2DiffRows(const ImageF& i0, const ImageF& i1, const float w,
+                       size_t y_begin, size_t y_end,
+                       ImageF* BUTTERAUGLI_RESTRICT diffmap) {
   if (w == 0) return;
 
   const HWY_FULL(float) d;
   const auto weight = Set(d, w);
 
-  for (size_t y = 0; y < i0.ysize(); ++y) {
+  for (size_t y = y_begin; y < y_end; ++y) {
     const float* BUTTERAUGLI_RESTRICT row0 = i0.ConstRow(y);
     const float* BUTTERAUGLI_RESTRICT row1 = i1.ConstRow(y);
     float* BUTTERAUGLI_RESTRICT row_diff = diffmap->Row(y);
@@ -1337,15 +1435,26 @@ static void L2Diff(const ImageF& i0, const ImageF& i1, const float w,
   }
 }
 
-// Initializes diffmap to the weighted L2 difference between i0 and i1.
-static void SetL2Diff(const ImageF& i0, const ImageF& i1, const float w,
-                      ImageF* BUTTERAUGLI_RESTRICT diffmap) {
+// Adds weighted L2 difference between i0 and i1 to diffmap.
+static Status L2Diff(const ImageF& i0, const ImageF& i1, const float w,
+                     ThreadPool* pool, ImageF* BUTTERAUGLI_RESTRICT diffmap) {
+  const auto diff_rows = [&](size_t y_begin, size_t y_end) {
+    L2DiffRows(i0, i1, w, y_begin, y_end, diffmap);
+  };
+  return RunOnRowBands(pool, i0.ysize(), diff_rows, "L2Diff");
+}
+
+// Initializes rows [y_begin, y_end) of diffmap to the weighted L2 difference
+// between i0 and i1.
+static void SetL2DiffRows(const ImageF& i0, const ImageF& i1, const float w,
+                          size_t y_begin, size_t y_end,
+                          ImageF* BUTTERAUGLI_RESTRICT diffmap) {
   if (w == 0) return;
 
   const HWY_FULL(float) d;
   const auto weight = Set(d, w);
 
-  for (size_t y = 0; y < i0.ysize(); ++y) {
+  for (size_t y = y_begin; y < y_end; ++y) {
     const float* BUTTERAUGLI_RESTRICT row0 = i0.ConstRow(y);
     const float* BUTTERAUGLI_RESTRICT row1 = i1.ConstRow(y);
     float* BUTTERAUGLI_RESTRICT row_diff = diffmap->Row(y);
@@ -1360,9 +1469,10 @@ static void SetL2Diff(const ImageF& i0, const ImageF& i1, const float w,
 
 // i0 is the original image.
 // i1 is the deformed copy.
-static void L2DiffAsymmetric(const ImageF& i0, const ImageF& i1, float w_0gt1,
-                             float w_0lt1,
-                             ImageF* BUTTERAUGLI_RESTRICT diffmap) {
+static void L2DiffAsymmetricRows(const ImageF& i0, const ImageF& i1,
+                                 float w_0gt1, float w_0lt1, size_t y_begin,
+                                 size_t y_end,
+                                 ImageF* BUTTERAUGLI_RESTRICT diffmap) {
   if (w_0gt1 == 0 && w_0lt1 == 0) {
     return;
   }
@@ -1371,7 +1481,7 @@ static void L2DiffAsymmetric(const ImageF& i0, const ImageF& i1, float w_0gt1,
   const auto vw_0gt1 = Set(d, w_0gt1 * 0.8);
   const auto vw_0lt1 = Set(d, w_0lt1 * 0.8);
 
-  for (size_t y = 0; y < i0.ysize(); ++y) {
+  for (size_t y = y_begin; y < y_end; ++y) {
     const float* BUTTERAUGLI_RESTRICT row0 = i0.Row(y);
     const float* BUTTERAUGLI_RESTRICT row1 = i1.Row(y);
     float* BUTTERAUGLI_RESTRICT row_diff = diffmap->Row(y);
@@ -1402,6 +1512,38 @@ static void L2DiffAsymmetric(const ImageF& i0, const ImageF& i1, float w_0gt1,
   }
 }
 
+static Status L2DiffAsymmetric(const ImageF& i0, const ImageF& i1,
+                               float w_0gt1, float w_0lt1, ThreadPool* pool,
+                               ImageF* BUTTERAUGLI_RESTRICT diffmap) {
+  const auto diff_rows = [&](size_t y_begin, size_t y_end) {
+    L2DiffAsymmetricRows(i0, i1, w_0gt1, w_0lt1, y_begin, y_end, diffmap);
+  };
+  return RunOnRowBands(pool, i0.ysize(), diff_rows, "L2DiffAsymmetric");
+}
+
+// Adds the L2 differences of the HF and MF bands of pi0 and pi1 to
+// block_diff_ac and initializes block_diff_dc to the L2 differences of the LF
+// bands. All bands and channels of a row band are processed by one task.
+Status L2DiffPsychoImage(const PsychoImage& pi0, const PsychoImage& pi1,
+                         float hf_asymmetry, ThreadPool* pool,
+                         Image3F* BUTTERAUGLI_RESTRICT block_diff_ac,
+                         Image3F* BUTTERAUGLI_RESTRICT block_diff_dc) {
+  const auto diff_rows = [&](size_t y_begin, size_t y_end) {
+    for (size_t c = 0; c < 3; ++c) {
+      if (c < 2) {  // No blue channel error accumulated at HF.
+        L2DiffAsymmetricRows(pi0.hf[c], pi1.hf[c], wmul[c] * hf_asymmetry,
+                             wmul[c] / hf_asymmetry, y_begin, y_end,
+                             &block_diff_ac->Plane(c));
+      }
+      L2DiffRows(pi0.mf.Plane(c), pi1.mf.Plane(c), wmul[3 + c], y_begin,
+                 y_end, &block_diff_ac->Plane(c));
+      SetL2DiffRows(pi0.lf.Plane(c), pi1.lf.Plane(c), wmul[6 + c], y_begin,
+                    y_end, &block_diff_dc->Plane(c));
+    }
+  };
+  return RunOnRowBands(pool, pi0.mf.ysize(), diff_rows, "L2DiffPsychoImage");
+}
+
 // A simple HDR compatible gamma function.
 template <class DF, class V>
 V Gamma(const DF df, V v) {
@@ -1465,82 +1607,86 @@ BUTTERAUGLI_INLINE void OpsinAbsorbance(const DF df, const V& in0, const V& in1,
 
 // `blurred` is a temporary image used inside this function and not returned.
 Status OpsinDynamicsImage(const Image3F& rgb, const ButteraugliParams& params,
-                          Image3F* blurred, BlurTemp* blur_temp, Image3F* xyb) {
+                          Image3F* blurred, BlurTemp* blur_temp,
+                          ThreadPool* pool, Image3F* xyb) {
   JXL_ENSURE(blurred != nullptr);
   const double kSigma = 1.2;
-  JXL_RETURN_IF_ERROR(
-      Blur(rgb.Plane(0), kSigma, params, blur_temp, &blurred->Plane(0)));
-  JXL_RETURN_IF_ERROR(
-      Blur(rgb.Plane(1), kSigma, params, blur_temp, &blurred->Plane(1)));
-  JXL_RETURN_IF_ERROR(
-      Blur(rgb.Plane(2), kSigma, params, blur_temp, &blurred->Plane(2)));
+  for (size_t c = 0; c < 3; ++c) {
+    JXL_RETURN_IF_ERROR(Blur(rgb.Plane(c), kSigma, params, blur_temp, pool,
+                             &blurred->Plane(c)));
+  }
   const HWY_FULL(float) df;
   const auto intensity_target_multiplier = Set(df, params.intensity_target);
-  for (size_t y = 0; y < rgb.ysize(); ++y) {
-    const float* row_r = rgb.ConstPlaneRow(0, y);
-    const float* row_g = rgb.ConstPlaneRow(1, y);
-    const float* row_b = rgb.ConstPlaneRow(2, y);
-    const float* row_blurred_r = blurred->ConstPlaneRow(0, y);
-    const float* row_blurred_g = blurred->ConstPlaneRow(1, y);
-    const float* row_blurred_b = blurred->ConstPlaneRow(2, y);
-    float* row_out_x = xyb->PlaneRow(0, y);
-    float* row_out_y = xyb->PlaneRow(1, y);
-    float* row_out_b = xyb->PlaneRow(2, y);
-    const auto min = Set(df, 1e-4f);
-    for (size_t x = 0; x < rgb.xsize(); x += Lanes(df)) {
-      auto sensitivity0 = Undefined(df);
-      auto sensitivity1 = Undefined(df);
-      auto sensitivity2 = Undefined(df);
-      {
-        // Calculate sensitivity based on the smoothed image gamma derivative.
-        auto pre_mixed0 = Undefined(df);
-        auto pre_mixed1 = Undefined(df);
-        auto pre_mixed2 = Undefined(df);
-        OpsinAbsorbance<true>(
-            df, Mul(Load(df, row_blurred_r + x), intensity_target_multiplier),
-            Mul(Load(df, row_blurred_g + x), intensity_target_multiplier),
-            Mul(Load(df, row_blurred_b + x), intensity_target_multiplier),
-            &pre_mixed0, &pre_mixed1, &pre_mixed2);
-        pre_mixed0 = Max(pre_mixed0, min);
-        pre_mixed1 = Max(pre_mixed1, min);
-        pre_mixed2 = Max(pre_mixed2, min);
-        sensitivity0 = Div(Gamma(df, pre_mixed0), pre_mixed0);
-        sensitivity1 = Div(Gamma(df, pre_mixed1), pre_mixed1);
-        sensitivity2 = Div(Gamma(df, pre_mixed2), pre_mixed2);
-        sensitivity0 = Max(sensitivity0, min);
-        sensitivity1 = Max(sensitivity1, min);
-        sensitivity2 = Max(sensitivity2, min);
+  const auto opsin_rows = [&](size_t y_begin, size_t y_end) {
+    for (size_t y = y_begin; y < y_end; ++y) {
+      const float* row_r = rgb.ConstPlaneRow(0, y);
+      const float* row_g = rgb.ConstPlaneRow(1, y);
+      const float* row_b = rgb.ConstPlaneRow(2, y);
+      const float* row_blurred_r = blurred->ConstPlaneRow(0, y);
+      const float* row_blurred_g = blurred->ConstPlaneRow(1, y);
+      const float* row_blurred_b = blurred->ConstPlaneRow(2, y);
+      float* row_out_x = xyb->PlaneRow(0, y);
+      float* row_out_y = xyb->PlaneRow(1, y);
+      float* row_out_b = xyb->PlaneRow(2, y);
+      const auto min = Set(df, 1e-4f);
+      for (size_t x = 0; x < rgb.xsize(); x += Lanes(df)) {
+        auto sensitivity0 = Undefined(df);
+        auto sensitivity1 = Undefined(df);
+        auto sensitivity2 = Undefined(df);
+        {
+          // Calculate sensitivity based on the smoothed image gamma
+          // derivative.
+          auto pre_mixed0 = Undefined(df);
+          auto pre_mixed1 = Undefined(df);
+          auto pre_mixed2 = Undefined(df);
+          OpsinAbsorbance<true>(
+              df,
+              Mul(Load(df, row_blurred_r + x), intensity_target_multiplier),
+              Mul(Load(df, row_blurred_g + x), intensity_target_multiplier),
+              Mul(Load(df, row_blurred_b + x), intensity_target_multiplier),
+              &pre_mixed0, &pre_mixed1, &pre_mixed2);
+          pre_mixed0 = Max(pre_mixed0, min);
+          pre_mixed1 = Max(pre_mixed1, min);
+          pre_mixed2 = Max(pre_mixed2, min);
+          sensitivity0 = Div(Gamma(df, pre_mixed0), pre_mixed0);
+          sensitivity1 = Div(Gamma(df, pre_mixed1), pre_mixed1);
+          sensitivity2 = Div(Gamma(df, pre_mixed2), pre_mixed2);
+          sensitivity0 = Max(sensitivity0, min);
+          sensitivity1 = Max(sensitivity1, min);
+          sensitivity2 = Max(sensitivity2, min);
+        }
+        auto cur_mixed0 = Undefined(df);
+        auto cur_mixed1 = Undefined(df);
+        auto cur_mixed2 = Undefined(df);
+        OpsinAbsorbance<false>(
+            df, Mul(Load(df, row_r + x), intensity_target_multiplier),
+            Mul(Load(df, row_g + x), intensity_target_multiplier),
+            Mul(Load(df, row_b + x), intensity_target_multiplier), &cur_mixed0,
+            &cur_mixed1, &cur_mixed2);
+        cur_mixed0 = Mul(cur_mixed0, sensitivity0);
+        cur_mixed1 = Mul(cur_mixed1, sensitivity1);
+        cur_mixed2 = Mul(cur_mixed2, sensitivity2);
+        // This is a kludge. The negative values should be zeroed away before
+        // blurring. Ideally there would be no negative values in the first
+        // place.
+        const auto min01 = Set(df, 1.7557483643287353f);
+        const auto min2 = Set(df, 12.226454707163354f);
+        cur_mixed0 = Max(cur_mixed0, min01);
+        cur_mixed1 = Max(cur_mixed1, min01);
+        cur_mixed2 = Max(cur_mixed2, min2);
+
+        Store(Sub(cur_mixed0, cur_mixed1), df, row_out_x + x);
+        Store(Add(cur_mixed0, cur_mixed1), df, row_out_y + x);
+        Store(cur_mixed2, df, row_out_b + x);
       }
-      auto cur_mixed0 = Undefined(df);
-      auto cur_mixed1 = Undefined(df);
-      auto cur_mixed2 = Undefined(df);
-      OpsinAbsorbance<false>(
-          df, Mul(Load(df, row_r + x), intensity_target_multiplier),
-          Mul(Load(df, row_g + x), intensity_target_multiplier),
-          Mul(Load(df, row_b + x), intensity_target_multiplier), &cur_mixed0,
-          &cur_mixed1, &cur_mixed2);
-      cur_mixed0 = Mul(cur_mixed0, sensitivity0);
-      cur_mixed1 = Mul(cur_mixed1, sensitivity1);
-      cur_mixed2 = Mul(cur_mixed2, sensitivity2);
-      // This is a kludge. The negative values should be zeroed away before
-      // blurring. Ideally there would be no negative values in the first place.
-      const auto min01 = Set(df, 1.7557483643287353f);
-      const auto min2 = Set(df, 12.226454707163354f);
-      cur_mixed0 = Max(cur_mixed0, min01);
-      cur_mixed1 = Max(cur_mixed1, min01);
-      cur_mixed2 = Max(cur_mixed2, min2);
-
-      Store(Sub(cur_mixed0, cur_mixed1), df, row_out_x + x);
-      Store(Add(cur_mixed0, cur_mixed1), df, row_out_y + x);
-      Store(cur_mixed2, df, row_out_b + x);
     }
-  }
-  return true;
+  };
+  return RunOnRowBands(pool, rgb.ysize(), opsin_rows, "OpsinDynamicsImage");
 }
 
 Status ButteraugliDiffmapInPlace(Image3F& image0, Image3F& image1,
                                  const ButteraugliParams& params,
-                                 ImageF& diffmap) {
+                                 ThreadPool* pool, ImageF& diffmap) {
   // image0 and image1 are in linear sRGB color space
   const size_t xsize = image0.xsize();
   const size_t ysize = image0.ysize();
@@ -1551,9 +1697,9 @@ Status ButteraugliDiffmapInPlace(Image3F& image0, Image3F& image1,
     JXL_ASSIGN_OR_RETURN(Image3F temp,
                          Image3F::Create(memory_manager, xsize, ysize));
     JXL_RETURN_IF_ERROR(
-        OpsinDynamicsImage(image0, params, &temp, &blur_temp, &image0));
+        OpsinDynamicsImage(image0, params, &temp, &blur_temp, pool, &image0));
     JXL_RETURN_IF_ERROR(
-        OpsinDynamicsImage(image1, params, &temp, &blur_temp, &image1));
+        OpsinDynamicsImage(image1, params, &temp, &blur_temp, pool, &image1));
   }
   // image0 and image1 are in XYB color space
   JXL_ASSIGN_OR_RETURN(ImageF block_diff_dc,
@@ -1567,18 +1713,21 @@ Status ButteraugliDiffmapInPlace(Image3F& image0, Image3F& image1,
     JXL_ASSIGN_OR_RETURN(Image3F lf1,
                          Image3F::Create(memory_manager, xsize, ysize));
     JXL_RETURN_IF_ERROR(
-        SeparateLFAndMF(params, image0, &lf0, &image0, &blur_temp));
+        SeparateLFAndMF(params, image0, &lf0, &image0, &blur_temp, pool));
     JXL_RETURN_IF_ERROR(
-        SeparateLFAndMF(params, image1, &lf1, &image1, &blur_temp));
+        SeparateLFAndMF(params, image1, &lf1, &image1, &blur_temp, pool));
     for (size_t c = 0; c < 3; ++c) {
-      L2Diff(lf0.Plane(c), lf1.Plane(c), wmul[6 + c], &block_diff_dc);
+      JXL_RETURN_IF_ERROR(L2Diff(lf0.Plane(c), lf1.Plane(c), wmul[6 + c], pool,
+                                 &block_diff_dc));
     }
   }
   // image0 and image1 are MF residuals (before blurring) in XYB color space
   ImageF hf0[2];
   ImageF hf1[2];
-  JXL_RETURN_IF_ERROR(SeparateMFAndHF(params, &image0, &hf0[0], &blur_temp));
-  JXL_RETURN_IF_ERROR(SeparateMFAndHF(params, &image1, &hf1[0], &blur_temp));
+  JXL_RETURN_IF_ERROR(
+      SeparateMFAndHF(params, &image0, &hf0[0], &blur_temp, pool));
+  JXL_RETURN_IF_ERROR(
+      SeparateMFAndHF(params, &image1, &hf1[0], &blur_temp, pool));
   // image0 and image1 are MF-images in XYB color space
 
   JXL_ASSIGN_OR_RETURN(ImageF block_diff_ac,
@@ -1586,17 +1735,23 @@ Status ButteraugliDiffmapInPlace(Image3F& image0, Image3F& image1,
   ZeroFillImage(&block_diff_ac);
   // start accumulating ac diff image from MF images
   {
-    JXL_ASSIGN_OR_RETURN(ImageF diffs,
-                         ImageF::Create(memory_manager, xsize, ysize));
-    JXL_RETURN_IF_ERROR(MaltaDiffMapLF(image0.Plane(1), image1.Plane(1),
-                                       wMfMalta, wMfMalta, norm1Mf, &diffs,
-                                       &block_diff_ac));
-    JXL_RETURN_IF_ERROR(MaltaDiffMapLF(image0.Plane(0), image1.Plane(0),
-                                       wMfMaltaX, wMfMaltaX, norm1MfX, &diffs,
-                                       &block_diff_ac));
+    ImageF diffs[2];
+    for (ImageF& image : diffs) {
+      JXL_ASSIGN_OR_RETURN(image, ImageF::Create(memory_manager,
+                                                 xsize + 2 * kMaltaBorder,
+                                                 ysize + 2 * kMaltaBorder));
+    }
+    const MaltaTerm terms[2] = {
+        {&image0.Plane(1), &image1.Plane(1), wMfMalta, wMfMalta, norm1Mf,
+         /*lf=*/true, &block_diff_ac},
+        {&image0.Plane(0), &image1.Plane(0), wMfMaltaX, wMfMaltaX, norm1MfX,
+         /*lf=*/true, &block_diff_ac},
+    };
+    JXL_RETURN_IF_ERROR(MaltaDiffMaps(terms, 2, diffs, pool));
   }
   for (size_t c = 0; c < 3; ++c) {
-    L2Diff(image0.Plane(c), image1.Plane(c), wmul[3 + c], &block_diff_ac);
+    JXL_RETURN_IF_ERROR(L2Diff(image0.Plane(c), image1.Plane(c), wmul[3 + c],
+                               pool, &block_diff_ac));
   }
   // we will not need the MF-images and more, so we deallocate them to reduce
   // peak memory usage
@@ -1605,30 +1760,42 @@ Status ButteraugliDiffmapInPlace(Image3F& image0, Image3F& image1,
 
   ImageF uhf0[2];
   ImageF uhf1[2];
-  JXL_RETURN_IF_ERROR(SeparateHFAndUHF(params, &hf0[0], &uhf0[0], &blur_temp));
-  JXL_RETURN_IF_ERROR(SeparateHFAndUHF(params, &hf1[0], &uhf1[0], &blur_temp));
+  JXL_RETURN_IF_ERROR(
+      SeparateHFAndUHF(params, &hf0[0], &uhf0[0], &blur_temp, pool));
+  JXL_RETURN_IF_ERROR(
+      SeparateHFAndUHF(params, &hf1[0], &uhf1[0], &blur_temp, pool));
 
   // continue accumulating ac diff image from HF and UHF images
   const float hf_asymmetry = params.hf_asymmetry;
   {
-    JXL_ASSIGN_OR_RETURN(ImageF diffs,
-                         ImageF::Create(memory_manager, xsize, ysize));
-    JXL_RETURN_IF_ERROR(MaltaDiffMap(uhf0[1], uhf1[1], wUhfMalta * hf_asymmetry,
-                                     wUhfMalta / hf_asymmetry, norm1Uhf, &diffs,
-                                     &block_diff_ac));
-    JXL_RETURN_IF_ERROR(MaltaDiffMap(
-        uhf0[0], uhf1[0], wUhfMaltaX * hf_asymmetry, wUhfMaltaX / hf_asymmetry,
-        norm1UhfX, &diffs, &block_diff_ac));
-    JXL_RETURN_IF_ERROR(MaltaDiffMapLF(
-        hf0[1], hf1[1], wHfMalta * std::sqrt(hf_asymmetry),
-        wHfMalta / std::sqrt(hf_asymmetry), norm1Hf, &diffs, &block_diff_ac));
-    JXL_RETURN_IF_ERROR(MaltaDiffMapLF(
-        hf0[0], hf1[0], wHfMaltaX * std::sqrt(hf_asymmetry),
-        wHfMaltaX / std::sqrt(hf_asymmetry), norm1HfX, &diffs, &block_diff_ac));
+    ImageF diffs[2];
+    for (ImageF& image : diffs) {
+      JXL_ASSIGN_OR_RETURN(image, ImageF::Create(memory_manager,
+                                                 xsize + 2 * kMaltaBorder,
+                                                 ysize + 2 * kMaltaBorder));
+    }
+    const MaltaTerm uhf_terms[2] = {
+        {&uhf0[1], &uhf1[1], wUhfMalta * hf_asymmetry,
+         wUhfMalta / hf_asymmetry, norm1Uhf, /*lf=*/false, &block_diff_ac},
+        {&uhf0[0], &uhf1[0], wUhfMaltaX * hf_asymmetry,
+         wUhfMaltaX / hf_asymmetry, norm1UhfX, /*lf=*/false, &block_diff_ac},
+    };
+    JXL_RETURN_IF_ERROR(MaltaDiffMaps(uhf_terms, 2, diffs, pool));
+    const MaltaTerm hf_terms[2] = {
+        {&hf0[1], &hf1[1], wHfMalta * std::sqrt(hf_asymmetry),
+         wHfMalta / std::sqrt(hf_asymmetry), norm1Hf, /*lf=*/true,
+         &block_diff_ac},
+        {&hf0[0], &hf1[0], wHfMaltaX * std::sqrt(hf_asymmetry),
+         wHfMaltaX / std::sqrt(hf_asymmetry), norm1HfX, /*lf=*/true,
+         &block_diff_ac},
+    };
+    JXL_RETURN_IF_ERROR(MaltaDiffMaps(hf_terms, 2, diffs, pool));
   }
   for (size_t c = 0; c < 2; ++c) {
-    L2DiffAsymmetric(hf0[c], hf1[c], wmul[c] * hf_asymmetry,
-                     wmul[c] / hf_asymmetry, &block_diff_ac);
+    JXL_RETURN_IF_ERROR(L2DiffAsymmetric(hf0[c], hf1[c],
+                                         wmul[c] * hf_asymmetry,
+                                         wmul[c] / hf_asymmetry, pool,
+                                         &block_diff_ac));
   }
 
   // compute mask image from HF and UHF X and Y images
@@ -1639,26 +1806,30 @@ Status ButteraugliDiffmapInPlace(Image3F& image0, Image3F& image1,
                          ImageF::Create(memory_manager, xsize, ysize));
     JXL_ASSIGN_OR_RETURN(ImageF mask1,
                          ImageF::Create(memory_manager, xsize, ysize));
-    CombineChannelsForMasking(&hf0[0], &uhf0[0], &mask0);
-    CombineChannelsForMasking(&hf1[0], &uhf1[0], &mask1);
+    JXL_RETURN_IF_ERROR(
+        CombineChannelsForMasking(&hf0[0], &uhf0[0], pool, &mask0));
+    JXL_RETURN_IF_ERROR(
+        CombineChannelsForMasking(&hf1[0], &uhf1[0], pool, &mask1));
     DeallocateHFAndUHF(&hf1[0], &uhf1[0]);
     DeallocateHFAndUHF(&hf0[0], &uhf0[0]);
     JXL_RETURN_IF_ERROR(
-        Mask(mask0, mask1, params, &blur_temp, &mask, &block_diff_ac));
+        Mask(mask0, mask1, params, &blur_temp, pool, &mask, &block_diff_ac));
   }
 
   // compute final diffmap from mask image and ac and dc diff images
   JXL_ASSIGN_OR_RETURN(diffmap, ImageF::Create(memory_manager, xsize, ysize));
-  for (size_t y = 0; y < ysize; ++y) {
-    const float* row_dc = block_diff_dc.Row(y);
-    const float* row_ac = block_diff_ac.Row(y);
-    float* row_out = diffmap.Row(y);
-    for (size_t x = 0; x < xsize; ++x) {
-      const float val = mask.Row(y)[x];
-      row_out[x] = sqrt(row_dc[x] * MaskDcY(val) + row_ac[x] * MaskY(val));
+  const auto combine_rows = [&](size_t y_begin, size_t y_end) {
+    for (size_t y = y_begin; y < y_end; ++y) {
+      const float* row_dc = block_diff_dc.Row(y);
+      const float* row_ac = block_diff_ac.Row(y);
+      float* row_out = diffmap.Row(y);
+      for (size_t x = 0; x < xsize; ++x) {
+        const float val = mask.Row(y)[x];
+        row_out[x] = sqrt(row_dc[x] * MaskDcY(val) + row_ac[x] * MaskY(val));
+      }
     }
-  }
-  return true;
+  };
+  return RunOnRowBands(pool, ysize, combine_rows, "ButteraugliDiffmapInPlace");
 }
 
 // NOLINTNEXTLINE(google-readability-namespace-comments)
@@ -1669,15 +1840,12 @@ HWY_AFTER_NAMESPACE();
 #if HWY_ONCE
 namespace jxl {
 
-HWY_EXPORT(SeparateFrequencies);       // Local function.
-HWY_EXPORT(MaskPsychoImage);           // Local function.
-HWY_EXPORT(L2DiffAsymmetric);          // Local function.
-HWY_EXPORT(L2Diff);                    // Local function.
-HWY_EXPORT(SetL2Diff);                 // Local function.
-HWY_EXPORT(CombineChannelsToDiffmap);  // Local function.
-HWY_EXPORT(MaltaDiffMap);              // Local function.
-HWY_EXPORT(MaltaDiffMapLF);            // Local function.
-HWY_EXPORT(OpsinDynamicsImage);        // Local function.
+HWY_EXPORT(SeparateFrequencies);        // Local function.
+HWY_EXPORT(MaskPsychoImage);            // Local function.
+HWY_EXPORT(L2DiffPsychoImage);          // Local function.
+HWY_EXPORT(CombineChannelsToDiffmap);   // Local function.
+HWY_EXPORT(MaltaDiffMaps);              // Local function.
+HWY_EXPORT(OpsinDynamicsImage);         // Local function.
 HWY_EXPORT(ButteraugliDiffmapInPlace);  // Local function.
 
 #if BUTTERAUGLI_ENABLE_CHECKS
@@ -1764,16 +1932,20 @@ static StatusOr<Image3F> SubSample2x(const Image3F& in) {
 }
 
 // Supersample src by 2x and add it to dest.
-static void AddSupersampled2x(const ImageF& src, float w, ImageF& dest) {
-  for (size_t y = 0; y < dest.ysize(); ++y) {
-    for (size_t x = 0; x < dest.xsize(); ++x) {
-      // There will be less errors from the more averaged images.
-      // We take it into account to some extent using a scaler.
-      static const double kHeuristicMixingValue = 0.3;
-      dest.Row(y)[x] *= 1.0 - kHeuristicMixingValue * w;
-      dest.Row(y)[x] += w * src.Row(y / 2)[x / 2];
+static Status AddSupersampled2x(const ImageF& src, float w, ThreadPool* pool,
+                                ImageF& dest) {
+  const auto add_rows = [&](size_t y_begin, size_t y_end) {
+    for (size_t y = y_begin; y < y_end; ++y) {
+      for (size_t x = 0; x < dest.xsize(); ++x) {
+        // There will be less errors from the more averaged images.
+        // We take it into account to some extent using a scaler.
+        static const double kHeuristicMixingValue = 0.3;
+        dest.Row(y)[x] *= 1.0 - kHeuristicMixingValue * w;
+        dest.Row(y)[x] += w * src.Row(y / 2)[x / 2];
+      }
     }
-  }
+  };
+  return RunOnRowBands(pool, dest.ysize(), add_rows, "AddSupersampled2x");
 }
 
 Image3F* ButteraugliComparator::Temp() const {
@@ -1789,7 +1961,7 @@ ButteraugliComparator::ButteraugliComparator(size_t xsize, size_t ysize,
     : xsize_(xsize), ysize_(ysize), params_(params) {}
 
 StatusOr<std::unique_ptr<ButteraugliComparator>> ButteraugliComparator::Make(
-    const Image3F& rgb0, const ButteraugliParams& params) {
+    const Image3F& rgb0, const ButteraugliParams& params, ThreadPool* pool) {
   size_t xsize = rgb0.xsize();
   size_t ysize = rgb0.ysize();
   JxlMemoryManager* memory_manager = rgb0.memory_manager();
@@ -1806,27 +1978,28 @@ StatusOr<std::unique_ptr<ButteraugliComparator>> ButteraugliComparator::Make(
   JXL_ASSIGN_OR_RETURN(Image3F xyb0,
                        Image3F::Create(memory_manager, xsize, ysize));
   JXL_RETURN_IF_ERROR(HWY_DYNAMIC_DISPATCH(OpsinDynamicsImage)(
-      rgb0, params, result->Temp(), &result->blur_temp_, &xyb0));
+      rgb0, params, result->Temp(), &result->blur_temp_, pool, &xyb0));
   result->ReleaseTemp();
   JXL_RETURN_IF_ERROR(HWY_DYNAMIC_DISPATCH(SeparateFrequencies)(
-      xsize, ysize, params, &result->blur_temp_, xyb0, result->pi0_));
+      xsize, ysize, params, &result->blur_temp_, xyb0, pool, result->pi0_));
 
   // Awful recursive construction of samples of different resolution.
   // This is an after-thought and possibly somewhat parallel in
   // functionality with the PsychoImage multi-resolution approach.
   JXL_ASSIGN_OR_RETURN(Image3F subsampledRgb0, SubSample2x(rgb0));
-  JXL_ASSIGN_OR_RETURN(result->sub_,
-                       ButteraugliComparator::Make(subsampledRgb0, params));
+  JXL_ASSIGN_OR_RETURN(
+      result->sub_, ButteraugliComparator::Make(subsampledRgb0, params, pool));
   return result;
 }
 
-Status ButteraugliComparator::Mask(ImageF* BUTTERAUGLI_RESTRICT mask) const {
+Status ButteraugliComparator::Mask(ImageF* BUTTERAUGLI_RESTRICT mask,
+                                   ThreadPool* pool) const {
   return HWY_DYNAMIC_DISPATCH(MaskPsychoImage)(
-      pi0_, pi0_, xsize_, ysize_, params_, &blur_temp_, mask, nullptr);
+      pi0_, pi0_, xsize_, ysize_, params_, &blur_temp_, pool, mask, nullptr);
 }
 
-Status ButteraugliComparator::Diffmap(const Image3F& rgb1,
-                                      ImageF& result) const {
+Status ButteraugliComparator::Diffmap(const Image3F& rgb1, ImageF& result,
+                                      ThreadPool* pool) const {
   JxlMemoryManager* memory_manager = rgb1.memory_manager();
   if (xsize_ < 8 || ysize_ < 8) {
     ZeroFillImage(&result);
@@ -1835,9 +2008,9 @@ Status ButteraugliComparator::Diffmap(const Image3F& rgb1,
   JXL_ASSIGN_OR_RETURN(Image3F xyb1,
                        Image3F::Create(memory_manager, xsize_, ysize_));
   JXL_RETURN_IF_ERROR(HWY_DYNAMIC_DISPATCH(OpsinDynamicsImage)(
-      rgb1, params_, Temp(), &blur_temp_, &xyb1));
+      rgb1, params_, Temp(), &blur_temp_, pool, &xyb1));
   ReleaseTemp();
-  JXL_RETURN_IF_ERROR(DiffmapOpsinDynamicsImage(xyb1, result));
+  JXL_RETURN_IF_ERROR(DiffmapOpsinDynamicsImage(xyb1, result, pool));
   if (sub_) {
     if (sub_->xsize_ < 8 || sub_->ysize_ < 8) {
       return true;
@@ -1847,17 +2020,19 @@ Status ButteraugliComparator::Diffmap(const Image3F& rgb1,
         Image3F::Create(memory_manager, sub_->xsize_, sub_->ysize_));
     JXL_ASSIGN_OR_RETURN(Image3F subsampledRgb1, SubSample2x(rgb1));
     JXL_RETURN_IF_ERROR(HWY_DYNAMIC_DISPATCH(OpsinDynamicsImage)(
-        subsampledRgb1, params_, sub_->Temp(), &sub_->blur_temp_, &sub_xyb));
+        subsampledRgb1, params_, sub_->Temp(), &sub_->blur_temp_, pool,
+        &sub_xyb));
     sub_->ReleaseTemp();
     ImageF subresult;
-    JXL_RETURN_IF_ERROR(sub_->DiffmapOpsinDynamicsImage(sub_xyb, subresult));
-    AddSupersampled2x(subresult, 0.5, result);
+    JXL_RETURN_IF_ERROR(
+        sub_->DiffmapOpsinDynamicsImage(sub_xyb, subresult, pool));
+    JXL_RETURN_IF_ERROR(AddSupersampled2x(subresult, 0.5, pool, result));
   }
   return true;
 }
 
-Status ButteraugliComparator::DiffmapOpsinDynamicsImage(const Image3F& xyb1,
-                                                        ImageF& result) const {
+Status ButteraugliComparator::DiffmapOpsinDynamicsImage(
+    const Image3F& xyb1, ImageF& result, ThreadPool* pool) const {
   JxlMemoryManager* memory_manager = xyb1.memory_manager();
   if (xsize_ < 8 || ysize_ < 8) {
     ZeroFillImage(&result);
@@ -1865,33 +2040,14 @@ Status ButteraugliComparator::DiffmapOpsinDynamicsImage(const Image3F& xyb1,
   }
   PsychoImage pi1;
   JXL_RETURN_IF_ERROR(HWY_DYNAMIC_DISPATCH(SeparateFrequencies)(
-      xsize_, ysize_, params_, &blur_temp_, xyb1, pi1));
+      xsize_, ysize_, params_, &blur_temp_, xyb1, pool, pi1));
   JXL_ASSIGN_OR_RETURN(result, ImageF::Create(memory_manager, xsize_, ysize_));
-  return DiffmapPsychoImage(pi1, result);
-}
-
-namespace {
-
-Status MaltaDiffMap(const ImageF& lum0, const ImageF& lum1, const double w_0gt1,
-                    const double w_0lt1, const double norm1,
-                    ImageF* HWY_RESTRICT diffs,
-                    Image3F* HWY_RESTRICT block_diff_ac, size_t c) {
-  return HWY_DYNAMIC_DISPATCH(MaltaDiffMap)(lum0, lum1, w_0gt1, w_0lt1, norm1,
-                                            diffs, &block_diff_ac->Plane(c));
-}
-
-Status MaltaDiffMapLF(const ImageF& lum0, const ImageF& lum1,
-                      const double w_0gt1, const double w_0lt1,
-                      const double norm1, ImageF* HWY_RESTRICT diffs,
-                      Image3F* HWY_RESTRICT block_diff_ac, size_t c) {
-  return HWY_DYNAMIC_DISPATCH(MaltaDiffMapLF)(lum0, lum1, w_0gt1, w_0lt1, norm1,
-                                              diffs, &block_diff_ac->Plane(c));
+  return DiffmapPsychoImage(pi1, result, pool);
 }
 
-}  // namespace
-
 Status ButteraugliComparator::DiffmapPsychoImage(const PsychoImage& pi1,
-                                                 ImageF& diffmap) const {
+                                                 ImageF& diffmap,
+                                                 ThreadPool* pool) const {
   JxlMemoryManager* memory_manager = diffmap.memory_manager();
   if (xsize_ < 8 || ysize_ < 8) {
     ZeroFillImage(&diffmap);
@@ -1901,52 +2057,60 @@ Status ButteraugliComparator::DiffmapPsychoImage(const PsychoImage& pi1,
   const float hf_asymmetry_ = params_.hf_asymmetry;
   const float xmul_ = params_.xmul;
 
-  JXL_ASSIGN_OR_RETURN(ImageF diffs,
-                       ImageF::Create(memory_manager, xsize_, ysize_));
+  ImageF diffs[2];
+  for (ImageF& image : diffs) {
+    JXL_ASSIGN_OR_RETURN(image, ImageF::Create(memory_manager,
+                                               xsize_ + 2 * kMaltaBorder,
+                                               ysize_ + 2 * kMaltaBorder));
+  }
   JXL_ASSIGN_OR_RETURN(Image3F block_diff_ac,
                        Image3F::Create(memory_manager, xsize_, ysize_));
   ZeroFillImage(&block_diff_ac);
-  JXL_RETURN_IF_ERROR(MaltaDiffMap(
-      pi0_.uhf[1], pi1.uhf[1], wUhfMalta * hf_asymmetry_,
-      wUhfMalta / hf_asymmetry_, norm1Uhf, &diffs, &block_diff_ac, 1));
-  JXL_RETURN_IF_ERROR(MaltaDiffMap(
-      pi0_.uhf[0], pi1.uhf[0], wUhfMaltaX * hf_asymmetry_,
-      wUhfMaltaX / hf_asymmetry_, norm1UhfX, &diffs, &block_diff_ac, 0));
-  JXL_RETURN_IF_ERROR(MaltaDiffMapLF(
-      pi0_.hf[1], pi1.hf[1], wHfMalta * std::sqrt(hf_asymmetry_),
-      wHfMalta / std::sqrt(hf_asymmetry_), norm1Hf, &diffs, &block_diff_ac, 1));
-  JXL_RETURN_IF_ERROR(MaltaDiffMapLF(pi0_.hf[0], pi1.hf[0],
-                                     wHfMaltaX * std::sqrt(hf_asymmetry_),
-                                     wHfMaltaX / std::sqrt(hf_asymmetry_),
-                                     norm1HfX, &diffs, &block_diff_ac, 0));
-  JXL_RETURN_IF_ERROR(MaltaDiffMapLF(pi0_.mf.Plane(1), pi1.mf.Plane(1),
-                                     wMfMalta, wMfMalta, norm1Mf, &diffs,
-                                     &block_diff_ac, 1));
-  JXL_RETURN_IF_ERROR(MaltaDiffMapLF(pi0_.mf.Plane(0), pi1.mf.Plane(0),
-                                     wMfMaltaX, wMfMaltaX, norm1MfX, &diffs,
-                                     &block_diff_ac, 0));
+  // The Y and X terms of a frequency band accumulate into different planes
+  // and are computed concurrently.
+  const MaltaTerm uhf_terms[2] = {
+      {&pi0_.uhf[1], &pi1.uhf[1], wUhfMalta * hf_asymmetry_,
+       wUhfMalta / hf_asymmetry_, norm1Uhf, /*lf=*/false,
+       &block_diff_ac.Plane(1)},
+      {&pi0_.uhf[0], &pi1.uhf[0], wUhfMaltaX * hf_asymmetry_,
+       wUhfMaltaX / hf_asymmetry_, norm1UhfX, /*lf=*/false,
+       &block_diff_ac.Plane(0)},
+  };
+  JXL_RETURN_IF_ERROR(
+      HWY_DYNAMIC_DISPATCH(MaltaDiffMaps)(uhf_terms, 2, diffs, pool));
+  const MaltaTerm hf_terms[2] = {
+      {&pi0_.hf[1], &pi1.hf[1], wHfMalta * std::sqrt(hf_asymmetry_),
+       wHfMalta / std::sqrt(hf_asymmetry_), norm1Hf, /*lf=*/true,
+       &block_diff_ac.Plane(1)},
+      {&pi0_.hf[0], &pi1.hf[0], wHfMaltaX * std::sqrt(hf_asymmetry_),
+       wHfMaltaX / std::sqrt(hf_asymmetry_), norm1HfX, /*lf=*/true,
+       &block_diff_ac.Plane(0)},
+  };
+  JXL_RETURN_IF_ERROR(
+      HWY_DYNAMIC_DISPATCH(MaltaDiffMaps)(hf_terms, 2, diffs, pool));
+  const MaltaTerm mf_terms[2] = {
+      {&pi0_.mf.Plane(1), &pi1.mf.Plane(1), wMfMalta, wMfMalta, norm1Mf,
+       /*lf=*/true, &block_diff_ac.Plane(1)},
+      {&pi0_.mf.Plane(0), &pi1.mf.Plane(0), wMfMaltaX, wMfMaltaX, norm1MfX,
+       /*lf=*/true, &block_diff_ac.Plane(0)},
+  };
+  JXL_RETURN_IF_ERROR(
+      HWY_DYNAMIC_DISPATCH(MaltaDiffMaps)(mf_terms, 2, diffs, pool));
+  diffs[0] = ImageF();
+  diffs[1] = ImageF();
 
   JXL_ASSIGN_OR_RETURN(Image3F block_diff_dc,
                        Image3F::Create(memory_manager, xsize_, ysize_));
-  for (size_t c = 0; c < 3; ++c) {
-    if (c < 2) {  // No blue channel error accumulated at HF.
-      HWY_DYNAMIC_DISPATCH(L2DiffAsymmetric)
-      (pi0_.hf[c], pi1.hf[c], wmul[c] * hf_asymmetry_, wmul[c] / hf_asymmetry_,
-       &block_diff_ac.Plane(c));
-    }
-    HWY_DYNAMIC_DISPATCH(L2Diff)
-    (pi0_.mf.Plane(c), pi1.mf.Plane(c), wmul[3 + c], &block_diff_ac.Plane(c));
-    HWY_DYNAMIC_DISPATCH(SetL2Diff)
-    (pi0_.lf.Plane(c), pi1.lf.Plane(c), wmul[6 + c], &block_diff_dc.Plane(c));
-  }
+  JXL_RETURN_IF_ERROR(HWY_DYNAMIC_DISPATCH(L2DiffPsychoImage)(
+      pi0_, pi1, hf_asymmetry_, pool, &block_diff_ac, &block_diff_dc));
 
   ImageF mask;
   JXL_RETURN_IF_ERROR(HWY_DYNAMIC_DISPATCH(MaskPsychoImage)(
-      pi0_, pi1, xsize_, ysize_, params_, &blur_temp_, &mask,
+      pi0_, pi1, xsize_, ysize_, params_, &blur_temp_, pool, &mask,
       &block_diff_ac.Plane(1)));
 
   JXL_RETURN_IF_ERROR(HWY_DYNAMIC_DISPATCH(CombineChannelsToDiffmap)(
-      mask, block_diff_dc, block_diff_ac, xmul_, &diffmap));
+      mask, block_diff_dc, block_diff_ac, xmul_, pool, &diffmap));
   return true;
 }
 
@@ -1962,6 +2126,13 @@ double ButteraugliScoreFromDiffmap(const ImageF& diffmap,
   return retval;
 }
 
+double ButteraugliScoreFromAccumulator(
+    const ButteraugliScoreAccumulator& accumulator,
+    const ButteraugliParams* params) {
+  // Same aggregation as ButteraugliScoreFromDiffmap: the maximum.
+  return accumulator.Max();
+}
+
 Status ButteraugliDiffmap(const Image3F& rgb0, const Image3F& rgb1,
                           double hf_asymmetry, double xmul, ImageF& diffmap) {
   ButteraugliParams params;
@@ -1972,7 +2143,8 @@ Status ButteraugliDiffmap(const Image3F& rgb0, const Image3F& rgb1,
 
 template <size_t kMax>
 bool ButteraugliDiffmapSmall(const Image3F& rgb0, const Image3F& rgb1,
-                             const ButteraugliParams& params, ImageF& diffmap) {
+                             const ButteraugliParams& params, ImageF& diffmap,
+                             ThreadPool* pool) {
   const size_t xsize = rgb0.xsize();
   const size_t ysize = rgb0.ysize();
   JxlMemoryManager* memory_manager = rgb0.memory_manager();
@@ -1999,7 +2171,8 @@ bool ButteraugliDiffmapSmall(const Image3F& rgb0, const Image3F& rgb1,
     }
   }
   ImageF diffmap_scaled;
-  const bool ok = ButteraugliDiffmap(scaled0, scaled1, params, diffmap_scaled);
+  const bool ok =
+      ButteraugliDiffmap(scaled0, scaled1, params, diffmap_scaled, pool);
   JXL_ASSIGN_OR_RETURN(diffmap, ImageF::Create(memory_manager, xsize, ysize));
   for (size_t y = 0; y < ysize; ++y) {
     for (size_t x = 0; x < xsize; ++x) {
@@ -2010,7 +2183,8 @@ bool ButteraugliDiffmapSmall(const Image3F& rgb0, const Image3F& rgb1,
 }
 
 Status ButteraugliDiffmap(const Image3F& rgb0, const Image3F& rgb1,
-                          const ButteraugliParams& params, ImageF& diffmap) {
+                          const ButteraugliParams& params, ImageF& diffmap,
+                          ThreadPool* pool) {
   const size_t xsize = rgb0.xsize();
   const size_t ysize = rgb0.ysize();
   if (xsize < 1 || ysize < 1) {
@@ -2021,11 +2195,11 @@ Status ButteraugliDiffmap(const Image3F& rgb0, const Image3F& rgb1,
   }
   static const int kMax = 8;
   if (xsize < kMax || ysize < kMax) {
-    return ButteraugliDiffmapSmall<kMax>(rgb0, rgb1, params, diffmap);
+    return ButteraugliDiffmapSmall<kMax>(rgb0, rgb1, params, diffmap, pool);
   }
   JXL_ASSIGN_OR_RETURN(std::unique_ptr<ButteraugliComparator> butteraugli,
-                       ButteraugliComparator::Make(rgb0, params));
-  JXL_RETURN_IF_ERROR(butteraugli->Diffmap(rgb1, diffmap));
+                       ButteraugliComparator::Make(rgb0, params, pool));
+  JXL_RETURN_IF_ERROR(butteraugli->Diffmap(rgb1, diffmap, pool));
   return true;
 }
 
@@ -2040,8 +2214,8 @@ bool ButteraugliInterface(const Image3F& rgb0, const Image3F& rgb1,
 
 bool ButteraugliInterface(const Image3F& rgb0, const Image3F& rgb1,
                           const ButteraugliParams& params, ImageF& diffmap,
-                          double& diffvalue) {
-  if (!ButteraugliDiffmap(rgb0, rgb1, params, diffmap)) {
+                          double& diffvalue, ThreadPool* pool) {
+  if (!ButteraugliDiffmap(rgb0, rgb1, params, diffmap, pool)) {
     return false;
   }
   diffvalue = ButteraugliScoreFromDiffmap(diffmap, &params);
@@ -2050,7 +2224,8 @@ bool ButteraugliInterface(const Image3F& rgb0, const Image3F& rgb1,
 
 Status ButteraugliInterfaceInPlace(Image3F&& rgb0, Image3F&& rgb1,
                                    const ButteraugliParams& params,
-                                   ImageF& diffmap, double& diffvalue) {
+                                   ImageF& diffmap, double& diffvalue,
+                                   ThreadPool* pool) {
   const size_t xsize = rgb0.xsize();
   const size_t ysize = rgb0.ysize();
   if (xsize < 1 || ysize < 1) {
@@ -2061,7 +2236,8 @@ Status ButteraugliInterfaceInPlace(Image3F&& rgb0, Image3F&& rgb1,
   }
   static const int kMax = 8;
   if (xsize < kMax || ysize < kMax) {
-    bool ok = ButteraugliDiffmapSmall<kMax>(rgb0, rgb1, params, diffmap);
+    bool ok =
+        ButteraugliDiffmapSmall<kMax>(rgb0, rgb1, params, diffmap, pool);
     diffvalue = ButteraugliScoreFromDiffmap(diffmap, &params);
     return ok;
   }
@@ -2070,17 +2246,134 @@ Status ButteraugliInterfaceInPlace(Image3F&& rgb0, Image3F&& rgb1,
     JXL_ASSIGN_OR_RETURN(Image3F rgb0_sub, SubSample2x(rgb0));
     JXL_ASSIGN_OR_RETURN(Image3F rgb1_sub, SubSample2x(rgb1));
     JXL_RETURN_IF_ERROR(HWY_DYNAMIC_DISPATCH(ButteraugliDiffmapInPlace)(
-        rgb0_sub, rgb1_sub, params, subdiffmap));
+        rgb0_sub, rgb1_sub, params, pool, subdiffmap));
   }
   JXL_RETURN_IF_ERROR(HWY_DYNAMIC_DISPATCH(ButteraugliDiffmapInPlace)(
-      rgb0, rgb1, params, diffmap));
+      rgb0, rgb1, params, pool, diffmap));
   if (xsize >= 15 && ysize >= 15) {
-    AddSupersampled2x(subdiffmap, 0.5, diffmap);
+    JXL_RETURN_IF_ERROR(AddSupersampled2x(subdiffmap, 0.5, pool, diffmap));
   }
   diffvalue = ButteraugliScoreFromDiffmap(diffmap, &params);
   return true;
 }
 
+void ButteraugliScoreAccumulator::AddRow(const float* row, size_t xsize) {
+  const bool cube = std::abs(p_ - 3.0) < 1E-6;
+  for (size_t x = 0; x < xsize; ++x) {
+    max_ = std::max(max_, row[x]);
+    const double d1 = row[x];
+    double d2 = cube ? d1 * d1 * d1 : std::pow(d1, p_);
+    sums_[0] += d2;
+    d2 *= d2;
+    sums_[1] += d2;
+    d2 *= d2;
+    sums_[2] += d2;
+  }
+  num_pixels_ += xsize;
+}
+
+void ButteraugliScoreAccumulator::Add(const ImageF& diffmap) {
+  for (size_t y = 0; y < diffmap.ysize(); ++y) {
+    AddRow(diffmap.ConstRow(y), diffmap.xsize());
+  }
+}
+
+double ButteraugliScoreAccumulator::PNorm() const {
+  if (num_pixels_ == 0) return 0.0;
+  const double one_per_pixels = 1.0 / num_pixels_;
+  double v = 0;
+  for (int i = 0; i < 3; ++i) {
+    v += std::pow(one_per_pixels * sums_[i], 1.0 / (p_ * (1 << i)));
+  }
+  return v / 3.0;
+}
+
+// Border added on each side of a tile. Away from the image edges, the values
+// within this distance of a tile edge differ from those of the whole image
+// because blurs and filters renormalize or zero-pad there. All blurs are
+// truncated at kGaussianTruncation sigma, so along the longest chain (opsin
+// blur 2, LF blur 16, HF blur 7, UHF blur 3, mask blur 6 and fuzzy erosion 3)
+// the affected area grows to 37 pixels, which the half resolution pass
+// doubles. The border is even, so that tiles of the half resolution pass start
+// at the same pixel pairs as for the whole image.
+constexpr size_t kTileBorder = 80;
+
+Status ButteraugliDiffmapTiled(JxlMemoryManager* memory_manager, size_t xsize,
+                               size_t ysize, const ButteraugliParams& params,
+                               size_t tile_size,
+                               const ButteraugliTileSource& source,
+                               const ButteraugliTileSink& sink,
+                               ThreadPool* pool) {
+  if (xsize < 1 || ysize < 1) {
+    return JXL_FAILURE("Zero-sized image");
+  }
+  if (tile_size == 0) {
+    return JXL_FAILURE("Zero tile size");
+  }
+  // Tiles start at even coordinates, see kTileBorder.
+  tile_size += tile_size & 1;
+  for (size_t y0 = 0; y0 < ysize; y0 += tile_size) {
+    for (size_t x0 = 0; x0 < xsize; x0 += tile_size) {
+      const Rect rect(x0, y0, tile_size, tile_size, xsize, ysize);
+      const size_t padded_x0 = x0 > kTileBorder ? x0 - kTileBorder : 0;
+      const size_t padded_y0 = y0 > kTileBorder ? y0 - kTileBorder : 0;
+      const Rect padded(padded_x0, padded_y0,
+                        rect.x1() - padded_x0 + kTileBorder,
+                        rect.y1() - padded_y0 + kTileBorder, xsize, ysize);
+      ImageF tile_diffmap;
+      {
+        JXL_ASSIGN_OR_RETURN(
+            Image3F rgb0,
+            Image3F::Create(memory_manager, padded.xsize(), padded.ysize()));
+        JXL_ASSIGN_OR_RETURN(
+            Image3F rgb1,
+            Image3F::Create(memory_manager, padded.xsize(), padded.ysize()));
+        JXL_RETURN_IF_ERROR(source(padded, &rgb0, &rgb1));
+        JXL_RETURN_IF_ERROR(
+            ButteraugliDiffmap(rgb0, rgb1, params, tile_diffmap, pool));
+      }
+      JXL_ASSIGN_OR_RETURN(
+          ImageF diffmap,
+          ImageF::Create(memory_manager, rect.xsize(), rect.ysize()));
+      JXL_RETURN_IF_ERROR(CopyImageTo(
+          Rect(x0 - padded_x0, y0 - padded_y0, rect.xsize(), rect.ysize()),
+          tile_diffmap, Rect(diffmap), &diffmap));
+      JXL_RETURN_IF_ERROR(sink(rect, diffmap));
+    }
+  }
+  return true;
+}
+
+Status ButteraugliInterfaceTiled(const Image3F& rgb0, const Image3F& rgb1,
+                                 const ButteraugliParams& params,
+                                 size_t tile_size, ImageF* diffmap,
+                                 ButteraugliScoreAccumulator* score,
+                                 ThreadPool* pool) {
+  if (!SameSize(rgb0, rgb1)) {
+    return JXL_FAILURE("Size mismatch");
+  }
+  JxlMemoryManager* memory_manager = rgb0.memory_manager();
+  if (diffmap != nullptr) {
+    JXL_ASSIGN_OR_RETURN(*diffmap, ImageF::Create(memory_manager, rgb0.xsize(),
+                                                  rgb0.ysize()));
+  }
+  const auto source = [&](const Rect& rect, Image3F* tile0,
+                          Image3F* tile1) -> Status {
+    JXL_RETURN_IF_ERROR(CopyImageTo(rect, rgb0, Rect(*tile0), tile0));
+    JXL_RETURN_IF_ERROR(CopyImageTo(rect, rgb1, Rect(*tile1), tile1));
+    return true;
+  };
+  const auto sink = [&](const Rect& rect, const ImageF& tile) -> Status {
+    if (diffmap != nullptr) {
+      JXL_RETURN_IF_ERROR(CopyImageTo(Rect(tile), tile, rect, diffmap));
+    }
+    if (score != nullptr) score->Add(tile);
+    return true;
+  };
+  return ButteraugliDiffmapTiled(memory_manager, rgb0.xsize(), rgb0.ysize(),
+                                 params, tile_size, source, sink, pool);
+}
+
 double ButteraugliFuzzyClass(double score) {
   static const double fuzzy_width_up = 4.8;
   static const double fuzzy_width_down = 4.8;
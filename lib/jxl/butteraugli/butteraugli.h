@@ -14,9 +14,12 @@
 #include <cstddef>
 #include <cstdlib>
 #include <cstring>
+#include <functional>
 #include <memory>
 
 #include "lib/jxl/base/compiler_specific.h"
+#include "lib/jxl/base/data_parallel.h"
+#include "lib/jxl/base/rect.h"
 #include "lib/jxl/base/status.h"
 #include "lib/jxl/image.h"
 
@@ -76,10 +79,13 @@ struct ButteraugliParams {
 // A diffvalue between kButteraugliGood and kButteraugliBad indicates that
 // a subtle difference can be observed between the images.
 //
+// If pool is not null, the computation is split into bands of rows that run
+// on the pool. The result does not depend on the number of threads.
+//
 // Returns true on success.
 bool ButteraugliInterface(const Image3F &rgb0, const Image3F &rgb1,
                           const ButteraugliParams &params, ImageF &diffmap,
-                          double &diffvalue);
+                          double &diffvalue, ThreadPool *pool = nullptr);
 
 // Deprecated (calls the previous function)
 bool ButteraugliInterface(const Image3F &rgb0, const Image3F &rgb1,
@@ -91,7 +97,60 @@ bool ButteraugliInterface(const Image3F &rgb0, const Image3F &rgb1,
 // params.xmul.
 Status ButteraugliInterfaceInPlace(Image3F &&rgb0, Image3F &&rgb1,
                                    const ButteraugliParams &params,
-                                   ImageF &diffmap, double &diffvalue);
+                                   ImageF &diffmap, double &diffvalue,
+                                   ThreadPool *pool = nullptr);
+
+// Maximum and p-norm of a diffmap that is produced in parts. The maximum
+// equals ButteraugliScoreFromDiffmap of the whole diffmap, and the p-norm is
+// computed as in ComputeDistanceP, up to rounding.
+class ButteraugliScoreAccumulator {
+ public:
+  explicit ButteraugliScoreAccumulator(double p = 3.0) : p_(p) {}
+
+  void AddRow(const float *row, size_t xsize);
+  void Add(const ImageF &diffmap);
+
+  double Max() const { return max_; }
+  double PNorm() const;
+  size_t NumPixels() const { return num_pixels_; }
+
+ private:
+  double p_;
+  float max_ = 0.0f;
+  // Sums of the p-th, 2p-th and 4p-th powers.
+  double sums_[3] = {0.0, 0.0, 0.0};
+  size_t num_pixels_ = 0;
+};
+
+// Provides the pixels of rect of both images, e.g. by reading or decoding
+// them on demand. rgb0 and rgb1 are allocated with the size of rect.
+using ButteraugliTileSource =
+    std::function<Status(const Rect &rect, Image3F *rgb0, Image3F *rgb1)>;
+
+// Receives the final diffmap values of rect, in an image of its size.
+using ButteraugliTileSink =
+    std::function<Status(const Rect &rect, const ImageF &diffmap)>;
+
+// Computes the same diffmap as ButteraugliDiffmap, but evaluates it on
+// tiles of (about) tile_size x tile_size pixels, each extended by a border
+// that covers the support of all blurs and filters, including those of the
+// half resolution pass. The temporary memory therefore depends on tile_size
+// but not on the image size. Tiles are processed in raster order, one at a
+// time; if pool is not null, each tile runs on it.
+Status ButteraugliDiffmapTiled(JxlMemoryManager *memory_manager, size_t xsize,
+                               size_t ysize, const ButteraugliParams &params,
+                               size_t tile_size,
+                               const ButteraugliTileSource &source,
+                               const ButteraugliTileSink &sink,
+                               ThreadPool *pool = nullptr);
+
+// Tiled counterpart of ButteraugliInterface. diffmap may be null, in which
+// case only the scores are computed and no full-size image is allocated.
+Status ButteraugliInterfaceTiled(const Image3F &rgb0, const Image3F &rgb1,
+                                 const ButteraugliParams &params,
+                                 size_t tile_size, ImageF *diffmap,
+                                 ButteraugliScoreAccumulator *score,
+                                 ThreadPool *pool = nullptr);
 
 // Converts the butteraugli score into fuzzy class values that are continuous
 // at the class boundary. The class boundary location is based on human
@@ -146,8 +205,8 @@ struct PsychoImage {
   Image3F lf;     // XYB
 };
 
-// Blur needs a transposed image.
-// Hold it here and only allocate on demand to reduce memory usage.
+// Blur needs a transposed image, or one of the same size for GaussianBlur.
+// Hold them here and only allocate on demand to reduce memory usage.
 struct BlurTemp {
   Status GetTransposed(const ImageF &in, ImageF **out) {
     JxlMemoryManager *memory_manager = in.memory_manager();
@@ -160,7 +219,19 @@ struct BlurTemp {
     return true;
   }
 
+  Status GetSameSize(const ImageF &in, ImageF **out) {
+    JxlMemoryManager *memory_manager = in.memory_manager();
+    if (same_size_temp.xsize() == 0) {
+      JXL_ASSIGN_OR_RETURN(
+          same_size_temp,
+          ImageF::Create(memory_manager, in.xsize(), in.ysize()));
+    }
+    *out = &same_size_temp;
+    return true;
+  }
+
   ImageF transposed_temp;
+  ImageF same_size_temp;
 };
 
 class ButteraugliComparator {
@@ -170,20 +241,27 @@ class ButteraugliComparator {
   // improve results at higher Butteraugli values.
   virtual ~ButteraugliComparator() = default;
 
+  // The optional pool is only used during construction.
   static StatusOr<std::unique_ptr<ButteraugliComparator>> Make(
-      const Image3F &rgb0, const ButteraugliParams &params);
+      const Image3F &rgb0, const ButteraugliParams &params,
+      ThreadPool *pool = nullptr);
 
   // Computes the butteraugli map between the original image given in the
-  // constructor and the distorted image give here.
-  Status Diffmap(const Image3F &rgb1, ImageF &result) const;
+  // constructor and the distorted image give here. Calls that share a pool
+  // must not overlap.
+  Status Diffmap(const Image3F &rgb1, ImageF &result,
+                 ThreadPool *pool = nullptr) const;
 
   // Same as above, but OpsinDynamicsImage() was already applied.
-  Status DiffmapOpsinDynamicsImage(const Image3F &xyb1, ImageF &result) const;
+  Status DiffmapOpsinDynamicsImage(const Image3F &xyb1, ImageF &result,
+                                   ThreadPool *pool = nullptr) const;
 
   // Same as above, but the frequency decomposition was already applied.
-  Status DiffmapPsychoImage(const PsychoImage &pi1, ImageF &diffmap) const;
+  Status DiffmapPsychoImage(const PsychoImage &pi1, ImageF &diffmap,
+                            ThreadPool *pool = nullptr) const;
 
-  Status Mask(ImageF *BUTTERAUGLI_RESTRICT mask) const;
+  Status Mask(ImageF *BUTTERAUGLI_RESTRICT mask,
+              ThreadPool *pool = nullptr) const;
 
  private:
   ButteraugliComparator(size_t xsize, size_t ysize,
@@ -210,11 +288,19 @@ Status ButteraugliDiffmap(const Image3F &rgb0, const Image3F &rgb1,
                           double hf_asymmetry, double xmul, ImageF &diffmap);
 
 Status ButteraugliDiffmap(const Image3F &rgb0, const Image3F &rgb1,
-                          const ButteraugliParams &params, ImageF &diffmap);
+                          const ButteraugliParams &params, ImageF &diffmap,
+                          ThreadPool *pool = nullptr);
 
 double ButteraugliScoreFromDiffmap(const ImageF &diffmap,
                                    const ButteraugliParams *params = nullptr);
 
+// Score of a diffmap that was produced in parts, e.g. by
+// ButteraugliDiffmapTiled. Equals ButteraugliScoreFromDiffmap of the whole
+// diffmap.
+double ButteraugliScoreFromAccumulator(
+    const ButteraugliScoreAccumulator &accumulator,
+    const ButteraugliParams *params = nullptr);
+
 // Generate rgb-representation of the distance between two images.
 StatusOr<Image3F> CreateHeatMapImage(const ImageF &distmap,
                                      double good_threshold,
@@ -0,0 +1,75 @@
+// Copyright (c) the JPEG XL Project Authors. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#include <jxl/memory_manager.h>
+
+#include <cstddef>
+#include <memory>
+
+#include "benchmark/benchmark.h"
+#include "lib/jxl/base/random.h"
+#include "lib/jxl/base/status.h"
+#include "lib/jxl/butteraugli/butteraugli.h"
+#include "lib/jxl/image.h"
+#include "tools/no_memory_manager.h"
+
+namespace jxl {
+namespace {
+
+#define QUIT(M)           \
+  state.SkipWithError(M); \
+  return;
+
+#define BM_CHECK(C) \
+  if (!(C)) {       \
+    QUIT(#C)        \
+  }
+
+void RandomFill(Image3F* image, float min, float max, Rng* rng) {
+  for (size_t c = 0; c < 3; ++c) {
+    for (size_t y = 0; y < image->ysize(); ++y) {
+      float* JXL_RESTRICT row = image->PlaneRow(c, y);
+      for (size_t x = 0; x < image->xsize(); ++x) {
+        row[x] = rng->UniformF(min, max);
+      }
+    }
+  }
+}
+
+// Diffmap against a precomputed reference, as in the encoder's butteraugli
+// iterations. The malta filters dominate the frequency band differences.
+void BM_ButteraugliDiffmap(benchmark::State& state) {
+  JxlMemoryManager* memory_manager = jpegxl::tools::NoMemoryManager();
+  const size_t xsize = state.range();
+  const size_t ysize = state.range();
+  Rng rng(1234);
+  JXL_ASSIGN_OR_QUIT(Image3F rgb0,
+                     Image3F::Create(memory_manager, xsize, ysize),
+                     "Failed to allocate reference image.");
+  JXL_ASSIGN_OR_QUIT(Image3F rgb1,
+                     Image3F::Create(memory_manager, xsize, ysize),
+                     "Failed to allocate distorted image.");
+  RandomFill(&rgb0, 0.0f, 1.0f, &rng);
+  RandomFill(&rgb1, 0.0f, 1.0f, &rng);
+
+  ButteraugliParams params;
+  JXL_ASSIGN_OR_QUIT(std::unique_ptr<ButteraugliComparator> comparator,
+                     ButteraugliComparator::Make(rgb0, params),
+                     "Failed to create comparator.");
+  ImageF diffmap;
+  for (auto _ : state) {
+    (void)_;
+    BM_CHECK(comparator->Diffmap(rgb1, diffmap));
+    benchmark::DoNotOptimize(diffmap.Row(0));
+  }
+
+  // Pixels per second.
+  state.SetItemsProcessed(state.iterations() * xsize * ysize);
+}
+
+BENCHMARK(BM_ButteraugliDiffmap)->RangeMultiplier(2)->Range(64, 1024);
+
+}  // namespace
+}  // namespace jxl
@@ -5,17 +5,25 @@
 
 #include "lib/jxl/butteraugli/butteraugli.h"
 
+#include <jxl/cms.h>
+#include <jxl/cms_interface.h>
 #include <jxl/memory_manager.h>
 
 #include <algorithm>
 #include <cstddef>
 #include <cstdint>
+#include <sstream>
 #include <utility>
 
 #include "lib/extras/metrics.h"
 #include "lib/jxl/base/random.h"
+#include "lib/jxl/color_encoding_internal.h"
+#include "lib/jxl/enc_butteraugli_comparator.h"
 #include "lib/jxl/image.h"
+#include "lib/jxl/image_bundle.h"
+#include "lib/jxl/image_metadata.h"
 #include "lib/jxl/image_ops.h"
+#include "lib/jxl/image_test_utils.h"
 #include "lib/jxl/test_image.h"
 #include "lib/jxl/test_memory_manager.h"
 #include "lib/jxl/test_utils.h"
@@ -26,6 +34,7 @@ namespace {
 
 using ::jxl::test::GetColorImage;
 using ::jxl::test::TestImage;
+using ::jxl::test::ThreadPoolForTests;
 
 Image3F SinglePixelImage(float red, float green, float blue) {
   JxlMemoryManager* memory_manager = jxl::test::MemoryManager();
@@ -108,5 +117,142 @@ TEST(ButteraugliInPlaceTest, LargeImage) {
   EXPECT_NEAR(distp, distp2, 1e-7);
 }
 
+TEST(ButteraugliTest, ThreadedMatchesSingleThreaded) {
+  JxlMemoryManager* memory_manager = jxl::test::MemoryManager();
+  // Not a multiple of the row band height.
+  const size_t xsize = 333;
+  const size_t ysize = 257;
+  TestImage img;
+  ASSERT_TRUE(img.SetDimensions(xsize, ysize));
+  JXL_TEST_ASSIGN_OR_DIE(auto frame, img.AddFrame());
+  frame.RandomFill(123);
+  JXL_TEST_ASSIGN_OR_DIE(Image3F rgb0, GetColorImage(img.ppf()));
+  JXL_TEST_ASSIGN_OR_DIE(Image3F rgb1,
+                         Image3F::Create(memory_manager, xsize, ysize));
+  ASSERT_TRUE(CopyImageTo(rgb0, &rgb1));
+  AddUniformNoise(&rgb1, 0.02f, 1234);
+  AddEdge(&rgb1, 0.1f, xsize / 3, ysize / 3);
+  ButteraugliParams butteraugli_params;
+  ThreadPoolForTests pool(4);
+
+  ImageF diffmap;
+  double diffval;
+  ASSERT_TRUE(
+      ButteraugliInterface(rgb0, rgb1, butteraugli_params, diffmap, diffval));
+  ImageF threaded_diffmap;
+  double threaded_diffval;
+  ASSERT_TRUE(ButteraugliInterface(rgb0, rgb1, butteraugli_params,
+                                   threaded_diffmap, threaded_diffval,
+                                   pool.get()));
+  std::stringstream failures;
+  EXPECT_TRUE(SamePixels(diffmap, threaded_diffmap, failures))
+      << failures.str();
+  EXPECT_EQ(diffval, threaded_diffval);
+
+  JXL_TEST_ASSIGN_OR_DIE(Image3F rgb0_copy,
+                         Image3F::Create(memory_manager, xsize, ysize));
+  JXL_TEST_ASSIGN_OR_DIE(Image3F rgb1_copy,
+                         Image3F::Create(memory_manager, xsize, ysize));
+  ASSERT_TRUE(CopyImageTo(rgb0, &rgb0_copy));
+  ASSERT_TRUE(CopyImageTo(rgb1, &rgb1_copy));
+  ImageF inplace_diffmap;
+  double inplace_diffval;
+  ASSERT_TRUE(ButteraugliInterfaceInPlace(std::move(rgb0), std::move(rgb1),
+                                          butteraugli_params, inplace_diffmap,
+                                          inplace_diffval));
+  ImageF threaded_inplace_diffmap;
+  double threaded_inplace_diffval;
+  ASSERT_TRUE(ButteraugliInterfaceInPlace(
+      std::move(rgb0_copy), std::move(rgb1_copy), butteraugli_params,
+      threaded_inplace_diffmap, threaded_inplace_diffval, pool.get()));
+  EXPECT_TRUE(SamePixels(inplace_diffmap, threaded_inplace_diffmap, failures))
+      << failures.str();
+  EXPECT_EQ(inplace_diffval, threaded_inplace_diffval);
+}
+
+TEST(ButteraugliTest, TiledMatchesUntiled) {
+  JxlMemoryManager* memory_manager = jxl::test::MemoryManager();
+  const size_t xsize = 333;
+  const size_t ysize = 257;
+  TestImage img;
+  ASSERT_TRUE(img.SetDimensions(xsize, ysize));
+  JXL_TEST_ASSIGN_OR_DIE(auto frame, img.AddFrame());
+  frame.RandomFill(77);
+  JXL_TEST_ASSIGN_OR_DIE(Image3F rgb0, GetColorImage(img.ppf()));
+  JXL_TEST_ASSIGN_OR_DIE(Image3F rgb1,
+                         Image3F::Create(memory_manager, xsize, ysize));
+  ASSERT_TRUE(CopyImageTo(rgb0, &rgb1));
+  AddUniformNoise(&rgb1, 0.02f, 4321);
+  AddEdge(&rgb1, 0.1f, xsize / 2, ysize / 2);
+  ButteraugliParams butteraugli_params;
+
+  ImageF diffmap;
+  double diffval;
+  ASSERT_TRUE(
+      ButteraugliInterface(rgb0, rgb1, butteraugli_params, diffmap, diffval));
+  ButteraugliScoreAccumulator expected;
+  expected.Add(diffmap);
+
+  // 63 is rounded up to an even size, 400 covers the image in one tile.
+  for (size_t tile_size : {63, 100, 400}) {
+    ImageF tiled_diffmap;
+    ButteraugliScoreAccumulator score;
+    ASSERT_TRUE(ButteraugliInterfaceTiled(rgb0, rgb1, butteraugli_params,
+                                          tile_size, &tiled_diffmap, &score));
+    std::stringstream failures;
+    EXPECT_TRUE(SamePixels(diffmap, tiled_diffmap, failures))
+        << "tile size " << tile_size << ": " << failures.str();
+    EXPECT_EQ(diffval, score.Max());
+    EXPECT_EQ(xsize * ysize, score.NumPixels());
+    EXPECT_NEAR(expected.PNorm(), score.PNorm(), 1e-6 * expected.PNorm());
+  }
+
+  ButteraugliScoreAccumulator score_only;
+  ASSERT_TRUE(ButteraugliInterfaceTiled(rgb0, rgb1, butteraugli_params, 128,
+                                        nullptr, &score_only));
+  EXPECT_EQ(diffval, score_only.Max());
+}
+
+TEST(ButteraugliTest, TiledComparatorMatchesUntiled) {
+  JxlMemoryManager* memory_manager = jxl::test::MemoryManager();
+  const size_t xsize = 301;
+  const size_t ysize = 211;
+  TestImage img;
+  ASSERT_TRUE(img.SetDimensions(xsize, ysize));
+  JXL_TEST_ASSIGN_OR_DIE(auto frame, img.AddFrame());
+  frame.RandomFill(123);
+  JXL_TEST_ASSIGN_OR_DIE(Image3F color0, GetColorImage(img.ppf()));
+  JXL_TEST_ASSIGN_OR_DIE(Image3F color1,
+                         Image3F::Create(memory_manager, xsize, ysize));
+  ASSERT_TRUE(CopyImageTo(color0, &color1));
+  AddUniformNoise(&color1, 0.02f, 765);
+  // Non-linear images, so that the tiled comparator converts each tile.
+  ImageMetadata metadata;
+  ImageBundle ib0(memory_manager, &metadata);
+  ImageBundle ib1(memory_manager, &metadata);
+  ASSERT_TRUE(ib0.SetFromImage(std::move(color0), ColorEncoding::SRGB()));
+  ASSERT_TRUE(ib1.SetFromImage(std::move(color1), ColorEncoding::SRGB()));
+  const JxlCmsInterface& cms = *JxlGetDefaultCms();
+  ButteraugliParams butteraugli_params;
+
+  JxlButteraugliComparator comparator(butteraugli_params, cms);
+  ASSERT_TRUE(comparator.SetReferenceImage(ib0));
+  ImageF diffmap;
+  float score;
+  ASSERT_TRUE(comparator.CompareWith(ib1, &diffmap, &score));
+
+  JxlButteraugliComparator tiled_comparator(butteraugli_params, cms);
+  tiled_comparator.SetTileSize(100);
+  ASSERT_TRUE(tiled_comparator.SetReferenceImage(ib0));
+  ImageF tiled_diffmap;
+  float tiled_score;
+  ASSERT_TRUE(tiled_comparator.CompareWith(ib1, &tiled_diffmap, &tiled_score));
+  std::stringstream failures;
+  EXPECT_TRUE(
+      VerifyRelativeError(diffmap, tiled_diffmap, 1e-5, 1e-5, failures))
+      << failures.str();
+  EXPECT_NEAR(score, tiled_score, 1e-5 * score);
+}
+
 }  // namespace
 }  // namespace jxl
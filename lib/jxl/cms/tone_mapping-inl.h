@@ -26,15 +26,39 @@ namespace {
 
 // These templates are not found via ADL.
 using hwy::HWY_NAMESPACE::Clamp;
+using hwy::HWY_NAMESPACE::GatherIndex;
 using hwy::HWY_NAMESPACE::Max;
+using hwy::HWY_NAMESPACE::ShiftRight;
 using hwy::HWY_NAMESPACE::ZeroIfNegative;
 
+// Vector version of LuminanceScaleTable::Lookup.
+template <typename V>
+V LookupLuminanceScale(const LuminanceScaleTable& table, V luminance) {
+  using T = LuminanceScaleTable;
+  const hwy::HWY_NAMESPACE::DFromV<V> df;
+  const hwy::HWY_NAMESPACE::RebindToSigned<decltype(df)> di;
+  const auto bits = BitCast(
+      di, Clamp(luminance, Set(df, T::MinLuminance()),
+                Set(df, T::MaxLuminance())));
+  // Also clamped as integers, which keeps NaNs in bounds.
+  const auto index = Clamp(
+      Sub(ShiftRight<T::kFractionBits>(bits), Set(di, T::kIndexOffset)),
+      Zero(di), Set(di, static_cast<int32_t>(T::kSize - 2)));
+  const V fraction =
+      Mul(ConvertTo(df, And(bits, Set(di, (1 << T::kFractionBits) - 1))),
+          Set(df, 1.0f / (1 << T::kFractionBits)));
+  const V lo = GatherIndex(df, table.data(), index);
+  const V hi = GatherIndex(df, table.data() + 1, index);
+  return MulAdd(Sub(hi, lo), fraction, lo);
+}
+
 template <typename D>
 class Rec2408ToneMapper : Rec2408ToneMapperBase {
  private:
   using V = hwy::HWY_NAMESPACE::Vec<D>;
 
  public:
+  using Rec2408ToneMapperBase::Multiplier;
   using Rec2408ToneMapperBase::Rec2408ToneMapperBase;
 
   void ToneMap(V* red, V* green, V* blue) const {
@@ -71,6 +95,22 @@ class Rec2408ToneMapper : Rec2408ToneMapperBase {
     }
   }
 
+  // Same as above, with the multipliers looked up in `table`, which must
+  // tabulate Multiplier().
+  void ToneMap(const LuminanceScaleTable& table, V* red, V* green,
+               V* blue) const {
+    const V luminance = Mul(Set(df_, source_range_[1]),
+                            (MulAdd(Set(df_, red_Y_), *red,
+                                    MulAdd(Set(df_, green_Y_), *green,
+                                           Mul(Set(df_, blue_Y_), *blue)))));
+    const auto use_cap = Le(luminance, Set(df_, kMinLuminance));
+    const V cap = Set(df_, black_level_);
+    const V multiplier = LookupLuminanceScale(table, luminance);
+    for (V* const val : {red, green, blue}) {
+      *val = IfThenElse(use_cap, cap, Mul(*val, multiplier));
+    }
+  }
+
  private:
   V InvEOTF(const V luminance) const {
     return tf_pq_.EncodedFromDisplay(df_, luminance);
@@ -102,6 +142,7 @@ class Rec2408ToneMapper : Rec2408ToneMapperBase {
 class HlgOOTF : HlgOOTF_Base {
  public:
   using HlgOOTF_Base::HlgOOTF_Base;
+  using HlgOOTF_Base::Ratio;
 
   static HlgOOTF FromSceneLight(float display_luminance,
                                 const Vector3& primaries_luminances) {
@@ -132,6 +173,22 @@ class HlgOOTF : HlgOOTF_Base {
     *blue = Mul(*blue, ratio);
   }
 
+  // Same as above, with the ratios looked up in `table`, which must tabulate
+  // Ratio().
+  template <typename V>
+  void Apply(const LuminanceScaleTable& table, V* red, V* green,
+             V* blue) const {
+    hwy::HWY_NAMESPACE::DFromV<V> df;
+    if (!apply_ootf_) return;
+    const V luminance =
+        MulAdd(Set(df, red_Y_), *red,
+               MulAdd(Set(df, green_Y_), *green, Mul(Set(df, blue_Y_), *blue)));
+    const V ratio = LookupLuminanceScale(table, luminance);
+    *red = Mul(*red, ratio);
+    *green = Mul(*green, ratio);
+    *blue = Mul(*blue, ratio);
+  }
+
   bool WarrantsGamutMapping() const { return apply_ootf_ && exponent_ < 0; }
 };
 
@@ -10,6 +10,8 @@
 #include <array>
 #include <cmath>
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
 
 #include "lib/jxl/base/common.h"
 #include "lib/jxl/base/compiler_specific.h"
@@ -20,6 +22,57 @@ namespace jxl {
 
 using Range = std::array<float, 2>;
 
+// Scale factors of a tone mapping that scales colors by a function of their
+// luminance, tabulated so that applying it takes a table lookup and a linear
+// interpolation instead of transcendental functions. The entries are spaced
+// linearly between consecutive powers of two, so that they are indexed by the
+// exponent and the top mantissa bits of the luminance; luminances outside of
+// [MinLuminance(), MaxLuminance()] are clamped.
+class LuminanceScaleTable {
+ public:
+  static constexpr int kMinLog2 = -24;
+  static constexpr int kMaxLog2 = 16;
+  // Entries per octave are 1 << kMantissaBits.
+  static constexpr int kMantissaBits = 6;
+  static constexpr int kFractionBits = 23 - kMantissaBits;
+  // Index of the first entry in terms of the float bits.
+  static constexpr int32_t kIndexOffset = (127 + kMinLog2) << kMantissaBits;
+  // The last entry is repeated for the interpolation at MaxLuminance().
+  static constexpr size_t kSize = ((kMaxLog2 - kMinLog2) << kMantissaBits) + 2;
+
+  static float MinLuminance() { return std::ldexp(1.0f, kMinLog2); }
+  static float MaxLuminance() { return std::ldexp(1.0f, kMaxLog2); }
+
+  // Tabulates `scale(luminance)`.
+  template <typename Scale>
+  explicit LuminanceScaleTable(const Scale& scale) {
+    constexpr size_t kMask = (1 << kMantissaBits) - 1;
+    for (size_t i = 0; i + 1 < kSize; i++) {
+      const float mantissa =
+          1.0f + static_cast<float>(i & kMask) / (1 << kMantissaBits);
+      const int exponent = kMinLog2 + static_cast<int>(i >> kMantissaBits);
+      table_[i] = scale(std::ldexp(mantissa, exponent));
+    }
+    table_[kSize - 1] = table_[kSize - 2];
+  }
+
+  float Lookup(float luminance) const {
+    luminance = Clamp1(luminance, MinLuminance(), MaxLuminance());
+    uint32_t bits;
+    memcpy(&bits, &luminance, sizeof(bits));
+    const size_t index = (bits >> kFractionBits) - kIndexOffset;
+    const uint32_t fraction_bits = bits & ((1 << kFractionBits) - 1);
+    const float fraction =
+        static_cast<float>(fraction_bits) * (1.0f / (1 << kFractionBits));
+    return table_[index] + fraction * (table_[index + 1] - table_[index]);
+  }
+
+  const float* data() const { return table_.data(); }
+
+ private:
+  std::array<float, kSize> table_;
+};
+
 class Rec2408ToneMapperBase {
  public:
   explicit Rec2408ToneMapperBase(const Range& source_range,
@@ -36,6 +89,28 @@ class Rec2408ToneMapperBase {
     const float luminance =
         source_range_[1] *
         (red_Y_ * rgb[0] + green_Y_ * rgb[1] + blue_Y_ * rgb[2]);
+    const float new_luminance = NewLuminance(luminance);
+    const bool use_cap = (luminance <= kMinLuminance);
+    const float ratio = new_luminance / std::max(luminance, kMinLuminance);
+    const float cap = new_luminance * inv_target_peak_;
+    const float multiplier = ratio * normalizer_;
+    for (size_t idx : {0, 1, 2}) {
+      rgb[idx] = use_cap ? cap : rgb[idx] * multiplier;
+    }
+  }
+
+  // Factor by which ToneMap scales colors of `luminance` nits, for
+  // LuminanceScaleTable.
+  float Multiplier(float luminance) const {
+    return NewLuminance(luminance) / std::max(luminance, kMinLuminance) *
+           normalizer_;
+  }
+
+ protected:
+  // Colors of at most this luminance, in nits, are mapped to gray.
+  static constexpr float kMinLuminance = 1e-6f;
+
+  float NewLuminance(float luminance) const {
     const float normalized_pq =
         std::min(1.f, (InvEOTF(luminance) - pq_mastering_min_) *
                           inv_pq_mastering_range_);
@@ -47,18 +122,9 @@ class Rec2408ToneMapperBase {
     const float e4 = e3 * pq_mastering_range_ + pq_mastering_min_;
     const float d4 =
         TF_PQ_Base::DisplayFromEncoded(/*display_intensity_target=*/1.0, e4);
-    const float new_luminance = Clamp1(d4, 0.f, target_range_[1]);
-    const float min_luminance = 1e-6f;
-    const bool use_cap = (luminance <= min_luminance);
-    const float ratio = new_luminance / std::max(luminance, min_luminance);
-    const float cap = new_luminance * inv_target_peak_;
-    const float multiplier = ratio * normalizer_;
-    for (size_t idx : {0, 1, 2}) {
-      rgb[idx] = use_cap ? cap : rgb[idx] * multiplier;
-    }
+    return Clamp1(d4, 0.f, target_range_[1]);
   }
 
- protected:
   static float InvEOTF(const float luminance) {
     return TF_PQ_Base::EncodedFromDisplay(/*display_intensity_target=*/1.0,
                                           luminance);
@@ -95,6 +161,8 @@ class Rec2408ToneMapperBase {
 
   const float normalizer_ = source_range_[1] / target_range_[1];
   const float inv_target_peak_ = 1.f / target_range_[1];
+  // What ToneMap maps colors of at most kMinLuminance to.
+  const float black_level_ = NewLuminance(0.f) * inv_target_peak_;
 };
 
 class HlgOOTF_Base {
@@ -110,12 +178,18 @@ class HlgOOTF_Base {
     if (!apply_ootf_) return;
     const float luminance =
         red_Y_ * rgb[0] + green_Y_ * rgb[1] + blue_Y_ * rgb[2];
-    const float ratio = std::min<float>(powf(luminance, exponent_), 1e9);
+    const float ratio = Ratio(luminance);
     rgb[0] *= ratio;
     rgb[1] *= ratio;
     rgb[2] *= ratio;
   }
 
+  // Factor by which Apply scales colors of relative luminance `luminance`,
+  // for LuminanceScaleTable.
+  float Ratio(float luminance) const {
+    return std::min<float>(powf(luminance, exponent_), 1e9);
+  }
+
  protected:
   explicit HlgOOTF_Base(float gamma, const Vector3& luminances)
       : exponent_(gamma - 1),
@@ -101,6 +101,52 @@ HWY_NOINLINE void TestHlgOotfApply() {
   printf("max abs err %e\n", static_cast<double>(max_abs_err));
 }
 
+HWY_NOINLINE void TestLuminanceScaleTable() {
+  constexpr size_t kNumTrials = 1 << 10;
+  constexpr size_t kNumColors = 1 << 8;
+  Rng rng(1);
+  float max_rel_err = 0;
+  HWY_FULL(float) d;
+  for (size_t i = 0; i < kNumTrials; i++) {
+    Vector3 luminances{rng.UniformF(0.2f, 0.4f), rng.UniformF(0.2f, 0.4f),
+                       rng.UniformF(0.2f, 0.4f)};
+    const bool pq = (i % 2 == 0);
+    const float src = pq ? 11000.0 + rng.UniformF(-150.0f, 150.0f)
+                         : 300.0 + rng.UniformF(-50.0f, 50.0f);
+    const float tgt = pq ? 250 + rng.UniformF(-5.0f, 5.0f)
+                         : 80 + rng.UniformF(-5.0f, 5.0f);
+    Rec2408ToneMapper<decltype(d)> tone_mapper({0.0f, src}, {0.0f, tgt},
+                                               luminances);
+    HlgOOTF ootf(src, tgt, luminances);
+    const LuminanceScaleTable table([&](float luminance) {
+      return pq ? tone_mapper.Multiplier(luminance) : ootf.Ratio(luminance);
+    });
+    for (size_t j = 0; j < kNumColors; j++) {
+      Color rgb{rng.UniformF(0.0f, 1.0f), rng.UniformF(0.0f, 1.0f),
+                rng.UniformF(0.0f, 1.0f)};
+      auto r = Set(d, rgb[0]);
+      auto g = Set(d, rgb[1]);
+      auto b = Set(d, rgb[2]);
+      if (pq) {
+        tone_mapper.ToneMap(table, &r, &g, &b);
+        Rec2408ToneMapperBase({0.0f, src}, {0.0f, tgt}, luminances)
+            .ToneMap(rgb);
+      } else {
+        ootf.Apply(table, &r, &g, &b);
+        HlgOOTF_Base(src, tgt, luminances).Apply(rgb);
+      }
+      const float actual[3] = {GetLane(r), GetLane(g), GetLane(b)};
+      for (size_t c = 0; c < 3; c++) {
+        const float rel_err =
+            std::abs(rgb[c] - actual[c]) / std::max(1.0f, rgb[c]);
+        EXPECT_LT(rel_err, 5e-4);
+        max_rel_err = std::max(max_rel_err, rel_err);
+      }
+    }
+  }
+  printf("max rel err %e\n", static_cast<double>(max_rel_err));
+}
+
 HWY_NOINLINE void TestGamutMap() {
   constexpr size_t kNumTrials = 1 << 23;
   Rng rng(1);
@@ -148,6 +194,7 @@ HWY_TARGET_INSTANTIATE_TEST_SUITE_P(ToneMappingTargetTest);
 
 HWY_EXPORT_AND_TEST_P(ToneMappingTargetTest, TestRec2408ToneMap);
 HWY_EXPORT_AND_TEST_P(ToneMappingTargetTest, TestHlgOotfApply);
+HWY_EXPORT_AND_TEST_P(ToneMappingTargetTest, TestLuminanceScaleTable);
 HWY_EXPORT_AND_TEST_P(ToneMappingTargetTest, TestGamutMap);
 
 }  // namespace jxl
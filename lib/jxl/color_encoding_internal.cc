@@ -14,11 +14,13 @@
 #include <vector>
 
 #include "lib/jxl/base/compiler_specific.h"
+#include "lib/jxl/base/span.h"
 #include "lib/jxl/base/status.h"
 #include "lib/jxl/cms/color_encoding_cms.h"
 #include "lib/jxl/cms/jxl_cms_internal.h"
 #include "lib/jxl/field_encodings.h"
 #include "lib/jxl/fields.h"
+#include "lib/jxl/icc_cache.h"
 #include "lib/jxl/pack_signed.h"
 
 namespace jxl {
@@ -80,14 +82,42 @@ Status ColorEncoding::SetPrimariesType(const Primaries& p) {
   return true;
 }
 
+Status ColorEncoding::SetICC(IccBytes&& icc, const JxlCmsInterface* cms) {
+  JXL_ENSURE(cms != nullptr);
+  JXL_ENSURE(!icc.empty());
+  storage_.have_fields = true;
+  ICCCache& cache = ICCCache::Global();
+  JxlColorEncoding c;
+  bool cmyk;
+  if (cache.LookupFields(*cms, Bytes(icc), &c, &cmyk)) {
+    // Same as SetFieldsFromICC(), without parsing the profile again.
+    storage_.cmyk = cmyk;
+    want_icc_ = storage_.FromExternal(c);
+    if (want_icc_) storage_.icc = std::move(icc);
+    return want_icc_;
+  }
+  want_icc_ = storage_.SetFieldsFromICC(std::move(icc), *cms);
+  if (want_icc_) {
+    cache.InsertFields(*cms, Bytes(storage_.icc), storage_.ToExternal(),
+                       storage_.cmyk);
+  }
+  return want_icc_;
+}
+
 void ColorEncoding::DecideIfWantICC(const JxlCmsInterface& cms) {
   if (storage_.icc.empty()) return;
 
+  ICCCache& cache = ICCCache::Global();
   JxlColorEncoding c;
-  JXL_BOOL cmyk;
-  if (!cms.set_fields_from_icc(cms.set_fields_data, storage_.icc.data(),
-                               storage_.icc.size(), &c, &cmyk)) {
-    return;
+  bool cmyk;
+  if (!cache.LookupFields(cms, Bytes(storage_.icc), &c, &cmyk)) {
+    JXL_BOOL parsed_cmyk;
+    if (!cms.set_fields_from_icc(cms.set_fields_data, storage_.icc.data(),
+                                 storage_.icc.size(), &c, &parsed_cmyk)) {
+      return;
+    }
+    cmyk = static_cast<bool>(parsed_cmyk);
+    cache.InsertFields(cms, Bytes(storage_.icc), c, cmyk);
   }
   if (cmyk) return;
 
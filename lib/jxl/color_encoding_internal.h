@@ -147,13 +147,8 @@ struct ColorEncoding : public Fields {
   // Returns true if `icc` is assigned and decoded successfully. If so,
   // subsequent WantICC() will return true until DecideIfWantICC() changes it.
   // Returning false indicates data has been lost.
-  Status SetICC(IccBytes&& icc, const JxlCmsInterface* cms) {
-    JXL_ENSURE(cms != nullptr);
-    JXL_ENSURE(!icc.empty());
-    storage_.have_fields = true;
-    want_icc_ = storage_.SetFieldsFromICC(std::move(icc), *cms);
-    return want_icc_;
-  }
+  // The fields derived from a profile are remembered in ICCCache.
+  Status SetICC(IccBytes&& icc, const JxlCmsInterface* cms);
 
   // Sets the raw ICC profile bytes, without parsing the ICC, and without
   // updating the direct fields such as white point, primaries and color
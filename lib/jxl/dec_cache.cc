@@ -10,6 +10,7 @@
 #include <algorithm>
 #include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <utility>
 
 #include "lib/jxl/ac_strategy.h"
@@ -33,6 +34,7 @@
 #include "lib/jxl/render_pipeline/stage_cms.h"
 #include "lib/jxl/render_pipeline/stage_epf.h"
 #include "lib/jxl/render_pipeline/stage_from_linear.h"
+#include "lib/jxl/render_pipeline/stage_gain_map.h"
 #include "lib/jxl/render_pipeline/stage_gaborish.h"
 #include "lib/jxl/render_pipeline/stage_noise.h"
 #include "lib/jxl/render_pipeline/stage_patches.h"
@@ -293,7 +295,14 @@ Status PassesDecoderState::PreparePipeline(const FrameHeader& frame_header,
       }
     }
 
-    auto tone_mapping_stage = GetToneMappingStage(output_encoding_info);
+    std::unique_ptr<RenderPipelineStage> tone_mapping_stage;
+    if (options.gain_map) {
+      tone_mapping_stage = GetGainMapStage(
+          *options.gain_map, options.display_headroom, output_encoding_info);
+    }
+    if (!tone_mapping_stage) {
+      tone_mapping_stage = GetToneMappingStage(output_encoding_info);
+    }
     if (tone_mapping_stage) {
       if (!linear) {
         auto to_linear_stage = GetToLinearStage(output_encoding_info);
@@ -15,6 +15,7 @@
 #include <cstdint>
 #include <hwy/base.h>  // HWY_ALIGN_MAX
 #include <memory>
+#include <utility>
 #include <vector>
 
 #include "lib/jxl/base/common.h"  // kMaxNumPasses
@@ -24,6 +25,8 @@
 #include "lib/jxl/common.h"
 #include "lib/jxl/dct_util.h"
 #include "lib/jxl/dec_ans.h"
+#include "lib/jxl/dec_gain_map.h"
+#include "lib/jxl/dec_stats.h"
 #include "lib/jxl/dec_xyb.h"
 #include "lib/jxl/frame_dimensions.h"
 #include "lib/jxl/frame_header.h"
@@ -31,6 +34,7 @@
 #include "lib/jxl/image_bundle.h"
 #include "lib/jxl/image_metadata.h"
 #include "lib/jxl/memory_manager_internal.h"
+#include "lib/jxl/modular/encoding/dec_ma.h"
 #include "lib/jxl/passes_state.h"
 #include "lib/jxl/render_pipeline/render_pipeline.h"
 #include "lib/jxl/render_pipeline/render_pipeline_stage.h"
@@ -81,6 +85,52 @@ struct ImageOutput {
   size_t stride;
 };
 
+// Quantized AC coefficients of a VarDCT frame as they are entropy coded, one
+// image per pass, and where they are in the sections, so that a transcoder can
+// entropy code them again and copy everything else.
+struct ACCapture {
+  // Only the positions are recorded if false.
+  bool with_coefficients = true;
+
+  struct SectionBits {
+    // Bit offsets, within the reader of the section, of the start of the
+    // VarDCT data, of its end and of the end of the modular data that follows.
+    size_t begin = 0;
+    size_t vardct_end = 0;
+    size_t end = 0;
+  };
+
+  // Laid out like the coefficients of the encoder: per group, the blocks of
+  // each channel in raster order.
+  std::vector<std::unique_ptr<ACImageT<int32_t>>> coeffs;
+  // Coefficient orders that were signalled for each pass.
+  uint16_t used_orders[kMaxNumPasses] = {};
+  // Bit offsets in the AC global section of the end of the quantization
+  // matrices and of the end of the histograms, i.e. of the section.
+  size_t matrices_end = 0;
+  size_t ac_global_end = 0;
+  // Indexed by pass * num_groups + group.
+  std::vector<SectionBits> ac_groups;
+};
+
+// The global MA tree of a frame and how its modular image is split into
+// groups, so that a transcoder can renumber the groups.
+struct ModularCapture {
+  // Bit offsets, within the DC global section, of the tree, both 0 if there is
+  // none, and of the end of the section.
+  size_t tree_begin = 0;
+  size_t tree_end = 0;
+  size_t dc_global_end = 0;
+  Tree tree;
+  bool has_squeeze = false;
+  // Horizontal and vertical shifts of the channels of the modular image after
+  // the global transforms, meta channels excluded.
+  std::vector<std::pair<int, int>> channel_shifts;
+  // Indexed by stream id, whether the stream has its own MA tree that splits on
+  // the stream id, for the streams that were decoded.
+  std::vector<uint8_t> local_tree_splits_on_stream_id;
+};
+
 // Per-frame decoder state. All the images here should be accessed through a
 // group rect (either with block units or pixel units).
 struct PassesDecoderState {
@@ -139,11 +189,24 @@ struct PassesDecoderState {
   // Storage for the current frame if it can be referenced by future frames.
   ImageBundle frame_storage_for_referencing;
 
+  // Counters of the current frame, if the decoder collects statistics.
+  FrameDecodeStats* stats = nullptr;
+
+  // If set, VarDCT frames record their AC coefficients here, and are decoded
+  // with 32-bit coefficients.
+  ACCapture* ac_capture = nullptr;
+  // If set, the global modular data of each frame is recorded here.
+  ModularCapture* modular_capture = nullptr;
+
   struct PipelineOptions {
     bool use_slow_render_pipeline;
     bool coalescing;
     bool render_spotcolors;
     bool render_noise;
+    // If set, the gain map is applied to render the image for a display with
+    // `display_headroom`, instead of tone mapping it.
+    const GainMap* gain_map = nullptr;
+    float display_headroom = 0.0f;
   };
 
   JxlMemoryManager* memory_manager() const { return shared->memory_manager; }
@@ -27,6 +27,7 @@
 #include "lib/jxl/base/rect.h"
 #include "lib/jxl/base/span.h"
 #include "lib/jxl/base/status.h"
+#include "lib/jxl/base/trace.h"
 #include "lib/jxl/chroma_from_luma.h"
 #include "lib/jxl/coeff_order.h"
 #include "lib/jxl/coeff_order_fwd.h"
@@ -40,6 +41,7 @@
 #include "lib/jxl/dec_modular.h"
 #include "lib/jxl/dec_noise.h"
 #include "lib/jxl/dec_patch_dictionary.h"
+#include "lib/jxl/dec_stats.h"
 #include "lib/jxl/entropy_coder.h"
 #include "lib/jxl/epf.h"
 #include "lib/jxl/fields.h"
@@ -305,11 +307,13 @@ Status FrameDecoder::ProcessDCGlobal(BitReader* br) {
         frame_dim_.xsize_upsampled, frame_dim_.ysize_upsampled,
         dec_state_->shared->cmap.base()));
   }
+  ModularCapture* capture = dec_state_->modular_capture;
   Status dec_status = modular_frame_decoder_.DecodeGlobalInfo(
-      br, frame_header_, /*allow_truncated_group=*/false);
+      br, frame_header_, /*allow_truncated_group=*/false, capture);
   if (dec_status.IsFatalError()) return dec_status;
   if (dec_status) {
     decoded_dc_global_ = true;
+    if (capture) capture->dc_global_end = br->TotalBitsConsumed();
   }
   return dec_status;
 }
@@ -376,6 +380,24 @@ Status FrameDecoder::ProcessACGlobal(BitReader* br) {
         memory_manager, br, &modular_frame_decoder_));
     JXL_RETURN_IF_ERROR(dec_state_->shared_storage.matrices.EnsureComputed(
         memory_manager, dec_state_->used_acs));
+    ACCapture* capture = dec_state_->ac_capture;
+    if (capture) {
+      capture->matrices_end = br->TotalBitsConsumed();
+      capture->coeffs.clear();
+      for (size_t i = 0; capture->with_coefficients &&
+                         i < frame_header_.passes.num_passes;
+           i++) {
+        JXL_ASSIGN_OR_RETURN(
+            auto coeffs,
+            ACImageT<int32_t>::Make(memory_manager, kGroupDim * kGroupDim,
+                                    frame_dim_.num_groups));
+        coeffs->ZeroFill();
+        capture->coeffs.emplace_back(std::move(coeffs));
+      }
+      capture->ac_groups.assign(
+          frame_header_.passes.num_passes * frame_dim_.num_groups,
+          ACCapture::SectionBits());
+    }
 
     size_t num_histo_bits =
         CeilLog2Nonzero(dec_state_->shared->frame_dim.num_groups);
@@ -394,6 +416,7 @@ Status FrameDecoder::ProcessACGlobal(BitReader* br) {
     size_t max_num_bits_ac = 0;
     for (size_t i = 0; i < frame_header_.passes.num_passes; i++) {
       uint16_t used_orders = U32Coder::Read(kOrderEnc, br);
+      if (capture) capture->used_orders[i] = used_orders;
       JXL_RETURN_IF_ERROR(DecodeCoeffOrders(
           memory_manager, used_orders, dec_state_->used_acs,
           &dec_state_->shared_storage
@@ -411,11 +434,13 @@ Status FrameDecoder::ProcessACGlobal(BitReader* br) {
       max_num_bits_ac =
           std::max(max_num_bits_ac, dec_state_->code[i].max_num_bits);
     }
+    if (capture) capture->ac_global_end = br->TotalBitsConsumed();
     max_num_bits_ac += CeilLog2Nonzero(frame_header_.passes.num_passes);
     // 16-bit buffer for decoding to JPEG are not implemented.
     // TODO(veluca): figure out the exact limit - 16 should still work with
     // 16-bit buffers, but we are excluding it for safety.
-    bool use_16_bit = max_num_bits_ac < 16 && !decoded_->IsJPEG();
+    bool use_16_bit =
+        max_num_bits_ac < 16 && !decoded_->IsJPEG() && capture == nullptr;
     bool store = frame_header_.passes.num_passes > 1;
     size_t xs = store ? kGroupDim * kGroupDim : 0;
     size_t ys = store ? frame_dim_.num_groups : 0;
@@ -497,16 +522,35 @@ Status FrameDecoder::ProcessACGroup(size_t ac_group_id, PassesReaders& br,
 
   bool should_run_pipeline = true;
 
+  ACCapture* capture = frame_header_.encoding == FrameEncoding::kVarDCT
+                           ? dec_state_->ac_capture
+                           : nullptr;
+  const auto capture_bits = [&](size_t i) -> ACCapture::SectionBits& {
+    size_t pass = decoded_passes_per_ac_group_[ac_group_id] + i;
+    return capture->ac_groups[pass * frame_dim_.num_groups + ac_group_id];
+  };
+
   if (frame_header_.encoding == FrameEncoding::kVarDCT) {
     JXL_RETURN_IF_ERROR(group_dec_caches_[thread].InitOnce(
         memory_manager, frame_header_.passes.num_passes, dec_state_->used_acs));
+    if (capture) {
+      for (size_t i = 0; i < num_passes; i++) {
+        capture_bits(i).begin = br[i]->TotalBitsConsumed();
+      }
+    }
     JXL_RETURN_IF_ERROR(DecodeGroup(
         frame_header_, br.data(), num_passes, ac_group_id, dec_state_,
         &group_dec_caches_[thread], thread, render_pipeline_input,
         decoded_->jpeg_data.get(), decoded_passes_per_ac_group_[ac_group_id],
         force_draw, dc_only, &should_run_pipeline));
+    if (capture) {
+      for (size_t i = 0; i < num_passes; i++) {
+        capture_bits(i).vardct_end = br[i]->TotalBitsConsumed();
+      }
+    }
   }
 
+  DecodeStatsTimer timer(dec_state_->stats);
   // don't limit to image dimensions here (is done in DecodeGroup)
   const Rect mrect(x, y, group_dim, group_dim);
   bool modular_ready = false;
@@ -530,6 +574,7 @@ Status FrameDecoder::ProcessACGroup(size_t ac_group_id, PassesReaders& br,
           ModularStreamId::ModularAC(ac_group_id, i),
           /*zerofill=*/false, dec_state_, &render_pipeline_input,
           /*allow_truncated=*/false, &modular_pass_ready));
+      if (capture) capture_bits(i - pass0).end = r->TotalBitsConsumed();
     } else {
       JXL_RETURN_IF_ERROR(modular_frame_decoder_.DecodeGroup(
           frame_header_, mrect, nullptr, minShift, maxShift,
@@ -540,6 +585,7 @@ Status FrameDecoder::ProcessACGroup(size_t ac_group_id, PassesReaders& br,
     if (modular_pass_ready) modular_ready = true;
   }
   decoded_passes_per_ac_group_[ac_group_id] += num_passes;
+  timer.Lap(JXL_DEC_STAT_ENTROPY_DECODE_USEC);
 
   if ((frame_header_.flags & FrameHeader::kNoise) != 0) {
     PrepareNoiseInput(*dec_state_, frame_dim_, frame_header_, ac_group_id,
@@ -549,6 +595,7 @@ Status FrameDecoder::ProcessACGroup(size_t ac_group_id, PassesReaders& br,
   if (!modular_frame_decoder_.UsesFullImage() && !decoded_->IsJPEG()) {
     if (should_run_pipeline && modular_ready) {
       JXL_RETURN_IF_ERROR(render_pipeline_input.Done());
+      timer.Lap(JXL_DEC_STAT_RENDER_USEC);
     } else if (force_draw) {
       return JXL_FAILURE("Modular group decoding failed.");
     }
@@ -563,13 +610,37 @@ void FrameDecoder::MarkSections(const SectionInfo* sections, size_t num,
     if (section_status[i] != SectionStatus::kDone) {
       processed_section_[sections[i].id] = JXL_FALSE;
       num_sections_done_--;
+    } else if (dec_state_->stats) {
+      AddSectionStats(sections[i], dec_state_->stats);
     }
   }
 }
 
+void FrameDecoder::AddSectionStats(const SectionInfo& section,
+                                   FrameDecodeStats* stats) const {
+  const uint64_t bytes = toc_[section.index].size;
+  const size_t ac_global_index = frame_dim_.num_dc_groups + 1;
+  if (toc_.size() == 1) {
+    stats->Add(JXL_DEC_STAT_AC_GROUP_BYTES, bytes);
+    stats->Add(JXL_DEC_STAT_NUM_DC_GROUPS, 1);
+    stats->Add(JXL_DEC_STAT_NUM_AC_GROUPS, 1);
+  } else if (section.id == 0) {
+    stats->Add(JXL_DEC_STAT_DC_GLOBAL_BYTES, bytes);
+  } else if (section.id < ac_global_index) {
+    stats->Add(JXL_DEC_STAT_DC_GROUP_BYTES, bytes);
+    stats->Add(JXL_DEC_STAT_NUM_DC_GROUPS, 1);
+  } else if (section.id == ac_global_index) {
+    stats->Add(JXL_DEC_STAT_AC_GLOBAL_BYTES, bytes);
+  } else {
+    stats->Add(JXL_DEC_STAT_AC_GROUP_BYTES, bytes);
+    stats->Add(JXL_DEC_STAT_NUM_AC_GROUPS, 1);
+  }
+}
+
 Status FrameDecoder::ProcessSections(const SectionInfo* sections, size_t num,
                                      SectionStatus* section_status) {
   if (num == 0) return true;  // Nothing to process
+  JXL_TRACE_SCOPE_ARG("ProcessSections", "sections", num);
   std::fill(section_status, section_status + num, SectionStatus::kSkipped);
   size_t dc_global_sec = num;
   size_t ac_global_sec = num;
@@ -632,7 +703,10 @@ Status FrameDecoder::ProcessSections(const SectionInfo* sections, size_t num,
     }
   }
   if (dc_global_sec != num) {
+    JXL_TRACE_SCOPE("DecodeDCGlobal");
+    DecodeStatsTimer timer(dec_state_->stats);
     Status dc_global_status = ProcessDCGlobal(sections[dc_global_sec].br);
+    timer.Lap(JXL_DEC_STAT_ENTROPY_DECODE_USEC);
     if (dc_global_status.IsFatalError()) return dc_global_status;
     if (dc_global_status) {
       section_status[dc_global_sec] = SectionStatus::kDone;
@@ -646,7 +720,9 @@ Status FrameDecoder::ProcessSections(const SectionInfo* sections, size_t num,
                                   &section_status](size_t i,
                                                    size_t thread) -> Status {
       if (dc_group_sec[i] != num) {
+        DecodeStatsTimer timer(dec_state_->stats);
         JXL_RETURN_IF_ERROR(ProcessDCGroup(i, sections[dc_group_sec[i]].br));
+        timer.Lap(JXL_DEC_STAT_ENTROPY_DECODE_USEC);
         section_status[dc_group_sec[i]] = SectionStatus::kDone;
       }
       return true;
@@ -657,15 +733,23 @@ Status FrameDecoder::ProcessSections(const SectionInfo* sections, size_t num,
   }
 
   if (!HasDcGroupToDecode() && !finalized_dc_) {
+    JXL_TRACE_SCOPE("FinalizeDC");
     PassesDecoderState::PipelineOptions pipeline_options;
     pipeline_options.use_slow_render_pipeline = use_slow_rendering_pipeline_;
     pipeline_options.coalescing = coalescing_;
     pipeline_options.render_spotcolors = render_spotcolors_;
     pipeline_options.render_noise = true;
+    if (frame_header_.frame_type == FrameType::kRegularFrame ||
+        frame_header_.frame_type == FrameType::kSkipProgressive) {
+      pipeline_options.gain_map = gain_map_;
+      pipeline_options.display_headroom = display_headroom_;
+    }
     JXL_RETURN_IF_ERROR(dec_state_->PreparePipeline(
         frame_header_, &frame_header_.nonserialized_metadata->m, decoded_,
         pipeline_options));
+    DecodeStatsTimer timer(dec_state_->stats);
     JXL_RETURN_IF_ERROR(FinalizeDC());
+    timer.Lap(JXL_DEC_STAT_TRANSFORM_USEC);
     JXL_RETURN_IF_ERROR(AllocateOutput());
     if (progressive_detail_ >= JxlProgressiveDetail::kDC) {
       MarkSections(sections, num, section_status);
@@ -674,7 +758,10 @@ Status FrameDecoder::ProcessSections(const SectionInfo* sections, size_t num,
   }
 
   if (finalized_dc_ && ac_global_sec != num && !decoded_ac_global_) {
+    JXL_TRACE_SCOPE("DecodeACGlobal");
+    DecodeStatsTimer timer(dec_state_->stats);
     JXL_RETURN_IF_ERROR(ProcessACGlobal(sections[ac_global_sec].br));
+    timer.Lap(JXL_DEC_STAT_ENTROPY_DECODE_USEC);
     section_status[ac_global_sec] = SectionStatus::kDone;
   }
 
@@ -24,7 +24,9 @@
 #include "lib/jxl/common.h"  // JXL_HIGH_PRECISION
 #include "lib/jxl/dec_bit_reader.h"
 #include "lib/jxl/dec_cache.h"
+#include "lib/jxl/dec_gain_map.h"
 #include "lib/jxl/dec_modular.h"
+#include "lib/jxl/dec_stats.h"
 #include "lib/jxl/frame_dimensions.h"
 #include "lib/jxl/frame_header.h"
 #include "lib/jxl/image_bundle.h"
@@ -56,6 +58,11 @@ class FrameDecoder {
 
   void SetRenderSpotcolors(bool rsc) { render_spotcolors_ = rsc; }
   void SetCoalescing(bool c) { coalescing_ = c; }
+  // Applies `gain_map`, if not null, to the displayed frames.
+  void SetGainMap(const GainMap* gain_map, float display_headroom) {
+    gain_map_ = gain_map;
+    display_headroom_ = display_headroom;
+  }
 
   // Read FrameHeader and table of contents from the given BitReader.
   Status InitFrame(BitReader* JXL_RESTRICT br, ImageBundle* decoded,
@@ -255,6 +262,8 @@ class FrameDecoder {
                         bool dc_only);
   void MarkSections(const SectionInfo* sections, size_t num,
                     const SectionStatus* section_status);
+  void AddSectionStats(const SectionInfo& section,
+                       FrameDecodeStats* stats) const;
 
   // Allocates storage for parallel decoding using up to `num_threads` threads
   // of up to `num_tasks` tasks. The value of `thread` passed to
@@ -316,6 +325,8 @@ class FrameDecoder {
   ModularFrameDecoder modular_frame_decoder_;
   bool render_spotcolors_ = true;
   bool coalescing_ = true;
+  const GainMap* gain_map_ = nullptr;
+  float display_headroom_ = 0.0f;
 
   std::vector<uint8_t> processed_section_;
   std::vector<uint8_t> decoded_passes_per_ac_group_;
@@ -0,0 +1,250 @@
+// Copyright (c) the JPEG XL Project Authors. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#include "lib/jxl/dec_gain_map.h"
+
+#include <jxl/codestream_header.h>
+#include <jxl/color_encoding.h>
+#include <jxl/decode.h>
+#include <jxl/decode_cxx.h>
+#include <jxl/memory_manager.h>
+#include <jxl/types.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "lib/jxl/base/byte_order.h"
+#include "lib/jxl/base/common.h"
+#include "lib/jxl/base/span.h"
+#include "lib/jxl/base/status.h"
+#include "lib/jxl/image.h"
+
+namespace jxl {
+
+namespace {
+
+// Reads the big-endian fields of the ISO 21496-1 metadata.
+class FieldReader {
+ public:
+  explicit FieldReader(Span<const uint8_t> data) : data_(data) {}
+
+  Status ReadU8(uint8_t* value) {
+    JXL_RETURN_IF_ERROR(Require(1));
+    *value = data_[pos_];
+    pos_ += 1;
+    return true;
+  }
+
+  Status ReadU16(uint16_t* value) {
+    JXL_RETURN_IF_ERROR(Require(2));
+    *value = LoadBE16(data_.data() + pos_);
+    pos_ += 2;
+    return true;
+  }
+
+  Status ReadU32(uint32_t* value) {
+    JXL_RETURN_IF_ERROR(Require(4));
+    *value = LoadBE32(data_.data() + pos_);
+    pos_ += 4;
+    return true;
+  }
+
+  // Reads a numerator, followed by its denominator unless the metadata uses
+  // `common_denominator`.
+  Status ReadFraction(bool is_signed, bool use_common_denominator,
+                      uint32_t common_denominator, float* value) {
+    uint32_t numerator;
+    uint32_t denominator = common_denominator;
+    JXL_RETURN_IF_ERROR(ReadU32(&numerator));
+    if (!use_common_denominator) JXL_RETURN_IF_ERROR(ReadU32(&denominator));
+    if (denominator == 0) {
+      return JXL_FAILURE("Zero denominator in gain map metadata");
+    }
+    const double n = is_signed ? static_cast<int32_t>(numerator)
+                               : static_cast<double>(numerator);
+    *value = static_cast<float>(n / denominator);
+    return true;
+  }
+
+ private:
+  Status Require(size_t num_bytes) const {
+    if (data_.size() - pos_ < num_bytes) {
+      return JXL_FAILURE("Truncated gain map metadata");
+    }
+    return true;
+  }
+
+  Span<const uint8_t> data_;
+  size_t pos_ = 0;
+};
+
+struct GainMapOutput {
+  const GainMapMetadata* metadata;
+  Image3F* log_gain;
+};
+
+// Stores interleaved gain map values as log2 gains.
+void StoreLogGain(void* opaque, size_t x, size_t y, size_t num_pixels,
+                  const void* pixels) {
+  const GainMapOutput* output = static_cast<const GainMapOutput*>(opaque);
+  const GainMapMetadata& m = *output->metadata;
+  const float* in = static_cast<const float*>(pixels);
+  for (size_t c = 0; c < 3; c++) {
+    float* JXL_RESTRICT row = output->log_gain->PlaneRow(c, y) + x;
+    const float inv_gamma = 1.0f / m.gamma[c];
+    const float range = m.gain_map_max[c] - m.gain_map_min[c];
+    for (size_t i = 0; i < num_pixels; i++) {
+      float g = Clamp1(in[3 * i + c], 0.0f, 1.0f);
+      if (inv_gamma != 1.0f) g = std::pow(g, inv_gamma);
+      row[i] = m.gain_map_min[c] + range * g;
+    }
+  }
+}
+
+}  // namespace
+
+Status ParseGainMapMetadata(Span<const uint8_t> data,
+                            GainMapMetadata* metadata, bool* supported) {
+  FieldReader reader(data);
+  uint16_t minimum_version;
+  uint16_t writer_version;
+  JXL_RETURN_IF_ERROR(reader.ReadU16(&minimum_version));
+  JXL_RETURN_IF_ERROR(reader.ReadU16(&writer_version));
+  *supported = (minimum_version == 0);
+  if (!*supported) return true;
+
+  uint8_t flags;
+  JXL_RETURN_IF_ERROR(reader.ReadU8(&flags));
+  const size_t num_channels = (flags & 0x80) ? 3 : 1;
+  const bool use_common_denominator = (flags & 0x08) != 0;
+  uint32_t denominator = 0;
+  if (use_common_denominator) {
+    JXL_RETURN_IF_ERROR(reader.ReadU32(&denominator));
+  }
+  auto read = [&](bool is_signed, float* value) {
+    return reader.ReadFraction(is_signed, use_common_denominator, denominator,
+                               value);
+  };
+  JXL_RETURN_IF_ERROR(read(false, &metadata->base_hdr_headroom));
+  JXL_RETURN_IF_ERROR(read(false, &metadata->alternate_hdr_headroom));
+  for (size_t c = 0; c < num_channels; c++) {
+    JXL_RETURN_IF_ERROR(read(true, &metadata->gain_map_min[c]));
+    JXL_RETURN_IF_ERROR(read(true, &metadata->gain_map_max[c]));
+    JXL_RETURN_IF_ERROR(read(false, &metadata->gamma[c]));
+    JXL_RETURN_IF_ERROR(read(true, &metadata->base_offset[c]));
+    JXL_RETURN_IF_ERROR(read(true, &metadata->alternate_offset[c]));
+    if (metadata->gamma[c] <= 0.0f) {
+      return JXL_FAILURE("Invalid gain map gamma");
+    }
+  }
+  for (size_t c = num_channels; c < 3; c++) {
+    metadata->gain_map_min[c] = metadata->gain_map_min[0];
+    metadata->gain_map_max[c] = metadata->gain_map_max[0];
+    metadata->gamma[c] = metadata->gamma[0];
+    metadata->base_offset[c] = metadata->base_offset[0];
+    metadata->alternate_offset[c] = metadata->alternate_offset[0];
+  }
+  return true;
+}
+
+Status DecodeGainMapBox(JxlMemoryManager* memory_manager,
+                        Span<const uint8_t> box,
+                        std::unique_ptr<GainMap>* gain_map) {
+  gain_map->reset();
+  // The box starts with the version of its layout, then holds the size and
+  // contents of the metadata, of the alternate color encoding and of the
+  // alternate ICC profile. The rest is the gain map codestream.
+  const uint8_t* data = box.data();
+  const size_t size = box.size();
+  if (size < 3) return JXL_FAILURE("Gain map box too small");
+  if (data[0] != 0) return JXL_FAILURE("Unknown gain map box version");
+  const size_t metadata_size = LoadBE16(data + 1);
+  size_t pos = 3;
+  if (size - pos < metadata_size + 1) {
+    return JXL_FAILURE("Truncated gain map metadata");
+  }
+  const Span<const uint8_t> metadata_bytes(data + pos, metadata_size);
+  pos += metadata_size;
+  const size_t color_encoding_size = data[pos];
+  pos += 1;
+  if (size - pos < color_encoding_size + 4) {
+    return JXL_FAILURE("Truncated gain map color encoding");
+  }
+  pos += color_encoding_size;
+  const size_t icc_size = LoadBE32(data + pos);
+  pos += 4;
+  if (size - pos < icc_size) return JXL_FAILURE("Truncated gain map ICC");
+  pos += icc_size;
+
+  auto result = jxl::make_unique<GainMap>();
+  bool supported;
+  JXL_RETURN_IF_ERROR(
+      ParseGainMapMetadata(metadata_bytes, &result->metadata, &supported));
+  if (!supported) return true;
+
+  JxlDecoderPtr dec = JxlDecoderMake(memory_manager);
+  if (!dec) return JXL_FAILURE("Failed to create gain map decoder");
+  // Keep the orientation of the codestream, in which the render pipeline
+  // processes the rows of the base image as well.
+  if (JXL_DEC_SUCCESS !=
+          JxlDecoderSubscribeEvents(dec.get(),
+                                    JXL_DEC_BASIC_INFO |
+                                        JXL_DEC_COLOR_ENCODING |
+                                        JXL_DEC_FULL_IMAGE) ||
+      JXL_DEC_SUCCESS != JxlDecoderSetKeepOrientation(dec.get(), JXL_TRUE) ||
+      JXL_DEC_SUCCESS !=
+          JxlDecoderSetInput(dec.get(), data + pos, size - pos)) {
+    return JXL_FAILURE("Failed to set up gain map decoder");
+  }
+  JxlDecoderCloseInput(dec.get());
+
+  // Grayscale gain maps are expanded to three channels.
+  const JxlPixelFormat format = {3, JXL_TYPE_FLOAT, JXL_NATIVE_ENDIAN, 0};
+  GainMapOutput output = {&result->metadata, &result->log_gain};
+  JxlBasicInfo info;
+  for (;;) {
+    JxlDecoderStatus status = JxlDecoderProcessInput(dec.get());
+    if (status == JXL_DEC_BASIC_INFO) {
+      if (JXL_DEC_SUCCESS != JxlDecoderGetBasicInfo(dec.get(), &info)) {
+        return JXL_FAILURE("Failed to get gain map basic info");
+      }
+      JXL_ASSIGN_OR_RETURN(
+          result->log_gain,
+          Image3F::Create(memory_manager, info.xsize, info.ysize));
+    } else if (status == JXL_DEC_COLOR_ENCODING) {
+      // The gain map values are stored in the original color encoding, while
+      // XYB images are otherwise decoded to linear light.
+      if (!info.uses_original_profile) {
+        JxlColorEncoding color_encoding;
+        if (JXL_DEC_SUCCESS != JxlDecoderGetColorAsEncodedProfile(
+                                   dec.get(), JXL_COLOR_PROFILE_TARGET_ORIGINAL,
+                                   &color_encoding)) {
+          return JXL_FAILURE("XYB gain map with an ICC profile");
+        }
+        if (JXL_DEC_SUCCESS !=
+            JxlDecoderSetPreferredColorProfile(dec.get(), &color_encoding)) {
+          return JXL_FAILURE("Failed to set gain map color profile");
+        }
+      }
+    } else if (status == JXL_DEC_NEED_IMAGE_OUT_BUFFER) {
+      if (JXL_DEC_SUCCESS != JxlDecoderSetImageOutCallback(
+                                 dec.get(), &format, StoreLogGain, &output)) {
+        return JXL_FAILURE("Failed to set gain map output");
+      }
+    } else if (status == JXL_DEC_FULL_IMAGE) {
+      // Only the first frame is used.
+      break;
+    } else {
+      return JXL_FAILURE("Invalid gain map codestream");
+    }
+  }
+  *gain_map = std::move(result);
+  return true;
+}
+
+}  // namespace jxl
@@ -0,0 +1,57 @@
+// Copyright (c) the JPEG XL Project Authors. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#ifndef LIB_JXL_DEC_GAIN_MAP_H_
+#define LIB_JXL_DEC_GAIN_MAP_H_
+
+// Decoding of the ISO 21496-1 gain map stored in the jhgm box, so that the
+// decoder can render the image for a display with a given HDR headroom.
+
+#include <jxl/memory_manager.h>
+
+#include <cstdint>
+#include <memory>
+
+#include "lib/jxl/base/span.h"
+#include "lib/jxl/base/status.h"
+#include "lib/jxl/image.h"
+
+namespace jxl {
+
+struct GainMapMetadata {
+  // Headrooms of the base and alternate images, as log2 of the ratio of their
+  // peak to their reference white.
+  float base_hdr_headroom;
+  float alternate_hdr_headroom;
+  // Per channel; the values of the three channels are the same if the
+  // metadata has a single channel. The gain map range is in log2 units.
+  float gain_map_min[3];
+  float gain_map_max[3];
+  float gamma[3];
+  float base_offset[3];
+  float alternate_offset[3];
+};
+
+// Parses the binary ISO 21496-1 metadata. Sets `supported` to false, without
+// failing, if the metadata requires a newer version of the standard.
+Status ParseGainMapMetadata(Span<const uint8_t> data,
+                            GainMapMetadata* metadata, bool* supported);
+
+struct GainMap {
+  GainMapMetadata metadata;
+  // log2 of the gain to apply at full weight, at the resolution of the gain
+  // map. That is, the stored gain map values after gamma and range mapping.
+  Image3F log_gain;
+};
+
+// Decodes the contents of a jhgm box. Sets `gain_map` to nullptr if the box
+// is valid but its gain map cannot be rendered.
+Status DecodeGainMapBox(JxlMemoryManager* memory_manager,
+                        Span<const uint8_t> box,
+                        std::unique_ptr<GainMap>* gain_map);
+
+}  // namespace jxl
+
+#endif  // LIB_JXL_DEC_GAIN_MAP_H_
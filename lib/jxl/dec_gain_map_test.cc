@@ -0,0 +1,341 @@
+// Copyright (c) the JPEG XL Project Authors. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#include "lib/jxl/dec_gain_map.h"
+
+#include <jxl/decode.h>
+#include <jxl/decode_cxx.h>
+#include <jxl/memory_manager.h>
+#include <jxl/types.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "lib/extras/enc/jxl.h"
+#include "lib/jxl/base/common.h"
+#include "lib/jxl/base/span.h"
+#include "lib/jxl/base/status.h"
+#include "lib/jxl/test_image.h"
+#include "lib/jxl/test_memory_manager.h"
+#include "lib/jxl/test_utils.h"
+#include "lib/jxl/testing.h"
+
+namespace jxl {
+namespace {
+
+void AppendU16(uint32_t value, std::vector<uint8_t>* out) {
+  out->push_back((value >> 8) & 0xFF);
+  out->push_back(value & 0xFF);
+}
+
+void AppendU32(uint32_t value, std::vector<uint8_t>* out) {
+  for (int shift = 24; shift >= 0; shift -= 8) {
+    out->push_back((value >> shift) & 0xFF);
+  }
+}
+
+// Single-channel metadata with a common denominator of 4.
+std::vector<uint8_t> CommonDenominatorMetadata(uint32_t gamma_n) {
+  std::vector<uint8_t> data;
+  AppendU16(0, &data);  // minimum version
+  AppendU16(0, &data);  // writer version
+  data.push_back(0x08);
+  AppendU32(4, &data);
+  AppendU32(0, &data);  // base headroom
+  AppendU32(8, &data);  // alternate headroom
+  AppendU32(0, &data);  // gain map min
+  AppendU32(12, &data);  // gain map max
+  AppendU32(gamma_n, &data);
+  AppendU32(1, &data);  // base offset
+  AppendU32(static_cast<uint32_t>(-1), &data);  // alternate offset
+  return data;
+}
+
+TEST(GainMapTest, ParseCommonDenominator) {
+  std::vector<uint8_t> data = CommonDenominatorMetadata(/*gamma_n=*/4);
+  GainMapMetadata metadata;
+  bool supported = false;
+  ASSERT_TRUE(ParseGainMapMetadata(Span<const uint8_t>(data), &metadata,
+                                   &supported));
+  ASSERT_TRUE(supported);
+  EXPECT_EQ(metadata.base_hdr_headroom, 0.0f);
+  EXPECT_EQ(metadata.alternate_hdr_headroom, 2.0f);
+  for (size_t c = 0; c < 3; c++) {
+    EXPECT_EQ(metadata.gain_map_min[c], 0.0f);
+    EXPECT_EQ(metadata.gain_map_max[c], 3.0f);
+    EXPECT_EQ(metadata.gamma[c], 1.0f);
+    EXPECT_EQ(metadata.base_offset[c], 0.25f);
+    EXPECT_EQ(metadata.alternate_offset[c], -0.25f);
+  }
+}
+
+TEST(GainMapTest, ParseMultiChannel) {
+  std::vector<uint8_t> data;
+  AppendU16(0, &data);
+  AppendU16(0, &data);
+  data.push_back(0x80);
+  for (uint32_t value : {1u, 2u, 3u, 1u}) AppendU32(value, &data);
+  for (uint32_t c = 0; c < 3; c++) {
+    for (uint32_t field = 0; field < 5; field++) {
+      AppendU32(c + 1, &data);
+      AppendU32(field == 2 ? 1 : 2, &data);
+    }
+  }
+  GainMapMetadata metadata;
+  bool supported = false;
+  ASSERT_TRUE(ParseGainMapMetadata(Span<const uint8_t>(data), &metadata,
+                                   &supported));
+  ASSERT_TRUE(supported);
+  EXPECT_EQ(metadata.base_hdr_headroom, 0.5f);
+  EXPECT_EQ(metadata.alternate_hdr_headroom, 3.0f);
+  for (size_t c = 0; c < 3; c++) {
+    EXPECT_EQ(metadata.gain_map_min[c], (c + 1) / 2.0f);
+    EXPECT_EQ(metadata.gamma[c], c + 1.0f);
+    EXPECT_EQ(metadata.alternate_offset[c], (c + 1) / 2.0f);
+  }
+}
+
+TEST(GainMapTest, ParseNewerVersion) {
+  std::vector<uint8_t> data;
+  AppendU16(1, &data);
+  AppendU16(1, &data);
+  GainMapMetadata metadata;
+  bool supported = true;
+  ASSERT_TRUE(ParseGainMapMetadata(Span<const uint8_t>(data), &metadata,
+                                   &supported));
+  EXPECT_FALSE(supported);
+}
+
+TEST(GainMapTest, RejectInvalidMetadata) {
+  GainMapMetadata metadata;
+  bool supported;
+  std::vector<uint8_t> data = CommonDenominatorMetadata(/*gamma_n=*/0);
+  EXPECT_FALSE(ParseGainMapMetadata(Span<const uint8_t>(data), &metadata,
+                                    &supported));
+  data = CommonDenominatorMetadata(/*gamma_n=*/4);
+  data.pop_back();
+  EXPECT_FALSE(ParseGainMapMetadata(Span<const uint8_t>(data), &metadata,
+                                    &supported));
+}
+
+TEST(GainMapTest, RejectTruncatedBox) {
+  JxlMemoryManager* memory_manager = jxl::test::MemoryManager();
+  std::vector<uint8_t> metadata = CommonDenominatorMetadata(/*gamma_n=*/4);
+  std::vector<uint8_t> box = {0};
+  AppendU16(metadata.size(), &box);
+  box.insert(box.end(), metadata.begin(), metadata.end());
+  box.push_back(0);  // no color encoding
+  AppendU32(16, &box);  // missing ICC profile
+  std::unique_ptr<GainMap> gain_map;
+  EXPECT_FALSE(DecodeGainMapBox(memory_manager, Span<const uint8_t>(box),
+                                &gain_map));
+  EXPECT_EQ(gain_map, nullptr);
+}
+
+TEST(GainMapTest, RejectUnknownBoxVersion) {
+  JxlMemoryManager* memory_manager = jxl::test::MemoryManager();
+  std::vector<uint8_t> metadata = CommonDenominatorMetadata(/*gamma_n=*/4);
+  std::vector<uint8_t> box = {1};
+  AppendU16(metadata.size(), &box);
+  box.insert(box.end(), metadata.begin(), metadata.end());
+  box.push_back(0);  // no color encoding
+  AppendU32(0, &box);  // no ICC profile
+  std::unique_ptr<GainMap> gain_map;
+  EXPECT_FALSE(DecodeGainMapBox(memory_manager, Span<const uint8_t>(box),
+                                &gain_map));
+  EXPECT_EQ(gain_map, nullptr);
+}
+
+void AppendBox(const char* type, const std::vector<uint8_t>& contents,
+               std::vector<uint8_t>* out) {
+  AppendU32(8 + contents.size(), out);
+  out->insert(out->end(), type, type + 4);
+  out->insert(out->end(), contents.begin(), contents.end());
+}
+
+constexpr size_t kXSize = 40;
+constexpr size_t kYSize = 24;
+constexpr size_t kGainMapXSize = 10;
+constexpr size_t kGainMapYSize = 6;
+
+float BaseValue(size_t x, size_t y, size_t c) {
+  return ((7 * x + 5 * y + 40 * c) % 256) / 255.0f;
+}
+
+float GainMapValue(size_t x, size_t y, size_t c) {
+  return ((20 * x + 30 * y + 50 * c) % 256) / 255.0f;
+}
+
+// Encodes an 8-bit RGB image with the given pixel values, and with the given
+// jhgm box, if any, which the encoder adds with JxlEncoderAddBox.
+template <typename Value>
+std::vector<uint8_t> EncodeImage(const extras::JXLCompressParams& cparams,
+                                 size_t xsize, size_t ysize,
+                                 const char* color_encoding,
+                                 const Value& value,
+                                 const std::vector<uint8_t>& jhgm = {}) {
+  test::TestImage t;
+  EXPECT_TRUE(t.SetDimensions(xsize, ysize));
+  EXPECT_TRUE(t.SetColorEncoding(color_encoding));
+  JXL_TEST_ASSIGN_OR_DIE(auto frame, t.AddFrame());
+  for (size_t y = 0; y < ysize; y++) {
+    for (size_t x = 0; x < xsize; x++) {
+      for (size_t c = 0; c < 3; c++) {
+        EXPECT_TRUE(frame.SetValue(y, x, c, value(x, y, c)));
+      }
+    }
+  }
+  t.ppf().metadata.jhgm = jhgm;
+  std::vector<uint8_t> compressed;
+  EXPECT_TRUE(extras::EncodeImageJXL(cparams, t.ppf(), /*jpeg_bytes=*/nullptr,
+                                     &compressed));
+  return compressed;
+}
+
+// Contents of a jhgm box with the metadata of CommonDenominatorMetadata() and
+// the given gain map codestream.
+std::vector<uint8_t> GainMapBox(const std::vector<uint8_t>& codestream) {
+  std::vector<uint8_t> metadata = CommonDenominatorMetadata(/*gamma_n=*/4);
+  std::vector<uint8_t> box = {0};
+  AppendU16(metadata.size(), &box);
+  box.insert(box.end(), metadata.begin(), metadata.end());
+  box.push_back(0);  // no color encoding
+  AppendU32(0, &box);  // no ICC profile
+  box.insert(box.end(), codestream.begin(), codestream.end());
+  return box;
+}
+
+std::vector<uint8_t> LosslessGainMapBox() {
+  return GainMapBox(EncodeImage(test::CompressParamsForLossless(),
+                                kGainMapXSize, kGainMapYSize,
+                                "RGB_D65_SRG_Rel_SRG", GainMapValue));
+}
+
+// A linear sRGB base image in a jxlc box, preceded by a jhgm box.
+std::vector<uint8_t> HandBuiltGainMapFile() {
+  // Signature box and ftyp box.
+  std::vector<uint8_t> file = {0,    0,    0,    0xc,  0x4a, 0x58, 0x4c, 0x20,
+                               0xd,  0xa,  0x87, 0xa,  0,    0,    0,    0x14,
+                               0x66, 0x74, 0x79, 0x70, 0x6a, 0x78, 0x6c, 0x20,
+                               0,    0,    0,    0,    0x6a, 0x78, 0x6c, 0x20};
+  AppendBox("jhgm", LosslessGainMapBox(), &file);
+  AppendBox("jxlc",
+            EncodeImage(test::CompressParamsForLossless(), kXSize, kYSize,
+                        "RGB_D65_SRG_Rel_Lin", BaseValue),
+            &file);
+  return file;
+}
+
+std::vector<float> DecodeAtHeadroom(const std::vector<uint8_t>& file,
+                                    float display_headroom) {
+  JxlDecoderPtr dec = JxlDecoderMake(nullptr);
+  EXPECT_EQ(JXL_DEC_SUCCESS,
+            JxlDecoderSubscribeEvents(dec.get(), JXL_DEC_FULL_IMAGE));
+  EXPECT_EQ(JXL_DEC_SUCCESS,
+            JxlDecoderSetGainMapHeadroom(dec.get(), display_headroom));
+  EXPECT_EQ(JXL_DEC_SUCCESS,
+            JxlDecoderSetInput(dec.get(), file.data(), file.size()));
+  JxlDecoderCloseInput(dec.get());
+  const JxlPixelFormat format = {3, JXL_TYPE_FLOAT, JXL_NATIVE_ENDIAN, 0};
+  std::vector<float> pixels(kXSize * kYSize * 3);
+  EXPECT_EQ(JXL_DEC_NEED_IMAGE_OUT_BUFFER, JxlDecoderProcessInput(dec.get()));
+  EXPECT_EQ(JXL_DEC_SUCCESS,
+            JxlDecoderSetImageOutBuffer(dec.get(), &format, pixels.data(),
+                                        pixels.size() * sizeof(float)));
+  EXPECT_EQ(JXL_DEC_FULL_IMAGE, JxlDecoderProcessInput(dec.get()));
+  EXPECT_EQ(JXL_DEC_SUCCESS, JxlDecoderProcessInput(dec.get()));
+  return pixels;
+}
+
+// Position of image coordinate `pos` in the gain map, as in the render stage.
+float GainMapPosition(size_t pos, size_t size, size_t gain_map_size) {
+  return Clamp1((pos + 0.5f) * gain_map_size / size - 0.5f, 0.0f,
+                gain_map_size - 1.0f);
+}
+
+// Applies the gain map of LosslessGainMapBox() to BaseValue(), with a reference
+// white of 1: the log2 gain ranges from 0 to 3 between base headroom 0 and
+// alternate headroom 2, and the offsets are 1/4 and -1/4.
+float ReferenceValue(size_t x, size_t y, size_t c, float display_headroom) {
+  const float weight = Clamp1(display_headroom / 2.0f, 0.0f, 1.0f);
+  const float gx = GainMapPosition(x, kXSize, kGainMapXSize);
+  const float gy = GainMapPosition(y, kYSize, kGainMapYSize);
+  const size_t x0 = static_cast<size_t>(gx);
+  const size_t y0 = static_cast<size_t>(gy);
+  const size_t x1 = std::min(x0 + 1, kGainMapXSize - 1);
+  const size_t y1 = std::min(y0 + 1, kGainMapYSize - 1);
+  const auto lerp = [](float a, float b, float t) { return a + t * (b - a); };
+  const float g =
+      lerp(lerp(GainMapValue(x0, y0, c), GainMapValue(x1, y0, c), gx - x0),
+           lerp(GainMapValue(x0, y1, c), GainMapValue(x1, y1, c), gx - x0),
+           gy - y0);
+  const float log_gain = 3.0f * g;
+  return (BaseValue(x, y, c) + 0.25f) * std::exp2(weight * log_gain) + 0.25f;
+}
+
+void ExpectGainMapApplied(const std::vector<uint8_t>& file) {
+  for (float display_headroom : {1.0f, 2.0f}) {
+    std::vector<float> pixels = DecodeAtHeadroom(file, display_headroom);
+    for (size_t y = 0; y < kYSize; y++) {
+      for (size_t x = 0; x < kXSize; x++) {
+        for (size_t c = 0; c < 3; c++) {
+          const float expected = ReferenceValue(x, y, c, display_headroom);
+          ASSERT_NEAR(pixels[(y * kXSize + x) * 3 + c], expected,
+                      1e-4f * expected)
+              << "headroom " << display_headroom << ", x = " << x
+              << ", y = " << y << ", c = " << c;
+        }
+      }
+    }
+  }
+}
+
+TEST(GainMapTest, RenderAtHeadrooms) {
+  ExpectGainMapApplied(HandBuiltGainMapFile());
+}
+
+// The encoder writes the codestream headers in a jxlp box before the jhgm box,
+// and the frames after it.
+TEST(GainMapTest, RenderBoxAddedByEncoder) {
+  ExpectGainMapApplied(EncodeImage(test::CompressParamsForLossless(), kXSize,
+                                   kYSize, "RGB_D65_SRG_Rel_Lin", BaseValue,
+                                   LosslessGainMapBox()));
+}
+
+// An XYB-encoded gain map stores its values in its original color encoding,
+// not in linear light.
+TEST(GainMapTest, DecodeXybGainMap) {
+  JxlMemoryManager* memory_manager = jxl::test::MemoryManager();
+  constexpr size_t kSize = 64;
+  const auto value = [](size_t x, size_t y, size_t c) {
+    return (x + 2 * y + 16 * c) / 255.0f;
+  };
+  extras::JXLCompressParams cparams;
+  cparams.distance = 1.0f;
+  std::vector<uint8_t> box = GainMapBox(
+      EncodeImage(cparams, kSize, kSize, "RGB_D65_SRG_Rel_SRG", value));
+  std::unique_ptr<GainMap> gain_map;
+  ASSERT_TRUE(DecodeGainMapBox(memory_manager, Span<const uint8_t>(box),
+                               &gain_map));
+  ASSERT_NE(gain_map, nullptr);
+  ASSERT_EQ(gain_map->log_gain.xsize(), kSize);
+  ASSERT_EQ(gain_map->log_gain.ysize(), kSize);
+  for (size_t c = 0; c < 3; c++) {
+    for (size_t y = 0; y < kSize; y++) {
+      const float* row = gain_map->log_gain.ConstPlaneRow(c, y);
+      for (size_t x = 0; x < kSize; x++) {
+        ASSERT_NEAR(row[x], 3.0f * value(x, y, c), 0.05f)
+            << "x = " << x << ", y = " << y << ", c = " << c;
+      }
+    }
+  }
+}
+
+}  // namespace
+}  // namespace jxl
@@ -45,6 +45,7 @@
 #include "lib/jxl/coeff_order.h"
 #include "lib/jxl/common.h"  // kMaxNumPasses
 #include "lib/jxl/dec_cache.h"
+#include "lib/jxl/dec_stats.h"
 #include "lib/jxl/dec_transforms-inl.h"
 #include "lib/jxl/dec_xyb.h"
 #include "lib/jxl/entropy_coder.h"
@@ -271,6 +272,8 @@ Status DecodeGroupImpl(const FrameHeader& frame_header,
     }
   }
 
+  // Reading the coefficients and transforming them alternate per block.
+  DecodeStatsTimer timer(dec_state->stats);
   for (size_t by = 0; by < ysize_blocks; ++by) {
     get_block->StartRow(by);
     size_t sby[3] = {by >> vshift[0], by >> vshift[1], by >> vshift[2]};
@@ -356,6 +359,7 @@ Status DecodeGroupImpl(const FrameHeader& frame_header,
         JXL_RETURN_IF_ERROR(get_block->LoadBlock(
             bx, by, acs, size, log2_covered_blocks, qblock, ac_type));
         offset += size;
+        timer.Lap(JXL_DEC_STAT_ENTROPY_DECODE_USEC);
         if (draw == kDontDraw) {
           bx += llf_x;
           continue;
@@ -448,6 +452,7 @@ Status DecodeGroupImpl(const FrameHeader& frame_header,
                               idct_stride[c], group_dec_cache->scratch_space);
           }
         }
+        timer.Lap(JXL_DEC_STAT_TRANSFORM_USEC);
         bx += llf_x;
       }
     }
@@ -579,13 +584,28 @@ struct GetBlockFromBitstream : public GetBlock {
                                           : DecodeACVarBlock<ACType::k32, 1>)
                 : (ac_type == ACType::k16 ? DecodeACVarBlock<ACType::k16, 0>
                                           : DecodeACVarBlock<ACType::k32, 0>);
+        ACPtr dst = block[c];
+        size_t shift = shift_for_pass[pass];
+        if (JXL_UNLIKELY(capture_rows[pass][c] != nullptr)) {
+          // Decode the pass on its own, then add it to the block.
+          JXL_ENSURE(ac_type == ACType::k32);
+          dst.ptr32 = capture_rows[pass][c] + capture_offset[c];
+          shift = 0;
+        }
         JXL_RETURN_IF_ERROR(decode_ac_varblock(
             ctx_offset[pass], log2_covered_blocks, row_nzeros[pass][c],
             row_nzeros_top[pass][c], nzeros_stride, c, sbx, sby, bx, acs,
             &coeff_orders[pass * coeff_order_size], readers[pass],
             &decoders[pass], context_map[pass], quant_dc_row, qf_row,
-            *block_ctx_map, block[c], shift_for_pass[pass]));
+            *block_ctx_map, dst, shift));
+        if (JXL_UNLIKELY(capture_rows[pass][c] != nullptr)) {
+          for (size_t k = 0; k < size; k++) {
+            block[c].ptr32[k] += static_cast<int32_t>(
+                static_cast<uint32_t>(dst.ptr32[k]) << shift_for_pass[pass]);
+          }
+        }
       }
+      capture_offset[c] += size;
     }
     return true;
   }
@@ -611,6 +631,18 @@ struct GetBlockFromBitstream : public GetBlock {
     block_ctx_map = &dec_state->shared->block_ctx_map;
     qf = &dec_state->shared->raw_quant_field;
     quant_dc = &dec_state->shared->quant_dc;
+    ACCapture* capture = dec_state->ac_capture;
+    for (size_t pass = 0; pass < num_passes; pass++) {
+      for (size_t c = 0; c < 3; c++) {
+        capture_rows[pass][c] = nullptr;
+        if (capture && capture->with_coefficients) {
+          JXL_ENSURE(first_pass + pass < capture->coeffs.size());
+          capture_rows[pass][c] = capture->coeffs[first_pass + pass]
+                                      ->PlaneRow(c, group_idx, 0)
+                                      .ptr32;
+        }
+      }
+    }
 
     for (size_t pass = 0; pass < num_passes; pass++) {
       // Select which histogram set to use among those of the current pass.
@@ -656,6 +688,9 @@ struct GetBlockFromBitstream : public GetBlock {
   const uint8_t* quant_dc_row;
   Rect rect;
   size_t hshift[3], vshift[3];
+  // Where to store the coefficients of each pass for the ACCapture, if any.
+  int32_t* JXL_RESTRICT capture_rows[kMaxNumPasses][3];
+  size_t capture_offset[3] = {};
 };
 
 struct GetBlockFromEncoder : public GetBlock {
@@ -666,42 +701,28 @@ struct GetBlockFromEncoder : public GetBlock {
                    ACType ac_type) override {
     JXL_ENSURE(ac_type == ACType::k32);
     for (size_t c = 0; c < 3; c++) {
-      // for each pass
-      for (size_t i = 0; i < quantized_ac->size(); i++) {
-        for (size_t k = 0; k < size; k++) {
-          // TODO(veluca): SIMD.
-          block[c].ptr32[k] +=
-              rows[i][c][offset + k] * (1 << shift_for_pass[i]);
-        }
+      for (size_t k = 0; k < size; k++) {
+        // TODO(veluca): SIMD.
+        block[c].ptr32[k] += rows[c][offset + k];
       }
     }
     offset += size;
     return true;
   }
 
-  static StatusOr<GetBlockFromEncoder> Create(
-      const std::vector<std::unique_ptr<ACImage>>& ac, size_t group_idx,
-      const uint32_t* shift_for_pass) {
-    GetBlockFromEncoder result(ac, group_idx, shift_for_pass);
+  static StatusOr<GetBlockFromEncoder> Create(const ACImage& ac,
+                                              size_t group_idx) {
+    GetBlockFromEncoder result;
     // TODO(veluca): not supported with chroma subsampling.
-    for (size_t i = 0; i < ac.size(); i++) {
-      JXL_ENSURE(ac[i]->Type() == ACType::k32);
-      for (size_t c = 0; c < 3; c++) {
-        result.rows[i][c] = ac[i]->PlaneRow(c, group_idx, 0).ptr32;
-      }
+    JXL_ENSURE(ac.Type() == ACType::k32);
+    for (size_t c = 0; c < 3; c++) {
+      result.rows[c] = ac.PlaneRow(c, group_idx, 0).ptr32;
     }
     return result;
   }
 
-  const std::vector<std::unique_ptr<ACImage>>* JXL_RESTRICT quantized_ac;
   size_t offset = 0;
-  const int32_t* JXL_RESTRICT rows[kMaxNumPasses][3];
-  const uint32_t* shift_for_pass = nullptr;  // not owned
-
- private:
-  GetBlockFromEncoder(const std::vector<std::unique_ptr<ACImage>>& ac,
-                      size_t group_idx, const uint32_t* shift_for_pass)
-      : quantized_ac(&ac), shift_for_pass(shift_for_pass) {}
+  const int32_t* JXL_RESTRICT rows[3];
 };
 
 HWY_EXPORT(DecodeGroupImpl);
@@ -817,8 +838,7 @@ Status DecodeGroup(const FrameHeader& frame_header,
 }
 
 Status DecodeGroupForRoundtrip(const FrameHeader& frame_header,
-                               const std::vector<std::unique_ptr<ACImage>>& ac,
-                               size_t group_idx,
+                               const ACImage& ac, size_t group_idx,
                                PassesDecoderState* JXL_RESTRICT dec_state,
                                GroupDecCache* JXL_RESTRICT group_dec_cache,
                                size_t thread,
@@ -828,7 +848,7 @@ Status DecodeGroupForRoundtrip(const FrameHeader& frame_header,
   JxlMemoryManager* memory_manager = dec_state->memory_manager();
   JXL_ASSIGN_OR_RETURN(
       GetBlockFromEncoder get_block,
-      GetBlockFromEncoder::Create(ac, group_idx, frame_header.passes.shift));
+      GetBlockFromEncoder::Create(ac, group_idx));
   JXL_RETURN_IF_ERROR(group_dec_cache->InitOnce(
       memory_manager,
       /*num_passes=*/0,
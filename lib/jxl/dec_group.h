@@ -7,8 +7,6 @@
 #define LIB_JXL_DEC_GROUP_H_
 
 #include <cstddef>
-#include <memory>
-#include <vector>
 
 #include "lib/jxl/base/compiler_specific.h"
 #include "lib/jxl/base/status.h"
@@ -32,9 +30,9 @@ Status DecodeGroup(const FrameHeader& frame_header,
                    jpeg::JPEGData* JXL_RESTRICT jpeg_data, size_t first_pass,
                    bool force_draw, bool dc_only, bool* should_run_pipeline);
 
+// `ac` holds the quantized AC coefficients of all passes added together.
 Status DecodeGroupForRoundtrip(const FrameHeader& frame_header,
-                               const std::vector<std::unique_ptr<ACImage>>& ac,
-                               size_t group_idx,
+                               const ACImage& ac, size_t group_idx,
                                PassesDecoderState* JXL_RESTRICT dec_state,
                                GroupDecCache* JXL_RESTRICT group_dec_cache,
                                size_t thread,
@@ -21,6 +21,7 @@
 #include "lib/jxl/chroma_from_luma.h"
 #include "lib/jxl/dec_ans.h"
 #include "lib/jxl/dec_cache.h"
+#include "lib/jxl/dec_stats.h"
 #include "lib/jxl/fields.h"
 #include "lib/jxl/frame_dimensions.h"
 #include "lib/jxl/frame_header.h"
@@ -200,7 +201,8 @@ std::string ModularStreamId::DebugString() const {
 
 Status ModularFrameDecoder::DecodeGlobalInfo(BitReader* reader,
                                              const FrameHeader& frame_header,
-                                             bool allow_truncated_group) {
+                                             bool allow_truncated_group,
+                                             ModularCapture* capture) {
   JxlMemoryManager* memory_manager = this->memory_manager();
   bool decode_color = frame_header.encoding == FrameEncoding::kModular;
   const auto& metadata = frame_header.nonserialized_metadata->m;
@@ -211,6 +213,12 @@ Status ModularFrameDecoder::DecodeGlobalInfo(BitReader* reader,
   }
   do_color = decode_color;
   size_t nb_extra = metadata.extra_channel_info.size();
+  capture_ = capture;
+  if (capture) {
+    *capture = ModularCapture();
+    capture->local_tree_splits_on_stream_id.resize(
+        ModularStreamId::Num(frame_dim, frame_header.passes.num_passes));
+  }
   bool has_tree = static_cast<bool>(reader->ReadBits(1));
   if (!allow_truncated_group ||
       reader->TotalBitsConsumed() < reader->TotalBytes() * kBitsPerByte) {
@@ -219,8 +227,13 @@ Status ModularFrameDecoder::DecodeGlobalInfo(BitReader* reader,
           std::min(static_cast<size_t>(1 << 22),
                    1024 + frame_dim.xsize * frame_dim.ysize *
                               (nb_chans + nb_extra) / 16);
+      if (capture) capture->tree_begin = reader->TotalBitsConsumed();
       JXL_RETURN_IF_ERROR(
           DecodeTree(memory_manager, reader, &tree, tree_size_limit));
+      if (capture) {
+        capture->tree_end = reader->TotalBitsConsumed();
+        capture->tree = tree;
+      }
       JXL_RETURN_IF_ERROR(DecodeHistograms(
           memory_manager, reader, (tree.size() + 1) / 2, &code, &context_map));
     }
@@ -287,6 +300,16 @@ Status ModularFrameDecoder::DecodeGlobalInfo(BitReader* reader,
     return JXL_FAILURE("Failed to decode global modular info");
   }
 
+  if (capture) {
+    for (const Transform& t : gi.transform) {
+      capture->has_squeeze |= t.id == TransformId::kSqueeze;
+    }
+    for (size_t c = gi.nb_meta_channels; c < gi.channel.size(); c++) {
+      capture->channel_shifts.emplace_back(gi.channel[c].hshift,
+                                           gi.channel[c].vshift);
+    }
+  }
+
   // TODO(eustas): are we sure this can be done after partial decode?
   have_something = false;
   for (size_t c = 0; c < gi.channel.size(); c++) {
@@ -379,6 +402,7 @@ Status ModularFrameDecoder::DecodeGroup(
     return true;
   }
   ModularOptions options;
+  CaptureLocalTree(stream.ID(frame_dim), &options);
   if (!zerofill) {
     auto status = ModularGenericDecompress(
         reader, gi, /*header=*/nullptr, stream.ID(frame_dim), &options,
@@ -436,6 +460,7 @@ Status ModularFrameDecoder::DecodeVarDCTDC(const FrameHeader& frame_header,
   size_t extra_precision = reader->ReadFixedBits<2>();
   float mul = 1.0f / (1 << extra_precision);
   ModularOptions options;
+  CaptureLocalTree(stream_id, &options);
   for (size_t c = 0; c < 3; c++) {
     Channel& ch = image.channel[c < 2 ? c ^ 1 : c];
     ch.w >>= frame_header.chroma_subsampling.HShift(c);
@@ -481,6 +506,7 @@ Status ModularFrameDecoder::DecodeAcMetadata(const FrameHeader& frame_header,
   JXL_ASSIGN_OR_RETURN(image.channel[2],
                        Channel::Create(memory_manager, count, 2, 0, 0));
   ModularOptions options;
+  CaptureLocalTree(stream_id, &options);
   if (!ModularGenericDecompress(
           reader, image, /*header=*/nullptr, stream_id, &options,
           /*undo_transforms=*/true, &tree, &code, &context_map)) {
@@ -751,7 +777,9 @@ Status ModularFrameDecoder::FinalizeDecoding(const FrameHeader& frame_header,
   if (xsize * ysize < frame_dim.group_dim * frame_dim.group_dim) pool = nullptr;
 
   // Undo the global transforms
+  DecodeStatsTimer timer(dec_state->stats);
   gi.undo_transforms(global_header.wp_header, pool);
+  timer.Lap(JXL_DEC_STAT_TRANSFORM_USEC);
   JXL_ENSURE(global_transform.empty());
   if (gi.error) return JXL_FAILURE("Undoing transforms failed");
 
@@ -768,12 +796,15 @@ Status ModularFrameDecoder::FinalizeDecoding(const FrameHeader& frame_header,
   };
   const auto process_group = [&](const uint32_t group,
                                  size_t thread_id) -> Status {
+    DecodeStatsTimer timer(dec_state->stats);
     RenderPipelineInput input =
         dec_state->render_pipeline->GetInputBuffers(group, thread_id);
     JXL_RETURN_IF_ERROR(ModularImageToDecodedRect(
         frame_header, gi, dec_state, nullptr, input,
         dec_state->shared->frame_dim.GroupRect(group)));
+    timer.Lap(JXL_DEC_STAT_TRANSFORM_USEC);
     JXL_RETURN_IF_ERROR(input.Done());
+    timer.Lap(JXL_DEC_STAT_RENDER_USEC);
     return true;
   };
   JXL_RETURN_IF_ERROR(RunOnPool(pool, 0,
@@ -800,6 +831,8 @@ Status ModularFrameDecoder::DecodeQuantTable(
   ModularOptions options;
   if (modular_frame_decoder) {
     JXL_ASSIGN_OR_RETURN(ModularStreamId qt, ModularStreamId::QuantTable(idx));
+    modular_frame_decoder->CaptureLocalTree(
+        qt.ID(modular_frame_decoder->frame_dim), &options);
     JXL_RETURN_IF_ERROR(ModularGenericDecompress(
         br, image, /*header=*/nullptr, qt.ID(modular_frame_decoder->frame_dim),
         &options, /*undo_transforms=*/true, &modular_frame_decoder->tree,
@@ -96,8 +96,12 @@ class ModularFrameDecoder {
   explicit ModularFrameDecoder(JxlMemoryManager* memory_manager)
       : memory_manager_(memory_manager), full_image(memory_manager) {}
   void Init(const FrameDimensions& new_frame_dim) { frame_dim = new_frame_dim; }
+  // Records the global tree and the layout of the modular image in `capture`,
+  // if not null, and then which streams decoded afterwards have a local tree
+  // that splits on the stream id.
   Status DecodeGlobalInfo(BitReader* reader, const FrameHeader& frame_header,
-                          bool allow_truncated_group);
+                          bool allow_truncated_group,
+                          ModularCapture* capture = nullptr);
   Status DecodeGroup(const FrameHeader& frame_header, const Rect& rect,
                      BitReader* reader, int minShift, int maxShift,
                      const ModularStreamId& stream, bool zerofill,
@@ -135,7 +139,14 @@ class ModularFrameDecoder {
                                    jxl::ThreadPool* pool,
                                    RenderPipelineInput& render_pipeline_input,
                                    Rect modular_rect) const;
+  // Points `options` at the flag of `stream_id` in the capture, if any.
+  void CaptureLocalTree(size_t stream_id, ModularOptions* options) const {
+    if (capture_ == nullptr) return;
+    options->tree_splits_on_stream_id =
+        &capture_->local_tree_splits_on_stream_id[stream_id];
+  }
   JxlMemoryManager* memory_manager_;
+  ModularCapture* capture_ = nullptr;
   Image full_image;
   std::vector<Transform> global_transform;
   FrameDimensions frame_dim;
@@ -0,0 +1,79 @@
+// Copyright (c) the JPEG XL Project Authors. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#ifndef LIB_JXL_DEC_STATS_H_
+#define LIB_JXL_DEC_STATS_H_
+
+#include <jxl/decode_stats.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace jxl {
+
+// Counters of the frame being decoded, see JxlDecoderStats. Groups are decoded
+// concurrently, hence the atomics. The time counters are in nanoseconds.
+class FrameDecodeStats {
+ public:
+  void Add(JxlDecoderStatsKey key, uint64_t value) {
+    values_[key].fetch_add(value, std::memory_order_relaxed);
+  }
+
+  uint64_t Get(JxlDecoderStatsKey key) const {
+    return values_[key].load(std::memory_order_relaxed);
+  }
+
+  void Reset() {
+    for (auto& value : values_) value.store(0, std::memory_order_relaxed);
+  }
+
+ private:
+  std::array<std::atomic<uint64_t>, JXL_DEC_NUM_STATS> values_{};
+};
+
+// Attributes the time between successive calls to Lap() to the given counters
+// of `stats`. The durations are summed locally, so that timing many small
+// steps does not contend on the atomics, and added when the timer is
+// destroyed. Does nothing if `stats` is null.
+class DecodeStatsTimer {
+ public:
+  explicit DecodeStatsTimer(FrameDecodeStats* stats) : stats_(stats) {
+    if (stats_) last_ = Clock::now();
+  }
+  ~DecodeStatsTimer() {
+    if (!stats_) return;
+    for (size_t i = 0; i < nanos_.size(); ++i) {
+      if (nanos_[i] != 0) {
+        stats_->Add(static_cast<JxlDecoderStatsKey>(i), nanos_[i]);
+      }
+    }
+  }
+  DecodeStatsTimer(const DecodeStatsTimer&) = delete;
+  DecodeStatsTimer& operator=(const DecodeStatsTimer&) = delete;
+
+  // Adds the time since the previous lap, or since construction, to `key`.
+  void Lap(JxlDecoderStatsKey key) {
+    if (!stats_) return;
+    Clock::time_point now = Clock::now();
+    nanos_[key] += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       now - last_)
+                       .count();
+    last_ = now;
+  }
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  FrameDecodeStats* stats_;
+  Clock::time_point last_;
+  std::array<uint64_t, JXL_DEC_NUM_STATS> nanos_{};
+};
+
+}  // namespace jxl
+
+#endif  // LIB_JXL_DEC_STATS_H_
@@ -10,6 +10,7 @@
 #include <jxl/color_encoding.h>
 #include <jxl/decode.h>
 #include <jxl/decode_cxx.h>
+#include <jxl/decode_stats.h>
 #include <jxl/memory_manager.h>
 #include <jxl/parallel_runner.h>
 #include <jxl/resizable_parallel_runner.h>
@@ -2141,6 +2142,68 @@ TEST(DecodeTest, PixelTestOpaqueSrgbLossyNoise) {
   }
 }
 
+TEST(DecodeTest, StatsTest) {
+  size_t xsize = 300;
+  size_t ysize = 300;
+  std::vector<uint8_t> pixels = jxl::test::GetSomeTestImage(xsize, ysize, 3, 0);
+  jxl::TestCodestreamParams params;
+  params.cparams.patches = jxl::Override::kOff;
+  std::vector<uint8_t> compressed = jxl::CreateTestJXLCodestream(
+      jxl::Bytes(pixels.data(), pixels.size()), xsize, ysize, 3, params);
+
+  JxlDecoder* dec = JxlDecoderCreate(nullptr);
+  JxlDecoderStats* stats = JxlDecoderStatsCreate();
+  JxlDecoderCollectStats(dec, stats);
+  JxlPixelFormat format = {3, JXL_TYPE_UINT8, JXL_LITTLE_ENDIAN, 0};
+  std::vector<uint8_t> pixels2 = jxl::DecodeWithAPI(
+      dec, jxl::Bytes(compressed.data(), compressed.size()), format,
+      /*use_callback=*/false, /*set_buffer_early=*/false,
+      /*use_resizable_runner=*/false, /*require_boxes=*/false,
+      /*expect_success=*/true);
+  JxlDecoderDestroy(dec);
+  EXPECT_EQ(xsize * ysize * 3, pixels2.size());
+
+  ASSERT_EQ(1u, JxlDecoderStatsNumFrames(stats));
+  const auto get = [&](JxlDecoderStatsKey key) {
+    return JxlDecoderStatsGetFrame(stats, 0, key);
+  };
+  // 2x2 groups of 256x256 pixels in one DC group, and a single pass.
+  EXPECT_EQ(1u, get(JXL_DEC_STAT_NUM_DC_GROUPS));
+  EXPECT_EQ(4u, get(JXL_DEC_STAT_NUM_AC_GROUPS));
+  size_t frame_bytes = 0;
+  for (JxlDecoderStatsKey key :
+       {JXL_DEC_STAT_HEADER_BYTES, JXL_DEC_STAT_DC_GLOBAL_BYTES,
+        JXL_DEC_STAT_DC_GROUP_BYTES, JXL_DEC_STAT_AC_GLOBAL_BYTES,
+        JXL_DEC_STAT_AC_GROUP_BYTES}) {
+    EXPECT_GT(get(key), 0u);
+    frame_bytes += get(key);
+  }
+  // Everything but the image headers belongs to the frame.
+  EXPECT_LE(frame_bytes, compressed.size());
+  EXPECT_GT(frame_bytes + 64, compressed.size());
+  EXPECT_GT(get(JXL_DEC_STAT_ENTROPY_DECODE_USEC) +
+                get(JXL_DEC_STAT_TRANSFORM_USEC) +
+                get(JXL_DEC_STAT_RENDER_USEC),
+            0u);
+  EXPECT_GT(get(JXL_DEC_STAT_NUM_ALLOCATIONS), 0u);
+  EXPECT_GT(get(JXL_DEC_STAT_PEAK_MEMORY_BYTES), xsize * ysize);
+  EXPECT_GE(JxlDecoderStatsGet(stats, JXL_DEC_STAT_NUM_ALLOCATIONS),
+            get(JXL_DEC_STAT_NUM_ALLOCATIONS));
+  EXPECT_GE(JxlDecoderStatsGet(stats, JXL_DEC_STAT_PEAK_MEMORY_BYTES),
+            get(JXL_DEC_STAT_PEAK_MEMORY_BYTES));
+
+  JxlDecoderStats* merged = JxlDecoderStatsCreate();
+  JxlDecoderStatsMerge(merged, stats);
+  JxlDecoderStatsMerge(merged, stats);
+  EXPECT_EQ(2u, JxlDecoderStatsNumFrames(merged));
+  EXPECT_EQ(2 * get(JXL_DEC_STAT_AC_GROUP_BYTES),
+            JxlDecoderStatsGet(merged, JXL_DEC_STAT_AC_GROUP_BYTES));
+  EXPECT_EQ(JxlDecoderStatsGet(stats, JXL_DEC_STAT_PEAK_MEMORY_BYTES),
+            JxlDecoderStatsGet(merged, JXL_DEC_STAT_PEAK_MEMORY_BYTES));
+  JxlDecoderStatsDestroy(merged);
+  JxlDecoderStatsDestroy(stats);
+}
+
 TEST(DecodeTest, ProcessEmptyInputWithBoxes) {
   size_t xsize = 123;
   size_t ysize = 77;
@@ -905,7 +905,7 @@ StatusOr<ImageBundle> RoundtripImage(const FrameHeader& frame_header,
     RenderPipelineInput input =
         dec_state->render_pipeline->GetInputBuffers(group_index, thread);
     JXL_RETURN_IF_ERROR(DecodeGroupForRoundtrip(
-        frame_header, enc_state->coeffs, group_index, dec_state.get(),
+        frame_header, *enc_state->coeffs, group_index, dec_state.get(),
         &group_dec_caches[thread], thread, input, nullptr, nullptr));
     for (size_t c = 0; c < metadata.num_extra_channels; c++) {
       std::pair<ImageF*, Rect> ri = input.GetBuffer(3 + c);
@@ -951,7 +951,7 @@ Status FindBestQuantization(const FrameHeader& frame_header,
       tf.IsPQ() || tf.IsHLG()
           ? frame_header.nonserialized_metadata->m.IntensityTarget()
           : 80.f;
-  JxlButteraugliComparator comparator(params, cms);
+  JxlButteraugliComparator comparator(params, cms, pool);
   JXL_RETURN_IF_ERROR(comparator.SetLinearReferenceImage(linear));
   bool lower_is_better =
       (comparator.GoodQualityScore() < comparator.BadQualityScore());
@@ -5,6 +5,7 @@
 
 #include "lib/jxl/enc_aux_out.h"
 
+#include <chrono>
 #include <cstddef>
 #include <cstdio>
 
@@ -51,6 +52,67 @@ const char* LayerName(LayerType layer) {
   return "Invalid";
 }
 
+const char* EncoderPhaseName(EncoderPhase phase) {
+  switch (phase) {
+    case EncoderPhase::Input:
+      return "Input";
+    case EncoderPhase::Heuristics:
+      return "Heuristics";
+    case EncoderPhase::CoeffOrders:
+      return "CoeffOrders";
+    case EncoderPhase::Tokenization:
+      return "Tokenization";
+    case EncoderPhase::Modular:
+      return "Modular";
+    case EncoderPhase::Histograms:
+      return "Histograms";
+    case EncoderPhase::GroupEncoding:
+      return "GroupEncoding";
+  }
+  JXL_DEBUG_ABORT("internal: unexpected EncoderPhase: %d",
+                  static_cast<int>(phase));
+  return "Invalid";
+}
+
+namespace {
+
+double NowSeconds() {
+  return std::chrono::duration<double>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+}  // namespace
+
+ScopedPhaseTimer::ScopedPhaseTimer(AuxOut* aux_out, EncoderPhase phase)
+    : aux_out_(aux_out),
+      phase_(phase),
+      start_(0.0)
+#if JPEGXL_ENABLE_TRACING
+      ,
+      trace_scope_(EncoderPhaseName(phase), "phase")
+#endif
+{
+  if (aux_out_) start_ = NowSeconds();
+}
+
+void ScopedPhaseTimer::Stop() {
+#if JPEGXL_ENABLE_TRACING
+  trace_scope_.End();
+#endif
+  if (!aux_out_) return;
+  aux_out_->phase_seconds[static_cast<uint8_t>(phase_)] +=
+      NowSeconds() - start_;
+  aux_out_ = nullptr;
+}
+
+ScopedGroupTimer::ScopedGroupTimer(double* seconds)
+    : seconds_(seconds), start_(seconds ? NowSeconds() : 0.0) {}
+
+ScopedGroupTimer::~ScopedGroupTimer() {
+  if (seconds_) *seconds_ += NowSeconds() - start_;
+}
+
 void AuxOut::LayerTotals::Print(size_t num_inputs) const {
   if (JXL_DEBUG_V_LEVEL > 0) {
     printf("%10" PRIuS, total_bits);
@@ -83,6 +145,11 @@ void AuxOut::Assimilate(const AuxOut& victim) {
   num_dct32x64_blocks += victim.num_dct32x64_blocks;
   num_dct64_blocks += victim.num_dct64_blocks;
   num_butteraugli_iters += victim.num_butteraugli_iters;
+  for (size_t i = 0; i < kNumEncoderPhases; ++i) {
+    phase_seconds[i] += victim.phase_seconds[i];
+  }
+  group_stats.insert(group_stats.end(), victim.group_stats.begin(),
+                     victim.group_stats.end());
 }
 
 void AuxOut::Print(size_t num_inputs) const {
@@ -108,6 +175,14 @@ void AuxOut::Print(size_t num_inputs) const {
     printf("Total image size           ");
     all_layers.Print(num_inputs);
 
+    for (size_t i = 0; i < kNumEncoderPhases; ++i) {
+      if (phase_seconds[i] != 0.0) {
+        printf("Phase %-13s\t%10.3f ms/input\n",
+               EncoderPhaseName(static_cast<EncoderPhase>(i)),
+               phase_seconds[i] * 1000.0 / num_inputs);
+      }
+    }
+
     size_t total_blocks = 0;
     size_t total_positions = 0;
     if (total_blocks != 0 && total_positions != 0) {
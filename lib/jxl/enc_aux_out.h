@@ -11,6 +11,9 @@
 #include <array>
 #include <cstddef>
 #include <cstdint>
+#include <vector>
+
+#include "lib/jxl/base/trace.h"
 
 namespace jxl {
 
@@ -40,6 +43,71 @@ constexpr uint8_t kNumImageLayers =
 
 const char* LayerName(LayerType layer);
 
+// Encoder phases whose wall time is accumulated in AuxOut::phase_seconds.
+// Phases do not overlap, so their sum approximates the frame encoding time.
+enum class EncoderPhase : uint8_t {
+  Input = 0,     // input copy, color transform and downsampling
+  Heuristics,    // AC strategy, quantization field, etc.
+  CoeffOrders,
+  Tokenization,  // VarDCT coefficient tokenization
+  Modular,       // modular tree learning and tokenization
+  Histograms,    // AC histogram clustering and encoding
+  GroupEncoding,
+};
+
+constexpr uint8_t kNumEncoderPhases =
+    static_cast<uint8_t>(EncoderPhase::GroupEncoding) + 1;
+
+const char* EncoderPhaseName(EncoderPhase phase);
+
+// Size classes of AC strategies, in the order of the AuxOut::num_*_blocks
+// counters.
+enum class BlockSizeClass : uint8_t {
+  Small = 0,  // identity, DCT2x2 and DCT4x4
+  Dct4x8,
+  Afv,
+  Dct8,
+  Dct8x16,
+  Dct8x32,
+  Dct16,
+  Dct16x32,
+  Dct32,
+  Dct32x64,
+  Dct64,  // DCT64 and larger
+};
+
+constexpr uint8_t kNumBlockSizeClasses =
+    static_cast<uint8_t>(BlockSizeClass::Dct64) + 1;
+
+// Encoding costs of one AC group of a VarDCT frame, to find the image regions
+// that are slow or expensive to encode.
+struct GroupStats {
+  // Position and size of the group in the frame, in pixels.
+  size_t x0 = 0;
+  size_t y0 = 0;
+  size_t xsize = 0;
+  size_t ysize = 0;
+
+  // Time spent on the group in the Heuristics, Tokenization and GroupEncoding
+  // phases. The heuristics time covers the AC strategy and quantization field
+  // search, the DCT and the quantization of the group, but not the frame-wide
+  // steps such as the butteraugli iterations.
+  double heuristics_seconds = 0.0;
+  double tokenization_seconds = 0.0;
+  double encoding_seconds = 0.0;
+
+  // Size of the AC group sections of all passes.
+  size_t bits = 0;
+
+  // Number of varblocks whose top-left 8x8 block is in the group.
+  std::array<size_t, kNumBlockSizeClasses> num_blocks = {};
+
+  // Quantization field over the 8x8 blocks of the group.
+  int min_quant = 0;
+  int max_quant = 0;
+  size_t quant_sum = 0;
+};
+
 // Statistics gathered during compression or decompression.
 struct AuxOut {
  private:
@@ -104,6 +172,72 @@ struct AuxOut {
   size_t num_dct64_blocks = 0;
 
   int num_butteraugli_iters = 0;
+
+  std::array<double, kNumEncoderPhases> phase_seconds = {};
+
+  double phase(EncoderPhase idx) const {
+    return phase_seconds[static_cast<uint8_t>(idx)];
+  }
+
+  // The groups of each VarDCT frame, in encoding order. Not collected in
+  // streaming mode.
+  std::vector<GroupStats> group_stats;
+
+  // Appends `num_groups` entries to group_stats for the frame being encoded.
+  void StartFrameGroupStats(size_t num_groups) {
+    frame_groups_begin_ = group_stats.size();
+    frame_num_groups_ = num_groups;
+    group_stats.resize(frame_groups_begin_ + num_groups);
+  }
+  void StopFrameGroupStats() { frame_num_groups_ = 0; }
+
+  // Returns the entry of a group of the frame being encoded, or null if the
+  // frame does not collect group statistics. Tasks of different groups may
+  // write their entries concurrently.
+  GroupStats* frame_group_stats(size_t group) {
+    if (group >= frame_num_groups_) return nullptr;
+    return &group_stats[frame_groups_begin_ + group];
+  }
+
+ private:
+  size_t frame_groups_begin_ = 0;
+  size_t frame_num_groups_ = 0;
+};
+
+// Adds the wall time spent in its scope (or until Stop) to the given phase of
+// aux_out. Does not read the clock if aux_out is null.
+class ScopedPhaseTimer {
+ public:
+  ScopedPhaseTimer(AuxOut* aux_out, EncoderPhase phase);
+  ~ScopedPhaseTimer() { Stop(); }
+
+  void Stop();
+
+  ScopedPhaseTimer(const ScopedPhaseTimer&) = delete;
+  ScopedPhaseTimer& operator=(const ScopedPhaseTimer&) = delete;
+
+ private:
+  AuxOut* aux_out_;
+  EncoderPhase phase_;
+  double start_;
+#if JPEGXL_ENABLE_TRACING
+  trace::TraceScope trace_scope_;
+#endif
+};
+
+// Adds the wall time spent in its scope to *seconds, typically a field of a
+// GroupStats. Does not read the clock if seconds is null.
+class ScopedGroupTimer {
+ public:
+  explicit ScopedGroupTimer(double* seconds);
+  ~ScopedGroupTimer();
+
+  ScopedGroupTimer(const ScopedGroupTimer&) = delete;
+  ScopedGroupTimer& operator=(const ScopedGroupTimer&) = delete;
+
+ private:
+  double* seconds_;
+  double start_;
 };
 }  // namespace jxl
 
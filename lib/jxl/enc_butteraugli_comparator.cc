@@ -11,6 +11,8 @@
 #include <cstddef>
 
 #include "lib/jxl/base/compiler_specific.h"
+#include "lib/jxl/base/data_parallel.h"
+#include "lib/jxl/base/rect.h"
 #include "lib/jxl/base/status.h"
 #include "lib/jxl/butteraugli/butteraugli.h"
 #include "lib/jxl/color_encoding_internal.h"
@@ -18,24 +20,34 @@
 #include "lib/jxl/image.h"
 #include "lib/jxl/image_bundle.h"
 #include "lib/jxl/image_metadata.h"
+#include "lib/jxl/image_ops.h"
 
 namespace jxl {
 
 JxlButteraugliComparator::JxlButteraugliComparator(
-    const ButteraugliParams& params, const JxlCmsInterface& cms)
-    : params_(params), cms_(cms) {}
+    const ButteraugliParams& params, const JxlCmsInterface& cms,
+    ThreadPool* pool)
+    : params_(params), cms_(cms), pool_(pool) {}
 
 Status JxlButteraugliComparator::SetReferenceImage(const ImageBundle& ref) {
-  const ImageBundle* ref_linear_srgb;
-  JxlMemoryManager* memory_manager = ref.memory_manager();
-  ImageMetadata metadata = *ref.metadata();
-  ImageBundle store(memory_manager, &metadata);
-  if (!TransformIfNeeded(ref, ColorEncoding::LinearSRGB(ref.IsGray()), cms_,
-                         /*pool=*/nullptr, &store, &ref_linear_srgb)) {
-    return false;
+  reference_ = nullptr;
+  linear_reference_ = nullptr;
+  comparator_.reset();
+  if (tile_size_ != 0) {
+    reference_ = &ref;
+  } else {
+    const ImageBundle* ref_linear_srgb;
+    JxlMemoryManager* memory_manager = ref.memory_manager();
+    ImageMetadata metadata = *ref.metadata();
+    ImageBundle store(memory_manager, &metadata);
+    if (!TransformIfNeeded(ref, ColorEncoding::LinearSRGB(ref.IsGray()), cms_,
+                           pool_, &store, &ref_linear_srgb)) {
+      return false;
+    }
+    JXL_ASSIGN_OR_RETURN(comparator_,
+                         ButteraugliComparator::Make(ref_linear_srgb->color(),
+                                                     params_, pool_));
   }
-  JXL_ASSIGN_OR_RETURN(comparator_, ButteraugliComparator::Make(
-                                        ref_linear_srgb->color(), params_));
   xsize_ = ref.xsize();
   ysize_ = ref.ysize();
   intensity_target_ = ref.metadata()->IntensityTarget();
@@ -44,43 +56,51 @@ Status JxlButteraugliComparator::SetReferenceImage(const ImageBundle& ref) {
 
 Status JxlButteraugliComparator::SetLinearReferenceImage(
     const Image3F& linear) {
-  JXL_ASSIGN_OR_RETURN(comparator_,
-                       ButteraugliComparator::Make(linear, params_));
+  reference_ = nullptr;
+  linear_reference_ = nullptr;
+  comparator_.reset();
+  if (tile_size_ != 0) {
+    linear_reference_ = &linear;
+  } else {
+    JXL_ASSIGN_OR_RETURN(comparator_,
+                         ButteraugliComparator::Make(linear, params_, pool_));
+  }
   xsize_ = linear.xsize();
   ysize_ = linear.ysize();
+  intensity_target_ = 0.f;
   return true;
 }
 
 Status JxlButteraugliComparator::CompareWith(const ImageBundle& actual,
                                              ImageF* diffmap, float* score) {
-  if (!comparator_) {
+  if (!comparator_ && !reference_ && !linear_reference_) {
     return JXL_FAILURE("Must set reference image first");
   }
   if (xsize_ != actual.xsize() || ysize_ != actual.ysize()) {
     return JXL_FAILURE("Images must have same size");
   }
+  float scale = 1.0f;
+  if (intensity_target_ != 0 &&
+      actual.metadata()->IntensityTarget() != intensity_target_) {
+    scale = actual.metadata()->IntensityTarget() / intensity_target_;
+  }
+  if (tile_size_ != 0) return CompareTiled(actual, scale, diffmap, score);
   JxlMemoryManager* memory_manager = actual.memory_manager();
 
   const ImageBundle* actual_linear_srgb;
   ImageMetadata metadata = *actual.metadata();
   ImageBundle store(memory_manager, &metadata);
   if (!TransformIfNeeded(actual, ColorEncoding::LinearSRGB(actual.IsGray()),
-                         cms_,
-                         /*pool=*/nullptr, &store, &actual_linear_srgb)) {
+                         cms_, pool_, &store, &actual_linear_srgb)) {
     return false;
   }
 
-  JXL_ASSIGN_OR_RETURN(ImageF temp_diffmap,
-                       ImageF::Create(memory_manager, xsize_, ysize_));
   const Image3F* scaled_actual_linear_srgb = &actual_linear_srgb->color();
   Image3F scaled_actual_linear_srgb_store;
-  if (intensity_target_ != 0 &&
-      actual.metadata()->IntensityTarget() != intensity_target_) {
+  if (scale != 1.0f) {
     scaled_actual_linear_srgb = &scaled_actual_linear_srgb_store;
     JXL_ASSIGN_OR_RETURN(scaled_actual_linear_srgb_store,
                          Image3F::Create(memory_manager, xsize_, ysize_));
-    const float scale =
-        actual.metadata()->IntensityTarget() / intensity_target_;
     for (size_t c = 0; c < 3; ++c) {
       for (size_t y = 0; y < ysize_; ++y) {
         const float* JXL_RESTRICT source_row =
@@ -93,8 +113,11 @@ Status JxlButteraugliComparator::CompareWith(const ImageBundle& actual,
       }
     }
   }
+
+  JXL_ASSIGN_OR_RETURN(ImageF temp_diffmap,
+                       ImageF::Create(memory_manager, xsize_, ysize_));
   JXL_RETURN_IF_ERROR(
-      comparator_->Diffmap(*scaled_actual_linear_srgb, temp_diffmap));
+      comparator_->Diffmap(*scaled_actual_linear_srgb, temp_diffmap, pool_));
 
   if (score != nullptr) {
     *score = ButteraugliScoreFromDiffmap(temp_diffmap, &params_);
@@ -106,6 +129,52 @@ Status JxlButteraugliComparator::CompareWith(const ImageBundle& actual,
   return true;
 }
 
+Status JxlButteraugliComparator::CompareTiled(const ImageBundle& actual,
+                                              float scale, ImageF* diffmap,
+                                              float* score) {
+  JxlMemoryManager* memory_manager = actual.memory_manager();
+  if (diffmap != nullptr) {
+    JXL_ASSIGN_OR_RETURN(*diffmap,
+                         ImageF::Create(memory_manager, xsize_, ysize_));
+  }
+  // Converts rect of ib to linear sRGB, into an image of the size of rect.
+  const auto to_linear = [this](const ImageBundle& ib, const Rect& rect,
+                                Image3F* tile) -> Status {
+    const ColorEncoding& c_linear = ColorEncoding::LinearSRGB(ib.IsGray());
+    if (ib.c_current().SameColorEncoding(c_linear) && !ib.HasBlack()) {
+      return CopyImageTo(rect, ib.color(), Rect(*tile), tile);
+    }
+    return ib.CopyTo(rect, c_linear, cms_, tile, pool_);
+  };
+  const auto source = [&](const Rect& rect, Image3F* tile0,
+                          Image3F* tile1) -> Status {
+    if (linear_reference_ != nullptr) {
+      JXL_RETURN_IF_ERROR(
+          CopyImageTo(rect, *linear_reference_, Rect(*tile0), tile0));
+    } else {
+      JXL_RETURN_IF_ERROR(to_linear(*reference_, rect, tile0));
+    }
+    JXL_RETURN_IF_ERROR(to_linear(actual, rect, tile1));
+    if (scale != 1.0f) ScaleImage(scale, tile1);
+    return true;
+  };
+  ButteraugliScoreAccumulator accumulator;
+  const auto sink = [&](const Rect& rect, const ImageF& tile) -> Status {
+    if (diffmap != nullptr) {
+      JXL_RETURN_IF_ERROR(CopyImageTo(Rect(tile), tile, rect, diffmap));
+    }
+    accumulator.Add(tile);
+    return true;
+  };
+  JXL_RETURN_IF_ERROR(ButteraugliDiffmapTiled(memory_manager, xsize_, ysize_,
+                                              params_, tile_size_, source,
+                                              sink, pool_));
+  if (score != nullptr) {
+    *score = ButteraugliScoreFromAccumulator(accumulator, &params_);
+  }
+  return true;
+}
+
 float JxlButteraugliComparator::GoodQualityScore() const {
   return ButteraugliFuzzyInverse(1.5);
 }
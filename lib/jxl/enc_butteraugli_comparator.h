@@ -11,6 +11,7 @@
 
 #include <memory>
 
+#include "lib/jxl/base/data_parallel.h"
 #include "lib/jxl/base/status.h"
 #include "lib/jxl/butteraugli/butteraugli.h"
 #include "lib/jxl/enc_comparator.h"
@@ -21,8 +22,18 @@ namespace jxl {
 
 class JxlButteraugliComparator : public Comparator {
  public:
+  // If pool is not null, butteraugli runs on it. The comparator must then not
+  // be used while the pool runs other work.
   explicit JxlButteraugliComparator(const ButteraugliParams& params,
-                                    const JxlCmsInterface& cms);
+                                    const JxlCmsInterface& cms,
+                                    ThreadPool* pool = nullptr);
+
+  // If tile_size is not zero, butteraugli is evaluated on tiles of about that
+  // size (see ButteraugliDiffmapTiled), which bounds its temporary memory
+  // without changing the result. Must be called before setting the reference
+  // image. Both images are then converted to linear sRGB tile by tile, and
+  // the reference image is not copied, so it must outlive CompareWith.
+  void SetTileSize(size_t tile_size) { tile_size_ = tile_size; }
 
   Status SetReferenceImage(const ImageBundle& ref) override;
   Status SetLinearReferenceImage(const Image3F& linear);
@@ -34,9 +45,17 @@ class JxlButteraugliComparator : public Comparator {
   float BadQualityScore() const override;
 
  private:
+  Status CompareTiled(const ImageBundle& actual, float scale, ImageF* diffmap,
+                      float* score);
+
   ButteraugliParams params_;
   JxlCmsInterface cms_;
+  ThreadPool* pool_;
+  size_t tile_size_ = 0;
   std::unique_ptr<ButteraugliComparator> comparator_;
+  // Caller's reference image, only used in tiled mode; at most one is set.
+  const ImageBundle* reference_ = nullptr;
+  const Image3F* linear_reference_ = nullptr;
   size_t xsize_ = 0;
   size_t ysize_ = 0;
   float intensity_target_ = 0.f;
@@ -78,20 +78,12 @@ Status InitializePassesEncoder(const FrameHeader& frame_header,
   enc_state->x_qm_multiplier = std::pow(1.25f, frame_header.x_qm_scale - 2.0f);
   enc_state->b_qm_multiplier = std::pow(1.25f, frame_header.b_qm_scale - 2.0f);
 
-  if (enc_state->coeffs.size() < frame_header.passes.num_passes) {
-    enc_state->coeffs.reserve(frame_header.passes.num_passes);
-    for (size_t i = enc_state->coeffs.size();
-         i < frame_header.passes.num_passes; i++) {
-      // Allocate enough coefficients for each group on every row.
-      JXL_ASSIGN_OR_RETURN(
-          std::unique_ptr<ACImageT<int32_t>> coeffs,
-          ACImageT<int32_t>::Make(memory_manager, kGroupDim * kGroupDim,
-                                  shared.frame_dim.num_groups));
-      enc_state->coeffs.emplace_back(std::move(coeffs));
-    }
-  }
-  while (enc_state->coeffs.size() > frame_header.passes.num_passes) {
-    enc_state->coeffs.pop_back();
+  if (!enc_state->coeffs) {
+    // Allocate enough coefficients for each group on every row.
+    JXL_ASSIGN_OR_RETURN(
+        enc_state->coeffs,
+        ACImageT<int32_t>::Make(memory_manager, kGroupDim * kGroupDim,
+                                shared.frame_dim.num_groups));
   }
 
   if (enc_state->initialize_global_state) {
@@ -106,6 +98,10 @@ Status InitializePassesEncoder(const FrameHeader& frame_header,
       Image3F dc, Image3F::Create(memory_manager, shared.frame_dim.xsize_blocks,
                                   shared.frame_dim.ysize_blocks));
   const auto process_group = [&](size_t group_idx, size_t _) -> Status {
+    GroupStats* group_stats =
+        aux_out ? aux_out->frame_group_stats(group_idx) : nullptr;
+    ScopedGroupTimer group_timer(
+        group_stats ? &group_stats->heuristics_seconds : nullptr);
     JXL_RETURN_IF_ERROR(
         ComputeCoefficients(group_idx, enc_state, opsin, rect, &dc));
     return true;
@@ -42,8 +42,9 @@ struct PassesEncoderState {
   bool initialize_global_state = true;
   size_t dc_group_index = 0;
 
-  // Per-pass DCT coefficients for the image. One row per group.
-  std::vector<std::unique_ptr<ACImage>> coeffs;
+  // Quantized DCT coefficients of all passes for the image. One row per
+  // group. Passes are split off while tokenizing each group.
+  std::unique_ptr<ACImage> coeffs;
 
   // Raw data for special (reference+DC) frames.
   std::vector<std::unique_ptr<BitWriter>> special_frames;
@@ -25,6 +25,7 @@
 #include "lib/jxl/enc_ans.h"
 #include "lib/jxl/enc_ans_params.h"
 #include "lib/jxl/enc_bit_writer.h"
+#include "lib/jxl/enc_progressive_split.h"
 #include "lib/jxl/frame_dimensions.h"
 #include "lib/jxl/lehmer_code.h"
 #include "lib/jxl/memory_manager_internal.h"
@@ -69,9 +70,16 @@ Status ComputeCoeffOrder(SpeedTier speed, const ACImage& ac_image,
                          uint32_t& all_used_orders, uint32_t prev_used_acs,
                          uint32_t current_used_acs,
                          uint32_t current_used_orders,
-                         coeff_order_t* JXL_RESTRICT order) {
+                         coeff_order_t* JXL_RESTRICT order,
+                         const ProgressiveSplitter* splitter, size_t pass) {
   JxlMemoryManager* memory_manager = ac_strategy.memory_manager();
   std::vector<int64_t> num_zeros(kCoeffOrderMaxSize);
+  const bool split_passes = splitter && splitter->GetNumPasses() > 1;
+  std::vector<int32_t> pass_block;
+  if (split_passes) {
+    JXL_ENSURE(ac_image.Type() == ACType::k32);
+    pass_block.resize(AcStrategy::kMaxCoeffArea);
+  }
   // If compressing at high speed and only using 8x8 DCTs, only consider a
   // subset of blocks.
   double block_fraction = 1.0f;
@@ -132,8 +140,14 @@ Status ComputeCoeffOrder(SpeedTier speed, const ACImage& ac_image,
                 num_zeros[order_offset + k] += is_zero ? 1 : 0;
               }
             } else {
+              const int32_t* JXL_RESTRICT block = rows[c].ptr32 + ac_offset;
+              if (split_passes) {
+                splitter->SplitACCoefficients(block, acs, pass,
+                                              pass_block.data());
+                block = pass_block.data();
+              }
               for (size_t k = 0; k < size; k++) {
-                bool is_zero = rows[c].ptr32[ac_offset + k] == 0;
+                bool is_zero = block[k] == 0;
                 num_zeros[order_offset + k] += is_zero ? 1 : 0;
               }
             }
@@ -17,6 +17,7 @@
 #include "lib/jxl/common.h"
 #include "lib/jxl/dct_util.h"
 #include "lib/jxl/enc_bit_writer.h"
+#include "lib/jxl/enc_progressive_split.h"
 #include "lib/jxl/frame_dimensions.h"
 
 namespace jxl {
@@ -32,14 +33,18 @@ std::pair<uint32_t, uint32_t> ComputeUsedOrders(
 
 // Modify zig-zag order, so that DCT bands with more zeros go later.
 // Order of DCT bands with same number of zeros is untouched, so
-// permutation will be cheaper to encode.
+// permutation will be cheaper to encode. If `splitter` is not null, `acs`
+// holds the coefficients of all passes and the order is computed for the
+// coefficients of `pass`.
 Status ComputeCoeffOrder(SpeedTier speed, const ACImage& acs,
                          const AcStrategyImage& ac_strategy,
                          const FrameDimensions& frame_dim,
                          uint32_t& all_used_orders, uint32_t prev_used_acs,
                          uint32_t current_used_acs,
                          uint32_t current_used_orders,
-                         coeff_order_t* JXL_RESTRICT order);
+                         coeff_order_t* JXL_RESTRICT order,
+                         const ProgressiveSplitter* splitter = nullptr,
+                         size_t pass = 0);
 
 Status EncodeCoeffOrders(uint16_t used_orders,
                          const coeff_order_t* JXL_RESTRICT order,
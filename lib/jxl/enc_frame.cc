@@ -15,6 +15,7 @@
 #include <cmath>
 #include <cstddef>
 #include <cstdint>
+#include <limits>
 #include <memory>
 #include <numeric>
 #include <utility>
@@ -31,6 +32,7 @@
 #include "lib/jxl/base/rect.h"
 #include "lib/jxl/base/span.h"
 #include "lib/jxl/base/status.h"
+#include "lib/jxl/base/trace.h"
 #include "lib/jxl/chroma_from_luma.h"
 #include "lib/jxl/coeff_order.h"
 #include "lib/jxl/coeff_order_fwd.h"
@@ -781,14 +783,10 @@ Status ComputeJPEGTranscodingData(const jpeg::JPEGData& jpeg_data,
   shared.ac_strategy.FillDCT8();
   FillImage(static_cast<uint8_t>(0), &shared.epf_sharpness);
 
-  enc_state->coeffs.clear();
-  while (enc_state->coeffs.size() < enc_state->passes.size()) {
-    JXL_ASSIGN_OR_RETURN(
-        std::unique_ptr<ACImageT<int32_t>> coeffs,
-        ACImageT<int32_t>::Make(memory_manager, kGroupDim * kGroupDim,
-                                frame_dim.num_groups));
-    enc_state->coeffs.emplace_back(std::move(coeffs));
-  }
+  JXL_ASSIGN_OR_RETURN(
+      enc_state->coeffs,
+      ACImageT<int32_t>::Make(memory_manager, kGroupDim * kGroupDim,
+                              frame_dim.num_groups));
 
   // convert JPEG quantization table to a Quantizer object
   float dcquantization[3];
@@ -939,9 +937,7 @@ Status ComputeJPEGTranscodingData(const jpeg::JPEGData& jpeg_data,
       Image3F dc, Image3F::Create(memory_manager, xsize_blocks, ysize_blocks));
   if (!frame_header.chroma_subsampling.Is444()) {
     ZeroFillImage(&dc);
-    for (auto& coeff : enc_state->coeffs) {
-      coeff->ZeroFill();
-    }
+    enc_state->coeffs->ZeroFill();
   }
   // JPEG DC is from -1024 to 1023.
   std::vector<size_t> dc_counts;
@@ -949,9 +945,7 @@ Status ComputeJPEGTranscodingData(const jpeg::JPEGData& jpeg_data,
   size_t total_dc[3] = {};
   for (size_t c : {1, 0, 2}) {
     if (jpeg_data.components.size() == 1 && c != 1) {
-      for (auto& coeff : enc_state->coeffs) {
-        coeff->ZeroFillPlane(c);
-      }
+      enc_state->coeffs->ZeroFillPlane(c);
       ZeroFillImage(&dc.Plane(c));
       // Ensure no division by 0.
       total_dc[c] = 1;
@@ -964,11 +958,8 @@ Status ComputeJPEGTranscodingData(const jpeg::JPEGData& jpeg_data,
          group_index++) {
       const size_t gx = group_index % frame_dim.xsize_groups;
       const size_t gy = group_index / frame_dim.xsize_groups;
-      int32_t* coeffs[kMaxNumPasses];
-      for (size_t i = 0; i < enc_state->coeffs.size(); i++) {
-        coeffs[i] = enc_state->coeffs[i]->PlaneRow(c, group_index, 0).ptr32;
-      }
-      int32_t block[64];
+      int32_t* JXL_RESTRICT coeffs =
+          enc_state->coeffs->PlaneRow(c, group_index, 0).ptr32;
       for (size_t by = gy * kGroupDimInBlocks;
            by < ysize_blocks && by < (gy + 1) * kGroupDimInBlocks; ++by) {
         if ((by >> vshift) << vshift != by) continue;
@@ -996,7 +987,7 @@ Status ComputeJPEGTranscodingData(const jpeg::JPEGData& jpeg_data,
               !frame_header.chroma_subsampling.Is444()) {
             for (size_t y = 0; y < 8; y++) {
               for (size_t x = 0; x < 8; x++) {
-                block[y * 8 + x] = inputjpeg[base + x * 8 + y];
+                coeffs[y * 8 + x] = inputjpeg[base + x * 8 + y];
               }
             }
           } else {
@@ -1016,16 +1007,11 @@ Status ComputeJPEGTranscodingData(const jpeg::JPEGData& jpeg_data,
                     (Y * coeff_scale + (1 << (kCFLFixedPointPrecision - 1))) >>
                     kCFLFixedPointPrecision;
                 int QCR = QChroma - cfl_factor;
-                block[y * 8 + x] = QCR;
+                coeffs[y * 8 + x] = QCR;
               }
             }
           }
-          enc_state->progressive_splitter.SplitACCoefficients(
-              block, AcStrategy::FromRawStrategy(AcStrategyType::DCT), bx, by,
-              coeffs);
-          for (size_t i = 0; i < enc_state->coeffs.size(); i++) {
-            coeffs[i] += kDCTBlockSize;
-          }
+          coeffs += kDCTBlockSize;
         }
       }
     }
@@ -1138,10 +1124,11 @@ Status ComputeAllCoeffOrders(PassesEncoderState& enc_state,
   enc_state.used_orders.resize(enc_state.progressive_splitter.GetNumPasses());
   for (size_t i = 0; i < enc_state.progressive_splitter.GetNumPasses(); i++) {
     JXL_RETURN_IF_ERROR(ComputeCoeffOrder(
-        enc_state.cparams.speed_tier, *enc_state.coeffs[i],
+        enc_state.cparams.speed_tier, *enc_state.coeffs,
         enc_state.shared.ac_strategy, frame_dim, enc_state.used_orders[i],
         enc_state.used_acs, used_orders_info.first, used_orders_info.second,
-        &enc_state.shared.coeff_orders[i * enc_state.shared.coeff_order_size]));
+        &enc_state.shared.coeff_orders[i * enc_state.shared.coeff_order_size],
+        &enc_state.progressive_splitter, i));
   }
   enc_state.used_acs |= used_orders_info.first;
   return true;
@@ -1150,21 +1137,54 @@ Status ComputeAllCoeffOrders(PassesEncoderState& enc_state,
 // Working area for TokenizeCoefficients (per-group!)
 struct EncCache {
   // Allocates memory when first called.
-  Status InitOnce(JxlMemoryManager* memory_manager) {
+  Status InitOnce(JxlMemoryManager* memory_manager, size_t num_passes) {
     if (num_nzeroes.xsize() == 0) {
       JXL_ASSIGN_OR_RETURN(num_nzeroes,
                            Image3I::Create(memory_manager, kGroupDimInBlocks,
                                            kGroupDimInBlocks));
     }
+    if (num_passes > 1 && !pass_coeffs) {
+      JXL_ASSIGN_OR_RETURN(
+          pass_coeffs,
+          ACImageT<int32_t>::Make(memory_manager, kGroupDim * kGroupDim, 1));
+    }
     return true;
   }
   // TokenizeCoefficients
   Image3I num_nzeroes;
+  // Coefficients of the current pass of the group, if there are several.
+  std::unique_ptr<ACImageT<int32_t>> pass_coeffs;
 };
 
+// Writes the coefficients of `pass` of the group at `rect`, in the order in
+// which TokenizeCoefficients reads them, from `ac_rows` to `pass_rows`.
+void SplitGroupCoefficients(const ProgressiveSplitter& splitter, size_t pass,
+                            const Rect& rect,
+                            const AcStrategyImage& ac_strategy,
+                            const YCbCrChromaSubsampling& cs,
+                            const int32_t* JXL_RESTRICT const* ac_rows,
+                            int32_t* JXL_RESTRICT const* pass_rows) {
+  size_t offset[3] = {};
+  for (size_t by = 0; by < rect.ysize(); ++by) {
+    AcStrategyRow acs_row = ac_strategy.ConstRow(rect, by);
+    for (size_t bx = 0; bx < rect.xsize(); ++bx) {
+      AcStrategy acs = acs_row[bx];
+      if (!acs.IsFirstBlock()) continue;
+      const size_t size = kDCTBlockSize << acs.log2_covered_blocks();
+      for (size_t c = 0; c < 3; c++) {
+        if (((bx >> cs.HShift(c)) << cs.HShift(c)) != bx) continue;
+        if (((by >> cs.VShift(c)) << cs.VShift(c)) != by) continue;
+        splitter.SplitACCoefficients(ac_rows[c] + offset[c], acs, pass,
+                                     pass_rows[c] + offset[c]);
+        offset[c] += size;
+      }
+    }
+  }
+}
+
 Status TokenizeAllCoefficients(const FrameHeader& frame_header,
-                               ThreadPool* pool,
-                               PassesEncoderState* enc_state) {
+                               ThreadPool* pool, PassesEncoderState* enc_state,
+                               AuxOut* aux_out) {
   PassesSharedState& shared = enc_state->shared;
   std::vector<EncCache> group_caches;
   JxlMemoryManager* memory_manager = enc_state->memory_manager();
@@ -1174,21 +1194,43 @@ Status TokenizeAllCoefficients(const FrameHeader& frame_header,
   };
   const auto tokenize_group = [&](const uint32_t group_index,
                                   const size_t thread) -> Status {
+    GroupStats* group_stats =
+        aux_out ? aux_out->frame_group_stats(group_index) : nullptr;
+    ScopedGroupTimer group_timer(
+        group_stats ? &group_stats->tokenization_seconds : nullptr);
     // Tokenize coefficients.
     const Rect rect = shared.frame_dim.BlockGroupRect(group_index);
-    for (size_t idx_pass = 0; idx_pass < enc_state->passes.size(); idx_pass++) {
-      JXL_ENSURE(enc_state->coeffs[idx_pass]->Type() == ACType::k32);
-      const int32_t* JXL_RESTRICT ac_rows[3] = {
-          enc_state->coeffs[idx_pass]->PlaneRow(0, group_index, 0).ptr32,
-          enc_state->coeffs[idx_pass]->PlaneRow(1, group_index, 0).ptr32,
-          enc_state->coeffs[idx_pass]->PlaneRow(2, group_index, 0).ptr32,
-      };
-      // Ensure group cache is initialized.
-      JXL_RETURN_IF_ERROR(group_caches[thread].InitOnce(memory_manager));
+    const size_t num_passes = enc_state->passes.size();
+    JXL_ENSURE(enc_state->coeffs->Type() == ACType::k32);
+    const int32_t* JXL_RESTRICT ac_rows[3] = {
+        enc_state->coeffs->PlaneRow(0, group_index, 0).ptr32,
+        enc_state->coeffs->PlaneRow(1, group_index, 0).ptr32,
+        enc_state->coeffs->PlaneRow(2, group_index, 0).ptr32,
+    };
+    // Ensure group cache is initialized.
+    EncCache& cache = group_caches[thread];
+    JXL_RETURN_IF_ERROR(cache.InitOnce(memory_manager, num_passes));
+    int32_t* JXL_RESTRICT pass_rows[3] = {};
+    const int32_t* JXL_RESTRICT rows[3] = {ac_rows[0], ac_rows[1], ac_rows[2]};
+    if (num_passes > 1) {
+      for (size_t c = 0; c < 3; c++) {
+        pass_rows[c] = cache.pass_coeffs->PlaneRow(c, 0, 0).ptr32;
+        rows[c] = pass_rows[c];
+      }
+    }
+    for (size_t idx_pass = 0; idx_pass < num_passes; idx_pass++) {
+      // Split off the pass here, so that no image of the coefficients of each
+      // pass is needed.
+      if (num_passes > 1) {
+        SplitGroupCoefficients(enc_state->progressive_splitter, idx_pass, rect,
+                               shared.ac_strategy,
+                               frame_header.chroma_subsampling, ac_rows,
+                               pass_rows);
+      }
       JXL_RETURN_IF_ERROR(TokenizeCoefficients(
           &shared.coeff_orders[idx_pass * shared.coeff_order_size], rect,
-          ac_rows, shared.ac_strategy, frame_header.chroma_subsampling,
-          &group_caches[thread].num_nzeroes,
+          rows, shared.ac_strategy, frame_header.chroma_subsampling,
+          &cache.num_nzeroes,
           &enc_state->passes[idx_pass].ac_tokens[group_index], shared.quant_dc,
           shared.raw_quant_field, shared.block_ctx_map));
     }
@@ -1200,6 +1242,72 @@ Status TokenizeAllCoefficients(const FrameHeader& frame_header,
   return true;
 }
 
+BlockSizeClass GetBlockSizeClass(AcStrategyType type) {
+  switch (type) {
+    case AcStrategyType::IDENTITY:
+    case AcStrategyType::DCT2X2:
+    case AcStrategyType::DCT4X4:
+      return BlockSizeClass::Small;
+    case AcStrategyType::DCT4X8:
+    case AcStrategyType::DCT8X4:
+      return BlockSizeClass::Dct4x8;
+    case AcStrategyType::AFV0:
+    case AcStrategyType::AFV1:
+    case AcStrategyType::AFV2:
+    case AcStrategyType::AFV3:
+      return BlockSizeClass::Afv;
+    case AcStrategyType::DCT:
+      return BlockSizeClass::Dct8;
+    case AcStrategyType::DCT8X16:
+    case AcStrategyType::DCT16X8:
+      return BlockSizeClass::Dct8x16;
+    case AcStrategyType::DCT8X32:
+    case AcStrategyType::DCT32X8:
+      return BlockSizeClass::Dct8x32;
+    case AcStrategyType::DCT16X16:
+      return BlockSizeClass::Dct16;
+    case AcStrategyType::DCT16X32:
+    case AcStrategyType::DCT32X16:
+      return BlockSizeClass::Dct16x32;
+    case AcStrategyType::DCT32X32:
+      return BlockSizeClass::Dct32;
+    case AcStrategyType::DCT32X64:
+    case AcStrategyType::DCT64X32:
+      return BlockSizeClass::Dct32x64;
+    default:
+      return BlockSizeClass::Dct64;
+  }
+}
+
+// Fills the AC strategy and quantization field statistics of the groups, once
+// the heuristics are done.
+void ComputeGroupBlockStats(const PassesSharedState& shared, AuxOut* aux_out) {
+  const FrameDimensions& frame_dim = shared.frame_dim;
+  for (size_t group_index = 0; group_index < frame_dim.num_groups;
+       ++group_index) {
+    GroupStats* group_stats = aux_out->frame_group_stats(group_index);
+    if (group_stats == nullptr) return;
+    const Rect rect = frame_dim.BlockGroupRect(group_index);
+    group_stats->min_quant = std::numeric_limits<int>::max();
+    group_stats->max_quant = 0;
+    for (size_t y = 0; y < rect.ysize(); ++y) {
+      AcStrategyRow acs_row = shared.ac_strategy.ConstRow(rect, y);
+      const int32_t* JXL_RESTRICT quant_row =
+          rect.ConstRow(shared.raw_quant_field, y);
+      for (size_t x = 0; x < rect.xsize(); ++x) {
+        AcStrategy acs = acs_row[x];
+        if (acs.IsFirstBlock()) {
+          size_t idx = static_cast<size_t>(GetBlockSizeClass(acs.Strategy()));
+          group_stats->num_blocks[idx]++;
+        }
+        group_stats->min_quant = std::min(group_stats->min_quant, quant_row[x]);
+        group_stats->max_quant = std::max(group_stats->max_quant, quant_row[x]);
+        group_stats->quant_sum += quant_row[x];
+      }
+    }
+  }
+}
+
 Status EncodeGlobalDCInfo(const PassesSharedState& shared, BitWriter* writer,
                           AuxOut* aux_out) {
   // Encode quantizer DC and global scale.
@@ -1298,6 +1406,7 @@ Status EncodeGroups(const FrameHeader& frame_header,
   JxlMemoryManager* memory_manager = shared.memory_manager;
   const FrameDimensions& frame_dim = shared.frame_dim;
   const size_t num_groups = frame_dim.num_groups;
+  JXL_TRACE_SCOPE_ARG("EncodeGroups", "groups", num_groups);
   const size_t num_passes = enc_state->progressive_splitter.GetNumPasses();
   const size_t global_ac_index = frame_dim.num_dc_groups + 1;
   const bool is_small_image =
@@ -1320,6 +1429,7 @@ Status EncodeGroups(const FrameHeader& frame_header,
                                    frame_dim.num_dc_groups));
   };
 
+  ScopedPhaseTimer group_timer(aux_out, EncoderPhase::GroupEncoding);
   if (enc_state->initialize_global_state) {
     if (frame_header.flags & FrameHeader::kPatches) {
       JXL_RETURN_IF_ERROR(PatchDictionaryEncoder::Encode(
@@ -1411,14 +1521,21 @@ Status EncodeGroups(const FrameHeader& frame_header,
                                   resize_aux_outs, process_dc_group,
                                   "EncodeDCGroup"));
   }
+  group_timer.Stop();
   if (frame_header.encoding == FrameEncoding::kVarDCT) {
+    ScopedPhaseTimer timer(aux_out, EncoderPhase::Histograms);
     JXL_RETURN_IF_ERROR(EncodeGlobalACInfo(
         enc_state, get_output(global_ac_index), enc_modular, aux_out));
   }
+  ScopedPhaseTimer ac_group_timer(aux_out, EncoderPhase::GroupEncoding);
 
   const auto process_group = [&](const uint32_t group_index,
                                  const size_t thread) -> Status {
     AuxOut* my_aux_out = aux_outs[thread].get();
+    GroupStats* group_stats =
+        aux_out ? aux_out->frame_group_stats(group_index) : nullptr;
+    ScopedGroupTimer group_timer(
+        group_stats ? &group_stats->encoding_seconds : nullptr);
 
     size_t ac_group_id =
         enc_state->streaming_mode
@@ -1429,6 +1546,7 @@ Status EncodeGroups(const FrameHeader& frame_header,
     for (size_t i = 0; i < num_passes; i++) {
       JXL_DEBUG_V(2, "Encoding AC group %u [abs %" PRIuS "] pass %" PRIuS,
                   group_index, ac_group_id, i);
+      const size_t bits_before = ac_group_code(i, group_index)->BitsWritten();
       if (frame_header.encoding == FrameEncoding::kVarDCT) {
         JXL_RETURN_IF_ERROR(EncodeGroupTokenizedCoefficients(
             group_index, i, enc_state->histogram_idx[group_index], *enc_state,
@@ -1443,6 +1561,10 @@ Status EncodeGroups(const FrameHeader& frame_header,
                   " encoded size is %" PRIuS " bits",
                   group_index, ac_group_id, i,
                   ac_group_code(i, group_index)->BitsWritten());
+      if (group_stats) {
+        group_stats->bits +=
+            ac_group_code(i, group_index)->BitsWritten() - bits_before;
+      }
     }
     return true;
   };
@@ -1470,6 +1592,7 @@ Status ComputeEncodingData(
     std::vector<std::unique_ptr<BitWriter>>* group_codes, AuxOut* aux_out) {
   JXL_ENSURE(x0 + xsize <= frame_data.xsize);
   JXL_ENSURE(y0 + ysize <= frame_data.ysize);
+  JXL_TRACE_SCOPE("ComputeEncodingData");
   JxlMemoryManager* memory_manager = enc_state.memory_manager();
   const FrameHeader& frame_header = mutable_frame_header;
   PassesSharedState& shared = enc_state.shared;
@@ -1543,6 +1666,7 @@ Status ComputeEncodingData(
   }
   ImageF* alpha = alpha_eci ? &extra_channels[alpha_idx] : nullptr;
   ImageF* black = black_eci ? &extra_channels[black_idx] : nullptr;
+  ScopedPhaseTimer input_timer(aux_out, EncoderPhase::Input);
   bool has_interleaved_alpha = false;
   JxlChunkedFrameInputSource input = frame_data.GetInputSource();
   if (!jpeg_data) {
@@ -1619,29 +1743,50 @@ Status ComputeEncodingData(
   if (!enc_state.streaming_mode) {
     group_rect = Rect(color);
   }
+  input_timer.Stop();
 
   if (frame_header.encoding == FrameEncoding::kVarDCT) {
     enc_state.passes.resize(enc_state.progressive_splitter.GetNumPasses());
     for (PassesEncoderState::PassData& pass : enc_state.passes) {
       pass.ac_tokens.resize(shared.frame_dim.num_groups);
     }
-    if (jpeg_data) {
-      JXL_RETURN_IF_ERROR(ComputeJPEGTranscodingData(
-          *jpeg_data, frame_header, pool, &enc_modular, &enc_state));
-    } else {
-      JXL_RETURN_IF_ERROR(ComputeVarDCTEncodingData(
-          frame_header, linear, &color, group_rect, cms, pool, &enc_modular,
-          &enc_state, aux_out));
+    if (aux_out && !enc_state.streaming_mode) {
+      aux_out->StartFrameGroupStats(frame_dim.num_groups);
+      for (size_t i = 0; i < frame_dim.num_groups; ++i) {
+        const Rect rect = frame_dim.GroupRect(i);
+        GroupStats* group_stats = aux_out->frame_group_stats(i);
+        group_stats->x0 = rect.x0();
+        group_stats->y0 = rect.y0();
+        group_stats->xsize = rect.xsize();
+        group_stats->ysize = rect.ysize();
+      }
+    }
+    {
+      ScopedPhaseTimer timer(aux_out, EncoderPhase::Heuristics);
+      if (jpeg_data) {
+        JXL_RETURN_IF_ERROR(ComputeJPEGTranscodingData(
+            *jpeg_data, frame_header, pool, &enc_modular, &enc_state));
+      } else {
+        JXL_RETURN_IF_ERROR(ComputeVarDCTEncodingData(
+            frame_header, linear, &color, group_rect, cms, pool, &enc_modular,
+            &enc_state, aux_out));
+      }
+    }
+    if (aux_out) ComputeGroupBlockStats(shared, aux_out);
+    {
+      ScopedPhaseTimer timer(aux_out, EncoderPhase::CoeffOrders);
+      JXL_RETURN_IF_ERROR(ComputeAllCoeffOrders(enc_state, frame_dim));
     }
-    JXL_RETURN_IF_ERROR(ComputeAllCoeffOrders(enc_state, frame_dim));
     if (!enc_state.streaming_mode) {
       shared.num_histograms = 1;
       enc_state.histogram_idx.resize(frame_dim.num_groups);
     }
+    ScopedPhaseTimer timer(aux_out, EncoderPhase::Tokenization);
     JXL_RETURN_IF_ERROR(
-        TokenizeAllCoefficients(frame_header, pool, &enc_state));
+        TokenizeAllCoefficients(frame_header, pool, &enc_state, aux_out));
   }
 
+  ScopedPhaseTimer modular_timer(aux_out, EncoderPhase::Modular);
   if (cparams.modular_mode || !extra_channels.empty()) {
     JXL_RETURN_IF_ERROR(enc_modular.ComputeEncodingData(
         frame_header, metadata->m, &color, extra_channels, group_rect,
@@ -1666,9 +1811,11 @@ Status ComputeEncodingData(
     mutable_frame_header.UpdateFlag(shared.image_features.splines.HasAny(),
                                     FrameHeader::kSplines);
   }
+  modular_timer.Stop();
 
   JXL_RETURN_IF_ERROR(EncodeGroups(frame_header, &enc_state, &enc_modular, pool,
                                    group_codes, aux_out));
+  if (aux_out) aux_out->StopFrameGroupStats();
   if (enc_state.streaming_mode) {
     const size_t group_index = enc_state.dc_group_index;
     enc_modular.ClearStreamData(ModularStreamId::VarDCTDC(group_index));
@@ -1689,15 +1836,12 @@ Status PermuteGroups(const CompressParams& cparams,
   // Don't permute global DC/AC or DC.
   permutation->resize(frame_dim.num_dc_groups + 2);
   std::iota(permutation->begin(), permutation->end(), 0);
-  std::vector<coeff_order_t> ac_group_order(num_groups);
-  std::iota(ac_group_order.begin(), ac_group_order.end(), 0);
-  size_t group_dim = frame_dim.group_dim;
 
   // The center of the image is either given by parameters or chosen
   // to be the middle of the image by default if center_x, center_y resp.
   // are not provided.
 
-  int64_t imag_cx;
+  size_t imag_cx;
   if (cparams.center_x != static_cast<size_t>(-1)) {
     JXL_RETURN_IF_ERROR(cparams.center_x < frame_dim.xsize);
     imag_cx = cparams.center_x;
@@ -1705,7 +1849,7 @@ Status PermuteGroups(const CompressParams& cparams,
     imag_cx = frame_dim.xsize / 2;
   }
 
-  int64_t imag_cy;
+  size_t imag_cy;
   if (cparams.center_y != static_cast<size_t>(-1)) {
     JXL_RETURN_IF_ERROR(cparams.center_y < frame_dim.ysize);
     imag_cy = cparams.center_y;
@@ -1713,33 +1857,9 @@ Status PermuteGroups(const CompressParams& cparams,
     imag_cy = frame_dim.ysize / 2;
   }
 
-  // The center of the group containing the center of the image.
-  int64_t cx = (imag_cx / group_dim) * group_dim + group_dim / 2;
-  int64_t cy = (imag_cy / group_dim) * group_dim + group_dim / 2;
-  // This identifies in what area of the central group the center of the image
-  // lies in.
-  double direction = -std::atan2(imag_cy - cy, imag_cx - cx);
-  // This identifies the side of the central group the center of the image
-  // lies closest to. This can take values 0, 1, 2, 3 corresponding to left,
-  // bottom, right, top.
-  int64_t side = std::fmod((direction + 5 * kPi / 4), 2 * kPi) * 2 / kPi;
-  auto get_distance_from_center = [&](size_t gid) {
-    Rect r = frame_dim.GroupRect(gid);
-    int64_t gcx = r.x0() + group_dim / 2;
-    int64_t gcy = r.y0() + group_dim / 2;
-    int64_t dx = gcx - cx;
-    int64_t dy = gcy - cy;
-    // The angle is determined by taking atan2 and adding an appropriate
-    // starting point depending on the side we want to start on.
-    double angle = std::remainder(
-        std::atan2(dy, dx) + kPi / 4 + side * (kPi / 2), 2 * kPi);
-    // Concentric squares in clockwise order.
-    return std::make_pair(std::max(std::abs(dx), std::abs(dy)), angle);
-  };
-  std::sort(ac_group_order.begin(), ac_group_order.end(),
-            [&](coeff_order_t a, coeff_order_t b) {
-              return get_distance_from_center(a) < get_distance_from_center(b);
-            });
+  std::vector<coeff_order_t> ac_group_order =
+      CenterFirstOrder(frame_dim.xsize_groups, frame_dim.ysize_groups,
+                       frame_dim.group_dim, imag_cx, imag_cy);
   std::vector<coeff_order_t> inv_ac_group_order(ac_group_order.size(), 0);
   for (size_t i = 0; i < ac_group_order.size(); i++) {
     inv_ac_group_order[ac_group_order[i]] = i;
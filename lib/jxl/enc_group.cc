@@ -12,6 +12,7 @@
 #include <cstddef>
 #include <cstdint>
 #include <cstdlib>
+#include <cstring>
 
 #include "lib/jxl/base/common.h"
 #include "lib/jxl/base/status.h"
@@ -31,7 +32,7 @@
 #include "lib/jxl/base/bits.h"
 #include "lib/jxl/base/compiler_specific.h"
 #include "lib/jxl/base/rect.h"
-#include "lib/jxl/common.h"  // kMaxNumPasses
+#include "lib/jxl/common.h"
 #include "lib/jxl/dct_util.h"
 #include "lib/jxl/dec_transforms-inl.h"
 #include "lib/jxl/enc_aux_out.h"
@@ -421,15 +422,11 @@ Status ComputeCoefficients(size_t group_idx, PassesEncoderState* enc_state,
     const bool error_diffusion = cparams.speed_tier <= SpeedTier::kSquirrel;
     constexpr HWY_CAPPED(float, kDCTBlockSize) d;
 
-    int32_t* JXL_RESTRICT coeffs[3][kMaxNumPasses] = {};
-    size_t num_passes = enc_state->progressive_splitter.GetNumPasses();
-    JXL_ENSURE(num_passes > 0);
-    for (size_t i = 0; i < num_passes; i++) {
-      // TODO(veluca): 16-bit quantized coeffs are not implemented yet.
-      JXL_ENSURE(enc_state->coeffs[i]->Type() == ACType::k32);
-      for (size_t c = 0; c < 3; c++) {
-        coeffs[c][i] = enc_state->coeffs[i]->PlaneRow(c, group_idx, 0).ptr32;
-      }
+    // TODO(veluca): 16-bit quantized coeffs are not implemented yet.
+    JXL_ENSURE(enc_state->coeffs->Type() == ACType::k32);
+    int32_t* JXL_RESTRICT coeffs[3] = {};
+    for (size_t c = 0; c < 3; c++) {
+      coeffs[c] = enc_state->coeffs->PlaneRow(c, group_idx, 0).ptr32;
     }
 
     HWY_ALIGN float* coeffs_in = fmem.address<float>();
@@ -514,11 +511,8 @@ Status ComputeCoefficients(size_t group_idx, PassesEncoderState* enc_state,
           }
           row_quant_ac[bx] = quant_ac;
           for (size_t c = 0; c < 3; c++) {
-            enc_state->progressive_splitter.SplitACCoefficients(
-                quantized + c * size, acs, bx, by, coeffs[c]);
-            for (size_t p = 0; p < num_passes; p++) {
-              coeffs[c][p] += size;
-            }
+            memcpy(coeffs[c], quantized + c * size, size * sizeof(int32_t));
+            coeffs[c] += size;
           }
         }
       }
@@ -42,6 +42,7 @@
 #include "lib/jxl/dec_xyb.h"
 #include "lib/jxl/enc_ac_strategy.h"
 #include "lib/jxl/enc_adaptive_quantization.h"
+#include "lib/jxl/enc_aux_out.h"
 #include "lib/jxl/enc_cache.h"
 #include "lib/jxl/enc_chroma_from_luma.h"
 #include "lib/jxl/enc_gaborish.h"
@@ -775,9 +776,9 @@ Status DownsampleImage2_Iterative(Image3F* opsin) {
   return true;
 }
 
-StatusOr<Image3F> ReconstructImage(
-    const FrameHeader& orig_frame_header, const PassesSharedState& shared,
-    const std::vector<std::unique_ptr<ACImage>>& coeffs, ThreadPool* pool) {
+StatusOr<Image3F> ReconstructImage(const FrameHeader& orig_frame_header,
+                                   const PassesSharedState& shared,
+                                   const ACImage& coeffs, ThreadPool* pool) {
   const FrameDimensions& frame_dim = shared.frame_dim;
   JxlMemoryManager* memory_manager = shared.memory_manager;
 
@@ -930,7 +931,7 @@ Status ComputeARHeuristics(const FrameHeader& frame_header,
     FillPlane(val, &epf_sharpness, Rect(epf_sharpness));
     JXL_ASSIGN_OR_RETURN(
         Image3F decoded,
-        ReconstructImage(frame_header, shared, enc_state->coeffs, pool));
+        ReconstructImage(frame_header, shared, *enc_state->coeffs, pool));
     JXL_ASSIGN_OR_RETURN(error_images[val],
                          ImageF::Create(memory_manager, frame_dim.xsize_blocks,
                                         frame_dim.ysize_blocks));
@@ -1152,7 +1153,12 @@ Status LossyFrameHeuristics(const FrameHeader& frame_header,
                                           initial_quant_masking,
                                           initial_quant_masking1x1, &matrices));
 
+  // Tiles never straddle groups, but several tiles of a group may be processed
+  // concurrently, so their times are only added to the group stats afterwards.
+  const bool group_stats = aux_out && aux_out->frame_group_stats(0);
+  std::vector<double> tile_seconds;
   auto process_tile = [&](const uint32_t tid, const size_t thread) -> Status {
+    ScopedGroupTimer tile_timer(group_stats ? &tile_seconds[tid] : nullptr);
     size_t n_enc_tiles = DivCeil(frame_dim.xsize_blocks, kEncTileDimInBlocks);
     size_t tx = tid % n_enc_tiles;
     size_t ty = tid / n_enc_tiles;
@@ -1196,6 +1202,7 @@ Status LossyFrameHeuristics(const FrameHeader& frame_header,
   };
   size_t num_tiles = DivCeil(frame_dim.xsize_blocks, kEncTileDimInBlocks) *
                      DivCeil(frame_dim.ysize_blocks, kEncTileDimInBlocks);
+  if (group_stats) tile_seconds.resize(num_tiles);
   const auto prepare = [&](const size_t num_threads) -> Status {
     JXL_RETURN_IF_ERROR(acs_heuristics.PrepareForThreads(num_threads));
     JXL_RETURN_IF_ERROR(cfl_heuristics.PrepareForThreads(num_threads));
@@ -1203,6 +1210,18 @@ Status LossyFrameHeuristics(const FrameHeader& frame_header,
   };
   JXL_RETURN_IF_ERROR(
       RunOnPool(pool, 0, num_tiles, prepare, process_tile, "Enc Heuristics"));
+  if (group_stats) {
+    const size_t n_enc_tiles =
+        DivCeil(frame_dim.xsize_blocks, kEncTileDimInBlocks);
+    const size_t tiles_per_group = frame_dim.group_dim / kEncTileDim;
+    for (size_t tid = 0; tid < num_tiles; ++tid) {
+      size_t gx = tid % n_enc_tiles / tiles_per_group;
+      size_t gy = tid / n_enc_tiles / tiles_per_group;
+      GroupStats* stats =
+          aux_out->frame_group_stats(gy * frame_dim.xsize_groups + gx);
+      if (stats) stats->heuristics_seconds += tile_seconds[tid];
+    }
+  }
 
   JXL_RETURN_IF_ERROR(acs_heuristics.Finalize(frame_dim, ac_strategy, aux_out));
 
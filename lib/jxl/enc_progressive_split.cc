@@ -18,9 +18,10 @@
 namespace jxl {
 
 template <typename T>
-void ProgressiveSplitter::SplitACCoefficients(
-    const T* JXL_RESTRICT block, const AcStrategy& acs, size_t bx, size_t by,
-    T* JXL_RESTRICT output[kMaxNumPasses]) {
+void ProgressiveSplitter::SplitACCoefficients(const T* JXL_RESTRICT block,
+                                              const AcStrategy& acs,
+                                              size_t pass,
+                                              T* JXL_RESTRICT output) const {
   size_t size = acs.covered_blocks_x() * acs.covered_blocks_y() * kDCTBlockSize;
   auto shift_right_round0 = [&](T v, int shift) {
     T one_if_negative = static_cast<uint32_t>(v) >> 31;
@@ -29,55 +30,56 @@ void ProgressiveSplitter::SplitACCoefficients(
   };
   // Early quit for the simple case of only one pass.
   if (mode_.num_passes == 1) {
-    memcpy(output[0], block, sizeof(T) * size);
+    memcpy(output, block, sizeof(T) * size);
     return;
   }
   size_t ncoeffs_all_done_from_earlier_passes = 1;
-
-  int previous_pass_shift = 0;
-  for (size_t num_pass = 0; num_pass < mode_.num_passes; num_pass++) {  // pass
-    // Zero out output block.
-    memset(output[num_pass], 0, size * sizeof(T));
-    const int pass_shift = mode_.passes[num_pass].shift;
-    size_t frame_ncoeffs = mode_.passes[num_pass].num_coefficients;
-    size_t xsize = acs.covered_blocks_x();
-    size_t ysize = acs.covered_blocks_y();
-    CoefficientLayout(&ysize, &xsize);
-    for (size_t y = 0; y < ysize * frame_ncoeffs; y++) {    // superblk-y
-      for (size_t x = 0; x < xsize * frame_ncoeffs; x++) {  // superblk-x
-        size_t pos = y * xsize * kBlockDim + x;
-        if (x < xsize * ncoeffs_all_done_from_earlier_passes &&
-            y < ysize * ncoeffs_all_done_from_earlier_passes) {
-          // This coefficient was already included in an earlier pass,
-          // which included a genuinely smaller set of coefficients.
-          continue;
-        }
-        T v = block[pos];
-        // Previous pass discarded some bits: do not encode them again.
-        if (previous_pass_shift != 0) {
-          T previous_v = shift_right_round0(v, previous_pass_shift) *
-                         (1 << previous_pass_shift);
-          v -= previous_v;
-        }
-        output[num_pass][pos] = shift_right_round0(v, pass_shift);
-      }  // superblk-x
-    }  // superblk-y
-    // We just finished a pass.
-    // Hence, we are now guaranteed to have included all coeffs up to
-    // frame_ncoeffs in every block, unless the current pass is shifted.
+  for (size_t num_pass = 0; num_pass < pass; num_pass++) {
+    // We are guaranteed to have included all coeffs up to num_coefficients
+    // in every block after an earlier pass, unless it was shifted.
     if (mode_.passes[num_pass].shift == 0) {
-      ncoeffs_all_done_from_earlier_passes = frame_ncoeffs;
+      ncoeffs_all_done_from_earlier_passes =
+          mode_.passes[num_pass].num_coefficients;
     }
-    previous_pass_shift = mode_.passes[num_pass].shift;
-  }  // num_pass
+  }
+
+  // Zero out output block.
+  memset(output, 0, size * sizeof(T));
+  const int pass_shift = mode_.passes[pass].shift;
+  size_t frame_ncoeffs = mode_.passes[pass].num_coefficients;
+  size_t xsize = acs.covered_blocks_x();
+  size_t ysize = acs.covered_blocks_y();
+  CoefficientLayout(&ysize, &xsize);
+  for (size_t y = 0; y < ysize * frame_ncoeffs; y++) {    // superblk-y
+    for (size_t x = 0; x < xsize * frame_ncoeffs; x++) {  // superblk-x
+      size_t pos = y * xsize * kBlockDim + x;
+      if (x < xsize * ncoeffs_all_done_from_earlier_passes &&
+          y < ysize * ncoeffs_all_done_from_earlier_passes) {
+        // This coefficient was already included in an earlier pass,
+        // which included a genuinely smaller set of coefficients.
+        continue;
+      }
+      T v = block[pos];
+      // Earlier passes that covered this coefficient may have discarded some
+      // bits: only encode what they left out. A shifted pass can be followed
+      // by one with more coefficients, so this depends on the position.
+      for (size_t num_pass = 0; num_pass < pass; num_pass++) {
+        const size_t ncoeffs = mode_.passes[num_pass].num_coefficients;
+        if (x >= xsize * ncoeffs || y >= ysize * ncoeffs) continue;
+        const int shift = mode_.passes[num_pass].shift;
+        v -= shift_right_round0(v, shift) * (1 << shift);
+      }
+      output[pos] = shift_right_round0(v, pass_shift);
+    }  // superblk-x
+  }  // superblk-y
 }
 
 template void ProgressiveSplitter::SplitACCoefficients<int32_t>(
-    const int32_t* JXL_RESTRICT, const AcStrategy&, size_t, size_t,
-    int32_t* JXL_RESTRICT[kMaxNumPasses]);
+    const int32_t* JXL_RESTRICT, const AcStrategy&, size_t,
+    int32_t* JXL_RESTRICT) const;
 
 template void ProgressiveSplitter::SplitACCoefficients<int16_t>(
-    const int16_t* JXL_RESTRICT, const AcStrategy&, size_t, size_t,
-    int16_t* JXL_RESTRICT[kMaxNumPasses]);
+    const int16_t* JXL_RESTRICT, const AcStrategy&, size_t,
+    int16_t* JXL_RESTRICT) const;
 
 }  // namespace jxl
@@ -103,22 +103,25 @@ class ProgressiveSplitter {
     return true;
   }
 
+  // Writes the part of the AC coefficients of `block` that is encoded in
+  // `pass` to `output`. The passes add up to `block` if the last one keeps all
+  // coefficients without shift, so the encoder only stores `block` and calls
+  // this when tokenizing each pass.
   template <typename T>
   void SplitACCoefficients(const T* JXL_RESTRICT block, const AcStrategy& acs,
-                           size_t bx, size_t by,
-                           T* JXL_RESTRICT output[kMaxNumPasses]);
+                           size_t pass, T* JXL_RESTRICT output) const;
 
  private:
   ProgressiveMode mode_;
 };
 
 extern template void ProgressiveSplitter::SplitACCoefficients<int32_t>(
-    const int32_t* JXL_RESTRICT, const AcStrategy&, size_t, size_t,
-    int32_t* JXL_RESTRICT[kMaxNumPasses]);
+    const int32_t* JXL_RESTRICT, const AcStrategy&, size_t,
+    int32_t* JXL_RESTRICT) const;
 
 extern template void ProgressiveSplitter::SplitACCoefficients<int16_t>(
-    const int16_t* JXL_RESTRICT, const AcStrategy&, size_t, size_t,
-    int16_t* JXL_RESTRICT[kMaxNumPasses]);
+    const int16_t* JXL_RESTRICT, const AcStrategy&, size_t,
+    int16_t* JXL_RESTRICT) const;
 
 }  // namespace jxl
 
@@ -5,8 +5,14 @@
 
 #include "lib/jxl/enc_toc.h"
 
+#include <algorithm>
+#include <cmath>
 #include <cstddef>
+#include <cstdint>
+#include <cstdlib>
 #include <memory>
+#include <numeric>
+#include <utility>
 #include <vector>
 
 #include "lib/jxl/base/common.h"
@@ -49,4 +55,42 @@ Status WriteGroupOffsets(
       });
 }
 
+std::vector<coeff_order_t> CenterFirstOrder(size_t xsize_cells,
+                                            size_t ysize_cells,
+                                            size_t cell_dim, size_t center_x,
+                                            size_t center_y) {
+  std::vector<coeff_order_t> order(xsize_cells * ysize_cells);
+  std::iota(order.begin(), order.end(), 0);
+  const int64_t dim = cell_dim;
+  const int64_t imag_cx = center_x;
+  const int64_t imag_cy = center_y;
+
+  // The center of the cell containing the center of the image.
+  int64_t cx = (imag_cx / dim) * dim + dim / 2;
+  int64_t cy = (imag_cy / dim) * dim + dim / 2;
+  // This identifies in what area of the central cell the center of the image
+  // lies in.
+  double direction = -std::atan2(imag_cy - cy, imag_cx - cx);
+  // This identifies the side of the central cell the center of the image
+  // lies closest to. This can take values 0, 1, 2, 3 corresponding to left,
+  // bottom, right, top.
+  int64_t side = std::fmod((direction + 5 * kPi / 4), 2 * kPi) * 2 / kPi;
+  auto get_distance_from_center = [&](size_t index) {
+    int64_t gcx = (index % xsize_cells) * dim + dim / 2;
+    int64_t gcy = (index / xsize_cells) * dim + dim / 2;
+    int64_t dx = gcx - cx;
+    int64_t dy = gcy - cy;
+    // The angle is determined by taking atan2 and adding an appropriate
+    // starting point depending on the side we want to start on.
+    double angle = std::remainder(
+        std::atan2(dy, dx) + kPi / 4 + side * (kPi / 2), 2 * kPi);
+    // Concentric squares in clockwise order.
+    return std::make_pair(std::max(std::abs(dx), std::abs(dy)), angle);
+  };
+  std::sort(order.begin(), order.end(), [&](coeff_order_t a, coeff_order_t b) {
+    return get_distance_from_center(a) < get_distance_from_center(b);
+  });
+  return order;
+}
+
 }  // namespace jxl
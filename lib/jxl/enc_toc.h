@@ -6,6 +6,7 @@
 #ifndef LIB_JXL_ENC_TOC_H_
 #define LIB_JXL_ENC_TOC_H_
 
+#include <cstddef>
 #include <memory>
 #include <vector>
 
@@ -25,6 +26,15 @@ Status WriteGroupOffsets(
     const std::vector<coeff_order_t>& permutation,
     BitWriter* JXL_RESTRICT writer, AuxOut* aux_out);
 
+// Returns the indices of the cells of a grid of `xsize_cells` x `ysize_cells`
+// square cells of `cell_dim` pixels, e.g. groups, in concentric squares around
+// the cell that contains the pixel (center_x, center_y), in clockwise order
+// and starting from the side of that cell closest to the pixel.
+std::vector<coeff_order_t> CenterFirstOrder(size_t xsize_cells,
+                                            size_t ysize_cells,
+                                            size_t cell_dim, size_t center_x,
+                                            size_t center_y);
+
 }  // namespace jxl
 
 #endif  // LIB_JXL_ENC_TOC_H_
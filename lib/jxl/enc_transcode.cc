@@ -0,0 +1,1250 @@
+// Copyright (c) the JPEG XL Project Authors. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#include "lib/jxl/enc_transcode.h"
+
+#include <jxl/memory_manager.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+#include "lib/jxl/base/bits.h"
+#include "lib/jxl/base/common.h"
+#include "lib/jxl/base/data_parallel.h"
+#include "lib/jxl/base/printf_macros.h"
+#include "lib/jxl/base/rect.h"
+#include "lib/jxl/base/span.h"
+#include "lib/jxl/base/status.h"
+#include "lib/jxl/coeff_order.h"
+#include "lib/jxl/coeff_order_fwd.h"
+#include "lib/jxl/common.h"
+#include "lib/jxl/dec_bit_reader.h"
+#include "lib/jxl/dec_cache.h"
+#include "lib/jxl/dec_frame.h"
+#include "lib/jxl/dec_modular.h"
+#include "lib/jxl/enc_ans.h"
+#include "lib/jxl/enc_ans_params.h"
+#include "lib/jxl/enc_aux_out.h"
+#include "lib/jxl/enc_bit_writer.h"
+#include "lib/jxl/enc_coeff_order.h"
+#include "lib/jxl/enc_entropy_coder.h"
+#include "lib/jxl/enc_fields.h"
+#include "lib/jxl/enc_icc_codec.h"
+#include "lib/jxl/enc_toc.h"
+#include "lib/jxl/fields.h"
+#include "lib/jxl/frame_dimensions.h"
+#include "lib/jxl/frame_header.h"
+#include "lib/jxl/headers.h"
+#include "lib/jxl/icc_codec.h"
+#include "lib/jxl/image.h"
+#include "lib/jxl/image_bundle.h"
+#include "lib/jxl/image_metadata.h"
+#include "lib/jxl/modular/encoding/dec_ma.h"
+#include "lib/jxl/modular/encoding/enc_ma.h"
+#include "lib/jxl/modular/encoding/encoding.h"
+#include "lib/jxl/modular/encoding/ma_common.h"
+#include "lib/jxl/modular/options.h"
+#include "lib/jxl/padded_bytes.h"
+#include "lib/jxl/passes_state.h"
+#include "lib/jxl/quant_weights.h"
+#include "lib/jxl/toc.h"
+
+namespace jxl {
+namespace {
+
+// Appends bits [begin, end) of `data` to `writer`.
+Status CopyBits(Span<const uint8_t> data, size_t begin, size_t end,
+                LayerType layer, BitWriter* writer) {
+  JXL_ENSURE(begin <= end && end <= data.size() * kBitsPerByte);
+  if (begin == end) return true;
+  Status ret = true;
+  {
+    BitReader reader(data);
+    BitReaderScopedCloser reader_closer(reader, ret);
+    reader.SkipBits(begin);
+    JXL_RETURN_IF_ERROR(writer->WithMaxBits(end - begin, layer, nullptr, [&] {
+      for (size_t pos = begin; pos < end;) {
+        size_t n = std::min<size_t>(end - pos, 32);
+        writer->Write(n, reader.ReadBits(n));
+        pos += n;
+      }
+      return true;
+    }));
+  }
+  return ret;
+}
+
+// Pads `writer` with zero bits to a byte boundary. Like every write, the
+// padding needs a bit allotment.
+Status PadToByte(LayerType layer, BitWriter* writer) {
+  return writer->WithMaxBits(kBitsPerByte, layer, nullptr, [&] {
+    writer->ZeroPadToByte();
+    return true;
+  });
+}
+
+// Reads the image headers, up to the first frame, whose offset is returned in
+// `frames_begin`.
+Status ReadHeaders(JxlMemoryManager* memory_manager,
+                   Span<const uint8_t> codestream, CodecMetadata* metadata,
+                   size_t* frames_begin) {
+  Status ret = true;
+  {
+    BitReader reader(codestream);
+    BitReaderScopedCloser reader_closer(reader, ret);
+    if (reader.ReadFixedBits<16>() != 0x0AFF) {
+      return JXL_FAILURE("Not a JPEG XL codestream");
+    }
+    JXL_RETURN_IF_ERROR(ReadSizeHeader(&reader, &metadata->size));
+    JXL_RETURN_IF_ERROR(ReadImageMetadata(&reader, &metadata->m));
+    metadata->transform_data.nonserialized_xyb_encoded =
+        metadata->m.xyb_encoded;
+    JXL_RETURN_IF_ERROR(Bundle::Read(&reader, &metadata->transform_data));
+    if (metadata->m.color_encoding.WantICC()) {
+      ICCReader icc_reader{memory_manager};
+      PaddedBytes decoded_icc{memory_manager};
+      JXL_RETURN_IF_ERROR(icc_reader.Init(&reader));
+      JXL_RETURN_IF_ERROR(icc_reader.Process(&reader, &decoded_icc));
+      IccBytes icc;
+      Bytes(decoded_icc).AppendTo(icc);
+      metadata->m.color_encoding.SetICCRaw(std::move(icc));
+    }
+    JXL_RETURN_IF_ERROR(reader.JumpToByteBoundary());
+    JXL_RETURN_IF_ERROR(reader.AllReadsWithinBounds());
+    *frames_begin = reader.TotalBitsConsumed() / kBitsPerByte;
+  }
+  return ret;
+}
+
+// Writes the image headers of `metadata`, up to the first frame.
+Status WriteHeaders(CodecMetadata* metadata, BitWriter* writer) {
+  JXL_RETURN_IF_ERROR(WriteCodestreamHeaders(metadata, writer, nullptr));
+  if (metadata->m.color_encoding.WantICC()) {
+    JXL_RETURN_IF_ERROR(WriteICC(Bytes(metadata->m.color_encoding.ICC()),
+                                 writer, LayerType::Header, nullptr));
+  }
+  return PadToByte(LayerType::Header, writer);
+}
+
+// A frame of the input, as split by ReadFrameSections.
+struct FrameSections {
+  explicit FrameSections(const CodecMetadata* metadata) : header(metadata) {}
+
+  FrameHeader header;
+  // Number of bits of the frame header, which the TOC follows.
+  size_t header_bits = 0;
+  std::vector<FrameDecoder::TocEntry> toc;
+  // In file order.
+  std::vector<Span<const uint8_t>> sections;
+  // Number of bytes of the whole frame.
+  size_t size = 0;
+};
+
+// Reads the header and the TOC of one frame, without decoding the sections.
+Status ReadFrameSections(JxlMemoryManager* memory_manager,
+                         Span<const uint8_t> data, bool is_preview,
+                         FrameSections* frame) {
+  std::vector<uint32_t> sizes;
+  std::vector<coeff_order_t> permutation;
+  size_t sections_begin;
+  Status ret = true;
+  {
+    BitReader reader(data);
+    BitReaderScopedCloser reader_closer(reader, ret);
+    frame->header.nonserialized_is_preview = is_preview;
+    JXL_RETURN_IF_ERROR(ReadFrameHeader(&reader, &frame->header));
+    frame->header_bits = reader.TotalBitsConsumed();
+    const FrameDimensions frame_dim = frame->header.ToFrameDimensions();
+    const size_t toc_entries =
+        NumTocEntries(frame_dim.num_groups, frame_dim.num_dc_groups,
+                      frame->header.passes.num_passes);
+    JXL_RETURN_IF_ERROR(
+        ReadToc(memory_manager, toc_entries, &reader, &sizes, &permutation));
+    JXL_RETURN_IF_ERROR(reader.AllReadsWithinBounds());
+    sections_begin = reader.TotalBitsConsumed() / kBitsPerByte;
+  }
+  JXL_RETURN_IF_ERROR(ret);
+
+  frame->toc.resize(sizes.size());
+  frame->sections.clear();
+  size_t pos = sections_begin;
+  for (size_t i = 0; i < sizes.size(); i++) {
+    frame->toc[i].size = sizes[i];
+    frame->toc[permutation.empty() ? i : permutation[i]].id = i;
+    if (pos + sizes[i] > data.size()) {
+      return JXL_FAILURE("Frame is truncated");
+    }
+    frame->sections.emplace_back(data.data() + pos, sizes[i]);
+    pos += sizes[i];
+  }
+  frame->size = pos;
+  return true;
+}
+
+// Sections of a frame that DecodeFrameSections decodes.
+enum class SectionsToDecode {
+  // DC global, e.g. for the patches.
+  kDCGlobal,
+  // DC global, the DC groups, which the AC global section depends on, and AC
+  // global. The AC groups only if they hold modular streams, which follow the
+  // VarDCT data.
+  kGlobals,
+  // All of them, e.g. for the coefficients.
+  kAll,
+};
+
+// Decodes the given sections of `frame`, as split by ReadFrameSections,
+// recording the positions of the AC and modular data in `ac_capture` and
+// `modular_capture` if not null. A frame that has a single section is always
+// decoded whole.
+Status DecodeFrameSections(const CodecMetadata& metadata,
+                           Span<const uint8_t> data,
+                           const FrameSections& frame, SectionsToDecode which,
+                           ThreadPool* pool, PassesDecoderState* dec_state,
+                           ACCapture* ac_capture,
+                           ModularCapture* modular_capture) {
+  JxlMemoryManager* memory_manager = dec_state->memory_manager();
+  FrameDecoder frame_decoder(dec_state, metadata, pool,
+                             /*use_slow_rendering_pipeline=*/false);
+  ImageBundle decoded(memory_manager, &metadata.m);
+  {
+    Status ret = true;
+    {
+      BitReader reader(data);
+      BitReaderScopedCloser reader_closer(reader, ret);
+      JXL_RETURN_IF_ERROR(frame_decoder.InitFrame(
+          &reader, &decoded, frame.header.nonserialized_is_preview));
+      JXL_RETURN_IF_ERROR(frame_decoder.InitFrameOutput());
+    }
+    JXL_RETURN_IF_ERROR(ret);
+  }
+  const std::vector<FrameDecoder::TocEntry>& toc = frame.toc;
+  JXL_ENSURE(frame_decoder.Toc().size() == toc.size());
+  const size_t ac_global_index = dec_state->shared->frame_dim.num_dc_groups + 1;
+
+  // Decodes the sections whose logical index is in [begin, end).
+  const auto process = [&](size_t begin, size_t end) -> Status {
+    Status close_ok = true;
+    {
+      std::vector<std::unique_ptr<BitReader>> section_readers;
+      std::vector<std::unique_ptr<BitReaderScopedCloser>> section_closers;
+      std::vector<FrameDecoder::SectionInfo> section_info;
+      for (size_t i = 0; i < toc.size(); i++) {
+        if (toc.size() > 1 && (toc[i].id < begin || toc[i].id >= end)) {
+          continue;
+        }
+        auto br = jxl::make_unique<BitReader>(frame.sections[i]);
+        section_info.emplace_back(
+            FrameDecoder::SectionInfo{br.get(), toc[i].id, i});
+        section_closers.emplace_back(
+            jxl::make_unique<BitReaderScopedCloser>(*br, close_ok));
+        section_readers.emplace_back(std::move(br));
+      }
+      std::vector<FrameDecoder::SectionStatus> section_status(
+          section_info.size());
+      JXL_RETURN_IF_ERROR(frame_decoder.ProcessSections(
+          section_info.data(), section_info.size(), section_status.data()));
+      for (const auto& s : section_status) {
+        JXL_RETURN_IF_ERROR(s == FrameDecoder::kDone);
+      }
+    }
+    return close_ok;
+  };
+
+  dec_state->ac_capture = ac_capture;
+  dec_state->modular_capture = modular_capture;
+  Status status = [&]() -> Status {
+    if (which == SectionsToDecode::kAll) return process(0, toc.size());
+    // The other sections of modular frames hold nothing that the captures
+    // record; their streams start the sections, see CropFrame.
+    if (which == SectionsToDecode::kDCGlobal ||
+        frame.header.encoding == FrameEncoding::kModular) {
+      return process(0, 1);
+    }
+    JXL_RETURN_IF_ERROR(process(0, ac_global_index + 1));
+    bool has_ac_group_channels = false;
+    if (modular_capture) {
+      for (const auto& shift : modular_capture->channel_shifts) {
+        has_ac_group_channels |= std::min(shift.first, shift.second) < 3;
+      }
+    }
+    if (has_ac_group_channels) {
+      JXL_RETURN_IF_ERROR(process(ac_global_index + 1, toc.size()));
+    }
+    return true;
+  }();
+  dec_state->ac_capture = nullptr;
+  dec_state->modular_capture = nullptr;
+  JXL_RETURN_IF_ERROR(status);
+  if (which == SectionsToDecode::kAll) {
+    JXL_RETURN_IF_ERROR(frame_decoder.FinalizeFrame());
+  }
+  return true;
+}
+
+// Appends the TOC and the sections of a frame to `writer`, which ends with the
+// frame header. `file_codes` are the byte-aligned sections in file order, and
+// `permutation` maps the logical index of each section to its position in the
+// file.
+Status WriteTocAndSections(
+    const std::vector<std::unique_ptr<BitWriter>>& file_codes,
+    std::vector<coeff_order_t> permutation, BitWriter* writer) {
+  bool is_permuted = false;
+  for (size_t i = 0; i < permutation.size(); i++) {
+    is_permuted |= permutation[i] != i;
+  }
+  if (!is_permuted) permutation.clear();
+  JXL_RETURN_IF_ERROR(
+      WriteGroupOffsets(file_codes, permutation, writer, nullptr));
+  return writer->AppendByteAligned(file_codes);
+}
+
+// Entropy codes the captured coefficients of a VarDCT frame again. The result
+// is the frame, including its header.
+Status RewriteVarDCTFrame(const FrameSections& frame,
+                          Span<const uint8_t> data,
+                          const PassesDecoderState& dec_state,
+                          const ACCapture& capture, SpeedTier speed_tier,
+                          ThreadPool* pool, BitWriter* writer) {
+  JxlMemoryManager* memory_manager = dec_state.memory_manager();
+  const FrameHeader& frame_header = frame.header;
+  const std::vector<FrameDecoder::TocEntry>& toc = frame.toc;
+  const PassesSharedState& shared = *dec_state.shared;
+  const FrameDimensions& frame_dim = shared.frame_dim;
+  const size_t num_groups = frame_dim.num_groups;
+  const size_t num_passes = frame_header.passes.num_passes;
+  const size_t ac_global_index = frame_dim.num_dc_groups + 1;
+  const bool single_section = toc.size() == 1;
+  JXL_ENSURE(capture.coeffs.size() == num_passes);
+  JXL_ENSURE(capture.ac_groups.size() == num_passes * num_groups);
+
+  // Coefficient orders. Their computation assumes that all channels have the
+  // same blocks, and faster speed tiers only consider DCT8; otherwise the
+  // signalled ones are kept.
+  std::vector<coeff_order_t> orders(
+      shared.coeff_orders.begin(),
+      shared.coeff_orders.begin() + num_passes * shared.coeff_order_size);
+  std::vector<uint16_t> used_orders(capture.used_orders,
+                                    capture.used_orders + num_passes);
+  if (frame_header.chroma_subsampling.Is444() &&
+      speed_tier < SpeedTier::kFalcon) {
+    auto used_orders_info = ComputeUsedOrders(
+        speed_tier, shared.ac_strategy, Rect(shared.raw_quant_field));
+    for (size_t i = 0; i < num_passes; i++) {
+      uint32_t all_used_orders = 0;
+      JXL_RETURN_IF_ERROR(ComputeCoeffOrder(
+          speed_tier, *capture.coeffs[i], shared.ac_strategy, frame_dim,
+          all_used_orders, /*prev_used_acs=*/0, used_orders_info.first,
+          used_orders_info.second, &orders[i * shared.coeff_order_size]));
+      used_orders[i] = all_used_orders;
+    }
+  }
+
+  // Tokens, per pass and group.
+  std::vector<std::vector<std::vector<Token>>> tokens(
+      num_passes, std::vector<std::vector<Token>>(num_groups));
+  std::vector<Image3I> num_nzeroes;
+  const auto tokenize_init = [&](const size_t num_threads) -> Status {
+    num_nzeroes.resize(num_threads);
+    return true;
+  };
+  const auto tokenize_group = [&](const uint32_t group_index,
+                                  const size_t thread) -> Status {
+    if (num_nzeroes[thread].xsize() == 0) {
+      JXL_ASSIGN_OR_RETURN(num_nzeroes[thread],
+                           Image3I::Create(memory_manager, kGroupDimInBlocks,
+                                           kGroupDimInBlocks));
+    }
+    const Rect rect = frame_dim.BlockGroupRect(group_index);
+    for (size_t i = 0; i < num_passes; i++) {
+      const int32_t* JXL_RESTRICT ac_rows[3] = {
+          capture.coeffs[i]->PlaneRow(0, group_index, 0).ptr32,
+          capture.coeffs[i]->PlaneRow(1, group_index, 0).ptr32,
+          capture.coeffs[i]->PlaneRow(2, group_index, 0).ptr32,
+      };
+      JXL_RETURN_IF_ERROR(TokenizeCoefficients(
+          &orders[i * shared.coeff_order_size], rect, ac_rows,
+          shared.ac_strategy, frame_header.chroma_subsampling,
+          &num_nzeroes[thread], &tokens[i][group_index], shared.quant_dc,
+          shared.raw_quant_field, shared.block_ctx_map));
+    }
+    return true;
+  };
+  JXL_RETURN_IF_ERROR(RunOnPool(pool, 0, num_groups, tokenize_init,
+                                tokenize_group, "TranscodeTokenize"));
+
+  // Sections, in logical order.
+  std::vector<Span<const uint8_t>> section_data(toc.size());
+  for (size_t i = 0; i < toc.size(); i++) {
+    section_data[toc[i].id] = frame.sections[i];
+  }
+  std::vector<std::unique_ptr<BitWriter>> group_codes;
+  for (size_t i = 0; i < toc.size(); i++) {
+    group_codes.emplace_back(jxl::make_unique<BitWriter>(memory_manager));
+    if (single_section || i >= ac_global_index) continue;
+    JXL_RETURN_IF_ERROR(group_codes[i]->AppendByteAligned(section_data[i]));
+  }
+  const size_t ac_global_section = single_section ? 0 : ac_global_index;
+  const Span<const uint8_t> ac_global_data = section_data[ac_global_section];
+  BitWriter* ac_global = group_codes[ac_global_section].get();
+
+  // AC global: the quantization matrices are kept, followed by a single set of
+  // histograms per pass.
+  JXL_RETURN_IF_ERROR(CopyBits(ac_global_data, 0, capture.matrices_end,
+                               LayerType::Quant, ac_global));
+  size_t num_histo_bits = CeilLog2Nonzero(num_groups);
+  if (num_histo_bits != 0) {
+    JXL_RETURN_IF_ERROR(
+        ac_global->WithMaxBits(num_histo_bits, LayerType::Ac, nullptr, [&] {
+          ac_global->Write(num_histo_bits, 0);
+          return true;
+        }));
+  }
+  std::vector<EntropyEncodingData> codes(num_passes);
+  for (size_t i = 0; i < num_passes; i++) {
+    size_t order_bits = 0;
+    JXL_RETURN_IF_ERROR(
+        U32Coder::CanEncode(kOrderEnc, used_orders[i], &order_bits));
+    JXL_RETURN_IF_ERROR(
+        ac_global->WithMaxBits(order_bits, LayerType::Order, nullptr, [&] {
+          return U32Coder::Write(kOrderEnc, used_orders[i], ac_global);
+        }));
+    JXL_RETURN_IF_ERROR(EncodeCoeffOrders(
+        used_orders[i], &orders[i * shared.coeff_order_size], ac_global,
+        LayerType::Order, nullptr));
+    HistogramParams hist_params(speed_tier,
+                                shared.block_ctx_map.NumACContexts());
+    if (speed_tier <= SpeedTier::kTortoise) {
+      hist_params.lz77_method = speed_tier <= SpeedTier::kGlacier
+                                    ? HistogramParams::LZ77Method::kOptimal
+                                    : HistogramParams::LZ77Method::kLZ77;
+    }
+    JXL_ASSIGN_OR_RETURN(
+        size_t cost,
+        BuildAndEncodeHistograms(memory_manager, hist_params,
+                                 shared.block_ctx_map.NumACContexts(),
+                                 tokens[i], &codes[i], ac_global,
+                                 LayerType::Ac, nullptr));
+    (void)cost;
+  }
+
+  // AC groups: the new tokens, followed by the modular data of the group.
+  for (size_t i = 0; i < num_passes; i++) {
+    for (size_t g = 0; g < num_groups; g++) {
+      size_t index =
+          single_section
+              ? 0
+              : AcGroupIndex(i, g, num_groups, frame_dim.num_dc_groups);
+      const ACCapture::SectionBits& bits =
+          capture.ac_groups[i * num_groups + g];
+      JXL_ENSURE(single_section || bits.begin == 0);
+      JXL_ENSURE(bits.begin <= bits.vardct_end && bits.vardct_end <= bits.end);
+      BitWriter* group_writer = group_codes[index].get();
+      JXL_RETURN_IF_ERROR(WriteTokens(tokens[i][g], codes[i],
+                                      /*context_offset=*/0, group_writer,
+                                      LayerType::AcTokens, nullptr));
+      JXL_RETURN_IF_ERROR(CopyBits(section_data[index], bits.vardct_end,
+                                   bits.end, LayerType::ModularAcGroup,
+                                   group_writer));
+    }
+  }
+  for (auto& group_code : group_codes) {
+    JXL_RETURN_IF_ERROR(PadToByte(LayerType::Ac, group_code.get()));
+  }
+
+  // Keep the order of the sections in the file.
+  std::vector<coeff_order_t> permutation(toc.size());
+  std::vector<std::unique_ptr<BitWriter>> file_codes(toc.size());
+  for (size_t i = 0; i < toc.size(); i++) {
+    permutation[toc[i].id] = i;
+    file_codes[i] = std::move(group_codes[toc[i].id]);
+  }
+
+  JXL_RETURN_IF_ERROR(
+      CopyBits(data, 0, frame.header_bits, LayerType::Header, writer));
+  return WriteTocAndSections(file_codes, permutation, writer);
+}
+
+// Writes `tree` as the global tree of the modular data.
+Status WriteTree(JxlMemoryManager* memory_manager, const Tree& tree,
+                 BitWriter* writer) {
+  std::vector<std::vector<Token>> tokens(1);
+  Tree decoded_tree;
+  JXL_RETURN_IF_ERROR(TokenizeTree(tree, tokens.data(), &decoded_tree));
+  EntropyEncodingData code;
+  JXL_ASSIGN_OR_RETURN(
+      size_t cost,
+      BuildAndEncodeHistograms(memory_manager, HistogramParams(),
+                               kNumTreeContexts, tokens, &code, writer,
+                               LayerType::ModularTree, nullptr));
+  (void)cost;
+  return WriteTokens(tokens[0], code, /*context_offset=*/0, writer,
+                     LayerType::ModularTree, nullptr);
+}
+
+// Moves the thresholds of the decisions of `tree` on the stream id so that
+// they select the same streams after these are renumbered. `stream_ids` maps
+// the old id of every stream that is kept to its new id, and is sorted in
+// both. Returns whether the tree changed.
+bool RemapStreamIds(const std::vector<std::pair<size_t, size_t>>& stream_ids,
+                    Tree* tree) {
+  constexpr int kStreamIdProperty = 1;
+  bool changed = false;
+  for (PropertyDecisionNode& node : *tree) {
+    if (node.property != kStreamIdProperty) continue;
+    // The kept streams with an id above the threshold stay above it.
+    auto above = std::upper_bound(
+        stream_ids.begin(), stream_ids.end(),
+        static_cast<int64_t>(node.splitval),
+        [](int64_t splitval, const std::pair<size_t, size_t>& ids) {
+          return splitval < static_cast<int64_t>(ids.first);
+        });
+    PropertyVal splitval =
+        above == stream_ids.begin()
+            ? -1
+            : static_cast<PropertyVal>(std::prev(above)->second);
+    changed |= splitval != node.splitval;
+    node.splitval = splitval;
+  }
+  return changed;
+}
+
+bool IsAligned(const Rect& rect, size_t dim, size_t xsize, size_t ysize) {
+  return rect.x0() % dim == 0 && rect.y0() % dim == 0 &&
+         (rect.x1() % dim == 0 || rect.x1() == xsize) &&
+         (rect.y1() % dim == 0 || rect.y1() == ysize);
+}
+
+// Sets `splits` to whether the modular stream that starts `section` has its own
+// MA tree that splits on the stream id. The header and the tree are read even
+// if the stream holds no channel, which can only make the answer conservative.
+Status LocalTreeSplitsOnStreamId(JxlMemoryManager* memory_manager,
+                                 Span<const uint8_t> section, bool* splits) {
+  *splits = false;
+  if (section.empty()) return true;
+  Status ret = true;
+  {
+    BitReader reader(section);
+    BitReaderScopedCloser reader_closer(reader, ret);
+    GroupHeader header;
+    JXL_RETURN_IF_ERROR(Bundle::Read(&reader, &header));
+    if (!header.use_global_tree) {
+      Tree tree;
+      JXL_RETURN_IF_ERROR(
+          DecodeTree(memory_manager, &reader, &tree, size_t{1} << 20));
+      for (const PropertyDecisionNode& node : tree) {
+        *splits |= node.property == 1;
+      }
+    }
+  }
+  return ret;
+}
+
+// Crops a frame that covers the whole image to `crop`, by copying the
+// sections of the groups inside it. The sections keep their order in the
+// file. The result is the frame, including its header.
+Status CropFrame(const FrameSections& frame, Span<const uint8_t> data,
+                 const PassesDecoderState& dec_state,
+                 const ACCapture& ac_capture,
+                 const ModularCapture& modular_capture,
+                 const CodecMetadata& cropped_metadata, const Rect& crop,
+                 BitWriter* writer) {
+  JxlMemoryManager* memory_manager = dec_state.memory_manager();
+  const FrameHeader& frame_header = frame.header;
+  const FrameDimensions& frame_dim = dec_state.shared->frame_dim;
+  const std::vector<FrameDecoder::TocEntry>& toc = frame.toc;
+  const size_t num_passes = frame_header.passes.num_passes;
+  const bool is_vardct = frame_header.encoding == FrameEncoding::kVarDCT;
+  if (frame_header.flags & (FrameHeader::kPatches | FrameHeader::kSplines)) {
+    return JXL_FAILURE("Cannot crop frames with patches or splines");
+  }
+  if ((frame_header.flags & FrameHeader::kUseDcFrame) ||
+      frame_header.frame_type == FrameType::kDCFrame) {
+    return JXL_FAILURE("Cannot crop frames with a separate DC frame");
+  }
+  if (frame_header.custom_size_or_origin) {
+    return JXL_FAILURE("Cannot crop frames that do not cover the image");
+  }
+  if (modular_capture.has_squeeze) {
+    return JXL_FAILURE("Cannot crop modular frames that use squeeze");
+  }
+
+  // Groups, in pixels of the image.
+  const size_t upsampling = frame_header.upsampling;
+  const size_t group_dim = frame_dim.group_dim * upsampling;
+  const size_t dc_group_dim = frame_dim.dc_group_dim * upsampling;
+  const size_t xsize = frame_dim.xsize_upsampled;
+  const size_t ysize = frame_dim.ysize_upsampled;
+  bool has_dc_group_channels = false;
+  for (const auto& shift : modular_capture.channel_shifts) {
+    has_dc_group_channels |= std::min(shift.first, shift.second) >= 3;
+  }
+  if (!IsAligned(crop, group_dim, xsize, ysize)) {
+    return JXL_FAILURE("The crop must be aligned to groups of %" PRIuS
+                       " pixels",
+                       group_dim);
+  }
+  // Otherwise the DC groups hold nothing.
+  const bool dc_aligned = IsAligned(crop, dc_group_dim, xsize, ysize);
+  if ((is_vardct || has_dc_group_channels) && !dc_aligned) {
+    return JXL_FAILURE("The crop must be aligned to DC groups of %" PRIuS
+                       " pixels",
+                       dc_group_dim);
+  }
+
+  FrameHeader cropped_header = frame_header;
+  cropped_header.nonserialized_metadata = &cropped_metadata;
+  const FrameDimensions cropped_dim = cropped_header.ToFrameDimensions();
+  if (cropped_dim.num_groups == 1 && num_passes == 1) {
+    return JXL_FAILURE("The crop must span more than one group");
+  }
+  JXL_ENSURE(toc.size() > 1);
+
+  // The leading modular channels that fit in a group are stored in the DC
+  // global section, which is copied, the others in the groups.
+  if (!modular_capture.channel_shifts.empty()) {
+    const auto fits_in_group = [&](const FrameDimensions& dim) {
+      const auto& shift = modular_capture.channel_shifts[0];
+      return DivCeil(dim.xsize, size_t{1} << shift.first) <= dim.group_dim &&
+             DivCeil(dim.ysize, size_t{1} << shift.second) <= dim.group_dim;
+    };
+    if (fits_in_group(frame_dim) || fits_in_group(cropped_dim)) {
+      return JXL_FAILURE("Cannot crop modular data that fits in a group");
+    }
+  }
+  // The decoder limits the size of the tree by that of the frame.
+  const auto& metadata = cropped_metadata.m;
+  size_t nb_chans = (metadata.color_encoding.IsGray() &&
+                     frame_header.color_transform == ColorTransform::kNone)
+                        ? 1
+                        : 3;
+  nb_chans += metadata.extra_channel_info.size();
+  size_t tree_size_limit =
+      std::min(static_cast<size_t>(1 << 22),
+               1024 + cropped_dim.xsize * cropped_dim.ysize * nb_chans / 16);
+  if (modular_capture.tree.size() > tree_size_limit) {
+    return JXL_FAILURE("The MA tree is too large for the cropped frame");
+  }
+
+  // Groups of the frame that are kept, by their index in the cropped frame.
+  const size_t x0 = crop.x0() / upsampling;
+  const size_t y0 = crop.y0() / upsampling;
+  const auto group = [&](size_t g) {
+    size_t gx = g % cropped_dim.xsize_groups + x0 / frame_dim.group_dim;
+    size_t gy = g / cropped_dim.xsize_groups + y0 / frame_dim.group_dim;
+    return gy * frame_dim.xsize_groups + gx;
+  };
+  // The one that contains its origin if it is not aligned.
+  const auto dc_group = [&](size_t g) {
+    size_t x = g % cropped_dim.xsize_dc_groups * cropped_dim.dc_group_dim + x0;
+    size_t y = g / cropped_dim.xsize_dc_groups * cropped_dim.dc_group_dim + y0;
+    return y / frame_dim.dc_group_dim * frame_dim.xsize_dc_groups +
+           x / frame_dim.dc_group_dim;
+  };
+
+  // Sections of the frame in logical order, and their position in the file.
+  std::vector<Span<const uint8_t>> section_data(toc.size());
+  std::vector<size_t> file_pos(toc.size());
+  for (size_t i = 0; i < toc.size(); i++) {
+    section_data[toc[i].id] = frame.sections[i];
+    file_pos[toc[i].id] = i;
+  }
+
+  // Modular streams that are kept. Those with their own MA tree cannot be
+  // renumbered if it splits on the stream id; the decoder records that for the
+  // streams of VarDCT frames, and those of modular frames start the section
+  // given here, if any.
+  std::vector<std::pair<size_t, size_t>> stream_ids;
+  const auto keep_stream = [&](const ModularStreamId& from,
+                               const ModularStreamId& to,
+                               size_t section = 0) -> Status {
+    const size_t from_id = from.ID(frame_dim);
+    const size_t to_id = to.ID(cropped_dim);
+    stream_ids.emplace_back(from_id, to_id);
+    if (from_id == to_id) return true;
+    bool splits = false;
+    if (is_vardct) {
+      JXL_ENSURE(from_id <
+                 modular_capture.local_tree_splits_on_stream_id.size());
+      splits = modular_capture.local_tree_splits_on_stream_id[from_id];
+    } else if (section != 0) {
+      JXL_RETURN_IF_ERROR(LocalTreeSplitsOnStreamId(
+          memory_manager, section_data[section], &splits));
+    }
+    if (splits) {
+      return JXL_FAILURE("Cannot renumber modular stream %s, whose MA tree "
+                         "splits on the stream id",
+                         from.DebugString().c_str());
+    }
+    return true;
+  };
+  JXL_RETURN_IF_ERROR(
+      keep_stream(ModularStreamId::Global(), ModularStreamId::Global()));
+  for (size_t g = 0; dc_aligned && g < cropped_dim.num_dc_groups; g++) {
+    JXL_RETURN_IF_ERROR(keep_stream(ModularStreamId::VarDCTDC(dc_group(g)),
+                                    ModularStreamId::VarDCTDC(g)));
+    JXL_RETURN_IF_ERROR(keep_stream(ModularStreamId::ModularDC(dc_group(g)),
+                                    ModularStreamId::ModularDC(g),
+                                    1 + dc_group(g)));
+    JXL_RETURN_IF_ERROR(keep_stream(ModularStreamId::ACMetadata(dc_group(g)),
+                                    ModularStreamId::ACMetadata(g)));
+  }
+  for (size_t i = 0; i < kNumQuantTables; i++) {
+    JXL_ASSIGN_OR_RETURN(ModularStreamId quant_table,
+                         ModularStreamId::QuantTable(i));
+    JXL_RETURN_IF_ERROR(keep_stream(quant_table, quant_table));
+  }
+  for (size_t i = 0; i < num_passes; i++) {
+    for (size_t g = 0; g < cropped_dim.num_groups; g++) {
+      JXL_RETURN_IF_ERROR(keep_stream(
+          ModularStreamId::ModularAC(group(g), i),
+          ModularStreamId::ModularAC(g, i),
+          AcGroupIndex(i, group(g), frame_dim.num_groups,
+                       frame_dim.num_dc_groups)));
+    }
+  }
+  std::sort(stream_ids.begin(), stream_ids.end());
+  for (size_t i = 1; i < stream_ids.size(); i++) {
+    JXL_ENSURE(stream_ids[i - 1].second < stream_ids[i].second);
+  }
+  Tree tree = modular_capture.tree;
+  const bool tree_changed = RemapStreamIds(stream_ids, &tree);
+
+  const size_t num_sections = NumTocEntries(
+      cropped_dim.num_groups, cropped_dim.num_dc_groups, num_passes);
+  std::vector<std::unique_ptr<BitWriter>> group_codes;
+  // Position in the file of the section each one comes from.
+  std::vector<size_t> from_pos;
+  const auto add_section = [&](size_t from) -> BitWriter* {
+    group_codes.emplace_back(jxl::make_unique<BitWriter>(memory_manager));
+    from_pos.push_back(file_pos[from]);
+    return group_codes.back().get();
+  };
+
+  // DC global, with the stream ids of the tree moved.
+  BitWriter* dc_global = add_section(0);
+  if (tree_changed) {
+    JXL_RETURN_IF_ERROR(CopyBits(section_data[0], 0, modular_capture.tree_begin,
+                                 LayerType::ModularGlobal, dc_global));
+    JXL_RETURN_IF_ERROR(WriteTree(memory_manager, tree, dc_global));
+    JXL_RETURN_IF_ERROR(CopyBits(section_data[0], modular_capture.tree_end,
+                                 modular_capture.dc_global_end,
+                                 LayerType::ModularGlobal, dc_global));
+    JXL_RETURN_IF_ERROR(PadToByte(LayerType::ModularGlobal, dc_global));
+  } else {
+    JXL_RETURN_IF_ERROR(dc_global->AppendByteAligned(section_data[0]));
+  }
+
+  for (size_t g = 0; g < cropped_dim.num_dc_groups; g++) {
+    BitWriter* dc_group_writer = add_section(1 + dc_group(g));
+    if (dc_aligned) {
+      JXL_RETURN_IF_ERROR(
+          dc_group_writer->AppendByteAligned(section_data[1 + dc_group(g)]));
+    }
+  }
+
+  // AC global, whose number of sets of histograms is written with as many bits
+  // as needed for the number of groups.
+  const size_t ac_global_index = frame_dim.num_dc_groups + 1;
+  const Span<const uint8_t> ac_global_data = section_data[ac_global_index];
+  BitWriter* ac_global = add_section(ac_global_index);
+  const size_t num_histo_bits = CeilLog2Nonzero(frame_dim.num_groups);
+  const size_t cropped_num_histo_bits = CeilLog2Nonzero(cropped_dim.num_groups);
+  if (is_vardct && num_histo_bits != cropped_num_histo_bits) {
+    size_t num_histograms = dec_state.shared->num_histograms;
+    if (num_histograms - 1 >= (size_t{1} << cropped_num_histo_bits)) {
+      return JXL_FAILURE("Too many sets of histograms for the cropped frame");
+    }
+    JXL_RETURN_IF_ERROR(CopyBits(ac_global_data, 0, ac_capture.matrices_end,
+                                 LayerType::Quant, ac_global));
+    JXL_RETURN_IF_ERROR(ac_global->WithMaxBits(
+        cropped_num_histo_bits, LayerType::Ac, nullptr, [&] {
+          ac_global->Write(cropped_num_histo_bits, num_histograms - 1);
+          return true;
+        }));
+    JXL_RETURN_IF_ERROR(
+        CopyBits(ac_global_data, ac_capture.matrices_end + num_histo_bits,
+                 ac_capture.ac_global_end, LayerType::Ac, ac_global));
+    JXL_RETURN_IF_ERROR(PadToByte(LayerType::Ac, ac_global));
+  } else {
+    JXL_RETURN_IF_ERROR(ac_global->AppendByteAligned(ac_global_data));
+  }
+
+  for (size_t i = 0; i < num_passes; i++) {
+    for (size_t g = 0; g < cropped_dim.num_groups; g++) {
+      size_t from = AcGroupIndex(i, group(g), frame_dim.num_groups,
+                                 frame_dim.num_dc_groups);
+      JXL_RETURN_IF_ERROR(
+          add_section(from)->AppendByteAligned(section_data[from]));
+    }
+  }
+  JXL_ENSURE(group_codes.size() == num_sections);
+
+  std::vector<size_t> file_order(num_sections);
+  std::iota(file_order.begin(), file_order.end(), 0);
+  std::stable_sort(
+      file_order.begin(), file_order.end(),
+      [&](size_t a, size_t b) { return from_pos[a] < from_pos[b]; });
+  std::vector<coeff_order_t> permutation(num_sections);
+  std::vector<std::unique_ptr<BitWriter>> file_codes(num_sections);
+  for (size_t i = 0; i < num_sections; i++) {
+    permutation[file_order[i]] = i;
+    file_codes[i] = std::move(group_codes[file_order[i]]);
+  }
+
+  JXL_RETURN_IF_ERROR(
+      CopyBits(data, 0, frame.header_bits, LayerType::Header, writer));
+  return WriteTocAndSections(file_codes, permutation, writer);
+}
+
+// Appends the frame with the given header and the sections of `frame` to
+// `writer`.
+Status WriteFrame(const FrameHeader& header, const FrameSections& frame,
+                  JxlMemoryManager* memory_manager, BitWriter* writer) {
+  JXL_RETURN_IF_ERROR(WriteFrameHeader(header, writer, nullptr));
+  std::vector<coeff_order_t> permutation(frame.toc.size());
+  std::vector<std::unique_ptr<BitWriter>> file_codes;
+  for (size_t i = 0; i < frame.toc.size(); i++) {
+    permutation[frame.toc[i].id] = i;
+    file_codes.emplace_back(jxl::make_unique<BitWriter>(memory_manager));
+    JXL_RETURN_IF_ERROR(
+        file_codes.back()->AppendByteAligned(frame.sections[i]));
+  }
+  return WriteTocAndSections(file_codes, permutation, writer);
+}
+
+// Returns the mean of `saliency`, stretched to `xsize` x `ysize`, over `rect`.
+float MeanSaliency(const ImageF& saliency, size_t xsize, size_t ysize,
+                   const Rect& rect) {
+  const size_t x0 = rect.x0() * saliency.xsize() / xsize;
+  const size_t y0 = rect.y0() * saliency.ysize() / ysize;
+  const size_t x1 = std::max(DivCeil(rect.x1() * saliency.xsize(), xsize),
+                             x0 + 1);
+  const size_t y1 = std::max(DivCeil(rect.y1() * saliency.ysize(), ysize),
+                             y0 + 1);
+  double sum = 0;
+  for (size_t y = y0; y < y1; y++) {
+    const float* JXL_RESTRICT row = saliency.ConstRow(y);
+    for (size_t x = x0; x < x1; x++) sum += row[x];
+  }
+  return sum / ((x1 - x0) * (y1 - y0));
+}
+
+// Returns the indices of the groups, or DC groups, of a frame in the given
+// order, with `cell_dim` the size of a group in pixels of `frame_dim`.
+std::vector<coeff_order_t> CellOrder(const SectionOrder& order,
+                                     const FrameHeader& header,
+                                     const FrameDimensions& frame_dim,
+                                     size_t xsize_cells, size_t ysize_cells,
+                                     size_t cell_dim) {
+  // The center is given in pixels of the image.
+  const int64_t x0 = header.custom_size_or_origin ? header.frame_origin.x0 : 0;
+  const int64_t y0 = header.custom_size_or_origin ? header.frame_origin.y0 : 0;
+  auto to_frame = [&](size_t pos, int64_t origin,
+                      size_t size_upsampled) -> size_t {
+    if (pos == static_cast<size_t>(-1)) {
+      return size_upsampled / 2 / header.upsampling;
+    }
+    int64_t in_frame = static_cast<int64_t>(pos) - origin;
+    in_frame = std::max<int64_t>(
+        0, std::min<int64_t>(in_frame, size_upsampled - 1));
+    return in_frame / header.upsampling;
+  };
+  const size_t center_x =
+      to_frame(order.center_x, x0, frame_dim.xsize_upsampled);
+  const size_t center_y =
+      to_frame(order.center_y, y0, frame_dim.ysize_upsampled);
+  std::vector<coeff_order_t> cells =
+      CenterFirstOrder(xsize_cells, ysize_cells, cell_dim, center_x, center_y);
+  if (order.saliency) {
+    std::vector<float> saliency(cells.size());
+    for (size_t i = 0; i < cells.size(); i++) {
+      const Rect rect((i % xsize_cells) * cell_dim,
+                      (i / xsize_cells) * cell_dim, cell_dim, cell_dim,
+                      frame_dim.xsize, frame_dim.ysize);
+      saliency[i] = MeanSaliency(*order.saliency, frame_dim.xsize,
+                                 frame_dim.ysize, rect);
+    }
+    std::stable_sort(cells.begin(), cells.end(),
+                     [&](coeff_order_t a, coeff_order_t b) {
+                       return saliency[a] > saliency[b];
+                     });
+  }
+  return cells;
+}
+
+// Appends `frame` to `writer` with its sections in the given order.
+Status ReorderFrame(const FrameSections& frame, Span<const uint8_t> data,
+                    const SectionOrder& order,
+                    JxlMemoryManager* memory_manager, BitWriter* writer) {
+  const FrameHeader& header = frame.header;
+  const FrameDimensions frame_dim = header.ToFrameDimensions();
+  const size_t num_groups = frame_dim.num_groups;
+  const size_t num_dc_groups = frame_dim.num_dc_groups;
+  const size_t num_passes = header.passes.num_passes;
+  const size_t num_sections = frame.toc.size();
+  const std::vector<coeff_order_t> ac_order =
+      CellOrder(order, header, frame_dim, frame_dim.xsize_groups,
+                frame_dim.ysize_groups, frame_dim.group_dim);
+
+  std::vector<size_t> ac_sections;
+  for (size_t pass = 0; pass < num_passes; pass++) {
+    for (coeff_order_t g : ac_order) {
+      ac_sections.push_back(AcGroupIndex(pass, g, num_groups, num_dc_groups));
+    }
+  }
+
+  // The logical index of the section at each position of the file.
+  std::vector<size_t> file_sections;
+  if (order.lf_first) {
+    const std::vector<coeff_order_t> dc_order =
+        CellOrder(order, header, frame_dim, frame_dim.xsize_dc_groups,
+                  frame_dim.ysize_dc_groups, frame_dim.dc_group_dim);
+    file_sections.push_back(0);
+    for (coeff_order_t g : dc_order) file_sections.push_back(1 + g);
+    file_sections.push_back(1 + num_dc_groups);
+    file_sections.insert(file_sections.end(), ac_sections.begin(),
+                         ac_sections.end());
+  } else {
+    // The AC groups take the places of the AC groups in the file.
+    size_t next_ac = 0;
+    for (const auto& toc_entry : frame.toc) {
+      file_sections.push_back(toc_entry.id > 1 + num_dc_groups
+                                  ? ac_sections[next_ac++]
+                                  : toc_entry.id);
+    }
+  }
+  JXL_ENSURE(file_sections.size() == num_sections);
+
+  std::vector<size_t> old_position(num_sections);
+  for (size_t i = 0; i < num_sections; i++) old_position[frame.toc[i].id] = i;
+  std::vector<coeff_order_t> permutation(num_sections);
+  std::vector<std::unique_ptr<BitWriter>> file_codes;
+  for (size_t i = 0; i < num_sections; i++) {
+    permutation[file_sections[i]] = i;
+    file_codes.emplace_back(jxl::make_unique<BitWriter>(memory_manager));
+    JXL_RETURN_IF_ERROR(file_codes.back()->AppendByteAligned(
+        frame.sections[old_position[file_sections[i]]]));
+  }
+  JXL_RETURN_IF_ERROR(
+      CopyBits(data, 0, frame.header_bits, LayerType::Header, writer));
+  return WriteTocAndSections(file_codes, permutation, writer);
+}
+
+}  // namespace
+
+Status OptimizeEntropy(JxlMemoryManager* memory_manager,
+                       Span<const uint8_t> codestream, SpeedTier speed_tier,
+                       ThreadPool* pool, std::vector<uint8_t>* out) {
+  CodecMetadata metadata;
+  size_t frames_begin;
+  JXL_RETURN_IF_ERROR(
+      ReadHeaders(memory_manager, codestream, &metadata, &frames_begin));
+  out->insert(out->end(), codestream.begin(),
+              codestream.begin() + frames_begin);
+
+  auto dec_state = jxl::make_unique<PassesDecoderState>(memory_manager);
+  JXL_RETURN_IF_ERROR(
+      dec_state->output_encoding_info.SetFromMetadata(metadata));
+
+  size_t pos = frames_begin;
+  bool is_preview = metadata.m.have_preview;
+  for (;;) {
+    Span<const uint8_t> data(codestream.data() + pos, codestream.size() - pos);
+    FrameSections frame(&metadata);
+    ACCapture capture;
+    JXL_RETURN_IF_ERROR(
+        ReadFrameSections(memory_manager, data, is_preview, &frame));
+    JXL_RETURN_IF_ERROR(DecodeFrameSections(
+        metadata, data, frame, SectionsToDecode::kAll, pool, dec_state.get(),
+        &capture, /*modular_capture=*/nullptr));
+
+    bool rewritten = false;
+    if (frame.header.encoding == FrameEncoding::kVarDCT) {
+      BitWriter writer(memory_manager);
+      JXL_RETURN_IF_ERROR(RewriteVarDCTFrame(frame, data, *dec_state, capture,
+                                             speed_tier, pool, &writer));
+      PaddedBytes frame_bytes = std::move(writer).TakeBytes();
+      if (frame_bytes.size() < frame.size) {
+        Bytes(frame_bytes).AppendTo(*out);
+        rewritten = true;
+      }
+    }
+    if (!rewritten) {
+      out->insert(out->end(), data.begin(), data.begin() + frame.size);
+    }
+    pos += frame.size;
+    if (!is_preview && frame.header.is_last) break;
+    is_preview = false;
+  }
+  // Keep anything that follows the last frame.
+  out->insert(out->end(), codestream.begin() + pos, codestream.end());
+  return true;
+}
+
+Status CropCodestream(JxlMemoryManager* memory_manager,
+                      Span<const uint8_t> codestream, const Rect& crop,
+                      ThreadPool* pool, std::vector<uint8_t>* out) {
+  CodecMetadata metadata;
+  size_t frames_begin;
+  JXL_RETURN_IF_ERROR(
+      ReadHeaders(memory_manager, codestream, &metadata, &frames_begin));
+  if (crop.xsize() == 0 || crop.ysize() == 0 ||
+      crop.x1() > metadata.xsize() || crop.y1() > metadata.ysize()) {
+    return JXL_FAILURE("Crop %s is not inside the %" PRIuS "x%" PRIuS
+                       " image",
+                       Description(crop).c_str(), metadata.xsize(),
+                       metadata.ysize());
+  }
+  const bool is_whole_image =
+      crop.xsize() == metadata.xsize() && crop.ysize() == metadata.ysize();
+
+  // The preview is dropped rather than cropped.
+  CodecMetadata cropped_metadata = metadata;
+  JXL_RETURN_IF_ERROR(cropped_metadata.size.Set(crop.xsize(), crop.ysize()));
+  cropped_metadata.m.have_preview = false;
+  cropped_metadata.m.have_intrinsic_size = false;
+  {
+    BitWriter writer(memory_manager);
+    JXL_RETURN_IF_ERROR(WriteHeaders(&cropped_metadata, &writer));
+    Bytes(std::move(writer).TakeBytes()).AppendTo(*out);
+  }
+
+  auto dec_state = jxl::make_unique<PassesDecoderState>(memory_manager);
+  JXL_RETURN_IF_ERROR(
+      dec_state->output_encoding_info.SetFromMetadata(metadata));
+
+  size_t pos = frames_begin;
+  bool is_preview = metadata.m.have_preview;
+  for (;;) {
+    Span<const uint8_t> data(codestream.data() + pos, codestream.size() - pos);
+    FrameSections frame(&metadata);
+    JXL_RETURN_IF_ERROR(
+        ReadFrameSections(memory_manager, data, is_preview, &frame));
+    if (is_whole_image && !is_preview) {
+      out->insert(out->end(), data.begin(), data.begin() + frame.size);
+    } else if (!is_preview) {
+      if (frame.toc.size() == 1) {
+        return JXL_FAILURE("The crop must span more than one group");
+      }
+      ACCapture ac_capture;
+      ac_capture.with_coefficients = false;
+      ModularCapture modular_capture;
+      JXL_RETURN_IF_ERROR(DecodeFrameSections(
+          metadata, data, frame, SectionsToDecode::kGlobals, pool,
+          dec_state.get(), &ac_capture, &modular_capture));
+      BitWriter writer(memory_manager);
+      JXL_RETURN_IF_ERROR(CropFrame(frame, data, *dec_state, ac_capture,
+                                    modular_capture, cropped_metadata, crop,
+                                    &writer));
+      Bytes(std::move(writer).TakeBytes()).AppendTo(*out);
+    }
+    pos += frame.size;
+    if (!is_preview && frame.header.is_last) break;
+    is_preview = false;
+  }
+  return true;
+}
+
+Status ExtractLayer(JxlMemoryManager* memory_manager,
+                    Span<const uint8_t> codestream, size_t layer_index,
+                    ThreadPool* pool, std::vector<uint8_t>* out) {
+  CodecMetadata metadata;
+  size_t frames_begin;
+  JXL_RETURN_IF_ERROR(
+      ReadHeaders(memory_manager, codestream, &metadata, &frames_begin));
+
+  auto dec_state = jxl::make_unique<PassesDecoderState>(memory_manager);
+  JXL_RETURN_IF_ERROR(
+      dec_state->output_encoding_info.SetFromMetadata(metadata));
+
+  // Frames up to the layer, with the reference ids they depend on, see
+  // FrameDecoder::References. Blending is left out, since the layer replaces
+  // the canvas.
+  std::vector<FrameSections> frames;
+  std::vector<Span<const uint8_t>> frame_data;
+  size_t num_layers = 0;
+  bool found = false;
+  size_t pos = frames_begin;
+  bool is_preview = metadata.m.have_preview;
+  while (!found) {
+    Span<const uint8_t> data(codestream.data() + pos, codestream.size() - pos);
+    FrameSections frame(&metadata);
+    JXL_RETURN_IF_ERROR(
+        ReadFrameSections(memory_manager, data, is_preview, &frame));
+    pos += frame.size;
+    if (is_preview) {
+      is_preview = false;
+      continue;
+    }
+    const FrameHeader& header = frame.header;
+    bool is_layer = header.frame_type == FrameType::kRegularFrame ||
+                    header.frame_type == FrameType::kSkipProgressive;
+    bool is_last = header.is_last;
+    if (is_layer && num_layers++ == layer_index) found = true;
+    frames.emplace_back(std::move(frame));
+    frame_data.push_back(data);
+    if (is_last) break;
+  }
+  if (!found) {
+    return JXL_FAILURE("No layer %" PRIuS ", the image has %" PRIuS " layers",
+                       layer_index, num_layers);
+  }
+  // Only the patches need decoding, from the DC global section, and the
+  // decoder checks them against the saved frames, so the frames saved before
+  // the last frame with patches are decoded whole.
+  size_t num_decoded = 0;
+  for (size_t i = 0; i < frames.size(); i++) {
+    if (frames[i].header.flags & FrameHeader::kPatches) num_decoded = i + 1;
+  }
+  std::vector<int> references;
+  for (size_t i = 0; i < frames.size(); i++) {
+    const FrameHeader& header = frames[i].header;
+    int frame_references = 0;
+    if (i < num_decoded && FrameDecoder::SavedAs(header) != 0) {
+      JXL_RETURN_IF_ERROR(DecodeFrameSections(
+          metadata, frame_data[i], frames[i], SectionsToDecode::kAll, pool,
+          dec_state.get(), /*ac_capture=*/nullptr,
+          /*modular_capture=*/nullptr));
+    } else if (header.flags & FrameHeader::kPatches) {
+      JXL_RETURN_IF_ERROR(DecodeFrameSections(
+          metadata, frame_data[i], frames[i], SectionsToDecode::kDCGlobal,
+          pool, dec_state.get(), /*ac_capture=*/nullptr,
+          /*modular_capture=*/nullptr));
+    }
+    if (header.flags & FrameHeader::kPatches) {
+      frame_references |=
+          dec_state->shared->image_features.patches.GetReferences();
+    }
+    if (header.flags & FrameHeader::kUseDcFrame) {
+      frame_references |= 16 << header.dc_level;
+    }
+    references.push_back(frame_references);
+  }
+
+  // The frames that the layer needs, walking back to the last frame saved with
+  // each reference id.
+  const size_t layer = frames.size() - 1;
+  std::vector<size_t> needed = {layer};
+  int missing = references[layer];
+  for (size_t i = layer; i-- > 0 && missing != 0;) {
+    int saved_as = FrameDecoder::SavedAs(frames[i].header);
+    if ((saved_as & missing) == 0) continue;
+    if (frames[i].header.frame_type == FrameType::kRegularFrame ||
+        frames[i].header.frame_type == FrameType::kSkipProgressive) {
+      return JXL_FAILURE("Layer %" PRIuS " depends on an earlier layer",
+                         layer_index);
+    }
+    missing = (missing & ~saved_as) | references[i];
+    needed.push_back(i);
+  }
+  if (missing != 0) {
+    return JXL_FAILURE("Layer %" PRIuS " depends on a missing frame",
+                       layer_index);
+  }
+  std::reverse(needed.begin(), needed.end());
+
+  // A still image of the size of the layer.
+  const FrameHeader& layer_header = frames[layer].header;
+  size_t xsize = metadata.xsize();
+  size_t ysize = metadata.ysize();
+  if (layer_header.custom_size_or_origin) {
+    xsize = layer_header.frame_size.xsize;
+    ysize = layer_header.frame_size.ysize;
+  }
+  const bool resized = xsize != metadata.xsize() || ysize != metadata.ysize();
+  CodecMetadata layer_metadata = metadata;
+  JXL_RETURN_IF_ERROR(layer_metadata.size.Set(xsize, ysize));
+  layer_metadata.m.have_preview = false;
+  layer_metadata.m.have_animation = false;
+  if (resized) layer_metadata.m.have_intrinsic_size = false;
+
+  BitWriter writer(memory_manager);
+  JXL_RETURN_IF_ERROR(WriteHeaders(&layer_metadata, &writer));
+  for (size_t i : needed) {
+    FrameHeader header = frames[i].header;
+    header.nonserialized_metadata = &layer_metadata;
+    if (i == layer) {
+      header.custom_size_or_origin = false;
+      header.frame_origin = FrameOrigin{0, 0};
+      header.frame_size = FrameSize{0, 0};
+      header.blending_info.mode = BlendMode::kReplace;
+      header.blending_info.source = 0;
+      for (BlendingInfo& info : header.extra_channel_blending_info) {
+        info.mode = BlendMode::kReplace;
+        info.source = 0;
+      }
+      header.animation_frame.duration = 0;
+      header.is_last = true;
+    } else if (resized) {
+      // Reference frames keep their size.
+      if (header.frame_type == FrameType::kDCFrame) {
+        return JXL_FAILURE("Cannot resize the DC frame of layer %" PRIuS,
+                           layer_index);
+      }
+      if (!header.custom_size_or_origin) {
+        header.custom_size_or_origin = true;
+        header.frame_size = FrameSize{static_cast<uint32_t>(metadata.xsize()),
+                                      static_cast<uint32_t>(metadata.ysize())};
+      }
+      if (!header.save_before_color_transform &&
+          (header.frame_size.xsize < xsize ||
+           header.frame_size.ysize < ysize)) {
+        return JXL_FAILURE("Reference frame is smaller than layer %" PRIuS,
+                           layer_index);
+      }
+    }
+    JXL_RETURN_IF_ERROR(
+        WriteFrame(header, frames[i], memory_manager, &writer));
+  }
+  Bytes(std::move(writer).TakeBytes()).AppendTo(*out);
+  return true;
+}
+
+Status ReorderSections(JxlMemoryManager* memory_manager,
+                       Span<const uint8_t> codestream,
+                       const SectionOrder& order, std::vector<uint8_t>* out) {
+  CodecMetadata metadata;
+  size_t frames_begin;
+  JXL_RETURN_IF_ERROR(
+      ReadHeaders(memory_manager, codestream, &metadata, &frames_begin));
+  if (order.saliency &&
+      (order.saliency->xsize() == 0 || order.saliency->ysize() == 0)) {
+    return JXL_FAILURE("Empty saliency map");
+  }
+  out->insert(out->end(), codestream.begin(),
+              codestream.begin() + frames_begin);
+
+  size_t pos = frames_begin;
+  bool is_preview = metadata.m.have_preview;
+  for (;;) {
+    Span<const uint8_t> data(codestream.data() + pos, codestream.size() - pos);
+    FrameSections frame(&metadata);
+    JXL_RETURN_IF_ERROR(
+        ReadFrameSections(memory_manager, data, is_preview, &frame));
+    if (frame.toc.size() == 1) {
+      out->insert(out->end(), data.begin(), data.begin() + frame.size);
+    } else {
+      BitWriter writer(memory_manager);
+      JXL_RETURN_IF_ERROR(
+          ReorderFrame(frame, data, order, memory_manager, &writer));
+      Bytes(std::move(writer).TakeBytes()).AppendTo(*out);
+    }
+    pos += frame.size;
+    if (!is_preview && frame.header.is_last) break;
+    is_preview = false;
+  }
+  // Keep anything that follows the last frame.
+  out->insert(out->end(), codestream.begin() + pos, codestream.end());
+  return true;
+}
+
+}  // namespace jxl
@@ -0,0 +1,90 @@
+// Copyright (c) the JPEG XL Project Authors. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#ifndef LIB_JXL_ENC_TRANSCODE_H_
+#define LIB_JXL_ENC_TRANSCODE_H_
+
+// Lossless rewriting of an existing codestream, without decoding it to pixels
+// and encoding it again.
+
+#include <jxl/memory_manager.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "lib/jxl/base/data_parallel.h"
+#include "lib/jxl/base/rect.h"
+#include "lib/jxl/base/span.h"
+#include "lib/jxl/base/status.h"
+#include "lib/jxl/common.h"
+#include "lib/jxl/image.h"
+
+namespace jxl {
+
+// Entropy codes the quantized AC coefficients of the VarDCT frames of the bare
+// `codestream` again, computing coefficient orders, context clustering,
+// histograms and LZ77 with the settings of `speed_tier`, and appends the
+// result to `out`. Everything else, including the headers, the DC and the
+// modular data, is copied as it is, so the decoded pixels are identical. A
+// frame that would not get smaller is copied unchanged.
+Status OptimizeEntropy(JxlMemoryManager* memory_manager,
+                       Span<const uint8_t> codestream, SpeedTier speed_tier,
+                       ThreadPool* pool, std::vector<uint8_t>* out);
+
+// Crops all frames of the bare `codestream` to `crop`, given in pixels of the
+// codestream, before orientation, and appends the result to `out`. The
+// sections of the groups inside the crop are copied; only the headers, the
+// TOC and, where the group indices are used as context, the MA tree are
+// written again. The crop must be aligned to groups, and to DC groups for
+// VarDCT frames, except where it reaches the right or bottom edge. Frames with
+// patches, splines, DC frames, squeezed modular data, MA trees local to a
+// group that split on the group, or their own size and origin are not
+// supported. The preview is dropped. Since the restoration filters no longer
+// see the pixels outside the crop, the pixels next to the new edges can change
+// slightly.
+Status CropCodestream(JxlMemoryManager* memory_manager,
+                      Span<const uint8_t> codestream, const Rect& crop,
+                      ThreadPool* pool, std::vector<uint8_t>* out);
+
+// Extracts one layer of the bare `codestream` as a still image of the size of
+// the layer, and appends it to `out`. Layers are counted like the frames that
+// the decoder returns without coalescing, which are the frames of an
+// animation unless these are made of several layers. The sections are copied,
+// along with the reference and DC frames that the layer needs, and the layer
+// is no longer blended. Fails if the layer needs an earlier layer, e.g. for
+// patches.
+Status ExtractLayer(JxlMemoryManager* memory_manager,
+                    Span<const uint8_t> codestream, size_t layer_index,
+                    ThreadPool* pool, std::vector<uint8_t>* out);
+
+// Order in which ReorderSections() writes the groups.
+struct SectionOrder {
+  // Groups closer to this pixel come first, in concentric squares as with
+  // JXL_ENC_FRAME_SETTING_GROUP_ORDER. The middle of the frame is used if
+  // -1.
+  size_t center_x = static_cast<size_t>(-1);
+  size_t center_y = static_cast<size_t>(-1);
+  // If not null, groups with a higher mean saliency come first instead, and
+  // groups of equal saliency in the order above. The map is scaled to the
+  // size of each frame.
+  const ImageF* saliency = nullptr;
+  // Moves the DC groups, which the decoder shows first, and the global
+  // sections before all AC groups and orders the DC groups in the same way.
+  // Otherwise only the AC groups change places.
+  bool lf_first = false;
+};
+
+// Writes the sections of the frames of the bare `codestream` in the given
+// order and appends the result to `out`. Only the TOC, which maps the
+// sections to their position in the file, is written again; the headers and
+// the sections are copied, so the decoded pixels are identical.
+Status ReorderSections(JxlMemoryManager* memory_manager,
+                       Span<const uint8_t> codestream,
+                       const SectionOrder& order, std::vector<uint8_t>* out);
+
+}  // namespace jxl
+
+#endif  // LIB_JXL_ENC_TRANSCODE_H_
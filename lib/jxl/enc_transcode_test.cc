@@ -0,0 +1,304 @@
+// Copyright (c) the JPEG XL Project Authors. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#include "lib/jxl/enc_transcode.h"
+
+#include <jxl/encode.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "lib/extras/dec/decode.h"
+#include "lib/extras/dec/jxl.h"
+#include "lib/extras/enc/jxl.h"
+#include "lib/extras/packed_image.h"
+#include "lib/jxl/base/data_parallel.h"
+#include "lib/jxl/base/rect.h"
+#include "lib/jxl/base/span.h"
+#include "lib/jxl/common.h"
+#include "lib/jxl/image.h"
+#include "lib/jxl/test_memory_manager.h"
+#include "lib/jxl/test_utils.h"
+#include "lib/jxl/testing.h"
+
+namespace jxl {
+namespace {
+
+using ::jxl::extras::ColorHints;
+using ::jxl::extras::JXLCompressParams;
+using ::jxl::extras::JXLDecompressParams;
+using ::jxl::extras::PackedImage;
+using ::jxl::extras::PackedPixelFile;
+using ::jxl::test::ReadTestData;
+using ::jxl::test::ThreadPoolForTests;
+
+PackedPixelFile LoadTestImage(const std::string& path, size_t xsize,
+                              size_t ysize) {
+  const std::vector<uint8_t> orig = ReadTestData(path);
+  PackedPixelFile ppf;
+  Check(extras::DecodeBytes(Bytes(orig), ColorHints(), &ppf));
+  Check(ppf.ShrinkTo(xsize, ysize));
+  return ppf;
+}
+
+// Encodes `ppf`, optimizes the result and checks that it decodes to the same
+// pixels.
+void EncodeAndOptimize(const PackedPixelFile& ppf,
+                       const JXLCompressParams& cparams, ThreadPool* pool,
+                       std::vector<uint8_t>* compressed,
+                       std::vector<uint8_t>* optimized) {
+  ASSERT_TRUE(extras::EncodeImageJXL(cparams, ppf, nullptr, compressed));
+  ASSERT_TRUE(OptimizeEntropy(test::MemoryManager(), Bytes(*compressed),
+                              SpeedTier::kTortoise, pool, optimized));
+  EXPECT_LE(optimized->size(), compressed->size());
+
+  JXLDecompressParams dparams;
+  test::DefaultAcceptedFormats(dparams);
+  PackedPixelFile decoded;
+  PackedPixelFile decoded_optimized;
+  ASSERT_TRUE(extras::DecodeImageJXL(compressed->data(), compressed->size(),
+                                     dparams, nullptr, &decoded));
+  ASSERT_TRUE(extras::DecodeImageJXL(optimized->data(), optimized->size(),
+                                     dparams, nullptr, &decoded_optimized));
+  EXPECT_TRUE(test::SamePixels(decoded, decoded_optimized));
+}
+
+TEST(TranscodeTest, OptimizeEntropyOfFastEncoding) {
+  ThreadPoolForTests pool(4);
+  PackedPixelFile ppf = LoadTestImage("jxl/flower/flower.png", 600, 400);
+  JXLCompressParams cparams;
+  cparams.distance = 1.0f;
+  cparams.AddOption(JXL_ENC_FRAME_SETTING_EFFORT, 3);
+  std::vector<uint8_t> compressed;
+  std::vector<uint8_t> optimized;
+  EncodeAndOptimize(ppf, cparams, pool.get(), &compressed, &optimized);
+  EXPECT_LT(optimized.size(), compressed.size());
+}
+
+TEST(TranscodeTest, OptimizeEntropyProgressive) {
+  ThreadPoolForTests pool(4);
+  PackedPixelFile ppf = LoadTestImage("jxl/flower/flower.png", 600, 400);
+  JXLCompressParams cparams;
+  cparams.distance = 2.0f;
+  cparams.AddOption(JXL_ENC_FRAME_SETTING_EFFORT, 2);
+  cparams.AddOption(JXL_ENC_FRAME_SETTING_PROGRESSIVE_AC, 1);
+  std::vector<uint8_t> compressed;
+  std::vector<uint8_t> optimized;
+  EncodeAndOptimize(ppf, cparams, pool.get(), &compressed, &optimized);
+}
+
+TEST(TranscodeTest, OptimizeEntropySingleSection) {
+  PackedPixelFile ppf = LoadTestImage("jxl/flower/flower.png", 200, 150);
+  JXLCompressParams cparams;
+  cparams.distance = 1.0f;
+  cparams.AddOption(JXL_ENC_FRAME_SETTING_EFFORT, 3);
+  std::vector<uint8_t> compressed;
+  std::vector<uint8_t> optimized;
+  EncodeAndOptimize(ppf, cparams, nullptr, &compressed, &optimized);
+}
+
+TEST(TranscodeTest, OptimizeEntropyKeepsModularFrames) {
+  PackedPixelFile ppf = LoadTestImage("jxl/flower/flower.png", 300, 200);
+  JXLCompressParams cparams = test::CompressParamsForLossless();
+  cparams.AddOption(JXL_ENC_FRAME_SETTING_EFFORT, 1);
+  std::vector<uint8_t> compressed;
+  std::vector<uint8_t> optimized;
+  EncodeAndOptimize(ppf, cparams, nullptr, &compressed, &optimized);
+  EXPECT_EQ(Bytes(optimized), Bytes(compressed));
+}
+
+PackedPixelFile Decode(const std::vector<uint8_t>& compressed) {
+  JXLDecompressParams dparams;
+  test::DefaultAcceptedFormats(dparams);
+  PackedPixelFile ppf;
+  Check(extras::DecodeImageJXL(compressed.data(), compressed.size(), dparams,
+                               nullptr, &ppf));
+  return ppf;
+}
+
+// Checks that `cropped` holds the pixels of `rect` of `image`.
+void ExpectSameRegion(const PackedImage& image, const Rect& rect,
+                      const PackedImage& cropped) {
+  ASSERT_EQ(cropped.xsize, rect.xsize());
+  ASSERT_EQ(cropped.ysize, rect.ysize());
+  ASSERT_EQ(cropped.pixel_stride(), image.pixel_stride());
+  for (size_t y = 0; y < rect.ysize(); ++y) {
+    ASSERT_EQ(0, memcmp(image.const_pixels(rect.y0() + y, rect.x0(), 0),
+                        cropped.const_pixels(y, 0, 0),
+                        rect.xsize() * image.pixel_stride()))
+        << "y = " << y;
+  }
+}
+
+TEST(TranscodeTest, CropLosslessModular) {
+  ThreadPoolForTests pool(4);
+  PackedPixelFile ppf = LoadTestImage("jxl/flower/flower.png", 600, 400);
+  JXLCompressParams cparams = test::CompressParamsForLossless();
+  cparams.AddOption(JXL_ENC_FRAME_SETTING_EFFORT, 3);
+  std::vector<uint8_t> compressed;
+  ASSERT_TRUE(extras::EncodeImageJXL(cparams, ppf, nullptr, &compressed));
+  PackedPixelFile decoded = Decode(compressed);
+
+  for (const Rect& crop : {Rect(256, 0, 344, 400), Rect(0, 256, 512, 144),
+                           Rect(256, 0, 256, 400)}) {
+    std::vector<uint8_t> cropped;
+    ASSERT_TRUE(CropCodestream(test::MemoryManager(), Bytes(compressed), crop,
+                               pool.get(), &cropped));
+    EXPECT_LT(cropped.size(), compressed.size());
+    PackedPixelFile decoded_cropped = Decode(cropped);
+    ASSERT_EQ(decoded_cropped.frames.size(), 1);
+    ExpectSameRegion(decoded.frames[0].color, crop,
+                     decoded_cropped.frames[0].color);
+  }
+}
+
+TEST(TranscodeTest, CropVarDCT) {
+  ThreadPoolForTests pool(4);
+  const std::vector<uint8_t> orig = ReadTestData("jxl/flower/flower.png");
+  PackedPixelFile ppf;
+  ASSERT_TRUE(extras::DecodeBytes(Bytes(orig), ColorHints(), &ppf));
+  ASSERT_GT(ppf.info.xsize, 2048);
+  JXLCompressParams cparams;
+  cparams.distance = 1.0f;
+  cparams.AddOption(JXL_ENC_FRAME_SETTING_EFFORT, 3);
+  std::vector<uint8_t> compressed;
+  ASSERT_TRUE(extras::EncodeImageJXL(cparams, ppf, nullptr, &compressed));
+  PackedPixelFile decoded = Decode(compressed);
+
+  // Only the pixels next to the new edge can differ.
+  const Rect crop(0, 0, 2048, ppf.info.ysize);
+  std::vector<uint8_t> cropped;
+  ASSERT_TRUE(CropCodestream(test::MemoryManager(), Bytes(compressed), crop,
+                             pool.get(), &cropped));
+  EXPECT_LT(cropped.size(), compressed.size());
+  PackedPixelFile decoded_cropped = Decode(cropped);
+  EXPECT_EQ(decoded_cropped.info.xsize, crop.xsize());
+  EXPECT_EQ(decoded_cropped.info.ysize, crop.ysize());
+  ASSERT_TRUE(decoded.ShrinkTo(crop.xsize(), crop.ysize()));
+  EXPECT_GT(test::ComputePSNR(decoded, decoded_cropped), 50.0);
+
+  // Not aligned to DC groups.
+  EXPECT_FALSE(CropCodestream(test::MemoryManager(), Bytes(compressed),
+                              Rect(256, 0, 256, 256), pool.get(), &cropped));
+}
+
+TEST(TranscodeTest, CropWholeImageIsUnchanged) {
+  PackedPixelFile ppf = LoadTestImage("jxl/flower/flower.png", 300, 200);
+  JXLCompressParams cparams;
+  cparams.distance = 1.0f;
+  cparams.AddOption(JXL_ENC_FRAME_SETTING_EFFORT, 3);
+  std::vector<uint8_t> compressed;
+  ASSERT_TRUE(extras::EncodeImageJXL(cparams, ppf, nullptr, &compressed));
+  std::vector<uint8_t> cropped;
+  ASSERT_TRUE(CropCodestream(test::MemoryManager(), Bytes(compressed),
+                             Rect(0, 0, 300, 200), nullptr, &cropped));
+  EXPECT_TRUE(test::SamePixels(Decode(compressed), Decode(cropped)));
+  EXPECT_FALSE(CropCodestream(test::MemoryManager(), Bytes(compressed),
+                              Rect(0, 0, 301, 200), nullptr, &cropped));
+}
+
+TEST(TranscodeTest, ExtractLayerOfAnimation) {
+  PackedPixelFile ppf = LoadTestImage("jxl/flower/flower.png", 300, 200);
+  ppf.info.have_animation = JXL_TRUE;
+  ppf.info.animation.tps_numerator = 10;
+  ppf.info.animation.tps_denominator = 1;
+  ppf.frames[0].frame_info.duration = 1;
+  for (size_t i = 1; i < 3; ++i) {
+    JXL_TEST_ASSIGN_OR_DIE(extras::PackedFrame frame, ppf.frames[0].Copy());
+    PackedImage& color = frame.color;
+    for (size_t y = 0; y < color.ysize; ++y) {
+      uint8_t* row = color.pixels(y, 0, 0);
+      for (size_t x = 0; x < color.xsize * color.pixel_stride(); ++x) {
+        row[x] ^= 0x40 * i;
+      }
+    }
+    ppf.frames.emplace_back(std::move(frame));
+  }
+  JXLCompressParams cparams = test::CompressParamsForLossless();
+  cparams.AddOption(JXL_ENC_FRAME_SETTING_EFFORT, 2);
+  std::vector<uint8_t> compressed;
+  ASSERT_TRUE(extras::EncodeImageJXL(cparams, ppf, nullptr, &compressed));
+  PackedPixelFile decoded = Decode(compressed);
+  ASSERT_EQ(decoded.frames.size(), 3);
+
+  for (size_t i = 0; i < 3; ++i) {
+    std::vector<uint8_t> layer;
+    ASSERT_TRUE(ExtractLayer(test::MemoryManager(), Bytes(compressed), i,
+                             nullptr, &layer));
+    PackedPixelFile decoded_layer = Decode(layer);
+    EXPECT_FALSE(decoded_layer.info.have_animation);
+    ASSERT_EQ(decoded_layer.frames.size(), 1);
+    EXPECT_TRUE(test::SamePixels(decoded.frames[i].color,
+                                 decoded_layer.frames[0].color));
+  }
+  std::vector<uint8_t> layer;
+  EXPECT_FALSE(ExtractLayer(test::MemoryManager(), Bytes(compressed), 3,
+                            nullptr, &layer));
+}
+
+TEST(TranscodeTest, ReorderSectionsCenterFirst) {
+  PackedPixelFile ppf = LoadTestImage("jxl/flower/flower.png", 600, 400);
+  JXLCompressParams cparams;
+  cparams.distance = 1.0f;
+  cparams.AddOption(JXL_ENC_FRAME_SETTING_EFFORT, 3);
+  std::vector<uint8_t> compressed;
+  ASSERT_TRUE(extras::EncodeImageJXL(cparams, ppf, nullptr, &compressed));
+
+  // The sections do not depend on their order, so this gives the same result
+  // as the encoder.
+  cparams.AddOption(JXL_ENC_FRAME_SETTING_GROUP_ORDER, 1);
+  cparams.AddOption(JXL_ENC_FRAME_SETTING_GROUP_ORDER_CENTER_X, 500);
+  cparams.AddOption(JXL_ENC_FRAME_SETTING_GROUP_ORDER_CENTER_Y, 100);
+  std::vector<uint8_t> center_first;
+  ASSERT_TRUE(extras::EncodeImageJXL(cparams, ppf, nullptr, &center_first));
+  ASSERT_NE(Bytes(center_first), Bytes(compressed));
+
+  SectionOrder order;
+  order.center_x = 500;
+  order.center_y = 100;
+  std::vector<uint8_t> reordered;
+  ASSERT_TRUE(ReorderSections(test::MemoryManager(), Bytes(compressed), order,
+                              &reordered));
+  EXPECT_EQ(Bytes(reordered), Bytes(center_first));
+}
+
+TEST(TranscodeTest, ReorderSectionsBySaliency) {
+  PackedPixelFile ppf = LoadTestImage("jxl/flower/flower.png", 600, 400);
+  JXLCompressParams cparams;
+  cparams.distance = 2.0f;
+  cparams.AddOption(JXL_ENC_FRAME_SETTING_EFFORT, 2);
+  cparams.AddOption(JXL_ENC_FRAME_SETTING_PROGRESSIVE_AC, 1);
+  std::vector<uint8_t> compressed;
+  ASSERT_TRUE(extras::EncodeImageJXL(cparams, ppf, nullptr, &compressed));
+
+  JXL_TEST_ASSIGN_OR_DIE(ImageF saliency,
+                         ImageF::Create(test::MemoryManager(), 6, 4));
+  for (size_t y = 0; y < saliency.ysize(); ++y) {
+    for (size_t x = 0; x < saliency.xsize(); ++x) {
+      saliency.Row(y)[x] = x * y;
+    }
+  }
+  SectionOrder order;
+  order.saliency = &saliency;
+  order.lf_first = true;
+  std::vector<uint8_t> reordered;
+  ASSERT_TRUE(ReorderSections(test::MemoryManager(), Bytes(compressed), order,
+                              &reordered));
+  EXPECT_NE(Bytes(reordered), Bytes(compressed));
+  EXPECT_TRUE(test::SamePixels(Decode(compressed), Decode(reordered)));
+
+  // Sections that are already in order stay where they are.
+  std::vector<uint8_t> reordered_again;
+  ASSERT_TRUE(ReorderSections(test::MemoryManager(), Bytes(reordered), order,
+                              &reordered_again));
+  EXPECT_EQ(Bytes(reordered_again), Bytes(reordered));
+}
+
+}  // namespace
+}  // namespace jxl
@@ -381,6 +381,8 @@ struct JxlEncoderQueuedBox {
   BoxType type;
   std::vector<uint8_t> contents;
   bool compress_box;
+  // Contents of the brob box once compressed, see CompressQueuedBoxes.
+  std::vector<uint8_t> brob_contents;
 };
 
 using FJXLFrameUniquePtr =
@@ -659,6 +661,10 @@ struct JxlEncoder {
   // the bytes to the output_byte_queue.
   jxl::Status ProcessOneEnqueuedInput();
 
+  // Brotli compresses all queued boxes that are written as brob boxes and
+  // were not compressed yet, in parallel on the thread pool.
+  jxl::Status CompressQueuedBoxes();
+
   bool MustUseContainer() const {
     return use_container || (codestream_level != 5 && codestream_level != -1) ||
            store_jpeg_metadata || use_boxes;
@@ -12,6 +12,8 @@
 #include <jxl/encode.h>
 #include <jxl/encode_cxx.h>
 #include <jxl/memory_manager.h>
+#include <jxl/thread_parallel_runner.h>
+#include <jxl/thread_parallel_runner_cxx.h>
 #include <jxl/types.h>
 
 #include <cstddef>
@@ -19,6 +21,7 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <memory>
 #include <mutex>
 #include <ostream>
 #include <set>
@@ -275,6 +278,63 @@ TEST(EncodeTest, EncoderResetTest) {
   VerifyFrameEncoding(157, 77, enc.get(), frame_settings, 2300, false);
 }
 
+TEST(EncodeTest, GroupStatsTest) {
+  JxlEncoderPtr enc = JxlEncoderMake(nullptr);
+  EXPECT_NE(nullptr, enc.get());
+  JxlEncoderFrameSettings* frame_settings =
+      JxlEncoderFrameSettingsCreate(enc.get(), nullptr);
+  ASSERT_NE(nullptr, frame_settings);
+  std::unique_ptr<JxlEncoderStats, decltype(JxlEncoderStatsDestroy)*> stats(
+      JxlEncoderStatsCreate(), JxlEncoderStatsDestroy);
+  JxlEncoderCollectStats(frame_settings, stats.get());
+  // Two groups of 256x256 side by side.
+  VerifyFrameEncoding(300, 200, enc.get(), frame_settings, 100000, false);
+
+  ASSERT_EQ(2u, JxlEncoderStatsNumGroups(stats.get()));
+  const JxlEncoderStats* s = stats.get();
+  EXPECT_EQ(0u, JxlEncoderStatsGetGroup(s, 0, JXL_ENC_GROUP_STAT_X0));
+  EXPECT_EQ(256u, JxlEncoderStatsGetGroup(s, 0, JXL_ENC_GROUP_STAT_XSIZE));
+  EXPECT_EQ(256u, JxlEncoderStatsGetGroup(s, 1, JXL_ENC_GROUP_STAT_X0));
+  EXPECT_EQ(44u, JxlEncoderStatsGetGroup(s, 1, JXL_ENC_GROUP_STAT_XSIZE));
+  EXPECT_EQ(200u, JxlEncoderStatsGetGroup(s, 1, JXL_ENC_GROUP_STAT_YSIZE));
+  size_t total_bits = 0;
+  for (size_t g = 0; g < 2; ++g) {
+    size_t bits = JxlEncoderStatsGetGroup(s, g, JXL_ENC_GROUP_STAT_BITS);
+    EXPECT_GT(bits, 0u);
+    total_bits += bits;
+    // Every 8x8 block is covered by exactly one varblock, so the counts
+    // weighted by the varblock areas add up to the size of the group.
+    static constexpr size_t kAreas[] = {1, 1, 1, 1, 2, 4, 4, 8, 16, 32, 64};
+    size_t area = 0;
+    for (size_t i = 0; i < 11; ++i) {
+      area += kAreas[i] *
+              JxlEncoderStatsGetGroup(
+                  s, g,
+                  static_cast<JxlEncoderGroupStatsKey>(
+                      JXL_ENC_GROUP_STAT_NUM_SMALL_BLOCKS + i));
+    }
+    size_t xsize_blocks = jxl::DivCeil(
+        JxlEncoderStatsGetGroup(s, g, JXL_ENC_GROUP_STAT_XSIZE), 8);
+    size_t ysize_blocks = jxl::DivCeil(
+        JxlEncoderStatsGetGroup(s, g, JXL_ENC_GROUP_STAT_YSIZE), 8);
+    EXPECT_GE(area, xsize_blocks * ysize_blocks);
+    size_t min_quant =
+        JxlEncoderStatsGetGroup(s, g, JXL_ENC_GROUP_STAT_MIN_QUANT);
+    EXPECT_GT(min_quant, 0u);
+    EXPECT_LE(min_quant,
+              JxlEncoderStatsGetGroup(s, g, JXL_ENC_GROUP_STAT_MAX_QUANT));
+    EXPECT_GE(JxlEncoderStatsGetGroup(s, g, JXL_ENC_GROUP_STAT_QUANT_SUM),
+              min_quant * xsize_blocks * ysize_blocks);
+  }
+  EXPECT_EQ(0u, JxlEncoderStatsGetGroup(s, 2, JXL_ENC_GROUP_STAT_BITS));
+  size_t frame_bits = 0;
+  for (int key = JXL_ENC_STAT_HEADER_BITS;
+       key <= JXL_ENC_STAT_MODULAR_AC_GROUP_BITS; ++key) {
+    frame_bits += JxlEncoderStatsGet(s, static_cast<JxlEncoderStatsKey>(key));
+  }
+  EXPECT_LT(total_bits, frame_bits);
+}
+
 TEST(EncodeTest, CmsTest) {
   JxlEncoderPtr enc = JxlEncoderMake(nullptr);
   EXPECT_NE(nullptr, enc.get());
@@ -1513,6 +1573,81 @@ JXL_GTEST_INSTANTIATE_TEST_SUITE_P(
                                      jxl::kLargeBoxContentSizeThreshold + 77)),
     nameBoxTest);
 
+JXL_BOXES_TEST(EncodeTest, ParallelBoxCompressionTest) {
+  // Several brob boxes queued together are compressed on the thread pool; they
+  // must still be written in order and with the right contents.
+  JxlEncoderPtr enc = JxlEncoderMake(nullptr);
+  EXPECT_NE(nullptr, enc.get());
+  JxlThreadParallelRunnerPtr runner = JxlThreadParallelRunnerMake(nullptr, 4);
+  EXPECT_EQ(JXL_ENC_SUCCESS,
+            JxlEncoderSetParallelRunner(enc.get(), JxlThreadParallelRunner,
+                                        runner.get()));
+  EXPECT_EQ(JXL_ENC_SUCCESS, JxlEncoderUseBoxes(enc.get()));
+  JxlEncoderFrameSettings* frame_settings =
+      JxlEncoderFrameSettingsCreate(enc.get(), nullptr);
+  ASSERT_NE(nullptr, frame_settings);
+  size_t xsize = 50;
+  size_t ysize = 17;
+  JxlPixelFormat pixel_format = {4, JXL_TYPE_UINT16, JXL_BIG_ENDIAN, 0};
+  std::vector<uint8_t> pixels = jxl::test::GetSomeTestImage(xsize, ysize, 4, 0);
+  JxlBasicInfo basic_info;
+  jxl::test::JxlBasicInfoSetFromPixelFormat(&basic_info, &pixel_format);
+  basic_info.xsize = xsize;
+  basic_info.ysize = ysize;
+  basic_info.uses_original_profile = JXL_FALSE;
+  EXPECT_EQ(JXL_ENC_SUCCESS, JxlEncoderSetBasicInfo(enc.get(), &basic_info));
+  JxlColorEncoding color_encoding;
+  JxlColorEncodingSetToSRGB(&color_encoding, /*is_gray=*/JXL_FALSE);
+  EXPECT_EQ(JXL_ENC_SUCCESS,
+            JxlEncoderSetColorEncoding(enc.get(), &color_encoding));
+
+  const std::vector<std::string> types = {"xml ", "jumb", "abcd", "efgh"};
+  std::vector<std::vector<uint8_t>> contents;
+  for (size_t i = 0; i < types.size(); ++i) {
+    contents.push_back(jxl::test::GetSomeTestImage(100 + 50 * i, 100, 3, i));
+    EXPECT_EQ(JXL_ENC_SUCCESS,
+              JxlEncoderAddBox(enc.get(), types[i].c_str(),
+                               contents[i].data(), contents[i].size(),
+                               /*compress_box=*/JXL_TRUE));
+  }
+  EXPECT_EQ(JXL_ENC_SUCCESS,
+            JxlEncoderAddImageFrame(frame_settings, &pixel_format,
+                                    pixels.data(), pixels.size()));
+  JxlEncoderCloseInput(enc.get());
+  std::vector<uint8_t> compressed = std::vector<uint8_t>(64);
+  uint8_t* next_out = compressed.data();
+  size_t avail_out = compressed.size() - (next_out - compressed.data());
+  ProcessEncoder(enc.get(), compressed, next_out, avail_out);
+
+  JxlDecoderPtr dec = JxlDecoderMake(nullptr);
+  EXPECT_NE(nullptr, dec.get());
+  EXPECT_EQ(JXL_DEC_SUCCESS, JxlDecoderSetDecompressBoxes(dec.get(), JXL_TRUE));
+  EXPECT_EQ(JXL_DEC_SUCCESS, JxlDecoderSubscribeEvents(dec.get(), JXL_DEC_BOX));
+  JxlDecoderSetInput(dec.get(), compressed.data(), compressed.size());
+  JxlDecoderCloseInput(dec.get());
+  std::vector<std::vector<uint8_t>> decoded(types.size());
+  size_t num_boxes = 0;
+  for (;;) {
+    JxlDecoderStatus status = JxlDecoderProcessInput(dec.get());
+    if (status == JXL_DEC_SUCCESS) break;
+    ASSERT_EQ(JXL_DEC_BOX, status);
+    EXPECT_EQ(0, JxlDecoderReleaseBoxBuffer(dec.get()));
+    JxlBoxType type;
+    EXPECT_EQ(JXL_DEC_SUCCESS, JxlDecoderGetBoxType(dec.get(), type, JXL_TRUE));
+    if (num_boxes < types.size() &&
+        memcmp(type, types[num_boxes].data(), 4) == 0) {
+      decoded[num_boxes].resize(contents[num_boxes].size());
+      JxlDecoderSetBoxBuffer(dec.get(), decoded[num_boxes].data(),
+                             decoded[num_boxes].size());
+      num_boxes++;
+    }
+  }
+  EXPECT_EQ(types.size(), num_boxes);
+  for (size_t i = 0; i < types.size(); ++i) {
+    EXPECT_EQ(contents[i], decoded[i]);
+  }
+}
+
 JXL_TRANSCODE_JPEG_TEST(EncodeTest, JPEGFrameTest) {
   TEST_LIBJPEG_SUPPORT();
   for (int skip_basic_info = 0; skip_basic_info < 2; skip_basic_info++) {
@@ -3,7 +3,7 @@
 // Use of this source code is governed by a BSD-style
 // license that can be found in the LICENSE file.
 
-#include "tools/gauss_blur.h"
+#include "lib/jxl/gauss_blur.h"
 
 #include <jxl/memory_manager.h>
 
@@ -13,13 +13,20 @@
 #include <cstdint>
 #include <cstdio>
 #include <cstring>
+#include <hwy/base.h>  // HWY_REP4
+#include <utility>
+#include <vector>
 
 #include "lib/jxl/base/data_parallel.h"
+#include "lib/jxl/base/rect.h"
 #include "lib/jxl/base/status.h"
+#include "lib/jxl/convolve.h"
+#include "lib/jxl/image.h"
+#include "lib/jxl/image_ops.h"
 #include "lib/jxl/memory_manager_internal.h"
 
 #undef HWY_TARGET_INCLUDE
-#define HWY_TARGET_INCLUDE "tools/gauss_blur.cc"
+#define HWY_TARGET_INCLUDE "lib/jxl/gauss_blur.cc"
 #include <hwy/cache_control.h>  // Prefetch
 #include <hwy/foreach_target.h>
 #include <hwy/highway.h>
@@ -372,42 +379,55 @@ void VerticalStrip(const RecursiveGaussian& rg, const size_t x,
   }
 }
 
-// Apply 1D vertical scan to multiple columns (one per vector lane).
-// Not yet parallelized.
+// Apply 1D vertical scan to multiple columns (one per vector lane). Each task
+// filters one strip of columns with its own ring buffer.
 Status FastGaussianVertical(JxlMemoryManager* memory_manager,
                             const RecursiveGaussian& rg, const size_t xsize,
                             const size_t ysize, const GetConstRow& in,
-                            const GetRow& out, ThreadPool* /* pool */) {
+                            const GetRow& out, ThreadPool* pool) {
   const HWY_FULL(float) df;
   constexpr size_t kCacheLineLanes = 64 / sizeof(float);
   const size_t unroll = std::max<size_t>(kCacheLineLanes / Lanes(df), 4);
+  if (unroll != 4 && unroll != 8 && unroll != 16) {
+    return JXL_UNREACHABLE("Unexpected vector size");
+  }
   const size_t fast_pace = unroll * Lanes(df);
   const size_t scratch_size =
       fast_pace * sizeof(float) * (1 + 3 * kRingBufferLen);
-  JXL_ASSIGN_OR_RETURN(AlignedMemory mem,
-                       AlignedMemory::Create(memory_manager, scratch_size));
-  float* zero = mem.address<float>();
-  float* ring_buffer = zero + fast_pace;
-  memset(zero, 0, fast_pace * sizeof(float));
-  size_t x = 0;
-  if (unroll == 4) {
-    for (; x + fast_pace <= xsize; x += fast_pace) {
-      VerticalStrip<4>(rg, x, ysize, ring_buffer, zero, in, out);
+  // The last strip, if partial, is processed one vector at a time.
+  const size_t num_full_strips = xsize / fast_pace;
+  const size_t num_strips = DivCeil(xsize, fast_pace);
+
+  std::vector<AlignedMemory> scratch;
+  const auto init = [&](const size_t num_threads) -> Status {
+    for (size_t i = 0; i < num_threads; ++i) {
+      JXL_ASSIGN_OR_RETURN(AlignedMemory mem,
+                           AlignedMemory::Create(memory_manager, scratch_size));
+      memset(mem.address<float>(), 0, fast_pace * sizeof(float));
+      scratch.emplace_back(std::move(mem));
     }
-  } else if (unroll == 8) {
-    for (; x + fast_pace <= xsize; x += fast_pace) {
+    return true;
+  };
+  const auto process_strip = [&](const uint32_t task,
+                                 const size_t thread) -> Status {
+    float* zero = scratch[thread].address<float>();
+    float* ring_buffer = zero + fast_pace;
+    size_t x = task * fast_pace;
+    if (task >= num_full_strips) {
+      for (; x < xsize; x += Lanes(df)) {
+        VerticalStrip<1>(rg, x, ysize, ring_buffer, zero, in, out);
+      }
+    } else if (unroll == 4) {
+      VerticalStrip<4>(rg, x, ysize, ring_buffer, zero, in, out);
+    } else if (unroll == 8) {
       VerticalStrip<8>(rg, x, ysize, ring_buffer, zero, in, out);
-    }
-  } else if (unroll == 16) {
-    for (; x + fast_pace <= xsize; x += fast_pace) {
+    } else {
       VerticalStrip<16>(rg, x, ysize, ring_buffer, zero, in, out);
     }
-  } else {
-    JXL_UNREACHABLE("Unexpected vector size");
-  }
-  for (; x < xsize; x += Lanes(df)) {
-    VerticalStrip<1>(rg, x, ysize, ring_buffer, zero, in, out);
-  }
+    return true;
+  };
+  JXL_RETURN_IF_ERROR(RunOnPool(pool, 0, num_strips, init, process_strip,
+                                "FastGaussianVertical"));
   return true;
 }
 
@@ -554,5 +574,92 @@ Status FastGaussian(JxlMemoryManager* memory_manager,
   return true;
 }
 
+namespace {
+
+// Divides the zero-padded recursive Gaussian `out` by the weight of the taps
+// inside the image, which is the product of the 1D filters of a row and a
+// column of ones.
+Status RenormalizeBorders(const RecursiveGaussian& rg, ThreadPool* pool,
+                          ImageF* out) {
+  const size_t xsize = out->xsize();
+  const size_t ysize = out->ysize();
+  JXL_ASSIGN_OR_RETURN(
+      ImageF weights,
+      ImageF::Create(out->memory_manager(), std::max(xsize, ysize), 3));
+  FillImage(1.0f, &weights);
+  float* JXL_RESTRICT inv_x = weights.Row(1);
+  float* JXL_RESTRICT inv_y = weights.Row(2);
+  FastGaussian1D(rg, xsize, weights.ConstRow(0), inv_x);
+  FastGaussian1D(rg, ysize, weights.ConstRow(0), inv_y);
+  for (size_t x = 0; x < xsize; ++x) {
+    inv_x[x] = 1.0f / inv_x[x];
+  }
+  for (size_t y = 0; y < ysize; ++y) {
+    inv_y[y] = 1.0f / inv_y[y];
+  }
+
+  const auto process_row = [&](const uint32_t task,
+                               size_t /*thread*/) -> Status {
+    const size_t y = task;
+    float* JXL_RESTRICT row = out->Row(y);
+    const float mul_y = inv_y[y];
+    for (size_t x = 0; x < xsize; ++x) {
+      row[x] *= inv_x[x] * mul_y;
+    }
+    return true;
+  };
+  JXL_RETURN_IF_ERROR(RunOnPool(pool, 0, ysize, ThreadPool::NoInit,
+                                process_row, "RenormalizeBorders"));
+  return true;
+}
+
+}  // namespace
+
+Status GaussianBlur(const ImageF& in, const float sigma, ThreadPool* pool,
+                    ImageF* temp, ImageF* out) {
+  JXL_ENSURE(SameSize(in, *out));
+  const int radius =
+      std::max<int>(1, kGaussianTruncation * std::fabs(sigma));
+  const bool direct = radius <= 2;
+  if (!direct || &in == out) {
+    JXL_ENSURE(temp != nullptr && SameSize(in, *temp));
+  }
+  if (direct) {
+    // Same weights as the truncated kernel of butteraugli, so that its
+    // results do not depend on which blur it calls.
+    const double scaler = -1.0 / (2.0 * sigma * sigma);
+    float kernel[5] = {};
+    float sum_weights = 0.0f;
+    for (int i = -radius; i <= radius; ++i) {
+      kernel[i + 2] = std::exp(scaler * i * i);
+      sum_weights += kernel[i + 2];
+    }
+    const float scale = 1.0f / sum_weights;
+    const float w0 = kernel[2] * scale;
+    const float w1 = kernel[1] * scale;
+    const float w2 = kernel[0] * scale;
+    const WeightsSeparable5 weights = {
+        {HWY_REP4(w0), HWY_REP4(w1), HWY_REP4(w2)},
+        {HWY_REP4(w0), HWY_REP4(w1), HWY_REP4(w2)},
+    };
+    // Separable5 is not in-place.
+    if (&in == out) {
+      JXL_RETURN_IF_ERROR(Separable5(in, Rect(in), weights, pool, temp));
+      return CopyImageTo(*temp, out);
+    }
+    return Separable5(in, Rect(in), weights, pool, out);
+  }
+
+  // The horizontal pass reads all of `in` before the vertical one writes to
+  // `out`, so they may alias.
+  const RecursiveGaussian rg = CreateRecursiveGaussian(sigma);
+  JXL_RETURN_IF_ERROR(FastGaussian(
+      in.memory_manager(), rg, in.xsize(), in.ysize(),
+      [&](size_t y) { return in.ConstRow(y); },
+      [&](size_t y) { return temp->Row(y); },
+      [&](size_t y) { return out->Row(y); }, pool));
+  return RenormalizeBorders(rg, pool, out);
+}
+
 }  // namespace jxl
 #endif  // HWY_ONCE
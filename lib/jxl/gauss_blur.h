@@ -15,6 +15,7 @@
 #include "lib/jxl/base/compiler_specific.h"
 #include "lib/jxl/base/data_parallel.h"
 #include "lib/jxl/base/status.h"
+#include "lib/jxl/image.h"
 
 namespace jxl {
 
@@ -58,6 +59,20 @@ Status FastGaussian(JxlMemoryManager* memory_manager,
                     const GetConstRow& in, const GetRow& temp,
                     const GetRow& out, ThreadPool* pool = nullptr);
 
+// Kernels truncated at this multiple of sigma that fit in 5 taps are applied
+// directly by GaussianBlur; as in butteraugli, the truncated kernel has
+// max(1, kGaussianTruncation * sigma) taps on each side.
+constexpr float kGaussianTruncation = 2.25f;
+
+// 2D Gaussian of `in`, which is renormalized at the borders instead of fading
+// to zero: small sigmas use a direct 5x5 separable kernel with mirrored
+// borders, larger ones the recursive filter divided by the weight of its taps
+// inside the image. Runtime is thus independent of sigma. `temp` must be the
+// size of `in`; it may be null for the direct kernel if `out` does not alias
+// `in`. Multi-threaded on `pool`.
+Status GaussianBlur(const ImageF& in, float sigma, ThreadPool* pool,
+                    ImageF* temp, ImageF* out);
+
 }  // namespace jxl
 
 #endif  // LIB_JXL_GAUSS_BLUR_H_
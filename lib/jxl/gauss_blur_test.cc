@@ -3,7 +3,7 @@
 // Use of this source code is governed by a BSD-style
 // license that can be found in the LICENSE file.
 
-#include "tools/gauss_blur.h"
+#include "lib/jxl/gauss_blur.h"
 
 #include <jxl/memory_manager.h>
 
@@ -602,4 +602,51 @@ TEST(GaussBlurTest, TestSign) {
          out_old.Row(ytest)[xtest]);
 }
 
+// GaussianBlur renormalizes at the borders, so constant images are unchanged.
+TEST(GaussBlurTest, GaussianBlurConstant) {
+  JxlMemoryManager* memory_manager = jxl::test::MemoryManager();
+  test::ThreadPoolForTests pool(4);
+  for (size_t size : {1, 7, 64, 131}) {
+    for (float sigma : {0.5f, 1.0f, 1.5f, 3.2f, 7.2f}) {
+      JXL_TEST_ASSIGN_OR_DIE(ImageF in,
+                             ImageF::Create(memory_manager, size, size + 3));
+      FillImage(0.75f, &in);
+      JXL_TEST_ASSIGN_OR_DIE(ImageF temp,
+                             ImageF::Create(memory_manager, size, size + 3));
+      JXL_TEST_ASSIGN_OR_DIE(ImageF out,
+                             ImageF::Create(memory_manager, size, size + 3));
+      ASSERT_TRUE(GaussianBlur(in, sigma, pool.get(), &temp, &out));
+      JXL_TEST_ASSERT_OK(VerifyRelativeError(in, out, 1E-5, 1E-5, _));
+    }
+  }
+}
+
+// Away from the borders, GaussianBlur matches a direct convolution for both
+// kernels, and may run in place.
+TEST(GaussBlurTest, GaussianBlurInterior) {
+  JxlMemoryManager* memory_manager = jxl::test::MemoryManager();
+  test::ThreadPoolForTests pool(4);
+  const size_t xsize = 201;
+  const size_t ysize = 150;
+  for (float sigma : {1.2f, 3.0f, 7.0f}) {
+    JXL_TEST_ASSIGN_OR_DIE(ImageF in,
+                           ImageF::Create(memory_manager, xsize, ysize));
+    RandomFillImage(&in, -1.0f, 5.0f);
+    JXL_TEST_ASSIGN_OR_DIE(ImageF temp,
+                           ImageF::Create(memory_manager, xsize, ysize));
+    JXL_TEST_ASSIGN_OR_DIE(ImageF out,
+                           ImageF::Create(memory_manager, xsize, ysize));
+    ASSERT_TRUE(GaussianBlur(in, sigma, pool.get(), &temp, &out));
+
+    const int radius = sigma < 1.5f ? 2 : static_cast<int>(4 * sigma);
+    const ImageF expected = Convolve(in, GaussianKernel(radius, sigma));
+    const size_t border = 2 * radius;
+    JXL_TEST_ASSERT_OK(
+        VerifyRelativeError(expected, out, 1.2E-2, 4E-3, _, border));
+
+    ASSERT_TRUE(GaussianBlur(in, sigma, pool.get(), &temp, &in));
+    JXL_TEST_ASSERT_OK(VerifyRelativeError(out, in, 1E-6, 1E-6, _));
+  }
+}
+
 }  // namespace jxl
@@ -0,0 +1,163 @@
+// Copyright (c) the JPEG XL Project Authors. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#include "lib/jxl/icc_cache.h"
+
+#include <jxl/cms_interface.h>
+#include <jxl/color_encoding.h>
+#include <jxl/decode_stats.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "lib/jxl/base/common.h"
+#include "lib/jxl/base/span.h"
+#include "lib/jxl/dec_bit_reader.h"
+
+namespace jxl {
+
+namespace {
+
+// Returns bits [begin, begin + num_bits) of `data`, starting at bit 0 of the
+// first byte.
+std::vector<uint8_t> ReadBitRange(Span<const uint8_t> data, size_t begin,
+                                  size_t num_bits) {
+  std::vector<uint8_t> bits(DivCeil(num_bits, kBitsPerByte));
+  BitReader reader(data);
+  reader.SkipBits(begin);
+  for (size_t i = 0; i < bits.size(); i++) {
+    bits[i] = reader.ReadBits(
+        std::min<size_t>(kBitsPerByte, num_bits - i * kBitsPerByte));
+  }
+  if (!reader.Close()) bits.clear();
+  return bits;
+}
+
+// Returns whether bits [begin, begin + num_bits) of `data` are `bits`.
+bool SameBits(Span<const uint8_t> data, size_t begin,
+              const std::vector<uint8_t>& bits, size_t num_bits) {
+  BitReader reader(data);
+  reader.SkipBits(begin);
+  bool same = true;
+  for (size_t i = 0; same && i < bits.size(); i++) {
+    same = reader.ReadBits(std::min<size_t>(
+               kBitsPerByte, num_bits - i * kBitsPerByte)) == bits[i];
+  }
+  return static_cast<bool>(reader.Close()) && same;
+}
+
+// Index of the least recently used entry, or a new one if there is room.
+template <typename Entry>
+size_t EntryToReplace(std::vector<Entry>* entries, size_t max_entries) {
+  if (entries->size() < max_entries) {
+    entries->emplace_back();
+    return entries->size() - 1;
+  }
+  return std::min_element(entries->begin(), entries->end(),
+                          [](const Entry& a, const Entry& b) {
+                            return a.last_use < b.last_use;
+                          }) -
+         entries->begin();
+}
+
+}  // namespace
+
+ICCCache& ICCCache::Global() {
+  static ICCCache* cache = new ICCCache();
+  return *cache;
+}
+
+size_t ICCCache::LookupCompressed(const BitReader& reader,
+                                  std::vector<uint8_t>* icc) {
+  Span<const uint8_t> data(reader.FirstByte(), reader.TotalBytes());
+  const size_t begin = reader.TotalBitsConsumed();
+  const size_t available = data.size() * kBitsPerByte - begin;
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (CompressedEntry& entry : compressed_) {
+    if (entry.num_bits > available ||
+        !SameBits(data, begin, entry.bits, entry.num_bits)) {
+      continue;
+    }
+    entry.last_use = ++clock_;
+    stats_.decode_lookups++;
+    stats_.decode_hits++;
+    *icc = entry.icc;
+    return entry.num_bits;
+  }
+  return 0;
+}
+
+void ICCCache::InsertCompressed(Span<const uint8_t> data, size_t begin_bit,
+                                size_t end_bit, Span<const uint8_t> icc) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  stats_.decode_lookups++;
+  const size_t num_bits = end_bit - begin_bit;
+  if (icc.size() > kMaxICCSize || num_bits == 0 ||
+      num_bits > kMaxICCSize * kBitsPerByte) {
+    return;
+  }
+  // Another thread may have decoded the same profile meanwhile.
+  for (const CompressedEntry& entry : compressed_) {
+    if (entry.num_bits == num_bits &&
+        SameBits(data, begin_bit, entry.bits, num_bits)) {
+      return;
+    }
+  }
+  std::vector<uint8_t> bits = ReadBitRange(data, begin_bit, num_bits);
+  if (bits.empty()) return;
+  CompressedEntry& entry =
+      compressed_[EntryToReplace(&compressed_, kMaxEntries)];
+  entry.bits = std::move(bits);
+  entry.num_bits = num_bits;
+  entry.icc.assign(icc.begin(), icc.end());
+  entry.last_use = ++clock_;
+}
+
+bool ICCCache::LookupFields(const JxlCmsInterface& cms,
+                            Span<const uint8_t> icc, JxlColorEncoding* c,
+                            bool* cmyk) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  stats_.parse_lookups++;
+  for (FieldsEntry& entry : fields_) {
+    if (entry.set_fields_from_icc != cms.set_fields_from_icc ||
+        entry.set_fields_data != cms.set_fields_data ||
+        entry.icc.size() != icc.size() ||
+        !std::equal(icc.begin(), icc.end(), entry.icc.begin())) {
+      continue;
+    }
+    entry.last_use = ++clock_;
+    stats_.parse_hits++;
+    *c = entry.c;
+    *cmyk = entry.cmyk;
+    return true;
+  }
+  return false;
+}
+
+void ICCCache::InsertFields(const JxlCmsInterface& cms,
+                            Span<const uint8_t> icc, const JxlColorEncoding& c,
+                            bool cmyk) {
+  if (icc.size() > kMaxICCSize) return;
+  std::lock_guard<std::mutex> lock(mutex_);
+  FieldsEntry& entry = fields_[EntryToReplace(&fields_, kMaxEntries)];
+  entry.set_fields_from_icc = cms.set_fields_from_icc;
+  entry.set_fields_data = cms.set_fields_data;
+  entry.icc.assign(icc.begin(), icc.end());
+  entry.c = c;
+  entry.cmyk = cmyk;
+  entry.last_use = ++clock_;
+}
+
+JxlICCCacheStats ICCCache::Stats() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  JxlICCCacheStats stats = stats_;
+  stats.num_entries = compressed_.size() + fields_.size();
+  return stats;
+}
+
+}  // namespace jxl
@@ -0,0 +1,85 @@
+// Copyright (c) the JPEG XL Project Authors. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#ifndef LIB_JXL_ICC_CACHE_H_
+#define LIB_JXL_ICC_CACHE_H_
+
+// Process-wide cache of ICC profiles. Most images carry one of a few common
+// profiles, which are then decoded from the codestream and parsed by the CMS
+// only once.
+
+#include <jxl/cms_interface.h>
+#include <jxl/color_encoding.h>
+#include <jxl/decode_stats.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "lib/jxl/base/span.h"
+#include "lib/jxl/dec_bit_reader.h"
+
+namespace jxl {
+
+// Thread-safe; the entries are shared by all encoders and decoders.
+class ICCCache {
+ public:
+  static ICCCache& Global();
+
+  // If the bits that follow the position of `reader` are the compressed
+  // representation of a profile seen before, returns the number of these
+  // bits and sets `icc` to the profile. Returns 0 otherwise. Does not move
+  // `reader`.
+  size_t LookupCompressed(const BitReader& reader, std::vector<uint8_t>* icc);
+
+  // Remembers that bits [begin_bit, end_bit) of `data` decode to `icc`.
+  void InsertCompressed(Span<const uint8_t> data, size_t begin_bit,
+                        size_t end_bit, Span<const uint8_t> icc);
+
+  // Returns whether the fields that `cms` derives from `icc` are known, and
+  // if so sets `c` and `cmyk` to them.
+  bool LookupFields(const JxlCmsInterface& cms, Span<const uint8_t> icc,
+                    JxlColorEncoding* c, bool* cmyk);
+
+  void InsertFields(const JxlCmsInterface& cms, Span<const uint8_t> icc,
+                    const JxlColorEncoding& c, bool cmyk);
+
+  JxlICCCacheStats Stats();
+
+ private:
+  // Larger profiles, which are unlikely to be shared between images, are not
+  // cached.
+  static constexpr size_t kMaxEntries = 16;
+  static constexpr size_t kMaxICCSize = 1 << 18;
+
+  struct CompressedEntry {
+    // The compressed bits, starting at bit 0 of the first byte.
+    std::vector<uint8_t> bits;
+    size_t num_bits;
+    std::vector<uint8_t> icc;
+    uint64_t last_use;
+  };
+
+  struct FieldsEntry {
+    // The CMS is identified by its callback and data.
+    jpegxl_cms_set_fields_from_icc_func set_fields_from_icc;
+    void* set_fields_data;
+    std::vector<uint8_t> icc;
+    JxlColorEncoding c;
+    bool cmyk;
+    uint64_t last_use;
+  };
+
+  std::mutex mutex_;
+  std::vector<CompressedEntry> compressed_;
+  std::vector<FieldsEntry> fields_;
+  uint64_t clock_ = 0;
+  JxlICCCacheStats stats_ = {};
+};
+
+}  // namespace jxl
+
+#endif  // LIB_JXL_ICC_CACHE_H_
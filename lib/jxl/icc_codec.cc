@@ -12,10 +12,12 @@
 #include <cstdint>
 
 #include "lib/jxl/base/common.h"
+#include "lib/jxl/base/span.h"
 #include "lib/jxl/base/status.h"
 #include "lib/jxl/dec_ans.h"
 #include "lib/jxl/dec_bit_reader.h"
 #include "lib/jxl/fields.h"
+#include "lib/jxl/icc_cache.h"
 #include "lib/jxl/icc_codec_common.h"
 #include "lib/jxl/padded_bytes.h"
 
@@ -329,6 +331,10 @@ Status ICCReader::Init(BitReader* reader) {
   JXL_RETURN_IF_ERROR(CheckEOI(reader));
   JxlMemoryManager* memory_manager = decompressed_.memory_manager();
   used_bits_base_ = reader->TotalBitsConsumed();
+  if (bits_to_skip_ == 0) {
+    bits_to_skip_ = ICCCache::Global().LookupCompressed(*reader, &cached_icc_);
+    from_cache_ = bits_to_skip_ != 0;
+  }
   if (bits_to_skip_ == 0) {
     enc_size_ = U64Coder::Read(reader);
     if (enc_size_ > 268435456) {
@@ -364,6 +370,10 @@ Status ICCReader::Init(BitReader* reader) {
 }
 
 Status ICCReader::Process(BitReader* reader, PaddedBytes* icc) {
+  if (from_cache_) {
+    icc->clear();
+    return icc->append(cached_icc_);
+  }
   auto checkpoint = jxl::make_unique<ANSSymbolReader::Checkpoint>();
   size_t saved_i = 0;
   auto save = [&]() {
@@ -406,7 +416,12 @@ Status ICCReader::Process(BitReader* reader, PaddedBytes* icc) {
   }
 
   icc->clear();
-  return UnpredictICC(decompressed_.data(), decompressed_.size(), icc);
+  JXL_RETURN_IF_ERROR(
+      UnpredictICC(decompressed_.data(), decompressed_.size(), icc));
+  ICCCache::Global().InsertCompressed(
+      Bytes(reader->FirstByte(), reader->TotalBytes()), used_bits_base_,
+      used_bits_base_ + bits_to_skip_, Bytes(icc->data(), icc->size()));
+  return true;
 }
 
 Status ICCReader::CheckEOI(BitReader* reader) {
@@ -30,6 +30,8 @@ struct ICCReader {
   void Reset() {
     bits_to_skip_ = 0;
     decompressed_.clear();
+    from_cache_ = false;
+    cached_icc_.clear();
   }
 
  private:
@@ -42,6 +44,10 @@ struct ICCReader {
   ANSCode code_;
   ANSSymbolReader ans_reader_;
   PaddedBytes decompressed_;
+  // Set by Init() if the profile was found in ICCCache; Process() then only
+  // copies it.
+  bool from_cache_ = false;
+  std::vector<uint8_t> cached_icc_;
 };
 
 }  // namespace jxl
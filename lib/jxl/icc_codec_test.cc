@@ -3,6 +3,7 @@
 // Use of this source code is governed by a BSD-style
 // license that can be found in the LICENSE file.
 
+#include <jxl/decode_stats.h>
 #include <jxl/memory_manager.h>
 
 #include <cstddef>
@@ -16,6 +17,7 @@
 #include "lib/jxl/enc_aux_out.h"
 #include "lib/jxl/enc_bit_writer.h"
 #include "lib/jxl/enc_icc_codec.h"
+#include "lib/jxl/icc_cache.h"
 #include "lib/jxl/test_memory_manager.h"
 #include "lib/jxl/test_utils.h"
 #include "lib/jxl/testing.h"
@@ -213,4 +215,35 @@ TEST(IccCodecTest, EncodedIccProfile) {
   }
 }
 
+// Tests that a profile read again is taken from ICCCache, and that the reader
+// then stops at the same position.
+TEST(IccCodecTest, CachedIccProfile) {
+  JxlMemoryManager* memory_manager = jxl::test::MemoryManager();
+  IccBytes icc;
+  Bytes(kTestProfile, sizeof(kTestProfile)).AppendTo(icc);
+  // Makes the profile differ from those of the other tests.
+  icc.back() ^= 0x5A;
+  BitWriter writer{memory_manager};
+  ASSERT_TRUE(WriteICC(Span<const uint8_t>(icc), &writer,
+                       jxl::LayerType::Header, nullptr));
+  ASSERT_TRUE(writer.WithMaxBits(8, LayerType::Header, nullptr, [&] {
+    writer.Write(8, 0xA5);
+    return true;
+  }));
+  writer.ZeroPadToByte();
+
+  JxlICCCacheStats before = ICCCache::Global().Stats();
+  for (size_t pass = 0; pass < 2; pass++) {
+    std::vector<uint8_t> dec;
+    BitReader reader(writer.GetSpan());
+    ASSERT_TRUE(test::ReadICC(&reader, &dec));
+    EXPECT_EQ(0xA5u, reader.ReadFixedBits<8>());
+    ASSERT_TRUE(reader.Close());
+    EXPECT_EQ(Bytes(icc), Bytes(dec));
+  }
+  JxlICCCacheStats after = ICCCache::Global().Stats();
+  EXPECT_EQ(before.decode_lookups + 2, after.decode_lookups);
+  EXPECT_EQ(before.decode_hits + 1, after.decode_hits);
+}
+
 }  // namespace jxl
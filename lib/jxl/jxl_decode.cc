@@ -7,6 +7,7 @@
 #include <jxl/codestream_header.h>
 #include <jxl/color_encoding.h>
 #include <jxl/decode.h>
+#include <jxl/decode_stats.h>
 #include <jxl/jxl_export.h>
 #include <jxl/memory_manager.h>
 #include <jxl/parallel_runner.h>
@@ -15,11 +16,14 @@
 
 #include <algorithm>
 #include <array>
+#include <cmath>
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
 #include <functional>
 #include <memory>
+#include <mutex>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -42,6 +46,8 @@
 #include "lib/jxl/box_content_decoder.h"
 #endif
 #include "lib/jxl/dec_frame.h"
+#include "lib/jxl/dec_gain_map.h"
+#include "lib/jxl/dec_stats.h"
 #if JPEGXL_ENABLE_TRANSCODE_JPEG
 #include "lib/jxl/decode_to_jpeg.h"
 #endif
@@ -49,6 +55,7 @@
 #include "lib/jxl/frame_dimensions.h"
 #include "lib/jxl/frame_header.h"
 #include "lib/jxl/headers.h"
+#include "lib/jxl/icc_cache.h"
 #include "lib/jxl/icc_codec.h"
 #include "lib/jxl/image_bundle.h"
 #include "lib/jxl/memory_manager_internal.h"
@@ -218,6 +225,7 @@ enum class BoxStage : uint32_t {
   kCodestream,  // Handling codestream box contents, or non-container stream
   kPartialCodestream,  // Handling the extra header of partial codestream box
   kJpegRecon,          // Handling jpeg reconstruction box
+  kGainMap,            // Buffering the gain map box to render it
 };
 
 enum class JpegReconStage : uint32_t {
@@ -362,11 +370,88 @@ struct JxlDecoderFrameIndexBox {
 
 }  // namespace jxl
 
+struct JxlDecoderStats {
+  using Values = std::array<uint64_t, JXL_DEC_NUM_STATS>;
+
+  // Counters of the frame being decoded.
+  jxl::FrameDecodeStats current;
+  std::vector<Values> frames;
+
+  // While attached to a decoder, its memory manager is replaced by one that
+  // forwards to `inner` and accounts the allocations here.
+  JxlMemoryManager inner;
+  std::mutex mutex;
+  std::unordered_map<void*, size_t> allocations;
+  uint64_t bytes_in_use = 0;
+  uint64_t num_allocations = 0;
+  uint64_t peak_bytes = 0;
+  uint64_t frame_start_allocations = 0;
+  uint64_t frame_peak_bytes = 0;
+
+  static void* Alloc(void* opaque, size_t size) {
+    JxlDecoderStats* self = static_cast<JxlDecoderStats*>(opaque);
+    void* address = self->inner._alloc(self->inner.opaque, size);
+    if (address == nullptr) return nullptr;
+    std::lock_guard<std::mutex> lock(self->mutex);
+    self->allocations[address] = size;
+    self->bytes_in_use += size;
+    ++self->num_allocations;
+    self->peak_bytes = std::max(self->peak_bytes, self->bytes_in_use);
+    self->frame_peak_bytes =
+        std::max(self->frame_peak_bytes, self->bytes_in_use);
+    return address;
+  }
+
+  static void Free(void* opaque, void* address) {
+    JxlDecoderStats* self = static_cast<JxlDecoderStats*>(opaque);
+    {
+      std::lock_guard<std::mutex> lock(self->mutex);
+      // Allocations made before the collection started are not tracked.
+      auto it = self->allocations.find(address);
+      if (it != self->allocations.end()) {
+        self->bytes_in_use -= it->second;
+        self->allocations.erase(it);
+      }
+    }
+    self->inner._free(self->inner.opaque, address);
+  }
+
+  void BeginFrame(uint64_t header_bytes) {
+    current.Reset();
+    current.Add(JXL_DEC_STAT_HEADER_BYTES, header_bytes);
+    std::lock_guard<std::mutex> lock(mutex);
+    frame_start_allocations = num_allocations;
+    frame_peak_bytes = bytes_in_use;
+  }
+
+  void EndFrame() {
+    Values values;
+    for (size_t i = 0; i < values.size(); ++i) {
+      JxlDecoderStatsKey key = static_cast<JxlDecoderStatsKey>(i);
+      values[i] = current.Get(key);
+      if (key == JXL_DEC_STAT_ENTROPY_DECODE_USEC ||
+          key == JXL_DEC_STAT_TRANSFORM_USEC ||
+          key == JXL_DEC_STAT_RENDER_USEC) {
+        values[i] = (values[i] + 500) / 1000;
+      }
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      values[JXL_DEC_STAT_NUM_ALLOCATIONS] =
+          num_allocations - frame_start_allocations;
+      values[JXL_DEC_STAT_PEAK_MEMORY_BYTES] = frame_peak_bytes;
+    }
+    frames.push_back(values);
+  }
+};
+
 // NOLINTNEXTLINE(clang-analyzer-optin.performance.Padding)
 struct JxlDecoder {
   JxlDecoder() = default;
 
   JxlMemoryManager memory_manager;
+  // Not owned; set by JxlDecoderCollectStats.
+  JxlDecoderStats* stats = nullptr;
   std::unique_ptr<jxl::ThreadPool> thread_pool;
 
   DecoderStage stage;
@@ -430,6 +515,8 @@ struct JxlDecoder {
   bool render_spotcolors;
   bool coalescing;
   float desired_intensity_target;
+  bool render_gain_map;
+  float display_headroom;
 
   // Bitfield, for which informative events (JXL_DEC_BASIC_INFO, etc...) the
   // decoder returns a status. By default, do not return for any of the events,
@@ -492,6 +579,9 @@ struct JxlDecoder {
 
   size_t remaining_frame_size;
   FrameStage frame_stage;
+  // Whether the TOC of a frame was processed. The gain map must be known
+  // before that.
+  bool got_frame_toc;
   bool dc_frame_progression_done;
   // The currently processed frame is the last of the current composite still,
   // and so must be returned as pixels
@@ -544,7 +634,12 @@ struct JxlDecoder {
 
 #if JPEGXL_ENABLE_BOXES
   jxl::JxlBoxContentDecoder box_content_decoder;
+  // Decodes the gain map box, if it is rendered.
+  jxl::JxlBoxContentDecoder gain_map_decoder;
+  std::vector<uint8_t> gain_map_box;
+  size_t gain_map_box_pos;
 #endif
+  std::unique_ptr<jxl::GainMap> gain_map;
 #if JPEGXL_ENABLE_TRANSCODE_JPEG
   jxl::JxlToJpegDecoder jpeg_decoder;
   // Decodes Exif or XMP metadata for JPEG reconstruction
@@ -715,6 +810,12 @@ void JxlDecoderRewindDecodingState(JxlDecoder* dec) {
   dec->box_out_buffer_size = 0;
   dec->box_out_buffer_begin = 0;
   dec->box_out_buffer_pos = 0;
+#if JPEGXL_ENABLE_BOXES
+  dec->gain_map_box.clear();
+  dec->gain_map_box_pos = 0;
+#endif
+  dec->gain_map.reset();
+  dec->got_frame_toc = false;
 
 #if JPEGXL_ENABLE_TRANSCODE_JPEG
   dec->exif_metadata.clear();
@@ -770,8 +871,17 @@ void JxlDecoderRewindDecodingState(JxlDecoder* dec) {
   dec->external_frames = 0;
 }
 
+// Stops collecting statistics and restores the memory manager of the decoder.
+void JxlDecoderStopCollectingStats(JxlDecoder* dec) {
+  if (!dec->stats) return;
+  dec->memory_manager = dec->stats->inner;
+  if (dec->passes_state) dec->passes_state->stats = nullptr;
+  dec->stats = nullptr;
+}
+
 void JxlDecoderReset(JxlDecoder* dec) {
   JxlDecoderRewindDecodingState(dec);
+  JxlDecoderStopCollectingStats(dec);
 
   dec->thread_pool.reset();
   dec->keep_orientation = false;
@@ -779,6 +889,8 @@ void JxlDecoderReset(JxlDecoder* dec) {
   dec->render_spotcolors = true;
   dec->coalescing = true;
   dec->desired_intensity_target = 0;
+  dec->render_gain_map = false;
+  dec->display_headroom = 0;
   dec->orig_events_wanted = 0;
   dec->events_wanted = 0;
   dec->frame_refs.clear();
@@ -806,6 +918,7 @@ JxlDecoder* JxlDecoderCreate(const JxlMemoryManager* memory_manager) {
 
 void JxlDecoderDestroy(JxlDecoder* dec) {
   if (dec) {
+    JxlDecoderStopCollectingStats(dec);
     JxlMemoryManager local_memory_manager = dec->memory_manager;
     // Call destructor directly since custom free function is used.
     dec->~JxlDecoder();
@@ -1262,6 +1375,10 @@ JxlDecoderStatus JxlDecoderProcessCodestream(JxlDecoder* dec) {
         return JXL_INPUT_ERROR("invalid frame header");
       }
       dec->AdvanceCodestream(reader->TotalBitsConsumed() / kBitsPerByte);
+      if (dec->stats) {
+        dec->stats->BeginFrame(reader->TotalBitsConsumed() / kBitsPerByte);
+        dec->passes_state->stats = &dec->stats->current;
+      }
       *dec->frame_header = dec->frame_dec->GetFrameHeader();
       jxl::FrameDimensions frame_dim = dec->frame_header->ToFrameDimensions();
       if (!CheckSizeLimit(dec, frame_dim.xsize_upsampled_padded,
@@ -1363,6 +1480,8 @@ JxlDecoderStatus JxlDecoderProcessCodestream(JxlDecoder* dec) {
     if (dec->frame_stage == FrameStage::kTOC) {
       dec->frame_dec->SetRenderSpotcolors(dec->render_spotcolors);
       dec->frame_dec->SetCoalescing(dec->coalescing);
+      dec->frame_dec->SetGainMap(dec->gain_map.get(), dec->display_headroom);
+      dec->got_frame_toc = true;
 
       if (!dec->preview_frame &&
           (dec->events_wanted & JXL_DEC_FRAME_PROGRESSION)) {
@@ -1477,6 +1596,7 @@ JxlDecoderStatus JxlDecoderProcessCodestream(JxlDecoder* dec) {
       if (!dec->frame_dec->FinalizeFrame()) {
         return JXL_INPUT_ERROR("decoding frame failed");
       }
+      if (dec->stats) dec->stats->EndFrame();
 #if JPEGXL_ENABLE_TRANSCODE_JPEG
       // If jpeg output was requested, we merely return the JXL_DEC_FULL_IMAGE
       // status without outputting pixels.
@@ -1864,6 +1984,18 @@ static JxlDecoderStatus HandleBoxes(JxlDecoder* dec) {
               "multiple JPEG reconstruction boxes not supported");
         }
         dec->box_stage = BoxStage::kJpegRecon;
+#endif
+#if JPEGXL_ENABLE_BOXES
+      } else if (dec->render_gain_map && !dec->got_frame_toc &&
+                 !dec->box_contents_unbounded &&
+                 memcmp(dec->box_decoded_type, "jhgm", 4) == 0) {
+        // The gain map is only rendered if known before the first frame.
+        bool brob = memcmp(dec->box_type, "brob", 4) == 0;
+        dec->gain_map_decoder.StartBox(brob, /*box_until_eof=*/false,
+                                       dec->box_contents_size);
+        dec->gain_map_box.clear();
+        dec->gain_map_box_pos = 0;
+        dec->box_stage = BoxStage::kGainMap;
 #endif
       } else {
         dec->box_stage = BoxStage::kSkip;
@@ -1985,6 +2117,42 @@ static JxlDecoderStatus HandleBoxes(JxlDecoder* dec) {
         // If anything else, return the result.
         return recon_result;
       }
+#endif
+#if JPEGXL_ENABLE_BOXES
+    } else if (dec->box_stage == BoxStage::kGainMap) {
+      JxlDecoderStatus box_result;
+      for (;;) {
+        if (dec->gain_map_box_pos == dec->gain_map_box.size()) {
+          dec->gain_map_box.resize(
+              std::max<size_t>(64, dec->gain_map_box.size() * 2));
+        }
+        uint8_t* orig_next_out =
+            dec->gain_map_box.data() + dec->gain_map_box_pos;
+        uint8_t* next_out = orig_next_out;
+        size_t avail_out = dec->gain_map_box.size() - dec->gain_map_box_pos;
+        box_result = dec->gain_map_decoder.Process(
+            dec->next_in, dec->avail_in,
+            dec->file_pos - dec->box_contents_begin, &next_out, &avail_out);
+        dec->gain_map_box_pos += next_out - orig_next_out;
+        if (box_result != JXL_DEC_BOX_NEED_MORE_OUTPUT) break;
+      }
+      if (box_result == JXL_DEC_NEED_MORE_INPUT) {
+        dec->AdvanceInput(
+            std::min(dec->avail_in, dec->box_contents_end - dec->file_pos));
+        return JXL_DEC_NEED_MORE_INPUT;
+      }
+      if (box_result != JXL_DEC_BOX_COMPLETE) {
+        return JXL_INPUT_ERROR("invalid gain map box");
+      }
+      dec->gain_map_box.resize(dec->gain_map_box_pos);
+      if (!jxl::DecodeGainMapBox(
+              &dec->memory_manager,
+              jxl::Span<const uint8_t>(dec->gain_map_box), &dec->gain_map)) {
+        return JXL_INPUT_ERROR("invalid gain map");
+      }
+      dec->gain_map_box.clear();
+      // Skips what remains of the box.
+      dec->box_stage = BoxStage::kSkip;
 #endif
     } else if (dec->box_stage == BoxStage::kSkip) {
       if (dec->box_contents_unbounded) {
@@ -2737,6 +2905,19 @@ JxlDecoderStatus JxlDecoderSetDesiredIntensityTarget(
   return JXL_DEC_SUCCESS;
 }
 
+JxlDecoderStatus JxlDecoderSetGainMapHeadroom(JxlDecoder* dec,
+                                              float display_headroom) {
+  if (dec->stage != DecoderStage::kInited) {
+    return JXL_API_ERROR("Must set gain map headroom before starting");
+  }
+  if (!std::isfinite(display_headroom)) {
+    return JXL_API_ERROR("invalid gain map headroom requested");
+  }
+  dec->render_gain_map = true;
+  dec->display_headroom = display_headroom;
+  return JXL_DEC_SUCCESS;
+}
+
 JxlDecoderStatus JxlDecoderSetBoxBuffer(JxlDecoder* dec, uint8_t* data,
                                         size_t size) {
   if (dec->box_out_buffer_set) {
@@ -2856,3 +3037,55 @@ JxlDecoderStatus JxlDecoderSetImageOutBitDepth(JxlDecoder* dec,
   dec->image_out_bit_depth = *bit_depth;
   return JXL_DEC_SUCCESS;
 }
+
+JxlDecoderStats* JxlDecoderStatsCreate() { return new JxlDecoderStats(); }
+
+void JxlDecoderStatsDestroy(JxlDecoderStats* stats) { delete stats; }
+
+void JxlDecoderCollectStats(JxlDecoder* dec, JxlDecoderStats* stats) {
+  JxlDecoderStopCollectingStats(dec);
+  if (!stats) return;
+  stats->inner = dec->memory_manager;
+  dec->memory_manager.opaque = stats;
+  dec->memory_manager._alloc = &JxlDecoderStats::Alloc;
+  dec->memory_manager._free = &JxlDecoderStats::Free;
+  dec->stats = stats;
+}
+
+size_t JxlDecoderStatsGet(const JxlDecoderStats* stats,
+                          JxlDecoderStatsKey key) {
+  if (!stats || static_cast<size_t>(key) >= JXL_DEC_NUM_STATS) return 0;
+  if (key == JXL_DEC_STAT_NUM_ALLOCATIONS) return stats->num_allocations;
+  if (key == JXL_DEC_STAT_PEAK_MEMORY_BYTES) return stats->peak_bytes;
+  uint64_t total = 0;
+  for (const auto& frame : stats->frames) total += frame[key];
+  return total;
+}
+
+size_t JxlDecoderStatsNumFrames(const JxlDecoderStats* stats) {
+  if (!stats) return 0;
+  return stats->frames.size();
+}
+
+size_t JxlDecoderStatsGetFrame(const JxlDecoderStats* stats, size_t frame,
+                               JxlDecoderStatsKey key) {
+  if (!stats || frame >= stats->frames.size() ||
+      static_cast<size_t>(key) >= JXL_DEC_NUM_STATS) {
+    return 0;
+  }
+  return stats->frames[frame][key];
+}
+
+void JxlDecoderStatsMerge(JxlDecoderStats* stats,
+                          const JxlDecoderStats* other) {
+  if (!stats || !other || stats == other) return;
+  stats->frames.insert(stats->frames.end(), other->frames.begin(),
+                       other->frames.end());
+  stats->num_allocations += other->num_allocations;
+  stats->peak_bytes = std::max(stats->peak_bytes, other->peak_bytes);
+}
+
+void JxlDecoderGetICCCacheStats(JxlICCCacheStats* stats) {
+  if (!stats) return;
+  *stats = jxl::ICCCache::Global().Stats();
+}
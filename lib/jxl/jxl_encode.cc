@@ -500,9 +500,9 @@ void QueueBox(JxlEncoder* enc,
 }
 
 // TODO(lode): share this code and the Brotli compression code in enc_jpeg_data
-JxlEncoderStatus BrotliCompress(int quality, const uint8_t* in, size_t in_size,
-                                jxl::PaddedBytes* out) {
-  JxlMemoryManager* memory_manager = out->memory_manager();
+JxlEncoderStatus BrotliCompress(JxlMemoryManager* memory_manager, int quality,
+                                const uint8_t* in, size_t in_size,
+                                std::vector<uint8_t>* out) {
   std::unique_ptr<BrotliEncoderState, decltype(BrotliEncoderDestroyInstance)*>
       enc(BrotliEncoderCreateInstance(nullptr, nullptr, nullptr),
           BrotliEncoderDestroyInstance);
@@ -535,11 +535,8 @@ JxlEncoderStatus BrotliCompress(int quality, const uint8_t* in, size_t in_size,
     }
     size_t out_size = next_out - temp_buffer.data();
     jxl::msan::UnpoisonMemory(next_out - out_size, out_size);
-    if (!out->resize(out->size() + out_size)) {
-      return JXL_API_ERROR_NOSET("resizing of PaddedBytes failed");
-    }
-
-    memcpy(out->data() + out->size() - out_size, temp_buffer.data(), out_size);
+    out->insert(out->end(), temp_buffer.data(),
+                temp_buffer.data() + out_size);
     if (BrotliEncoderIsFinished(enc.get())) break;
   }
 
@@ -1085,25 +1082,20 @@ jxl::Status JxlEncoder::ProcessOneEnqueuedInput() {
     }
   } else {
     // Not a frame, so is a box instead
+    if (input.box->compress_box && input.box->brob_contents.empty()) {
+      if (!CompressQueuedBoxes()) {
+        return JXL_API_ERROR(this, JXL_ENC_ERR_GENERIC,
+                             "Brotli compression for brob box failed");
+      }
+    }
     jxl::MemoryManagerUniquePtr<jxl::JxlEncoderQueuedBox> box =
         std::move(input.box);
     input_queue.erase(input_queue.begin());
     num_queued_boxes--;
 
     if (box->compress_box) {
-      jxl::PaddedBytes compressed(&memory_manager);
-      // Prepend the original box type in the brob box contents
-      JXL_RETURN_IF_ERROR(compressed.append(box->type));
-      if (JXL_ENC_SUCCESS !=
-          BrotliCompress((brotli_effort >= 0 ? brotli_effort : 4),
-                         box->contents.data(), box->contents.size(),
-                         &compressed)) {
-        return JXL_API_ERROR(this, JXL_ENC_ERR_GENERIC,
-                             "Brotli compression for brob box failed");
-      }
-
       JXL_RETURN_IF_ERROR(
-          AppendBoxWithContents(jxl::MakeBoxType("brob"), compressed));
+          AppendBoxWithContents(jxl::MakeBoxType("brob"), box->brob_contents));
     } else {
       JXL_RETURN_IF_ERROR(AppendBoxWithContents(box->type, box->contents));
     }
@@ -1112,6 +1104,34 @@ jxl::Status JxlEncoder::ProcessOneEnqueuedInput() {
   return jxl::OkStatus();
 }
 
+jxl::Status JxlEncoder::CompressQueuedBoxes() {
+  // Typically the Exif, XMP and JUMBF boxes of a recompressed JPEG, which are
+  // queued together, so compressing them all at once makes them independent
+  // tasks of similar size.
+  std::vector<jxl::JxlEncoderQueuedBox*> boxes;
+  for (jxl::JxlEncoderQueuedInput& input : input_queue) {
+    if (input.box && input.box->compress_box &&
+        input.box->brob_contents.empty()) {
+      boxes.push_back(input.box.get());
+    }
+  }
+  const int quality = brotli_effort >= 0 ? brotli_effort : 4;
+  return jxl::RunOnPool(
+      thread_pool.get(), 0, boxes.size(), jxl::ThreadPool::NoInit,
+      [&](size_t i, size_t /* thread */) -> jxl::Status {
+        jxl::JxlEncoderQueuedBox* box = boxes[i];
+        // Prepend the original box type in the brob box contents
+        std::vector<uint8_t> brob(box->type.begin(), box->type.end());
+        if (BrotliCompress(&memory_manager, quality, box->contents.data(),
+                           box->contents.size(), &brob) != JXL_ENC_SUCCESS) {
+          return JXL_FAILURE("Brotli compression failed");
+        }
+        box->brob_contents = std::move(brob);
+        return true;
+      },
+      "CompressBoxes");
+}
+
 JxlEncoderStatus JxlEncoderSetColorEncoding(JxlEncoder* enc,
                                             const JxlColorEncoding* color) {
   if (!enc->basic_info_set) {
@@ -2757,6 +2777,12 @@ JXL_EXPORT void JxlEncoderCollectStats(JxlEncoderFrameSettings* frame_settings,
   frame_settings->values.aux_out = stats->aux_out.get();
 }
 
+namespace {
+size_t PhaseMicroseconds(const jxl::AuxOut& aux_out, jxl::EncoderPhase phase) {
+  return static_cast<size_t>(aux_out.phase(phase) * 1e6 + 0.5);
+}
+}  // namespace
+
 JXL_EXPORT size_t JxlEncoderStatsGet(const JxlEncoderStats* stats,
                                      JxlEncoderStatsKey key) {
   if (!stats) return 0;
@@ -2814,6 +2840,69 @@ JXL_EXPORT size_t JxlEncoderStatsGet(const JxlEncoderStats* stats,
       return aux_out.num_dct64_blocks;
     case JXL_ENC_STAT_NUM_BUTTERAUGLI_ITERS:
       return aux_out.num_butteraugli_iters;
+    case JXL_ENC_STAT_INPUT_USEC:
+      return PhaseMicroseconds(aux_out, jxl::EncoderPhase::Input);
+    case JXL_ENC_STAT_HEURISTICS_USEC:
+      return PhaseMicroseconds(aux_out, jxl::EncoderPhase::Heuristics);
+    case JXL_ENC_STAT_COEF_ORDER_USEC:
+      return PhaseMicroseconds(aux_out, jxl::EncoderPhase::CoeffOrders);
+    case JXL_ENC_STAT_TOKENIZATION_USEC:
+      return PhaseMicroseconds(aux_out, jxl::EncoderPhase::Tokenization);
+    case JXL_ENC_STAT_MODULAR_USEC:
+      return PhaseMicroseconds(aux_out, jxl::EncoderPhase::Modular);
+    case JXL_ENC_STAT_HISTOGRAM_USEC:
+      return PhaseMicroseconds(aux_out, jxl::EncoderPhase::Histograms);
+    case JXL_ENC_STAT_GROUP_ENCODING_USEC:
+      return PhaseMicroseconds(aux_out, jxl::EncoderPhase::GroupEncoding);
+    default:
+      return 0;
+  }
+}
+
+JXL_EXPORT size_t JxlEncoderStatsNumGroups(const JxlEncoderStats* stats) {
+  if (!stats) return 0;
+  return stats->aux_out->group_stats.size();
+}
+
+JXL_EXPORT size_t JxlEncoderStatsGetGroup(const JxlEncoderStats* stats,
+                                          size_t group,
+                                          JxlEncoderGroupStatsKey key) {
+  static_assert(JXL_ENC_GROUP_STAT_NUM_DCT64_BLOCKS -
+                        JXL_ENC_GROUP_STAT_NUM_SMALL_BLOCKS + 1 ==
+                    jxl::kNumBlockSizeClasses,
+                "Keys must match the block size classes");
+  if (!stats || group >= stats->aux_out->group_stats.size()) return 0;
+  const jxl::GroupStats& group_stats = stats->aux_out->group_stats[group];
+  const auto usec = [](double seconds) {
+    return static_cast<size_t>(seconds * 1e6 + 0.5);
+  };
+  if (key >= JXL_ENC_GROUP_STAT_NUM_SMALL_BLOCKS &&
+      key <= JXL_ENC_GROUP_STAT_NUM_DCT64_BLOCKS) {
+    return group_stats.num_blocks[key - JXL_ENC_GROUP_STAT_NUM_SMALL_BLOCKS];
+  }
+  switch (key) {
+    case JXL_ENC_GROUP_STAT_X0:
+      return group_stats.x0;
+    case JXL_ENC_GROUP_STAT_Y0:
+      return group_stats.y0;
+    case JXL_ENC_GROUP_STAT_XSIZE:
+      return group_stats.xsize;
+    case JXL_ENC_GROUP_STAT_YSIZE:
+      return group_stats.ysize;
+    case JXL_ENC_GROUP_STAT_HEURISTICS_USEC:
+      return usec(group_stats.heuristics_seconds);
+    case JXL_ENC_GROUP_STAT_TOKENIZATION_USEC:
+      return usec(group_stats.tokenization_seconds);
+    case JXL_ENC_GROUP_STAT_ENCODING_USEC:
+      return usec(group_stats.encoding_seconds);
+    case JXL_ENC_GROUP_STAT_BITS:
+      return group_stats.bits;
+    case JXL_ENC_GROUP_STAT_MIN_QUANT:
+      return static_cast<size_t>(group_stats.min_quant);
+    case JXL_ENC_GROUP_STAT_MAX_QUANT:
+      return static_cast<size_t>(group_stats.max_quant);
+    case JXL_ENC_GROUP_STAT_QUANT_SUM:
+      return group_stats.quant_sum;
     default:
       return 0;
   }
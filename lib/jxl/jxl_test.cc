@@ -9,6 +9,7 @@
 #include <jxl/color_encoding.h>
 #include <jxl/encode.h>
 #include <jxl/memory_manager.h>
+#include <jxl/trace.h>
 #include <jxl/types.h>
 
 #include <algorithm>
@@ -34,6 +35,7 @@
 #include "lib/jxl/base/data_parallel.h"
 #include "lib/jxl/base/span.h"
 #include "lib/jxl/base/status.h"
+#include "lib/jxl/base/trace.h"  // JPEGXL_ENABLE_TRACING
 #include "lib/jxl/butteraugli/butteraugli.h"
 #include "lib/jxl/color_encoding_internal.h"
 #include "lib/jxl/common.h"  // JXL_HIGH_PRECISION
@@ -150,6 +152,86 @@ TEST(JxlTest, RoundtripSmallD1) {
     EXPECT_EQ(ppf_out.info.intensity_target, t.ppf().info.intensity_target);
   }
 }
+
+TEST(JxlTest, RoundtripTargetButteraugli) {
+  const std::vector<uint8_t> orig =
+      ReadTestData("external/wesaturate/500px/u76c0g_bliznaca_srgb8.png");
+  TestImage t;
+  ASSERT_TRUE(t.DecodeFromBytes(orig));
+  t.ClearMetadata();
+  size_t xsize = t.ppf().info.xsize / 8;
+  size_t ysize = t.ppf().info.ysize / 8;
+  ASSERT_TRUE(t.SetDimensions(xsize, ysize));
+
+  extras::JXLTargetScoreParams target;
+  target.target_score = -2.0;
+  target.tolerance = 0.1;
+  size_t num_scored = 0;
+  const auto score = [&](const std::vector<uint8_t>& compressed,
+                         double* score) -> bool {
+    PackedPixelFile ppf_out;
+    if (!extras::DecodeImageJXL(compressed.data(), compressed.size(), {},
+                                /* decoded_bytes */ nullptr, &ppf_out)) {
+      return false;
+    }
+    *score = -ButteraugliDistance(t.ppf(), ppf_out);
+    ++num_scored;
+    return true;
+  };
+  std::vector<uint8_t> compressed;
+  extras::JXLTargetScoreResult result;
+  ASSERT_TRUE(extras::EncodeImageJXLToTargetScore(
+      JXLCompressParams(), t.ppf(), score, target, &compressed, &result));
+  EXPECT_TRUE(result.reached);
+  EXPECT_EQ(result.num_probes, num_scored);
+  EXPECT_LE(result.num_probes, target.max_probes);
+
+  // The output is the probe that reached the target.
+  PackedPixelFile ppf_out;
+  ASSERT_TRUE(extras::DecodeImageJXL(compressed.data(), compressed.size(), {},
+                                     /* decoded_bytes */ nullptr, &ppf_out));
+  const double distance = ButteraugliDistance(t.ppf(), ppf_out);
+  EXPECT_LE(distance, 2.0);
+  EXPECT_NEAR(distance, -result.score, 1e-6);
+}
+
+TEST(JxlTest, RoundtripTrace) {
+  std::string trace;
+  const JxlTraceWriteFunc write = [](void* opaque, const char* data,
+                                     size_t size) {
+    static_cast<std::string*>(opaque)->append(data, size);
+  };
+#if JPEGXL_ENABLE_TRACING
+  ThreadPoolForTests pool(4);
+  const std::vector<uint8_t> orig = ReadTestData("jxl/flower/flower.png");
+  TestImage t;
+  ASSERT_TRUE(t.DecodeFromBytes(orig));
+  t.ClearMetadata();
+  ASSERT_TRUE(JxlTraceStart(write, &trace));
+  // Only one trace at a time.
+  EXPECT_FALSE(JxlTraceStart(write, &trace));
+  PackedPixelFile ppf_out;
+  Roundtrip(t.ppf(), {}, {}, pool.get(), &ppf_out);
+  JxlTraceStop();
+  ASSERT_GT(trace.size(), 4u);
+  EXPECT_EQ(trace.compare(0, 15, "{\"traceEvents\":"), 0);
+  EXPECT_EQ(trace.compare(trace.size() - 4, 4, "\n]}\n"), 0);
+  for (const char* name : {"ComputeEncodingData", "EncodeGroups",
+                           "ProcessSections", "DecodeGroup", "RenderGroup"}) {
+    EXPECT_NE(trace.find(std::string("\"") + name + "\""), std::string::npos)
+        << name;
+  }
+  // Nothing is written after stopping.
+  const size_t trace_size = trace.size();
+  Roundtrip(t.ppf(), {}, {}, pool.get(), &ppf_out);
+  EXPECT_EQ(trace.size(), trace_size);
+#else
+  EXPECT_FALSE(JxlTraceStart(write, &trace));
+  JxlTraceStop();
+  EXPECT_TRUE(trace.empty());
+#endif
+}
+
 TEST(JxlTest, RoundtripResample2) {
   ThreadPool* pool = nullptr;
   const std::vector<uint8_t> orig =
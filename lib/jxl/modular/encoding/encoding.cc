@@ -6,6 +6,7 @@
 #include "lib/jxl/modular/encoding/encoding.h"
 
 #include <jxl/memory_manager.h>
+#include <jxl/types.h>
 
 #include <algorithm>
 #include <array>
@@ -616,6 +617,11 @@ Status ModularDecode(BitReader *br, Image &image, GroupHeader &header,
     max_tree_size = std::min(static_cast<uint64_t>(1 << 20), max_tree_size);
     JXL_RETURN_IF_ERROR(
         DecodeTree(memory_manager, br, &tree_storage, max_tree_size));
+    if (options->tree_splits_on_stream_id != nullptr) {
+      for (const PropertyDecisionNode &node : tree_storage) {
+        if (node.property == 1) *options->tree_splits_on_stream_id = JXL_TRUE;
+      }
+    }
     JXL_RETURN_IF_ERROR(DecodeHistograms(memory_manager, br,
                                          (tree_storage.size() + 1) / 2,
                                          &code_storage, &context_map_storage));
@@ -67,6 +67,11 @@ struct ModularOptions {
   // Used during decoding for validation of transforms (sqeeezing) scheme.
   size_t group_dim = 0x1FFFFFFF;
 
+  /// Decode options:
+  // If not null, set to true if the stream has its own MA tree that splits on
+  // the stream id (property 1).
+  uint8_t* tree_splits_on_stream_id = nullptr;
+
   /// Encode options:
   // Fraction of pixels to look at to learn a MA tree
   // Number of iterations to do to learn a MA tree
@@ -8,6 +8,7 @@
 #include <jxl/memory_manager.h>
 #include <jxl/types.h>
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
 #include <future>
@@ -17,9 +18,14 @@
 
 #include "lib/extras/dec/jxl.h"
 #include "lib/extras/packed_image.h"
+#include "lib/jxl/ac_strategy.h"
 #include "lib/jxl/base/data_parallel.h"
+#include "lib/jxl/base/random.h"
 #include "lib/jxl/base/span.h"
 #include "lib/jxl/base/status.h"
+#include "lib/jxl/coeff_order_fwd.h"
+#include "lib/jxl/enc_progressive_split.h"
+#include "lib/jxl/frame_dimensions.h"
 #include "lib/jxl/test_utils.h"
 #include "lib/jxl/testing.h"
 
@@ -425,5 +431,51 @@ TEST(PassesTest, RoundtripSmallNoGaborishPasses) {
   EXPECT_SLIGHTLY_BELOW(ButteraugliDistance(ppf, ppf2, pool), 1.0);
 }
 
+// The encoder only keeps the sum of all passes and splits off each pass while
+// tokenizing, so the passes must add up to the block again.
+TEST(PassesTest, SplitPassesAddUp) {
+  const PassDefinition kNestedPasses[] = {
+      {2, 0, 4}, {4, 0, 4}, {8, 2, 2}, {8, 1, 2}, {8, 0, 1}};
+  // A shifted pass followed by one with more coefficients.
+  const PassDefinition kWidenedPasses[] = {{2, 0, 4}, {4, 2, 2}, {8, 0, 1}};
+  for (const ProgressiveMode& mode :
+       {ProgressiveMode{kNestedPasses}, ProgressiveMode{kWidenedPasses}}) {
+    ProgressiveSplitter splitter;
+    splitter.SetProgressiveMode(mode);
+    Rng rng(0);
+    std::vector<int32_t> block(AcStrategy::kMaxCoeffArea);
+    std::vector<int32_t> pass_block(AcStrategy::kMaxCoeffArea);
+    std::vector<int32_t> sum(AcStrategy::kMaxCoeffArea);
+    for (AcStrategyType type :
+         {AcStrategyType::DCT, AcStrategyType::DCT16X8,
+          AcStrategyType::DCT32X32, AcStrategyType::DCT64X32}) {
+      const AcStrategy acs = AcStrategy::FromRawStrategy(type);
+      const size_t size = kDCTBlockSize << acs.log2_covered_blocks();
+      for (size_t i = 0; i < size; i++) {
+        block[i] = rng.UniformI(-1000, 1001);
+      }
+      std::fill(sum.begin(), sum.end(), 0);
+      for (size_t pass = 0; pass < splitter.GetNumPasses(); pass++) {
+        splitter.SplitACCoefficients(block.data(), acs, pass,
+                                     pass_block.data());
+        for (size_t i = 0; i < size; i++) {
+          sum[i] += pass_block[i] * (1 << mode.passes[pass].shift);
+        }
+      }
+      // The LLF coefficients are part of the DC, not of any pass.
+      size_t cx = acs.covered_blocks_x();
+      size_t cy = acs.covered_blocks_y();
+      CoefficientLayout(&cy, &cx);
+      for (size_t y = 0; y < cy * kBlockDim; y++) {
+        for (size_t x = 0; x < cx * kBlockDim; x++) {
+          if (x < cx && y < cy) continue;
+          const size_t pos = y * cx * kBlockDim + x;
+          ASSERT_EQ(block[pos], sum[pos]);
+        }
+      }
+    }
+  }
+}
+
 }  // namespace
 }  // namespace jxl
@@ -18,6 +18,7 @@
 #include "lib/jxl/base/compiler_specific.h"  // ssize_t
 #include "lib/jxl/base/rect.h"
 #include "lib/jxl/base/status.h"
+#include "lib/jxl/base/trace.h"
 #include "lib/jxl/dec_group_border.h"
 #include "lib/jxl/image.h"
 #include "lib/jxl/image_ops.h"
@@ -591,6 +592,12 @@ Status LowMemoryRenderPipeline::RenderRect(size_t thread_id,
                                            std::vector<ImageF>& input_data,
                                            Rect data_max_color_channel_rect,
                                            Rect image_max_color_channel_rect) {
+#if JPEGXL_ENABLE_TRACING
+  // Stages run interleaved row by row, so only their total time in this rect
+  // is reported, as arguments of one event.
+  trace::TraceScope trace_scope("RenderStages", "render");
+  std::vector<double> stage_us(trace_scope.active() ? stages_.size() : 0);
+#endif
   // For each stage, the rect corresponding to the image area currently being
   // processed, in the coordinates of that stage (i.e. with the scaling factor
   // that that stage has).
@@ -737,6 +744,10 @@ Status LowMemoryRenderPipeline::RenderRect(size_t thread_id,
       prepare_io_rows(y, i);
 
       // Produce output rows.
+#if JPEGXL_ENABLE_TRACING
+      trace::TraceAccumulator stage_timer(stage_us.empty() ? nullptr
+                                                           : &stage_us[i]);
+#endif
       JXL_RETURN_IF_ERROR(stages_[i]->ProcessRow(
           input_rows[i], output_rows, xpadding_for_output_[i],
           group_rect[i].xsize(), group_rect[i].x0(), image_y, thread_id));
@@ -779,11 +790,21 @@ Status LowMemoryRenderPipeline::RenderRect(size_t thread_id,
           i < first_image_dim_stage_ ? full_image_x0 - frame_x0 : full_image_x0;
       size_t y0 =
           i < first_image_dim_stage_ ? full_image_y - frame_y0 : full_image_y;
+#if JPEGXL_ENABLE_TRACING
+      trace::TraceAccumulator stage_timer(stage_us.empty() ? nullptr
+                                                           : &stage_us[i]);
+#endif
       JXL_RETURN_IF_ERROR(stages_[i]->ProcessRow(
           input_rows[first_trailing_stage_], output_rows,
           /*xextra=*/0, full_image_x1 - full_image_x0, x0, y0, thread_id));
     }
   }
+#if JPEGXL_ENABLE_TRACING
+  for (size_t i = 0; i < stage_us.size(); i++) {
+    trace_scope.AddArg(stages_[i]->GetName(),
+                       static_cast<int64_t>(stage_us[i]));
+  }
+#endif
   return true;
 }
 
@@ -811,6 +832,7 @@ Status LowMemoryRenderPipeline::RenderPadding(size_t thread_id, Rect rect) {
 
 Status LowMemoryRenderPipeline::ProcessBuffers(size_t group_id,
                                                size_t thread_id) {
+  JXL_TRACE_SCOPE_ARG("RenderGroup", "group", group_id);
   std::vector<ImageF>& input_data =
       group_data_[use_group_ids_ ? group_id : thread_id];
 
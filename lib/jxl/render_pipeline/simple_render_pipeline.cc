@@ -19,6 +19,7 @@
 #include "lib/jxl/base/rect.h"
 #include "lib/jxl/base/sanitizers.h"
 #include "lib/jxl/base/status.h"
+#include "lib/jxl/base/trace.h"
 #include "lib/jxl/frame_header.h"
 #include "lib/jxl/image.h"
 #include "lib/jxl/image_ops.h"
@@ -89,6 +90,7 @@ Status SimpleRenderPipeline::ProcessBuffers(size_t group_id, size_t thread_id) {
 
   for (size_t stage_id = 0; stage_id < stages_.size(); stage_id++) {
     const auto& stage = stages_[stage_id];
+    JXL_TRACE_SCOPE_ARG(stage->GetName(), "stage", stage_id);
     // Prepare buffers for kInOut channels.
     std::vector<ImageF> new_channels(channel_data_.size());
     std::vector<ImageF*> output_channels(channel_data_.size());
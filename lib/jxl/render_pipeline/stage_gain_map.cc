@@ -0,0 +1,203 @@
+// Copyright (c) the JPEG XL Project Authors. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#include "lib/jxl/render_pipeline/stage_gain_map.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "lib/jxl/base/common.h"
+#include "lib/jxl/base/compiler_specific.h"  // ssize_t
+#include "lib/jxl/base/sanitizers.h"
+#include "lib/jxl/base/status.h"
+#include "lib/jxl/dec_gain_map.h"
+#include "lib/jxl/dec_xyb.h"
+#include "lib/jxl/image.h"
+#include "lib/jxl/render_pipeline/render_pipeline_stage.h"
+
+#undef HWY_TARGET_INCLUDE
+#define HWY_TARGET_INCLUDE "lib/jxl/render_pipeline/stage_gain_map.cc"
+#include <hwy/foreach_target.h>
+#include <hwy/highway.h>
+
+#include "lib/jxl/base/fast_math-inl.h"
+
+HWY_BEFORE_NAMESPACE();
+namespace jxl {
+namespace HWY_NAMESPACE {
+
+// These templates are not found via ADL.
+using hwy::HWY_NAMESPACE::Add;
+using hwy::HWY_NAMESPACE::Clamp;
+using hwy::HWY_NAMESPACE::GatherIndex;
+using hwy::HWY_NAMESPACE::Min;
+using hwy::HWY_NAMESPACE::Mul;
+using hwy::HWY_NAMESPACE::MulAdd;
+using hwy::HWY_NAMESPACE::MulSub;
+using hwy::HWY_NAMESPACE::Rebind;
+using hwy::HWY_NAMESPACE::Sub;
+
+class GainMapStage : public RenderPipelineStage {
+ public:
+  GainMapStage(const GainMap& gain_map, float weight, float scale)
+      : RenderPipelineStage(RenderPipelineStage::Settings()),
+        gain_map_(gain_map),
+        weight_(weight),
+        scale_(scale),
+        inv_scale_(1.0f / scale) {}
+
+  Status SetInputSizes(
+      const std::vector<std::pair<size_t, size_t>>& input_sizes) override {
+    JXL_ENSURE(input_sizes.size() >= 3);
+    x_scale_ = static_cast<float>(gain_map_.log_gain.xsize()) /
+               std::max<size_t>(input_sizes[0].first, 1);
+    y_scale_ = static_cast<float>(gain_map_.log_gain.ysize()) /
+               std::max<size_t>(input_sizes[0].second, 1);
+    return true;
+  }
+
+  Status ProcessRow(const RowInfo& input_rows, const RowInfo& output_rows,
+                    size_t xextra, size_t xsize, size_t xpos, size_t ypos,
+                    size_t thread_id) const final {
+    const Image3F& log_gain = gain_map_.log_gain;
+    const GainMapMetadata& metadata = gain_map_.metadata;
+    const HWY_FULL(float) df;
+    const Rebind<int32_t, decltype(df)> di;
+    // Finds the two gain map samples around each image position, where the
+    // scale is the ratio of the gain map size to the image size, and the
+    // weight of the second one.
+    const float y = Clamp1((ypos + 0.5f) * y_scale_ - 0.5f, 0.0f,
+                           log_gain.ysize() - 1.0f);
+    const size_t y0 = static_cast<size_t>(y);
+    const size_t y1 = std::min(y0 + 1, log_gain.ysize() - 1);
+    const auto fy = Set(df, y - y0);
+    const auto x_scale = Set(df, x_scale_);
+    const auto half = Set(df, 0.5f);
+    const auto x_max = Set(df, log_gain.xsize() - 1.0f);
+    const auto x_max_index =
+        Set(di, static_cast<int32_t>(log_gain.xsize() - 1));
+    const auto weight = Set(df, weight_);
+    const auto scale = Set(df, scale_);
+    const auto inv_scale = Set(df, inv_scale_);
+
+    const size_t xsize_v = RoundUpTo(xsize, Lanes(df));
+    float* JXL_RESTRICT rows[3];
+    const float* rows0[3];
+    const float* rows1[3];
+    for (size_t c = 0; c < 3; c++) {
+      rows[c] = GetInputRow(input_rows, c, 0);
+      rows0[c] = log_gain.ConstPlaneRow(c, y0);
+      rows1[c] = log_gain.ConstPlaneRow(c, y1);
+      // Temporarily unpoison the last vector tail.
+      msan::UnpoisonMemory(rows[c] + xsize, sizeof(float) * (xsize_v - xsize));
+    }
+    for (ssize_t x = -xextra; x < static_cast<ssize_t>(xsize + xextra);
+         x += Lanes(df)) {
+      const auto pos =
+          Iota(df, static_cast<float>(static_cast<ssize_t>(xpos) + x));
+      const auto p =
+          Clamp(MulSub(Add(pos, half), x_scale, half), Zero(df), x_max);
+      // Truncates, as the positions are not negative.
+      const auto x0 = ConvertTo(di, p);
+      const auto x1 = Min(Add(x0, Set(di, 1)), x_max_index);
+      const auto fx = Sub(p, ConvertTo(df, x0));
+      for (size_t c = 0; c < 3; c++) {
+        const auto top0 = GatherIndex(df, rows0[c], x0);
+        const auto top = MulAdd(Sub(GatherIndex(df, rows0[c], x1), top0), fx,
+                                top0);
+        const auto bottom0 = GatherIndex(df, rows1[c], x0);
+        const auto bottom = MulAdd(
+            Sub(GatherIndex(df, rows1[c], x1), bottom0), fx, bottom0);
+        const auto gain =
+            FastPow2f(df, Mul(weight, MulAdd(Sub(bottom, top), fy, top)));
+        const auto base = MulAdd(LoadU(df, rows[c] + x), scale,
+                                 Set(df, metadata.base_offset[c]));
+        const auto alternate =
+            MulSub(base, gain, Set(df, metadata.alternate_offset[c]));
+        StoreU(Mul(alternate, inv_scale), df, rows[c] + x);
+      }
+    }
+    for (size_t c = 0; c < 3; c++) {
+      msan::PoisonMemory(rows[c] + xsize, sizeof(float) * (xsize_v - xsize));
+    }
+    return true;
+  }
+
+  RenderPipelineChannelMode GetChannelMode(size_t c) const final {
+    return c < 3 ? RenderPipelineChannelMode::kInPlace
+                 : RenderPipelineChannelMode::kIgnored;
+  }
+
+  const char* GetName() const override { return "GainMap"; }
+
+ private:
+  const GainMap& gain_map_;
+  // Weight of the log2 gain, from the display headroom.
+  const float weight_;
+  // Converts the pipeline scale to multiples of the reference white, in which
+  // the gain map offsets are expressed.
+  const float scale_;
+  const float inv_scale_;
+  float x_scale_ = 1.0f;
+  float y_scale_ = 1.0f;
+};
+
+std::unique_ptr<RenderPipelineStage> MakeGainMapStage(const GainMap& gain_map,
+                                                      float weight,
+                                                      float scale) {
+  return jxl::make_unique<GainMapStage>(gain_map, weight, scale);
+}
+
+// NOLINTNEXTLINE(google-readability-namespace-comments)
+}  // namespace HWY_NAMESPACE
+}  // namespace jxl
+HWY_AFTER_NAMESPACE();
+
+#if HWY_ONCE
+namespace jxl {
+
+HWY_EXPORT(MakeGainMapStage);
+
+namespace {
+
+// Reference white of PQ and HLG images, in nits (ITU-R BT.2408).
+constexpr float kHdrReferenceWhite = 203.0f;
+
+}  // namespace
+
+std::unique_ptr<RenderPipelineStage> GetGainMapStage(
+    const GainMap& gain_map, float display_headroom,
+    const OutputEncodingInfo& output_encoding_info) {
+  const GainMapMetadata& metadata = gain_map.metadata;
+  const float headroom_range =
+      metadata.alternate_hdr_headroom - metadata.base_hdr_headroom;
+  if (headroom_range == 0.0f || gain_map.log_gain.xsize() == 0 ||
+      gain_map.log_gain.ysize() == 0) {
+    return nullptr;
+  }
+  const float weight = Clamp1(
+      (display_headroom - metadata.base_hdr_headroom) / headroom_range, 0.0f,
+      1.0f);
+  if (weight == 0.0f) return nullptr;
+
+  const float intensity_target = output_encoding_info.orig_intensity_target;
+  const auto& orig_tf = output_encoding_info.orig_color_encoding.Tf();
+  const float reference_white = (orig_tf.IsPQ() || orig_tf.IsHLG())
+                                    ? kHdrReferenceWhite
+                                    : intensity_target;
+  // Luminance of (1, 1, 1) in the pipeline, as for the tone mapping stage.
+  const float one = output_encoding_info.color_encoding.Tf().IsPQ()
+                        ? 10000.0f
+                        : intensity_target;
+  return HWY_DYNAMIC_DISPATCH(MakeGainMapStage)(gain_map, weight,
+                                                one / reference_white);
+}
+
+}  // namespace jxl
+#endif
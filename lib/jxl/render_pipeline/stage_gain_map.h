@@ -0,0 +1,31 @@
+// Copyright (c) the JPEG XL Project Authors. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#ifndef LIB_JXL_RENDER_PIPELINE_STAGE_GAIN_MAP_H_
+#define LIB_JXL_RENDER_PIPELINE_STAGE_GAIN_MAP_H_
+
+#include <memory>
+
+#include "lib/jxl/dec_gain_map.h"
+#include "lib/jxl/dec_xyb.h"
+#include "lib/jxl/render_pipeline/render_pipeline_stage.h"
+
+namespace jxl {
+
+// Applies `gain_map` to render the image for a display whose headroom is
+// `display_headroom`, the log2 of the ratio of its peak to its reference
+// white. The image must be in linear space and scaled like the input of the
+// tone mapping stage, and keeps that scale. The reference white is the
+// nominal white of an SDR base image, or 203 nits for a PQ or HLG base image.
+// The gain map is sampled bilinearly for each row, without upsampling it.
+//
+// If the gain map has no effect at that headroom, this will return nullptr.
+std::unique_ptr<RenderPipelineStage> GetGainMapStage(
+    const GainMap& gain_map, float display_headroom,
+    const OutputEncodingInfo& output_encoding_info);
+
+}  // namespace jxl
+
+#endif  // LIB_JXL_RENDER_PIPELINE_STAGE_GAIN_MAP_H_
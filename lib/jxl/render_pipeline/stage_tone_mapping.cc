@@ -54,6 +54,17 @@ class ToneMappingStage : public RenderPipelineStage {
           /*target_luminance=*/output_encoding_info_.desired_intensity_target,
           output_encoding_info_.luminances);
     }
+    // The scale factors only depend on the luminance, so they are tabulated
+    // once per frame instead of evaluating the curves for every pixel.
+    if (tone_mapper_) {
+      const ToneMapper& tone_mapper = *tone_mapper_;
+      scale_table_ = jxl::make_unique<LuminanceScaleTable>(
+          [&](float luminance) { return tone_mapper.Multiplier(luminance); });
+    } else if (hlg_ootf_) {
+      const HlgOOTF& hlg_ootf = *hlg_ootf_;
+      scale_table_ = jxl::make_unique<LuminanceScaleTable>(
+          [&](float luminance) { return hlg_ootf.Ratio(luminance); });
+    }
 
     if (dest_tf.IsPQ() && (tone_mapper_ || hlg_ootf_)) {
       to_intensity_target_ =
@@ -92,9 +103,9 @@ class ToneMappingStage : public RenderPipelineStage {
       g = Mul(g, Set(d, to_intensity_target_));
       b = Mul(b, Set(d, to_intensity_target_));
       if (tone_mapper_) {
-        tone_mapper_->ToneMap(&r, &g, &b);
+        tone_mapper_->ToneMap(*scale_table_, &r, &g, &b);
       } else {
-        hlg_ootf_->Apply(&r, &g, &b);
+        hlg_ootf_->Apply(*scale_table_, &r, &g, &b);
       }
       if (tone_mapper_ || hlg_ootf_->WarrantsGamutMapping()) {
         GamutMap(&r, &g, &b, output_encoding_info_.luminances);
@@ -124,6 +135,7 @@ class ToneMappingStage : public RenderPipelineStage {
   OutputEncodingInfo output_encoding_info_;
   std::unique_ptr<ToneMapper> tone_mapper_;
   std::unique_ptr<HlgOOTF> hlg_ootf_;
+  std::unique_ptr<LuminanceScaleTable> scale_table_;
   // When the target colorspace is PQ, 1 represents 10000 nits instead of
   // orig_intensity_target. This temporarily changes this if the tone mappers
   // require it.
@@ -631,7 +631,7 @@ float ButteraugliDistance(const ImageBundle& rgb0, const ImageBundle& rgb1,
                           const ButteraugliParams& params,
                           const JxlCmsInterface& cms, ImageF* distmap,
                           ThreadPool* pool, bool ignore_alpha) {
-  JxlButteraugliComparator comparator(params, cms);
+  JxlButteraugliComparator comparator(params, cms, pool);
   float distance;
   Check(ComputeScore(rgb0, rgb1, &comparator, cms, &distance, distmap, pool,
                      ignore_alpha));
@@ -643,7 +643,7 @@ float ButteraugliDistance(const std::vector<ImageBundle>& frames0,
                           const ButteraugliParams& params,
                           const JxlCmsInterface& cms, ImageF* distmap,
                           ThreadPool* pool) {
-  JxlButteraugliComparator comparator(params, cms);
+  JxlButteraugliComparator comparator(params, cms, pool);
   Check(frames0.size() == frames1.size());
   float max_dist = 0.0f;
   for (size_t i = 0; i < frames0.size(); ++i) {
@@ -0,0 +1,26 @@
+// Copyright (c) the JPEG XL Project Authors. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#include <jxl/trace.h>
+#include <jxl/types.h>
+
+#include "lib/jxl/base/trace.h"
+
+JXL_BOOL JxlTraceStart(JxlTraceWriteFunc write, void* opaque) {
+#if JPEGXL_ENABLE_TRACING
+  if (write == nullptr) return JXL_FALSE;
+  return TO_JXL_BOOL(jxl::trace::Tracer::Get().Start(write, opaque));
+#else
+  (void)write;
+  (void)opaque;
+  return JXL_FALSE;
+#endif
+}
+
+void JxlTraceStop(void) {
+#if JPEGXL_ENABLE_TRACING
+  jxl::trace::Tracer::Get().Stop();
+#endif
+}
@@ -22,11 +22,6 @@ if(benchmark_FOUND)
       INTERFACE_LINK_LIBRARIES "Threads::Threads;-lrt")
   endif()
 
-  list(APPEND JPEGXL_INTERNAL_TESTS
-    # TODO(eustas): Move this to tools/
-    ../tools/gauss_blur_gbench.cc
-  )
-
   # Compiles all the benchmark files into a single binary. Individual benchmarks
   # can be run with --benchmark_filter.
   add_executable(jxl_gbench "${JPEGXL_INTERNAL_GBENCH_SOURCES}" gbench_main.cc)
@@ -39,6 +34,20 @@ if(benchmark_FOUND)
     jxl_tool
     benchmark::benchmark
   )
+
+  # End-to-end encoder and decoder API benchmarks, kept separate from the
+  # microbenchmarks above since a full run takes several minutes.
+  add_executable(jxl_api_gbench ../tools/jxl_api_gbench.cc gbench_main.cc)
+
+  target_compile_definitions(jxl_api_gbench PRIVATE
+    -DTEST_DATA_PATH="${JPEGXL_TEST_DATA_PATH}")
+  target_link_libraries(jxl_api_gbench
+    jxl_extras-internal
+    jxl-internal
+    jxl_threads
+    jxl_tool
+    benchmark::benchmark
+  )
 else()
   message(STATUS "benchmark NOT found")
 endif() # benchmark_FOUND
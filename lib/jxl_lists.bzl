@@ -33,6 +33,7 @@ libjxl_base_sources = [
     "jxl/base/scope_guard.h",
     "jxl/base/span.h",
     "jxl/base/status.h",
+    "jxl/base/trace.h",
 ]
 
 libjxl_cms_sources = [
@@ -82,6 +83,8 @@ libjxl_codec_jpg_sources = [
 libjxl_codec_jxl_sources = [
     "extras/dec/jxl.cc",
     "extras/dec/jxl.h",
+    "extras/dec/row_reorder_buffer.cc",
+    "extras/dec/row_reorder_buffer.h",
     "extras/enc/jxl.cc",
     "extras/enc/jxl.h",
 ]
@@ -165,6 +168,8 @@ libjxl_dec_sources = [
     "jxl/dec_external_image.h",
     "jxl/dec_frame.cc",
     "jxl/dec_frame.h",
+    "jxl/dec_gain_map.cc",
+    "jxl/dec_gain_map.h",
     "jxl/dec_group.cc",
     "jxl/dec_group.h",
     "jxl/dec_group_border.cc",
@@ -177,6 +182,7 @@ libjxl_dec_sources = [
     "jxl/dec_noise.h",
     "jxl/dec_patch_dictionary.cc",
     "jxl/dec_patch_dictionary.h",
+    "jxl/dec_stats.h",
     "jxl/dec_transforms-inl.h",
     "jxl/dec_xyb-inl.h",
     "jxl/dec_xyb.cc",
@@ -196,6 +202,8 @@ libjxl_dec_sources = [
     "jxl/headers.h",
     "jxl/huffman_table.cc",
     "jxl/huffman_table.h",
+    "jxl/icc_cache.cc",
+    "jxl/icc_cache.h",
     "jxl/icc_codec.cc",
     "jxl/icc_codec.h",
     "jxl/icc_codec_common.cc",
@@ -268,6 +276,8 @@ libjxl_dec_sources = [
     "jxl/render_pipeline/stage_from_linear.h",
     "jxl/render_pipeline/stage_gaborish.cc",
     "jxl/render_pipeline/stage_gaborish.h",
+    "jxl/render_pipeline/stage_gain_map.cc",
+    "jxl/render_pipeline/stage_gain_map.h",
     "jxl/render_pipeline/stage_noise.cc",
     "jxl/render_pipeline/stage_noise.h",
     "jxl/render_pipeline/stage_patches.cc",
@@ -295,6 +305,7 @@ libjxl_dec_sources = [
     "jxl/splines.h",
     "jxl/toc.cc",
     "jxl/toc.h",
+    "jxl/trace.cc",
     "jxl/transpose-inl.h",
     "jxl/xorshift128plus-inl.h",
 ]
@@ -385,6 +396,8 @@ libjxl_enc_sources = [
     "jxl/enc_splines.h",
     "jxl/enc_toc.cc",
     "jxl/enc_toc.h",
+    "jxl/enc_transcode.cc",
+    "jxl/enc_transcode.h",
     "jxl/enc_transforms-inl.h",
     "jxl/enc_transforms.cc",
     "jxl/enc_transforms.h",
@@ -392,6 +405,8 @@ libjxl_enc_sources = [
     "jxl/enc_xyb.h",
     "jxl/encode.cc",
     "jxl/encode_internal.h",
+    "jxl/gauss_blur.cc",
+    "jxl/gauss_blur.h",
     "jxl/jpeg/enc_jpeg_data.cc",
     "jxl/jpeg/enc_jpeg_data.h",
     "jxl/jpeg/enc_jpeg_data_reader.cc",
@@ -455,9 +470,11 @@ libjxl_extras_sources = [
 
 libjxl_gbench_sources = [
     "extras/tone_mapping_gbench.cc",
+    "jxl/butteraugli/butteraugli_gbench.cc",
     "jxl/dct_gbench.cc",
     "jxl/dec_external_image_gbench.cc",
     "jxl/enc_external_image_gbench.cc",
+    "jxl/gauss_blur_gbench.cc",
     "jxl/splines_gbench.cc",
     "jxl/tf_gbench.cc",
 ]
@@ -564,12 +581,14 @@ libjxl_public_headers = [
     "include/jxl/compressed_icc.h",
     "include/jxl/decode.h",
     "include/jxl/decode_cxx.h",
+    "include/jxl/decode_stats.h",
     "include/jxl/encode.h",
     "include/jxl/encode_cxx.h",
     "include/jxl/gain_map.h",
     "include/jxl/memory_manager.h",
     "include/jxl/parallel_runner.h",
     "include/jxl/stats.h",
+    "include/jxl/trace.h",
     "include/jxl/types.h",
 ]
 
@@ -594,6 +613,7 @@ libjxl_tests = [
     "extras/compressed_icc_test.cc",
     "extras/dec/color_description_test.cc",
     "extras/dec/pgx_test.cc",
+    "extras/dec/row_reorder_buffer_test.cc",
     "extras/gain_map_test.cc",
     "extras/jpegli_test.cc",
     "jxl/ac_strategy_test.cc",
@@ -613,6 +633,7 @@ libjxl_tests = [
     "jxl/convolve_test.cc",
     "jxl/data_parallel_test.cc",
     "jxl/dct_test.cc",
+    "jxl/dec_gain_map_test.cc",
     "jxl/decode_test.cc",
     "jxl/enc_bit_writer_test.cc",
     "jxl/enc_external_image_test.cc",
@@ -620,11 +641,13 @@ libjxl_tests = [
     "jxl/enc_linalg_test.cc",
     "jxl/enc_optimize_test.cc",
     "jxl/enc_photon_noise_test.cc",
+    "jxl/enc_transcode_test.cc",
     "jxl/encode_test.cc",
     "jxl/entropy_coder_test.cc",
     "jxl/fast_math_test.cc",
     "jxl/fields_test.cc",
     "jxl/gamma_correct_test.cc",
+    "jxl/gauss_blur_test.cc",
     "jxl/gradient_test.cc",
     "jxl/iaca_test.cc",
     "jxl/icc_codec_test.cc",
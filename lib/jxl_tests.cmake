@@ -29,7 +29,7 @@ endif()
 list(APPEND JPEGXL_INTERNAL_TESTS
   # TODO(deymo): Move this to tools/
   ../tools/djxl_fuzzer_test.cc
-  ../tools/gauss_blur_test.cc
+  ../tools/ssimulacra2_test.cc
 )
 
 set(JXL_WASM_TEST_LINK_FLAGS "")
@@ -60,6 +60,9 @@ foreach (TESTFILE IN LISTS JPEGXL_INTERNAL_TESTS)
   if(TESTFILE STREQUAL ../tools/djxl_fuzzer_test.cc)
     add_executable(${TESTNAME} ${TESTFILE} ../tools/djxl_fuzzer.cc)
     target_link_libraries(${TESTNAME} jxl_tool)
+  elseif(TESTFILE STREQUAL ../tools/ssimulacra2_test.cc)
+    add_executable(${TESTNAME} ${TESTFILE})
+    target_link_libraries(${TESTNAME} jxl_ssimulacra2)
   else()
     add_executable(${TESTNAME} ${TESTFILE})
   endif()
@@ -80,9 +83,6 @@ foreach (TESTFILE IN LISTS JPEGXL_INTERNAL_TESTS)
     jxl_testlib-internal
     jxl_extras-internal
   )
-  if(TESTFILE STREQUAL ../tools/gauss_blur_test.cc)
-    target_link_libraries(${TESTNAME} jxl_gauss_blur)
-  endif()
 
   # Output test targets in the test directory.
   set_target_properties(${TESTNAME} PROPERTIES PREFIX "tests/")
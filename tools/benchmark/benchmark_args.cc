@@ -83,6 +83,16 @@ Status BenchmarkArgs::AddCommandLineOptions() {
       &print_more_stats, "print_more_stats",
       "Prints codec-specific stats. Not safe for concurrent benchmark runs.",
       false);
+  AddString(&json_out, "json_out",
+            "If not empty, writes per-codec and per-image results, encoder "
+            "and decoder phase timings and hardware counters as JSON to this "
+            "file.");
+  AddFlag(&perf_counters, "perf_counters",
+          "Collects cycles, instructions, cache misses and branch misses "
+          "of each encode and decode run (Linux perf_event_open only). "
+          "Counters are per thread, use --inner_threads=0 to include all "
+          "the codec work.",
+          false);
   AddFlag(&print_distance_percentiles, "print_distance_percentiles",
           "Prints distance percentiles for the corpus. Not safe for "
           "concurrent benchmark runs.",
@@ -186,6 +196,24 @@ Status BenchmarkArgs::AddCommandLineOptions() {
               "Defaults to 1.",
               1);
 
+  AddFlag(&compare, "compare",
+          "Runs the two codecs given with --codec on each image with "
+          "interleaved --encode_reps/--decode_reps repetitions, and prints "
+          "the encode time, decode time and size change of the second codec "
+          "with confidence intervals.",
+          false);
+  AddString(&compare_baseline, "compare_baseline",
+            "Compares the single codec given with --codec against the "
+            "samples written earlier with --compare_out to this file.");
+  AddString(&compare_out, "compare_out",
+            "Writes the timing and size samples of the (last) codec to this "
+            "file, for later use with --compare_baseline.");
+  AddDouble(&regression_threshold, "regression_threshold",
+            "If positive, exits with an error in comparison mode when the "
+            "lower confidence bound of an encode time, decode time or size "
+            "increase exceeds this many percent.",
+            0.0);
+
   AddString(&sample_tmp_dir, "sample_tmp_dir",
             "Directory to put samples from input images.");
 
@@ -267,6 +295,24 @@ Status BenchmarkArgs::ValidateArgs() {
 
   if (print_details_csv) print_details = true;
 
+  if (compare || !compare_baseline.empty() || !compare_out.empty()) {
+    const size_t num_codecs = SplitString(codec, ',').size();
+    if (compare && !compare_baseline.empty()) {
+      return JXL_FAILURE("--compare and --compare_baseline are exclusive");
+    }
+    if (compare && num_codecs != 2) {
+      return JXL_FAILURE("--compare needs exactly two codecs");
+    }
+    if (!compare && num_codecs != 1) {
+      return JXL_FAILURE(
+          "--compare_baseline and --compare_out need exactly one codec");
+    }
+    if (decode_only || generations > 0) {
+      return JXL_FAILURE(
+          "Comparison mode does not support --decode_only or --generations");
+    }
+  }
+
   if (override_bitdepth > 32) {
     return JXL_FAILURE("override_bitdepth must be <= 32");
   }
@@ -108,6 +108,8 @@ struct BenchmarkArgs {
   bool print_details_csv;
   bool print_more_stats;
   bool print_distance_percentiles;
+  std::string json_out;
+  bool perf_counters;
   bool silent_errors;
   bool save_compressed;
   bool save_decompressed;
@@ -146,6 +148,11 @@ struct BenchmarkArgs {
   size_t encode_reps;
   size_t generations;
 
+  bool compare;
+  std::string compare_baseline;
+  std::string compare_out;
+  double regression_threshold;
+
   std::string sample_tmp_dir;
 
   int num_samples;
@@ -5,6 +5,7 @@
 #include "tools/benchmark/benchmark_codec_jxl.h"
 
 #include <jxl/color_encoding.h>
+#include <jxl/decode_stats.h>
 #include <jxl/encode.h>
 #include <jxl/memory_manager.h>
 #include <jxl/stats.h>
@@ -133,7 +134,8 @@ class JxlCodec : public ImageCodec {
   JxlCodec(const BenchmarkArgs& args, JxlMemoryManager* memory_manager)
       : ImageCodec(args),
         memory_manager_(memory_manager),
-        stats_(nullptr, JxlEncoderStatsDestroy) {}
+        stats_(nullptr, JxlEncoderStatsDestroy),
+        dec_stats_(nullptr, JxlDecoderStatsDestroy) {}
 
   Status ParseParam(const std::string& param) override {
     const std::string kMaxPassesPrefix = "max_passes=";
@@ -290,7 +292,7 @@ class JxlCodec : public ImageCodec {
     }
     DebugTicket ticket;
     JXL_RETURN_IF_ERROR(SetDebugImageCallback(filename, &ticket, &cparams_));
-    if (args_.print_more_stats) {
+    if (args_.print_more_stats || !args_.json_out.empty()) {
       stats_.reset(JxlEncoderStatsCreate());
       cparams_.stats = stats_.get();
     }
@@ -320,6 +322,10 @@ class JxlCodec : public ImageCodec {
     // originals, so we must set the option to keep the original orientation
     // instead.
     dparams_.keep_orientation = true;
+    if (!args_.json_out.empty()) {
+      dec_stats_.reset(JxlDecoderStatsCreate());
+      dparams_.stats = dec_stats_.get();
+    }
     size_t decoded_bytes;
     const double start = jxl::Now();
     JXL_RETURN_IF_ERROR(jxl::extras::DecodeImageJXL(
@@ -332,6 +338,10 @@ class JxlCodec : public ImageCodec {
   void GetMoreStats(BenchmarkStats* stats) override {
     stats->jxl_stats.num_inputs += 1;
     JxlEncoderStatsMerge(stats->jxl_stats.stats.get(), stats_.get());
+    if (dec_stats_) {
+      stats->jxl_dec_stats.num_inputs += 1;
+      JxlDecoderStatsMerge(stats->jxl_dec_stats.stats.get(), dec_stats_.get());
+    }
   }
 
  protected:
@@ -342,6 +352,8 @@ class JxlCodec : public ImageCodec {
   bool uint8_ = false;
   JxlMemoryManager* memory_manager_;
   std::unique_ptr<JxlEncoderStats, decltype(JxlEncoderStatsDestroy)*> stats_;
+  std::unique_ptr<JxlDecoderStats, decltype(JxlDecoderStatsDestroy)*>
+      dec_stats_;
 
  private:
   struct DebugTicket {
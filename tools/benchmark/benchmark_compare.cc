@@ -0,0 +1,216 @@
+// Copyright (c) the JPEG XL Project Authors. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#include "tools/benchmark/benchmark_compare.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "lib/jxl/base/printf_macros.h"
+#include "lib/jxl/base/status.h"
+#include "tools/benchmark/benchmark_args.h"
+#include "tools/benchmark/benchmark_stats.h"
+#include "tools/file_io.h"
+
+namespace jpegxl {
+namespace tools {
+
+namespace {
+
+constexpr char kSamplesHeader[] = "image,operation,rep,seconds,bytes";
+
+// Two-sided 95% quantile of Student's t distribution. Between table entries,
+// the value for the next lower degree of freedom is used (conservative).
+double StudentT95(size_t degrees_of_freedom) {
+  static const double kTable[30] = {
+      12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+      2.201,  2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+      2.080,  2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+  if (degrees_of_freedom == 0) return 0.0;
+  if (degrees_of_freedom <= 30) return kTable[degrees_of_freedom - 1];
+  if (degrees_of_freedom <= 40) return 2.042;
+  if (degrees_of_freedom <= 60) return 2.021;
+  if (degrees_of_freedom <= 120) return 2.000;
+  return 1.980;
+}
+
+// Converts a mean log ratio to a relative change in percent.
+double ToPercent(double log_ratio) { return 100.0 * (std::exp(log_ratio) - 1); }
+
+Status ParseSampleLine(const std::string& line, RunSamples* samples) {
+  std::vector<std::string> fields = SplitString(line, ',');
+  if (fields.size() < 5) {
+    return JXL_FAILURE("Invalid samples line: %s", line.c_str());
+  }
+  // The image name is everything before the last four fields, so that it
+  // may contain commas.
+  const size_t n = fields.size();
+  std::string image = fields[0];
+  for (size_t i = 1; i + 4 < n; ++i) image += "," + fields[i];
+  const std::string& operation = fields[n - 4];
+  char* end;
+  const double seconds = strtod(fields[n - 2].c_str(), &end);
+  if (*end != '\0' || !(seconds >= 0)) {
+    return JXL_FAILURE("Invalid time in samples line: %s", line.c_str());
+  }
+  const size_t bytes = strtoull(fields[n - 1].c_str(), &end, 10);
+  if (*end != '\0') {
+    return JXL_FAILURE("Invalid size in samples line: %s", line.c_str());
+  }
+  RunSamples::Image& entry = samples->images[image];
+  if (operation == "encode") {
+    entry.encode_seconds.push_back(seconds);
+  } else if (operation == "decode") {
+    entry.decode_seconds.push_back(seconds);
+  } else {
+    return JXL_FAILURE("Invalid operation in samples line: %s", line.c_str());
+  }
+  entry.compressed_size = bytes;
+  return true;
+}
+
+// Paired log ratios of candidate over baseline timings, for the repetitions
+// both runs have.
+void AddTimeRatios(const std::vector<double>& baseline,
+                   const std::vector<double>& candidate,
+                   std::vector<double>* log_ratios) {
+  const size_t reps = std::min(baseline.size(), candidate.size());
+  for (size_t i = 0; i < reps; ++i) {
+    if (baseline[i] > 0 && candidate[i] > 0) {
+      log_ratios->push_back(std::log(candidate[i] / baseline[i]));
+    }
+  }
+}
+
+void PrintChange(const char* name, const std::vector<double>& log_ratios,
+                 double threshold_percent, bool* regressed) {
+  if (log_ratios.empty()) {
+    printf("%-12s %10s %10s %10s %8d\n", name, "---", "---", "---", 0);
+    return;
+  }
+  const ConfidenceInterval ci = ComputeConfidenceInterval(log_ratios);
+  const double lower = ToPercent(ci.lower);
+  printf("%-12s %+9.2f%% %+9.2f%% %+9.2f%% %8" PRIuS, name, ToPercent(ci.mean),
+         lower, ToPercent(ci.upper), ci.num_samples);
+  if (threshold_percent > 0 && lower > threshold_percent) {
+    printf("  REGRESSION (> %.2f%%)", threshold_percent);
+    *regressed = true;
+  }
+  printf("\n");
+}
+
+}  // namespace
+
+Status WriteRunSamples(const RunSamples& samples, const std::string& filename) {
+  std::string out = "# benchmark_xl samples: " + samples.method + "\n";
+  out += kSamplesHeader;
+  out += "\n";
+  for (const auto& it : samples.images) {
+    const RunSamples::Image& image = it.second;
+    for (size_t i = 0; i < image.encode_seconds.size(); ++i) {
+      out += StringPrintf("%s,encode,%" PRIuS ",%.9g,%" PRIuS "\n",
+                          it.first.c_str(), i, image.encode_seconds[i],
+                          image.compressed_size);
+    }
+    for (size_t i = 0; i < image.decode_seconds.size(); ++i) {
+      out += StringPrintf("%s,decode,%" PRIuS ",%.9g,%" PRIuS "\n",
+                          it.first.c_str(), i, image.decode_seconds[i],
+                          image.compressed_size);
+    }
+  }
+  return WriteFile(filename, out);
+}
+
+Status ReadRunSamples(const std::string& filename, RunSamples* samples) {
+  std::vector<uint8_t> bytes;
+  if (!ReadFile(filename, &bytes)) {
+    return JXL_FAILURE("Could not read samples file %s", filename.c_str());
+  }
+  const std::string contents(bytes.begin(), bytes.end());
+  const std::string method_prefix = "# benchmark_xl samples: ";
+  for (std::string line : SplitString(contents, '\n')) {
+    if (!line.empty() && line.back() == '\r') line.pop_back();
+    if (line.empty() || line == kSamplesHeader) continue;
+    if (line.compare(0, method_prefix.size(), method_prefix) == 0) {
+      samples->method = line.substr(method_prefix.size());
+      continue;
+    }
+    if (line[0] == '#') continue;
+    JXL_RETURN_IF_ERROR(ParseSampleLine(line, samples));
+  }
+  if (samples->images.empty()) {
+    return JXL_FAILURE("No samples in %s", filename.c_str());
+  }
+  return true;
+}
+
+ConfidenceInterval ComputeConfidenceInterval(const std::vector<double>& x) {
+  ConfidenceInterval ci;
+  ci.num_samples = x.size();
+  if (x.empty()) return ci;
+  double sum = 0.0;
+  for (double v : x) sum += v;
+  ci.mean = sum / x.size();
+  double sum_sq = 0.0;
+  for (double v : x) sum_sq += (v - ci.mean) * (v - ci.mean);
+  double half_width = 0.0;
+  if (x.size() > 1) {
+    const double stddev = std::sqrt(sum_sq / (x.size() - 1));
+    half_width = StudentT95(x.size() - 1) * stddev / std::sqrt(x.size());
+  }
+  ci.lower = ci.mean - half_width;
+  ci.upper = ci.mean + half_width;
+  return ci;
+}
+
+Status CompareRunSamples(const RunSamples& baseline,
+                         const RunSamples& candidate, double threshold_percent,
+                         bool* regressed) {
+  *regressed = false;
+  std::vector<double> encode_ratios;
+  std::vector<double> decode_ratios;
+  std::vector<double> size_ratios;
+  size_t num_images = 0;
+  for (const auto& it : candidate.images) {
+    auto base = baseline.images.find(it.first);
+    if (base == baseline.images.end()) {
+      fprintf(stderr, "Warning: %s is missing from the baseline, skipped.\n",
+              it.first.c_str());
+      continue;
+    }
+    ++num_images;
+    AddTimeRatios(base->second.encode_seconds, it.second.encode_seconds,
+                  &encode_ratios);
+    AddTimeRatios(base->second.decode_seconds, it.second.decode_seconds,
+                  &decode_ratios);
+    if (base->second.compressed_size > 0 && it.second.compressed_size > 0) {
+      size_ratios.push_back(
+          std::log(static_cast<double>(it.second.compressed_size) /
+                   base->second.compressed_size));
+    }
+  }
+  if (num_images == 0) {
+    return JXL_FAILURE("Baseline and candidate have no images in common");
+  }
+
+  printf("Comparing %s against %s on %" PRIuS " images (95%% confidence)\n",
+         candidate.method.c_str(), baseline.method.c_str(), num_images);
+  printf("%-12s %10s %10s %10s %8s\n", "", "change", "lower", "upper",
+         "samples");
+  PrintChange("Encode time", encode_ratios, threshold_percent, regressed);
+  PrintChange("Decode time", decode_ratios, threshold_percent, regressed);
+  PrintChange("Size", size_ratios, threshold_percent, regressed);
+  fflush(stdout);
+  return true;
+}
+
+}  // namespace tools
+}  // namespace jpegxl
@@ -0,0 +1,65 @@
+// Copyright (c) the JPEG XL Project Authors. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#ifndef TOOLS_BENCHMARK_BENCHMARK_COMPARE_H_
+#define TOOLS_BENCHMARK_BENCHMARK_COMPARE_H_
+
+// Regression comparison of two codec configurations for benchmark_xl.
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "lib/jxl/base/status.h"
+
+namespace jpegxl {
+namespace tools {
+
+using ::jxl::Status;
+
+// Timing and size samples of one codec configuration on a corpus.
+struct RunSamples {
+  struct Image {
+    // Elapsed time of each repetition, in run order.
+    std::vector<double> encode_seconds;
+    std::vector<double> decode_seconds;
+    size_t compressed_size = 0;
+  };
+
+  std::string method;
+  // Keyed by image base name, so that samples of the same corpus in
+  // different locations can be compared.
+  std::map<std::string, Image> images;
+};
+
+// Writes the samples as CSV, in a format that ReadRunSamples accepts.
+Status WriteRunSamples(const RunSamples& samples, const std::string& filename);
+
+Status ReadRunSamples(const std::string& filename, RunSamples* samples);
+
+struct ConfidenceInterval {
+  double mean = 0.0;
+  double lower = 0.0;
+  double upper = 0.0;
+  size_t num_samples = 0;
+};
+
+// Mean and two-sided 95% confidence interval of the mean (Student's t).
+ConfidenceInterval ComputeConfidenceInterval(const std::vector<double>& x);
+
+// Prints the relative encode time, decode time and size change of candidate
+// against baseline with confidence intervals. Repetitions with the same index
+// are paired, which is most accurate when they were run interleaved.
+// Sets *regressed if the lower bound of any change exceeds threshold_percent;
+// a threshold of zero or less disables the check.
+Status CompareRunSamples(const RunSamples& baseline,
+                         const RunSamples& candidate, double threshold_percent,
+                         bool* regressed);
+
+}  // namespace tools
+}  // namespace jpegxl
+
+#endif  // TOOLS_BENCHMARK_BENCHMARK_COMPARE_H_
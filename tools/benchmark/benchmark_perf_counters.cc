@@ -0,0 +1,121 @@
+// Copyright (c) the JPEG XL Project Authors. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#include "tools/benchmark/benchmark_perf_counters.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace jpegxl {
+namespace tools {
+
+const char* PerfCounterName(PerfCounterType type) {
+  switch (type) {
+    case kPerfCycles:
+      return "cycles";
+    case kPerfInstructions:
+      return "instructions";
+    case kPerfCacheMisses:
+      return "cache_misses";
+    case kPerfBranchMisses:
+      return "branch_misses";
+    default:
+      return "";
+  }
+}
+
+namespace {
+
+void WarnUnavailableOnce() {
+  static std::atomic<bool> warned{false};
+  if (!warned.exchange(true)) {
+    fprintf(stderr,
+            "Warning: hardware performance counters are not available, "
+            "counter values will be omitted.\n");
+  }
+}
+
+#if defined(__linux__)
+int OpenCounter(uint64_t config) {
+  perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = config;
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  // pid 0, cpu -1: the calling thread on any CPU.
+  return static_cast<int>(
+      syscall(__NR_perf_event_open, &attr, 0, -1, /*group_fd=*/-1, 0));
+}
+#endif
+
+}  // namespace
+
+PerfCounters::PerfCounters() {
+  fds_.fill(-1);
+#if defined(__linux__)
+  static const uint64_t kConfigs[kNumPerfCounters] = {
+      PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+      PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+  valid_ = true;
+  for (size_t i = 0; i < kNumPerfCounters; ++i) {
+    fds_[i] = OpenCounter(kConfigs[i]);
+    if (fds_[i] < 0) valid_ = false;
+  }
+#endif
+  if (!valid_) WarnUnavailableOnce();
+}
+
+PerfCounters::~PerfCounters() {
+#if defined(__linux__)
+  for (int fd : fds_) {
+    if (fd >= 0) close(fd);
+  }
+#endif
+}
+
+void PerfCounters::Start() {
+  if (!valid_) return;
+#if defined(__linux__)
+  for (int fd : fds_) {
+    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+  }
+#endif
+}
+
+void PerfCounters::Stop(PerfCounterValues* values) {
+  if (!valid_) return;
+#if defined(__linux__)
+  for (int fd : fds_) {
+    ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+  }
+  std::array<uint64_t, kNumPerfCounters> counts;
+  for (size_t i = 0; i < kNumPerfCounters; ++i) {
+    if (read(fds_[i], &counts[i], sizeof(counts[i])) != sizeof(counts[i])) {
+      valid_ = false;
+      WarnUnavailableOnce();
+      return;
+    }
+  }
+  for (size_t i = 0; i < kNumPerfCounters; ++i) values->counts[i] += counts[i];
+  values->num_runs++;
+#endif
+}
+
+}  // namespace tools
+}  // namespace jpegxl
@@ -0,0 +1,68 @@
+// Copyright (c) the JPEG XL Project Authors. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#ifndef TOOLS_BENCHMARK_BENCHMARK_PERF_COUNTERS_H_
+#define TOOLS_BENCHMARK_BENCHMARK_PERF_COUNTERS_H_
+
+// Hardware performance counters for benchmark_xl.
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace jpegxl {
+namespace tools {
+
+enum PerfCounterType {
+  kPerfCycles = 0,
+  kPerfInstructions,
+  kPerfCacheMisses,
+  kPerfBranchMisses,
+  kNumPerfCounters,
+};
+
+const char* PerfCounterName(PerfCounterType type);
+
+// Counter totals over a number of measured runs.
+struct PerfCounterValues {
+  void Assimilate(const PerfCounterValues& victim) {
+    for (size_t i = 0; i < kNumPerfCounters; ++i) counts[i] += victim.counts[i];
+    num_runs += victim.num_runs;
+  }
+
+  std::array<uint64_t, kNumPerfCounters> counts = {};
+  // Zero if counters were not requested or are unavailable.
+  size_t num_runs = 0;
+};
+
+// Counts user space events of the calling thread. Uses perf_event_open on
+// Linux; elsewhere, or if the kernel denies access (see
+// /proc/sys/kernel/perf_event_paranoid), IsValid() is false and Start/Stop
+// do nothing. Not thread-safe; Start and Stop must be called from the thread
+// that constructed the object.
+class PerfCounters {
+ public:
+  PerfCounters();
+  ~PerfCounters();
+  PerfCounters(const PerfCounters&) = delete;
+  PerfCounters& operator=(const PerfCounters&) = delete;
+
+  bool IsValid() const { return valid_; }
+
+  // Resets and enables the counters.
+  void Start();
+
+  // Disables the counters and adds their values to `values`.
+  void Stop(PerfCounterValues* values);
+
+ private:
+  std::array<int, kNumPerfCounters> fds_;
+  bool valid_ = false;
+};
+
+}  // namespace tools
+}  // namespace jpegxl
+
+#endif  // TOOLS_BENCHMARK_BENCHMARK_PERF_COUNTERS_H_
@@ -5,9 +5,11 @@
 
 #include "tools/benchmark/benchmark_stats.h"
 
+#include <jxl/decode_stats.h>
 #include <jxl/stats.h>
 
 #include <algorithm>
+#include <cinttypes>
 #include <cmath>
 #include <cstdarg>
 #include <cstddef>
@@ -15,11 +17,13 @@
 #include <cstdio>
 #include <cstring>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "lib/jxl/base/printf_macros.h"
 #include "lib/jxl/base/status.h"
 #include "tools/benchmark/benchmark_args.h"
+#include "tools/benchmark/benchmark_perf_counters.h"
 
 namespace jpegxl {
 namespace tools {
@@ -55,6 +59,13 @@ const char* JxlStatsName(JxlEncoderStatsKey key) {
     ADD_NAME(NUM_DCT32X64_BLOCKS, "Number of 32x64 blocks");
     ADD_NAME(NUM_DCT64_BLOCKS, "Number of 64x64 blocks");
     ADD_NAME(NUM_BUTTERAUGLI_ITERS, "Butteraugli iters");
+    ADD_NAME(INPUT_USEC, "Input usec");
+    ADD_NAME(HEURISTICS_USEC, "Heuristics usec");
+    ADD_NAME(COEF_ORDER_USEC, "Coeff order usec");
+    ADD_NAME(TOKENIZATION_USEC, "Tokenization usec");
+    ADD_NAME(MODULAR_USEC, "Modular usec");
+    ADD_NAME(HISTOGRAM_USEC, "Histogram usec");
+    ADD_NAME(GROUP_ENCODING_USEC, "Group encoding usec");
     default:
       return "";
   };
@@ -111,10 +122,12 @@ struct ColumnDescriptor {
   uint32_t precision;
   ColumnType type;
   bool more;  // Whether to print only if more_columns is enabled
+  // Key of this column in the --json_out report
+  const char* json_key;
 };
 
 ColumnDescriptor ExtraMetricDescriptor() {
-  ColumnDescriptor d{{"DO NOT USE"}, 12, 4, TYPE_POSITIVE_FLOAT, false};
+  ColumnDescriptor d{{"DO NOT USE"}, 12, 4, TYPE_POSITIVE_FLOAT, false, ""};
   return d;
 }
 
@@ -126,19 +139,28 @@ ColumnDescriptor ExtraMetricDescriptor() {
 std::vector<ColumnDescriptor> GetColumnDescriptors(size_t num_extra_metrics) {
   // clang-format off
   std::vector<ColumnDescriptor> result = {
-      {{"Encoding"}, ComputeLargestCodecName() + 1, 0, TYPE_STRING, false},
-      {{"kPixels"},        10,  0, TYPE_SIZE, false},
-      {{"Bytes"},           9,  0, TYPE_SIZE, false},
-      {{"BPP"},            13,  7, TYPE_POSITIVE_FLOAT, false},
-      {{"E MP/s"},          8,  3, TYPE_POSITIVE_FLOAT, false},
-      {{"D MP/s"},          8,  3, TYPE_POSITIVE_FLOAT, false},
-      {{"Max norm"},       13,  8, TYPE_POSITIVE_FLOAT, false},
-      {{"SSIMULACRA2"},    13,  8, TYPE_POSITIVE_FLOAT, false},
-      {{"PSNR"},            7,  2, TYPE_POSITIVE_FLOAT, false},
-      {{"pnorm"},          13,  8, TYPE_POSITIVE_FLOAT, false},
-      {{"BPP*pnorm"},      16, 12, TYPE_POSITIVE_FLOAT, false},
-      {{"QABPP"},           8,  3, TYPE_POSITIVE_FLOAT, false},
-      {{"Bugs"},            7,  5, TYPE_COUNT, false},
+      {{"Encoding"}, ComputeLargestCodecName() + 1, 0, TYPE_STRING, false,
+       "method"},
+      {{"kPixels"},        10,  0, TYPE_SIZE, false, "kpixels"},
+      {{"Bytes"},           9,  0, TYPE_SIZE, false, "bytes"},
+      {{"BPP"},            13,  7, TYPE_POSITIVE_FLOAT, false, "bpp"},
+      {{"E MP/s"},          8,  3, TYPE_POSITIVE_FLOAT, false, "enc_mps"},
+      {{"D MP/s"},          8,  3, TYPE_POSITIVE_FLOAT, false, "dec_mps"},
+      {{"Max norm"},       13,  8, TYPE_POSITIVE_FLOAT, false, "max_norm"},
+      {{"SSIMULACRA2"},    13,  8, TYPE_POSITIVE_FLOAT, false, "ssimulacra2"},
+      {{"PSNR"},            7,  2, TYPE_POSITIVE_FLOAT, false, "psnr"},
+      {{"pnorm"},          13,  8, TYPE_POSITIVE_FLOAT, false, "pnorm"},
+      {{"BPP*pnorm"},      16, 12, TYPE_POSITIVE_FLOAT, false, "bpp_pnorm"},
+      {{"QABPP"},           8,  3, TYPE_POSITIVE_FLOAT, false, "qabpp"},
+      {{"E peak MB"},      10,  2, TYPE_POSITIVE_FLOAT, false, "enc_peak_mb"},
+      {{"E alloc MB"},     11,  2, TYPE_POSITIVE_FLOAT, true, "enc_alloc_mb"},
+      {{"E allocs"},       10,  0, TYPE_SIZE, true, "enc_allocs"},
+      {{"E max MB"},       10,  2, TYPE_POSITIVE_FLOAT, true, "enc_largest_mb"},
+      {{"D peak MB"},      10,  2, TYPE_POSITIVE_FLOAT, false, "dec_peak_mb"},
+      {{"D alloc MB"},     11,  2, TYPE_POSITIVE_FLOAT, true, "dec_alloc_mb"},
+      {{"D allocs"},       10,  0, TYPE_SIZE, true, "dec_allocs"},
+      {{"D max MB"},       10,  2, TYPE_POSITIVE_FLOAT, true, "dec_largest_mb"},
+      {{"Bugs"},            7,  5, TYPE_COUNT, false, "errors"},
   };
   // clang-format on
 
@@ -149,6 +171,17 @@ std::vector<ColumnDescriptor> GetColumnDescriptors(size_t num_extra_metrics) {
   return result;
 }
 
+// Index of the column with the given --json_out key in `columns`, or
+// columns.size() if there is none.
+size_t ColumnIndex(const std::vector<ColumnDescriptor>& columns,
+                   const char* json_key) {
+  for (size_t i = 0; i < columns.size(); ++i) {
+    if (strcmp(columns[i].json_key, json_key) == 0) return i;
+  }
+  JXL_DEBUG_ABORT("Unknown column %s", json_key);
+  return columns.size();
+}
+
 // Computes throughput [megapixels/s] as reported in the report table
 double ComputeSpeed(size_t pixels, double time_s) {
   if (time_s == 0.0) return 0;
@@ -183,6 +216,21 @@ std::string StringPrintf(const char* format, ...) {
   return std::string(buf);
 }
 
+std::string JsonQuote(const std::string& s) {
+  std::string out = "\"";
+  for (char c : s) {
+    if (c == '"' || c == '\\') {
+      out += '\\';
+      out += c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      out += StringPrintf("\\u%04x", c);
+    } else {
+      out += c;
+    }
+  }
+  return out + "\"";
+}
+
 void BenchmarkStats::Assimilate(const BenchmarkStats& victim) {
   total_input_files += victim.total_input_files;
   total_input_pixels += victim.total_input_pixels;
@@ -201,6 +249,11 @@ void BenchmarkStats::Assimilate(const BenchmarkStats& victim) {
                       victim.ssimulacra2s.end());
   total_errors += victim.total_errors;
   jxl_stats.Assimilate(victim.jxl_stats);
+  jxl_dec_stats.Assimilate(victim.jxl_dec_stats);
+  encode_memory.Assimilate(victim.encode_memory);
+  decode_memory.Assimilate(victim.decode_memory);
+  encode_counters.Assimilate(victim.encode_counters);
+  decode_counters.Assimilate(victim.decode_counters);
   if (extra_metrics.size() < victim.extra_metrics.size()) {
     extra_metrics.resize(victim.extra_metrics.size());
   }
@@ -268,28 +321,140 @@ std::vector<ColumnValue> BenchmarkStats::ComputeColumns(
   const double max_distance_avg =
       sqrt(max_distance / static_cast<double>(total_input_pixels));
 
-  std::vector<ColumnValue> values(
-      GetColumnDescriptors(extra_metrics.size()).size());
-
-  values[0].s = codec_desc;
-  values[1].i = total_input_pixels / 1000;
-  values[2].i = total_compressed_size;
-  values[3].f = comp_bpp;
-  values[4].f = compression_speed;
-  values[5].f = decompression_speed;
-  values[6].f = static_cast<double>(max_distance_avg);
-  values[7].f = ssimulacra2_avg;
-  values[8].f = psnr_avg;
-  values[9].f = p_norm_avg;
-  values[10].f = bpp_p_norm;
-  values[11].f = adj_comp_bpp;
-  values[12].i = total_errors;
+  const std::vector<ColumnDescriptor> columns =
+      GetColumnDescriptors(extra_metrics.size());
+  std::vector<ColumnValue> values(columns.size());
+  ColumnValue unknown;
+  const auto value = [&](const char* json_key) -> ColumnValue& {
+    const size_t index = ColumnIndex(columns, json_key);
+    return index < values.size() ? values[index] : unknown;
+  };
+
+  value("method").s = codec_desc;
+  value("kpixels").i = total_input_pixels / 1000;
+  value("bytes").i = total_compressed_size;
+  value("bpp").f = comp_bpp;
+  value("enc_mps").f = compression_speed;
+  value("dec_mps").f = decompression_speed;
+  value("max_norm").f = static_cast<double>(max_distance_avg);
+  value("ssimulacra2").f = ssimulacra2_avg;
+  value("psnr").f = psnr_avg;
+  value("pnorm").f = p_norm_avg;
+  value("bpp_pnorm").f = bpp_p_norm;
+  value("qabpp").f = adj_comp_bpp;
+  // Allocated bytes and counts are averaged over the images, peaks are the
+  // maximum over the images.
+  const size_t files = std::max<size_t>(total_input_files, 1);
+  value("enc_peak_mb").f = encode_memory.peak_bytes * 1E-6;
+  value("enc_alloc_mb").f = encode_memory.total_bytes * 1E-6 / files;
+  value("enc_allocs").i = encode_memory.num_allocations / files;
+  value("enc_largest_mb").f = encode_memory.largest_allocation * 1E-6;
+  value("dec_peak_mb").f = decode_memory.peak_bytes * 1E-6;
+  value("dec_alloc_mb").f = decode_memory.total_bytes * 1E-6 / files;
+  value("dec_allocs").i = decode_memory.num_allocations / files;
+  value("dec_largest_mb").f = decode_memory.largest_allocation * 1E-6;
+  value("errors").i = total_errors;
+  // The extra metrics follow the fixed columns.
+  const size_t first_extra = columns.size() - extra_metrics.size();
   for (size_t i = 0; i < extra_metrics.size(); i++) {
-    values[13 + i].f = extra_metrics[i] / total_input_files;
+    values[first_extra + i].f = extra_metrics[i] / total_input_files;
   }
   return values;
 }
 
+namespace {
+
+std::string JsonNumber(double value) {
+  if (!std::isfinite(value)) return "null";
+  return StringPrintf("%.9g", value);
+}
+
+std::string PerfCountersJson(const PerfCounterValues& values) {
+  std::string out = StringPrintf("{\"runs\": %" PRIuS, values.num_runs);
+  for (size_t i = 0; i < kNumPerfCounters; ++i) {
+    out += StringPrintf(", \"%s\": %" PRIu64,
+                        PerfCounterName(static_cast<PerfCounterType>(i)),
+                        values.counts[i]);
+  }
+  return out + "}";
+}
+
+}  // namespace
+
+std::string BenchmarkStats::PrintJson(
+    const std::string& codec_desc,
+    const std::vector<std::string>& extra_metrics_names) const {
+  const auto& descriptors = GetColumnDescriptors(extra_metrics.size());
+  const std::vector<ColumnValue> values = ComputeColumns(codec_desc);
+  const size_t num_fixed = descriptors.size() - extra_metrics.size();
+
+  std::string out = "{";
+  for (size_t i = 0; i < descriptors.size(); i++) {
+    std::string key;
+    if (i < num_fixed) {
+      key = descriptors[i].json_key;
+    } else if (i - num_fixed < extra_metrics_names.size()) {
+      key = extra_metrics_names[i - num_fixed];
+    } else {
+      key = StringPrintf("extra_metric_%" PRIuS, i - num_fixed);
+    }
+    if (i != 0) out += ", ";
+    out += JsonQuote(key) + ": ";
+    if (descriptors[i].type == TYPE_STRING) {
+      out += JsonQuote(values[i].s);
+    } else if (descriptors[i].type == TYPE_POSITIVE_FLOAT) {
+      out += JsonNumber(values[i].f);
+    } else {
+      out += StringPrintf("%" PRIuS, values[i].i);
+    }
+  }
+  out += StringPrintf(", \"encode_seconds\": %s, \"decode_seconds\": %s",
+                      JsonNumber(total_time_encode).c_str(),
+                      JsonNumber(total_time_decode).c_str());
+
+  if (jxl_stats.num_inputs > 0) {
+    static const std::pair<JxlEncoderStatsKey, const char*> kPhases[] = {
+        {JXL_ENC_STAT_INPUT_USEC, "input"},
+        {JXL_ENC_STAT_HEURISTICS_USEC, "heuristics"},
+        {JXL_ENC_STAT_COEF_ORDER_USEC, "coeff_orders"},
+        {JXL_ENC_STAT_TOKENIZATION_USEC, "tokenization"},
+        {JXL_ENC_STAT_MODULAR_USEC, "modular"},
+        {JXL_ENC_STAT_HISTOGRAM_USEC, "histograms"},
+        {JXL_ENC_STAT_GROUP_ENCODING_USEC, "group_encoding"},
+    };
+    out += ", \"encoder_phases_usec\": {";
+    for (size_t i = 0; i < sizeof(kPhases) / sizeof(kPhases[0]); ++i) {
+      if (i != 0) out += ", ";
+      out += StringPrintf(
+          "\"%s\": %" PRIuS, kPhases[i].second,
+          JxlEncoderStatsGet(jxl_stats.stats.get(), kPhases[i].first));
+    }
+    out += "}";
+  }
+  if (jxl_dec_stats.num_inputs > 0) {
+    static const std::pair<JxlDecoderStatsKey, const char*> kPhases[] = {
+        {JXL_DEC_STAT_ENTROPY_DECODE_USEC, "entropy_decode"},
+        {JXL_DEC_STAT_TRANSFORM_USEC, "transform"},
+        {JXL_DEC_STAT_RENDER_USEC, "render"},
+    };
+    out += ", \"decoder_phases_usec\": {";
+    for (size_t i = 0; i < sizeof(kPhases) / sizeof(kPhases[0]); ++i) {
+      if (i != 0) out += ", ";
+      out += StringPrintf(
+          "\"%s\": %" PRIuS, kPhases[i].second,
+          JxlDecoderStatsGet(jxl_dec_stats.stats.get(), kPhases[i].first));
+    }
+    out += "}";
+  }
+  if (encode_counters.num_runs > 0) {
+    out += ", \"encode_counters\": " + PerfCountersJson(encode_counters);
+  }
+  if (decode_counters.num_runs > 0) {
+    out += ", \"decode_counters\": " + PerfCountersJson(decode_counters);
+  }
+  return out + "}";
+}
+
 static std::string PrintFormattedEntries(
     size_t num_extra_metrics, const std::vector<ColumnValue>& values) {
   const auto& descriptors = GetColumnDescriptors(num_extra_metrics);
@@ -368,6 +533,7 @@ std::string BenchmarkStats::PrintLine(const std::string& codec_desc) const {
   }
 
   std::vector<ColumnValue> result(descriptors.size());
+  const size_t ssimulacra2_column = ColumnIndex(descriptors, "ssimulacra2");
 
   // Statistics for the aggregate row are combined together with different
   // formulas than Assimilate uses for combining the statistics of files.
@@ -401,7 +567,7 @@ std::string BenchmarkStats::PrintLine(const std::string& codec_desc) const {
     double geomean = numvalid ? std::exp2(logsum / numvalid) : 0.0;
 
     // ssimulacra2 can get negative, so use arithmetic mean instead
-    if (i == 7) {
+    if (i == ssimulacra2_column) {
       geomean = 0;
       for (const auto& column : aggregate) {
         geomean += column[i].f;
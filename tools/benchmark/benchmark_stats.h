@@ -6,20 +6,27 @@
 #ifndef TOOLS_BENCHMARK_BENCHMARK_STATS_H_
 #define TOOLS_BENCHMARK_BENCHMARK_STATS_H_
 
+#include <jxl/decode_stats.h>
 #include <jxl/stats.h>
 
+#include <algorithm>
 #include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <vector>
 
 #include "lib/jxl/base/status.h"
+#include "tools/benchmark/benchmark_perf_counters.h"
 
 namespace jpegxl {
 namespace tools {
 
 std::string StringPrintf(const char* format, ...);
 
+// Returns s as a quoted and escaped JSON string.
+std::string JsonQuote(const std::string& s);
+
 struct JxlStats {
   JxlStats()
       : num_inputs(0), stats(JxlEncoderStatsCreate(), JxlEncoderStatsDestroy) {}
@@ -33,6 +40,35 @@ struct JxlStats {
   std::unique_ptr<JxlEncoderStats, decltype(JxlEncoderStatsDestroy)*> stats;
 };
 
+struct JxlDecStats {
+  JxlDecStats()
+      : num_inputs(0), stats(JxlDecoderStatsCreate(), JxlDecoderStatsDestroy) {}
+  void Assimilate(const JxlDecStats& victim) {
+    num_inputs += victim.num_inputs;
+    JxlDecoderStatsMerge(stats.get(), victim.stats.get());
+  }
+
+  size_t num_inputs;
+  std::unique_ptr<JxlDecoderStats, decltype(JxlDecoderStatsDestroy)*> stats;
+};
+
+// Allocations made through the memory manager during codec runs. For one
+// image, every field is the maximum over the repetitions.
+struct MemoryStats {
+  void Assimilate(const MemoryStats& victim) {
+    peak_bytes = std::max(peak_bytes, victim.peak_bytes);
+    total_bytes += victim.total_bytes;
+    num_allocations += victim.num_allocations;
+    largest_allocation =
+        std::max(largest_allocation, victim.largest_allocation);
+  }
+
+  uint64_t peak_bytes = 0;
+  uint64_t total_bytes = 0;
+  uint64_t num_allocations = 0;
+  uint64_t largest_allocation = 0;
+};
+
 // The value of an entry in the table. Depending on the ColumnType, the string,
 // size_t or double should be used.
 struct ColumnValue {
@@ -48,6 +84,12 @@ struct BenchmarkStats {
 
   std::string PrintLine(const std::string& codec_desc) const;
 
+  // Returns the table columns, total times, encoder and decoder phase timings
+  // and hardware counters as a JSON object.
+  std::string PrintJson(
+      const std::string& codec_desc,
+      const std::vector<std::string>& extra_metrics_names) const;
+
   ::jxl::Status PrintMoreStats() const;
 
   size_t total_input_files = 0;
@@ -66,7 +108,12 @@ struct BenchmarkStats {
   std::vector<float> ssimulacra2s;
   size_t total_errors = 0;
   JxlStats jxl_stats;
+  JxlDecStats jxl_dec_stats;
   std::vector<float> extra_metrics;
+  MemoryStats encode_memory;
+  MemoryStats decode_memory;
+  PerfCounterValues encode_counters;
+  PerfCounterValues decode_counters;
 };
 
 ::jxl::StatusOr<std::string> PrintHeader(
@@ -10,6 +10,7 @@
 #include <jxl/types.h>
 
 #include <algorithm>
+#include <cinttypes>
 #include <cmath>
 #include <cstdint>
 #include <cstdio>
@@ -48,7 +49,9 @@
 #include "lib/jxl/jpeg/enc_jpeg_data.h"
 #include "tools/benchmark/benchmark_args.h"
 #include "tools/benchmark/benchmark_codec.h"
+#include "tools/benchmark/benchmark_compare.h"
 #include "tools/benchmark/benchmark_file_io.h"
+#include "tools/benchmark/benchmark_perf_counters.h"
 #include "tools/benchmark/benchmark_stats.h"
 #include "tools/benchmark/benchmark_utils.h"
 #include "tools/cmdline.h"
@@ -93,10 +96,12 @@ Status WriteImage(const Image3F& image, ThreadPool* pool,
 
 void PrintStats(const TrackingMemoryManager& memory_manager) {
   fprintf(stderr,
-          "Allocation count: %" PRIuS ", total: %E (max bytes in use: %E)\n",
+          "Allocation count: %" PRIuS ", total: %E (max bytes in use: %E, "
+          "largest allocation: %E)\n",
           static_cast<size_t>(memory_manager.total_allocations),
           static_cast<double>(memory_manager.total_bytes_allocated),
-          static_cast<double>(memory_manager.max_bytes_in_use));
+          static_cast<double>(memory_manager.max_bytes_in_use),
+          static_cast<double>(memory_manager.largest_allocation));
 }
 
 Status ReadPNG(const std::string& filename, Image3F* image) {
@@ -138,9 +143,56 @@ std::string CodecToExtension(const std::string& codec_name, char sep) {
   return result;
 }
 
+// Updates *stats with the allocations since the last ResetStats call.
+void UpdateMemoryStats(const TrackingMemoryManager& memory_manager,
+                       MemoryStats* stats) {
+  stats->peak_bytes =
+      std::max<uint64_t>(stats->peak_bytes, memory_manager.max_bytes_in_use);
+  stats->total_bytes = std::max<uint64_t>(stats->total_bytes,
+                                          memory_manager.total_bytes_allocated);
+  stats->num_allocations = std::max<uint64_t>(stats->num_allocations,
+                                              memory_manager.total_allocations);
+  stats->largest_allocation = std::max<uint64_t>(
+      stats->largest_allocation, memory_manager.largest_allocation);
+}
+
+// Reference side of the metrics of one input image, computed on first use
+// and shared by the tasks of all methods on that image. It is released when
+// the last of them is done.
+class ReferenceMetrics {
+ public:
+  explicit ReferenceMetrics(size_t num_users) : remaining_users_(num_users) {}
+
+  // Returns the SSIMULACRA 2 reference of orig, which must be the same image
+  // for all users.
+  StatusOr<const Ssimulacra2Reference*> Ssimulacra2(const ImageBundle& orig,
+                                                    ThreadPool* pool) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    if (!ssimulacra2_) {
+      JXL_ASSIGN_OR_RETURN(Ssimulacra2Reference reference,
+                           Ssimulacra2Reference::Create(orig, 0.5f, pool));
+      ssimulacra2_ =
+          jxl::make_unique<Ssimulacra2Reference>(std::move(reference));
+    }
+    return ssimulacra2_.get();
+  }
+
+  void Release() {
+    std::lock_guard<std::mutex> guard(mutex_);
+    if (remaining_users_ > 0 && --remaining_users_ == 0) ssimulacra2_.reset();
+  }
+
+ private:
+  std::mutex mutex_;
+  size_t remaining_users_;
+  std::unique_ptr<Ssimulacra2Reference> ssimulacra2_;
+};
+
+// reference_metrics may be null, then the reference side is recomputed.
 Status DoCompress(const std::string& filename, const PackedPixelFile& ppf,
                   const std::vector<std::string>& extra_metrics_commands,
-                  ImageCodec* codec, ThreadPool* inner_pool,
+                  ImageCodec* codec, TrackingMemoryManager* codec_memory,
+                  ThreadPool* inner_pool, ReferenceMetrics* reference_metrics,
                   std::vector<uint8_t>* compressed, BenchmarkStats* s) {
   JxlMemoryManager* memory_manager = jpegxl::tools::NoMemoryManager();
   ++s->total_input_files;
@@ -158,6 +210,14 @@ Status DoCompress(const std::string& filename, const PackedPixelFile& ppf,
 
   jpegxl::tools::SpeedStats speed_stats;
   jpegxl::tools::SpeedStats::Summary summary;
+  std::unique_ptr<PerfCounters> perf_counters;
+  if (Args()->perf_counters) perf_counters = jxl::make_unique<PerfCounters>();
+  const auto start_counters = [&]() {
+    if (perf_counters) perf_counters->Start();
+  };
+  const auto stop_counters = [&](PerfCounterValues* values) {
+    if (perf_counters) perf_counters->Stop(values);
+  };
 
   bool valid = true;  // false if roundtrip, encoding or decoding errors occur.
 
@@ -180,8 +240,12 @@ Status DoCompress(const std::string& filename, const PackedPixelFile& ppf,
           JXL_RETURN_IF_ERROR(codec->RecompressJpeg(filename, data_in,
                                                     compressed, &speed_stats));
         } else {
+          codec_memory->ResetStats();
+          start_counters();
           Status status = codec->Compress(filename, *ppf1, inner_pool,
                                           compressed, &speed_stats);
+          stop_counters(&s->encode_counters);
+          UpdateMemoryStats(*codec_memory, &s->encode_memory);
           if (!status) {
             valid = false;
             if (!Args()->silent_errors) {
@@ -211,8 +275,13 @@ Status DoCompress(const std::string& filename, const PackedPixelFile& ppf,
     if (valid) {
       speed_stats = jpegxl::tools::SpeedStats();
       for (size_t i = 0; i < Args()->decode_reps; ++i) {
-        if (!codec->Decompress(filename, Bytes(*compressed), inner_pool, &ppf2,
-                               &speed_stats)) {
+        codec_memory->ResetStats();
+        start_counters();
+        const Status status = codec->Decompress(
+            filename, Bytes(*compressed), inner_pool, &ppf2, &speed_stats);
+        stop_counters(&s->decode_counters);
+        UpdateMemoryStats(*codec_memory, &s->decode_memory);
+        if (!status) {
           if (!Args()->silent_errors) {
             fprintf(stderr,
                     "%s failed to decompress encoded image. Original source:"
@@ -278,7 +347,7 @@ Status DoCompress(const std::string& filename, const PackedPixelFile& ppf,
                                                             : 80.f;
 
       const JxlCmsInterface& cms = *JxlGetDefaultCms();
-      JxlButteraugliComparator comparator(params, cms);
+      JxlButteraugliComparator comparator(params, cms, inner_pool);
       JXL_RETURN_IF_ERROR(ComputeScore(ib1, ib2, &comparator, cms, &distance,
                                        &distmap, inner_pool,
                                        codec->IgnoreAlpha()));
@@ -297,7 +366,15 @@ Status DoCompress(const std::string& filename, const PackedPixelFile& ppf,
         double pnorm,
         ComputeDistanceP(distmap, ButteraugliParams(), Args()->error_pnorm));
     s->distance_p_norm += pnorm * input_pixels;
-    JXL_ASSIGN_OR_RETURN(Msssim msssim, ComputeSSIMULACRA2(ib1, ib2));
+    Msssim msssim;
+    if (reference_metrics != nullptr && jxl::SameSize(ppf, ppf2)) {
+      JXL_ASSIGN_OR_RETURN(const Ssimulacra2Reference* reference,
+                           reference_metrics->Ssimulacra2(ib1, inner_pool));
+      JXL_ASSIGN_OR_RETURN(msssim, reference->Compare(ib2, inner_pool));
+    } else {
+      JXL_ASSIGN_OR_RETURN(msssim,
+                           ComputeSSIMULACRA2(ib1, ib2, 0.5f, inner_pool));
+    }
     double ssimulacra2 = msssim.Score();
     s->ssimulacra2 += ssimulacra2 * input_pixels;
     s->max_distance = std::max(s->max_distance, distance);
@@ -420,6 +497,8 @@ std::string Base64Image(const std::string& filename) {
 }
 
 struct Task {
+  // Tracks the allocations of codec, forwarding them to the global manager.
+  std::unique_ptr<TrackingMemoryManager> memory_manager;
   ImageCodecPtr codec;
   size_t idx_image;
   size_t idx_method;
@@ -610,6 +689,39 @@ Status WriteHtmlReport(const std::string& codec_desc,
   return true;
 }
 
+// Writes the aggregate statistics of each method, followed by the statistics of
+// each of its images, to Args()->json_out.
+Status WriteJsonReport(const std::vector<std::string>& methods,
+                       const std::vector<std::string>& extra_metrics_names,
+                       const std::vector<std::string>& fnames,
+                       const std::vector<Task>& tasks) {
+  std::string out = "{\n  \"methods\": [";
+  for (size_t idx_method = 0; idx_method < methods.size(); ++idx_method) {
+    BenchmarkStats method_stats;
+    std::string images;
+    for (const Task& t : tasks) {
+      if (t.idx_method != idx_method) continue;
+      method_stats.Assimilate(t.stats);
+      BenchmarkStats image_stats;
+      image_stats.Assimilate(t.stats);
+      images += images.empty() ? "\n" : ",\n";
+      images += "        {\"image\": " +
+                JsonQuote(FileBaseName(fnames[t.idx_image])) +
+                ", \"stats\": " +
+                image_stats.PrintJson(methods[idx_method],
+                                      extra_metrics_names) +
+                "}";
+    }
+    out += idx_method == 0 ? "\n" : ",\n";
+    out += "    {\"method\": " + JsonQuote(methods[idx_method]) +
+           ",\n      \"aggregate\": " +
+           method_stats.PrintJson(methods[idx_method], extra_metrics_names) +
+           ",\n      \"images\": [" + images + "\n      ]}";
+  }
+  out += "\n  ]\n}\n";
+  return WriteFile(Args()->json_out, out);
+}
+
 // Prints the detailed and aggregate statistics, in the correct order but as
 // soon as possible when multithreaded tasks are done.
 struct StatPrinter {
@@ -711,6 +823,11 @@ struct StatPrinter {
              t.stats.total_errors, t.stats.total_compressed_size, pixels,
              enc_mps, dec_mps, comp_bpp, t.stats.max_distance, ssimulacra2,
              psnr, p_norm, bpp_p_norm, adj_comp_bpp);
+      for (const MemoryStats* m : {&t.stats.encode_memory,
+                                   &t.stats.decode_memory}) {
+        printf(",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64, m->peak_bytes,
+               m->total_bytes, m->num_allocations, m->largest_allocation);
+      }
       for (float m : t.stats.extra_metrics) {
         printf(",%.8f", m);
       }
@@ -730,10 +847,11 @@ struct StatPrinter {
           "error:%" PRIdS "    size:%8" PRIdS "    pixels:%9" PRIdS
           "    enc_speed:%8.8f    dec_speed:%8.8f    bpp:%10.8f    dist:%10.8f"
           "    psnr:%10.8f    ssimulacra2:%.2f   p:%10.8f    bppp:%10.8f    "
-          "qabpp:%10.8f ",
+          "qabpp:%10.8f    enc_peak_mb:%.2f    dec_peak_mb:%.2f ",
           t.stats.total_errors, t.stats.total_compressed_size, pixels, enc_mps,
           dec_mps, comp_bpp, t.stats.max_distance, psnr, ssimulacra2, p_norm,
-          bpp_p_norm, adj_comp_bpp);
+          bpp_p_norm, adj_comp_bpp, t.stats.encode_memory.peak_bytes * 1E-6,
+          t.stats.decode_memory.peak_bytes * 1E-6);
       for (size_t i = 0; i < t.stats.extra_metrics.size(); i++) {
         printf(" %s:%.8f", (*extra_metrics_names_)[i].c_str(),
                t.stats.extra_metrics[i]);
@@ -857,13 +975,25 @@ class Benchmark {
       std::vector<PackedPixelFile> loaded_images =
           LoadImages(fnames, pool->get());
 
+      std::vector<std::unique_ptr<ReferenceMetrics>> reference_metrics;
+      for (size_t i = 0; i < fnames.size(); ++i) {
+        reference_metrics.push_back(
+            jxl::make_unique<ReferenceMetrics>(methods.size()));
+      }
+
       if (RunTasks(methods, extra_metrics_names, extra_metrics_commands, fnames,
-                   loaded_images, pool->get(), inner_pools, &tasks) != 0) {
+                   loaded_images, reference_metrics, pool->get(), inner_pools,
+                   &tasks) != 0) {
         ok = false;
         if (!Args()->silent_errors) {
           fprintf(stderr, "There were error(s) in the benchmark.\n");
         }
       }
+      if (!Args()->json_out.empty() &&
+          !WriteJsonReport(methods, extra_metrics_names, fnames, tasks)) {
+        fprintf(stderr, "Failed to write %s\n", Args()->json_out.c_str());
+        ok = false;
+      }
     }
 
     PrintStats(memory_manager);
@@ -871,6 +1001,58 @@ class Benchmark {
     return true;
   }
 
+  // Comparison mode, see --compare, --compare_baseline and --compare_out.
+  static Status RunComparison() {
+    TrackingMemoryManager memory_manager{};
+    const StringVec methods = GetMethods();
+    const StringVec fnames = GetFilenames();
+
+    // Images are measured one at a time, so that concurrent tasks do not
+    // disturb the timings; only the inner threads are used.
+    std::unique_ptr<ThreadPoolInternal> pool;
+    std::vector<std::unique_ptr<ThreadPoolInternal>> inner_pools;
+    InitThreads(/*num_tasks=*/1, &pool, &inner_pools);
+    std::vector<PackedPixelFile> loaded_images =
+        LoadImages(fnames, pool->get());
+
+    std::vector<RunSamples> samples(methods.size());
+    for (size_t i = 0; i < methods.size(); ++i) {
+      samples[i].method = methods[i];
+    }
+    for (size_t i = 0; i < fnames.size(); ++i) {
+      JXL_RETURN_IF_ERROR(MeasureInterleaved(fnames[i], loaded_images[i],
+                                             methods, memory_manager.get(),
+                                             inner_pools[0]->get(), &samples));
+      if (Args()->show_progress) {
+        fprintf(stderr, ".");
+        fflush(stderr);
+      }
+    }
+    if (Args()->show_progress) fprintf(stderr, "\n");
+
+    if (!Args()->compare_out.empty()) {
+      JXL_RETURN_IF_ERROR(WriteRunSamples(samples.back(), Args()->compare_out));
+    }
+    bool regressed = false;
+    if (Args()->compare) {
+      JXL_RETURN_IF_ERROR(CompareRunSamples(samples[0], samples[1],
+                                            Args()->regression_threshold,
+                                            &regressed));
+    } else if (!Args()->compare_baseline.empty()) {
+      RunSamples baseline;
+      JXL_RETURN_IF_ERROR(ReadRunSamples(Args()->compare_baseline, &baseline));
+      JXL_RETURN_IF_ERROR(CompareRunSamples(baseline, samples[0],
+                                            Args()->regression_threshold,
+                                            &regressed));
+    }
+    if (regressed) {
+      fprintf(stderr, "Regression above %.2f%% detected.\n",
+              Args()->regression_threshold);
+      return false;
+    }
+    return true;
+  }
+
  private:
   static size_t NumOuterThreads(const size_t num_hw_threads,
                                 const size_t num_tasks) {
@@ -1089,6 +1271,69 @@ class Benchmark {
     return loaded_images;
   }
 
+  // Encodes and then decodes the image with each method, encode_reps and
+  // decode_reps times, interleaving the methods within each repetition.
+  static Status MeasureInterleaved(const std::string& filename,
+                                   const PackedPixelFile& ppf,
+                                   const StringVec& methods,
+                                   JxlMemoryManager* memory_manager,
+                                   ThreadPool* pool,
+                                   std::vector<RunSamples>* samples) {
+    if (ppf.frames.size() != 1) {
+      fprintf(stderr, "Warning: skipping multiframe image %s\n",
+              filename.c_str());
+      return true;
+    }
+    const std::string name = FileBaseName(filename);
+    const size_t num_methods = methods.size();
+    std::vector<ImageCodecPtr> codecs;
+    for (const std::string& method : methods) {
+      codecs.push_back(CreateImageCodec(method, memory_manager));
+    }
+    std::vector<std::vector<uint8_t>> compressed(num_methods);
+    // Reverse the order in every other repetition, so that slow drifts such
+    // as thermal throttling affect all methods alike.
+    const auto method_index = [&](size_t rep, size_t i) {
+      return rep % 2 == 0 ? i : num_methods - 1 - i;
+    };
+    for (size_t rep = 0; rep < Args()->encode_reps; ++rep) {
+      for (size_t i = 0; i < num_methods; ++i) {
+        const size_t m = method_index(rep, i);
+        jpegxl::tools::SpeedStats speed_stats;
+        jpegxl::tools::SpeedStats::Summary summary;
+        compressed[m].clear();
+        if (!codecs[m]->Compress(filename, ppf, pool, &compressed[m],
+                                 &speed_stats)) {
+          return JXL_FAILURE("%s failed to compress %s", methods[m].c_str(),
+                             filename.c_str());
+        }
+        JXL_RETURN_IF_ERROR(speed_stats.GetSummary(&summary));
+        (*samples)[m].images[name].encode_seconds.push_back(
+            summary.central_tendency);
+      }
+    }
+    for (size_t rep = 0; rep < Args()->decode_reps; ++rep) {
+      for (size_t i = 0; i < num_methods; ++i) {
+        const size_t m = method_index(rep, i);
+        jpegxl::tools::SpeedStats speed_stats;
+        jpegxl::tools::SpeedStats::Summary summary;
+        PackedPixelFile decoded;
+        if (!codecs[m]->Decompress(filename, Bytes(compressed[m]), pool,
+                                   &decoded, &speed_stats)) {
+          return JXL_FAILURE("%s failed to decompress %s", methods[m].c_str(),
+                             filename.c_str());
+        }
+        JXL_RETURN_IF_ERROR(speed_stats.GetSummary(&summary));
+        (*samples)[m].images[name].decode_seconds.push_back(
+            summary.central_tendency);
+      }
+    }
+    for (size_t m = 0; m < num_methods; ++m) {
+      (*samples)[m].images[name].compressed_size = compressed[m].size();
+    }
+    return true;
+  }
+
   static StatusOr<std::vector<Task>> CreateTasks(
       const StringVec& methods, const StringVec& fnames,
       JxlMemoryManager* memory_manager) {
@@ -1098,7 +1343,10 @@ class Benchmark {
       for (size_t idx_method = 0; idx_method < methods.size(); ++idx_method) {
         tasks.emplace_back();
         Task& t = tasks.back();
-        t.codec = CreateImageCodec(methods[idx_method], memory_manager);
+        t.memory_manager = jxl::make_unique<TrackingMemoryManager>();
+        t.memory_manager->SetInner(memory_manager);
+        t.codec =
+            CreateImageCodec(methods[idx_method], t.memory_manager->get());
         t.idx_image = idx_image;
         t.idx_method = idx_method;
         // t.stats is default-initialized.
@@ -1112,7 +1360,9 @@ class Benchmark {
   static size_t RunTasks(
       const StringVec& methods, const StringVec& extra_metrics_names,
       const StringVec& extra_metrics_commands, const StringVec& fnames,
-      const std::vector<PackedPixelFile>& loaded_images, ThreadPool* pool,
+      const std::vector<PackedPixelFile>& loaded_images,
+      const std::vector<std::unique_ptr<ReferenceMetrics>>& reference_metrics,
+      ThreadPool* pool,
       const std::vector<std::unique_ptr<ThreadPoolInternal>>& inner_pools,
       std::vector<Task>* tasks) {
     StatPrinter printer(methods, extra_metrics_names, fnames, *tasks);
@@ -1120,7 +1370,9 @@ class Benchmark {
       // Print CSV header
       printf(
           "method,image,error,size,pixels,enc_speed,dec_speed,"
-          "bpp,maxnorm,ssimulacra2,psnr,pnorm,bppp,qabpp");
+          "bpp,maxnorm,ssimulacra2,psnr,pnorm,bppp,qabpp,"
+          "enc_peak_bytes,enc_total_bytes,enc_allocs,enc_largest_alloc,"
+          "dec_peak_bytes,dec_total_bytes,dec_allocs,dec_largest_alloc");
       for (const std::string& s : extra_metrics_names) {
         printf(",%s", s.c_str());
       }
@@ -1138,14 +1390,17 @@ class Benchmark {
       Task& t = (*tasks)[i];
       const PackedPixelFile& image = loaded_images[t.idx_image];
       t.image = &image;
+      ReferenceMetrics* reference = reference_metrics[t.idx_image].get();
       std::vector<uint8_t> compressed;
       if (!DoCompress(fnames[t.idx_image], image, extra_metrics_commands,
-                      t.codec.get(), inner_pools[thread]->get(), &compressed,
+                      t.codec.get(), t.memory_manager.get(),
+                      inner_pools[thread]->get(), reference, &compressed,
                       &t.stats)) {
         t.stats.total_errors++;
       } else if (!printer.TaskDone(i, t)) {
         t.stats.total_errors++;
       }
+      reference->Release();
       errors_thread[8 * thread] += t.stats.total_errors;
       return true;
     };
@@ -1176,7 +1431,12 @@ int BenchmarkMain(int argc, const char** argv) {
     fprintf(stderr, "Use '%s -h' for more information\n", argv[0]);
     return EXIT_FAILURE;
   }
-  return Benchmark::Run() ? EXIT_SUCCESS : EXIT_FAILURE;
+  const bool comparison = Args()->compare ||
+                          !Args()->compare_baseline.empty() ||
+                          !Args()->compare_out.empty();
+  const Status status =
+      comparison ? Benchmark::RunComparison() : Benchmark::Run();
+  return status ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
 }  // namespace
@@ -12,6 +12,7 @@
 #include <cstdio>
 #include <cstdlib>
 #include <string>
+#include <thread>  // NOLINT
 #include <vector>
 
 #include "lib/extras/codec.h"
@@ -61,7 +62,8 @@ static Status RunButteraugli(const char* pathname1, const char* pathname2,
                       const std::string& distmap_filename,
                       const std::string& raw_distmap_filename,
                       const std::string& colorspace_hint, double p,
-                      float intensity_target) {
+                      float intensity_target, size_t num_threads,
+                      size_t tile_size) {
   JxlMemoryManager* memory_manager = jpegxl::tools::NoMemoryManager();
   jxl::extras::ColorHints color_hints;
   if (!colorspace_hint.empty()) {
@@ -73,7 +75,7 @@ static Status RunButteraugli(const char* pathname1, const char* pathname2,
   auto io2 = jxl::make_unique<CodecInOut>(memory_manager);
 
   CodecInOut* io[2] = {io1.get(), io2.get()};
-  ThreadPoolInternal pool(4);
+  ThreadPoolInternal pool(num_threads);
   for (size_t i = 0; i < 2; ++i) {
     std::vector<uint8_t> encoded;
     if (!jpegxl::tools::ReadFile(pathname[i], &encoded)) {
@@ -112,7 +114,8 @@ static Status RunButteraugli(const char* pathname1, const char* pathname2,
             : 80.f;  // sRGB intensity target.
   }
   const JxlCmsInterface& cms = *JxlGetDefaultCms();
-  JxlButteraugliComparator comparator(butteraugli_params, cms);
+  JxlButteraugliComparator comparator(butteraugli_params, cms, pool.get());
+  comparator.SetTileSize(tile_size);
   float distance;
   JXL_RETURN_IF_ERROR(ComputeScore(io1->Main(), io2->Main(), &comparator, cms,
                                    &distance, &distmap, pool.get(),
@@ -164,11 +167,17 @@ int main(int argc, const char** argv) {
             "  [--intensity_target <intensity_target>]\n"
             "  [--colorspace <colorspace_hint>]\n"
             "  [--pnorm <pth norm>]\n"
+            "  [--num_threads <number of worker threads>]\n"
+            "  [--tile_size <tile size in pixels>]\n"
             "NOTE: images get converted to linear sRGB for butteraugli. Images"
             " without attached profiles (such as ppm or pfm) are interpreted"
             " as nonlinear sRGB. The hint format is RGB_D65_SRG_Rel_Lin for"
             " linear sRGB. Intensity target is viewing conditions screen nits"
-            ", defaults to 80 for SDR input.\n",
+            ", defaults to 80 for SDR input. The number of threads defaults"
+            " to the number of hardware threads; with 0 threads, everything"
+            " runs on the main thread. With a tile size, butteraugli is"
+            " evaluated on overlapping tiles, which gives the same result with"
+            " less memory for large images.\n",
             argv[0]);
     return 1;
   }
@@ -177,6 +186,8 @@ int main(int argc, const char** argv) {
   std::string colorspace;
   double p = 3;
   float intensity_target = 0.f;
+  size_t num_threads = std::thread::hardware_concurrency();
+  size_t tile_size = 0;
   for (int i = 3; i < argc; i++) {
     if (std::string(argv[i]) == "--distmap" && i + 1 < argc) {
       distmap = argv[++i];
@@ -193,6 +204,22 @@ int main(int argc, const char** argv) {
         fprintf(stderr, "Failed to parse pnorm \"%s\".\n", argv[i]);
         return 1;
       }
+    } else if (std::string(argv[i]) == "--num_threads" && i + 1 < argc) {
+      char* end;
+      const long threads = strtol(argv[++i], &end, 10);  // NOLINT
+      if (end == argv[i] || *end != '\0' || threads < 0) {
+        fprintf(stderr, "Failed to parse num_threads \"%s\".\n", argv[i]);
+        return 1;
+      }
+      num_threads = threads;
+    } else if (std::string(argv[i]) == "--tile_size" && i + 1 < argc) {
+      char* end;
+      const long size = strtol(argv[++i], &end, 10);  // NOLINT
+      if (end == argv[i] || *end != '\0' || size <= 0) {
+        fprintf(stderr, "Failed to parse tile_size \"%s\".\n", argv[i]);
+        return 1;
+      }
+      tile_size = size;
     } else {
       fprintf(stderr, "Unrecognized flag \"%s\".\n", argv[i]);
       return 1;
@@ -200,6 +227,7 @@ int main(int argc, const char** argv) {
   }
 
   Status result = RunButteraugli(argv[1], argv[2], distmap, raw_distmap,
-                                 colorspace, p, intensity_target);
+                                 colorspace, p, intensity_target, num_threads,
+                                 tile_size);
   return result ? EXIT_SUCCESS : EXIT_FAILURE;
 }
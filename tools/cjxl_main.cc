@@ -19,14 +19,19 @@
 
 #include <algorithm>
 #include <cerrno>
+#include <condition_variable>
 #include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <deque>
 #include <functional>
 #include <iostream>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
 #include "lib/extras/dec/color_hints.h"
@@ -47,6 +52,7 @@
 #include "tools/codec_config.h"
 #include "tools/file_io.h"
 #include "tools/speed_stats.h"
+#include "tools/trace_file.h"
 
 #include "monolithic_examples.h"
 
@@ -358,10 +364,31 @@ struct CompressArgs {
                            "Enable incremental writing of the output file.",
                            &streaming_output, &SetBooleanTrue, 3);
 
+    cmdline->AddOptionFlag(
+        '\0', "pipelined",
+        "Overlap reading of the input, encoding and writing of the output, "
+        "with bounded read-ahead and write-behind buffers. Implies "
+        "--streaming_input and --streaming_output.",
+        &pipelined, &SetBooleanTrue, 3);
+
     cmdline->AddOptionFlag('\0', "disable_output",
                            "Do not write an output file.", &disable_output,
                            &SetBooleanTrue, 3);
 
+    cmdline->AddOptionValue(
+        '\0', "trace_out", "FILENAME",
+        "Write a Chrome trace JSON file (chrome://tracing, ui.perfetto.dev) "
+        "of when each encoder phase and group ran on each thread.\n"
+        "    Requires a library built with JPEGXL_ENABLE_TRACING.",
+        &trace_out, &ParseString, 3);
+
+    cmdline->AddOptionValue(
+        '\0', "group_stats_out", "FILENAME",
+        "Write a JSON file with the encoding time, size, transform sizes and "
+        "quantization of each group of the VarDCT frames.\n"
+        "    Not available with streaming.",
+        &group_stats_out, &ParseString, 3);
+
     cmdline->AddOptionValue(
         '\0', "dots", "0|1",
         "Disable/enable dots generation. 0 = disable. 1 = enable. "
@@ -479,6 +506,7 @@ struct CompressArgs {
   jxl::Override print_profile = jxl::Override::kDefault;
   bool streaming_input = false;
   bool streaming_output = false;
+  bool pipelined = false;
 
   bool verbose = false;
 
@@ -543,6 +571,8 @@ struct CompressArgs {
   size_t effort = 7;
   size_t brotli_effort = 9;
   std::string frame_indexing;
+  std::string trace_out;
+  std::string group_stats_out;
 
   // References (ids) of specific options to check if they were matched.
   CommandLineParser::OptionId opt_lossless_jpeg_id = -1;
@@ -572,6 +602,42 @@ std::string DistanceFromArgs(const CompressArgs& args) {
   return buf;
 }
 
+bool WriteGroupStats(const JxlEncoderStats* stats,
+                     const std::string& filename) {
+  static const char* const kKeys[JXL_ENC_GROUP_NUM_STATS] = {
+      "x0",        "y0",           "xsize",       "ysize",
+      "heur_us",   "tokenize_us",  "encode_us",   "bits",
+      "num_small", "num_dct4x8",   "num_afv",     "num_dct8",
+      "num_8x16",  "num_8x32",     "num_dct16",   "num_16x32",
+      "num_dct32", "num_32x64",    "num_dct64",   "min_quant",
+      "max_quant", "quant_sum",
+  };
+  FILE* file = fopen(filename.c_str(), "wb");
+  if (!file) {
+    fprintf(stderr, "Could not open %s for writing: %s\n", filename.c_str(),
+            strerror(errno));
+    return false;
+  }
+  fprintf(file, "{\"groups\": [");
+  const size_t num_groups = JxlEncoderStatsNumGroups(stats);
+  for (size_t g = 0; g < num_groups; ++g) {
+    fprintf(file, "%s\n  {", g == 0 ? "" : ",");
+    for (int key = 0; key < JXL_ENC_GROUP_NUM_STATS; ++key) {
+      size_t value = JxlEncoderStatsGetGroup(
+          stats, g, static_cast<JxlEncoderGroupStatsKey>(key));
+      fprintf(file, "%s\"%s\": %" PRIuS, key == 0 ? "" : ", ", kKeys[key],
+              value);
+    }
+    fprintf(file, "}");
+  }
+  fprintf(file, "\n]}\n");
+  if (fclose(file) != 0) {
+    fprintf(stderr, "Could not write %s.\n", filename.c_str());
+    return false;
+  }
+  return true;
+}
+
 void PrintMode(jxl::extras::PackedPixelFile& ppf, const double decode_mps,
                size_t num_bytes, const CompressArgs& args,
                jpegxl::tools::CommandLineParser& cmdline) {
@@ -946,7 +1012,13 @@ void ProcessFlags(const jxl::extras::Codec codec,
       });
 }
 
+// Amount of input that is read ahead of the encoder, and of encoded output
+// that may be waiting to be written, in --pipelined mode.
+constexpr size_t kPipelineBufferBytes = size_t{64} << 20;
+
 struct JxlOutputProcessor {
+  ~JxlOutputProcessor() { (void)Finish(); }
+
   bool SetOutputPath(const std::string& path) {
     outfile = jxl::make_unique<FileWrapper>(path, "wb");
     if (!*outfile) {
@@ -967,8 +1039,41 @@ struct JxlOutputProcessor {
         METHOD_TO_C_CALLBACK(&JxlOutputProcessor::SetFinalizedPosition)};
   }
 
+  // Moves writing of the output file to a background thread, so that it
+  // overlaps with encoding. The encoder blocks in GetBuffer() while more than
+  // `max_pending_bytes` are waiting to be written.
+  void EnableWriteBehind(size_t max_pending_bytes) {
+    if (!outfile || writer.joinable()) return;
+    max_pending = max_pending_bytes;
+    writer = std::thread([this]() { WriterLoop(); });
+  }
+
+  // Waits for all pending writes and stops the writer thread, if any. Returns
+  // false if any of the writes failed.
+  bool Finish() {
+    if (writer.joinable()) {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        done = true;
+      }
+      cv.notify_all();
+      writer.join();
+    }
+    return !write_failed;
+  }
+
   void* GetBuffer(size_t* size) {
     *size = std::min<size_t>(*size, 1u << 16);
+    if (writer.joinable()) {
+      std::unique_lock<std::mutex> lock(mutex);
+      cv.wait(lock, [&]() {
+        return pending.empty() || pending_bytes + *size <= max_pending;
+      });
+      if (!free_buffers.empty()) {
+        output = std::move(free_buffers.back());
+        free_buffers.pop_back();
+      }
+    }
     if (output.size() < *size) {
       output.resize(*size);
     }
@@ -976,26 +1081,94 @@ struct JxlOutputProcessor {
   }
 
   void ReleaseBuffer(size_t written_bytes) {
-    if (*outfile &&
-        fwrite(output.data(), 1, written_bytes, *outfile) != written_bytes) {
-      JXL_WARNING("Failed to write %" PRIuS " bytes to output", written_bytes);
+    if (writer.joinable()) {
+      output.resize(written_bytes);
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending_bytes += written_bytes;
+        pending.emplace_back(PendingOp{std::move(output), false, 0});
+      }
+      cv.notify_all();
+      output = std::vector<uint8_t>();
+      return;
     }
+    Write(output.data(), written_bytes);
     output.clear();
   }
 
   void Seek(uint64_t position) {  // NOLINT
-    if (*outfile && fseek(*outfile, position, SEEK_SET) != 0) {
-      JXL_WARNING("Failed to seek output.");
+    if (writer.joinable()) {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.emplace_back(PendingOp{std::vector<uint8_t>(), true, position});
+      }
+      cv.notify_all();
+      return;
     }
+    DoSeek(position);
   }
 
   void SetFinalizedPosition(uint64_t finalized_position) {
     this->finalized_position = finalized_position;
   }
 
+  struct PendingOp {
+    std::vector<uint8_t> data;
+    bool is_seek;
+    uint64_t position;
+  };
+
+  void Write(const uint8_t* data, size_t size) {
+    if (outfile && *outfile && fwrite(data, 1, size, *outfile) != size) {
+      JXL_WARNING("Failed to write %" PRIuS " bytes to output", size);
+      write_failed = true;
+    }
+  }
+
+  void DoSeek(uint64_t position) {
+    if (outfile && *outfile && fseek(*outfile, position, SEEK_SET) != 0) {
+      JXL_WARNING("Failed to seek output.");
+      write_failed = true;
+    }
+  }
+
+  void WriterLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+      cv.wait(lock, [&]() { return done || !pending.empty(); });
+      if (pending.empty()) return;
+      PendingOp op = std::move(pending.front());
+      pending.pop_front();
+      lock.unlock();
+      if (op.is_seek) {
+        DoSeek(op.position);
+      } else {
+        Write(op.data.data(), op.data.size());
+      }
+      lock.lock();
+      if (!op.is_seek) {
+        pending_bytes -= op.data.size();
+        op.data.clear();
+        free_buffers.emplace_back(std::move(op.data));
+      }
+      cv.notify_all();
+    }
+  }
+
   std::vector<uint8_t> output;
   size_t finalized_position = 0;
   std::unique_ptr<FileWrapper> outfile;
+
+  // Write-behind state, only used after EnableWriteBehind().
+  std::thread writer;
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::deque<PendingOp> pending;
+  std::vector<std::vector<uint8_t>> free_buffers;
+  size_t pending_bytes = 0;
+  size_t max_pending = 0;
+  bool done = false;
+  bool write_failed = false;
 };
 
 }  // namespace tools
@@ -1039,6 +1212,11 @@ int main(int argc, const char** argv) {
     exit(EXIT_FAILURE);
   }
 
+  if (args.pipelined) {
+    args.streaming_input = true;
+    args.streaming_output = true;
+  }
+
   if (args.file_out && args.disable_output && !args.quiet) {
     fprintf(stderr,
             "Encoding will be performed, but the result will be discarded.\n");
@@ -1064,6 +1242,9 @@ int main(int argc, const char** argv) {
       std::cerr << "Warning PPM/PGM streaming decoding failed, trying "
                    "non-streaming mode.\n";
     } else {  // ok
+      if (args.pipelined) {
+        pnm_dec.SetReadAhead(jpegxl::tools::kPipelineBufferBytes);
+      }
       if (!pnm_dec.InitializePPF(args.color_hints_proxy.target, &ppf)) {
         std::cerr
             << "Failed to initialize decoding with the given color hints\n";
@@ -1189,14 +1370,33 @@ int main(int argc, const char** argv) {
         !output_processor.SetOutputPath(args.file_out)) {
       return EXIT_FAILURE;
     }
+    if (args.pipelined) {
+      output_processor.EnableWriteBehind(jpegxl::tools::kPipelineBufferBytes);
+    }
     params.output_processor = output_processor.GetOutputProcessor();
   }
+  jpegxl::tools::TraceFile trace_file;
+  if (!args.trace_out.empty() && !trace_file.Start(args.trace_out)) {
+    return EXIT_FAILURE;
+  }
+  std::unique_ptr<JxlEncoderStats, decltype(JxlEncoderStatsDestroy)*>
+      group_stats(nullptr, JxlEncoderStatsDestroy);
+  if (!args.group_stats_out.empty() &&
+      (args.streaming_input || args.streaming_output)) {
+    std::cerr << "Group stats are not supported with streaming.\n";
+    return EXIT_FAILURE;
+  }
   std::vector<uint8_t> compressed;
   for (size_t num_rep = 0; num_rep < args.num_reps; ++num_rep) {
     if (args.streaming_output) {
       output_processor.Seek(0);
       output_processor.SetFinalizedPosition(0);
     }
+    if (!args.group_stats_out.empty()) {
+      // Only keep the groups of the last repetition.
+      group_stats.reset(JxlEncoderStatsCreate());
+      params.stats = group_stats.get();
+    }
     const double t0 = jxl::Now();
     if (!EncodeImageJXL(params, ppf, jpeg_bytes,
                         args.streaming_output ? nullptr : &compressed)) {
@@ -1207,6 +1407,15 @@ int main(int argc, const char** argv) {
     stats.NotifyElapsed(t1 - t0);
     stats.SetImageSize(ppf.info.xsize, ppf.info.ysize);
   }
+  if (!trace_file.Stop()) return EXIT_FAILURE;
+  if (group_stats && !jpegxl::tools::WriteGroupStats(group_stats.get(),
+                                                     args.group_stats_out)) {
+    return EXIT_FAILURE;
+  }
+  if (!output_processor.Finish()) {
+    std::cerr << "Could not write jxl file.\n";
+    return EXIT_FAILURE;
+  }
   size_t compressed_size = args.streaming_output
                                ? output_processor.finalized_position
                                : compressed.size();
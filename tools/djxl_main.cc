@@ -8,6 +8,7 @@
 #include <jxl/thread_parallel_runner_cxx.h>
 #include <jxl/types.h>
 
+#include <cerrno>
 #include <cmath>
 #include <cstddef>
 #include <cstdint>
@@ -18,6 +19,7 @@
 #include <memory>
 #include <sstream>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "lib/extras/alpha_blend.h"
@@ -27,11 +29,14 @@
 #include "lib/extras/enc/jpg.h"
 #include "lib/extras/packed_image.h"
 #include "lib/extras/time.h"
+#include "lib/jxl/base/common.h"
 #include "lib/jxl/base/printf_macros.h"
+#include "lib/jxl/base/status.h"
 #include "tools/cmdline.h"
 #include "tools/codec_config.h"
 #include "tools/file_io.h"
 #include "tools/speed_stats.h"
+#include "tools/trace_file.h"
 
 #include "monolithic_examples.h"
 
@@ -102,6 +107,13 @@ struct DecompressArgs {
                             "the given peak display luminance.",
                             &display_nits, &ParseDouble, 1);
 
+    cmdline->AddOptionValue('\0', "display_headroom", "LOG2_HEADROOM",
+                            "If set to a non-negative value, applies the gain "
+                            "map of the image, if any, for a display with the "
+                            "given HDR headroom (log2 of its peak over its "
+                            "reference white).",
+                            &display_headroom, &ParseDouble, 1);
+
     cmdline->AddOptionValue(
         '\0', "color_space", "COLORSPACE_DESC",
         "Sets the desired output color space of the image. For example:\n"
@@ -218,9 +230,23 @@ struct DecompressArgs {
                            "(default is white).",
                            &alpha_blend, &SetBooleanTrue, 2);
 
+    cmdline->AddOptionFlag(
+        '\0', "streaming_output",
+        "Write PNG, PPM or PGM output row by row while decoding, without "
+        "holding the whole decoded image in memory. Falls back to regular "
+        "output for animations and for options that need the whole image.",
+        &streaming_output, &SetBooleanTrue, 2);
+
     cmdline->AddOptionFlag('\0', "print_read_bytes",
                            "Print total number of decoded bytes.",
                            &print_read_bytes, &SetBooleanTrue, 2);
+
+    cmdline->AddOptionValue(
+        '\0', "trace_out", "FILENAME",
+        "Write a Chrome trace JSON file (chrome://tracing, ui.perfetto.dev) "
+        "of when each section, group and render stage ran on each thread.\n"
+        "    Requires a library built with JPEGXL_ENABLE_TRACING.",
+        &trace_out, &ParseString, 2);
   }
 
   // Validate the passed arguments, checking whether all passed options are
@@ -249,6 +275,7 @@ struct DecompressArgs {
   int32_t num_threads = -1;
   int bits_per_sample = -1;
   double display_nits = 0.0;
+  double display_headroom = -1.0;
   std::string color_space;
   uint32_t downsampling = 0;
   bool allow_partial_files = false;
@@ -266,6 +293,8 @@ struct DecompressArgs {
   std::string background_spec = "white";
   bool alpha_blend = false;
   bool print_read_bytes = false;
+  bool streaming_output = false;
+  std::string trace_out;
   bool quiet = false;
   // References (ids) of specific options to check if they were matched.
   CommandLineParser::OptionId opt_bits_per_sample_id = -1;
@@ -381,11 +410,14 @@ static bool DecompressJxlToPackedPixelFile(
     const std::vector<uint8_t>& compressed,
     const std::vector<JxlPixelFormat>& accepted_formats, bool accepts_cmyk,
     void* runner, jxl::extras::PackedPixelFile* ppf, size_t* decoded_bytes,
-    jpegxl::tools::SpeedStats* stats) {
+    jpegxl::tools::SpeedStats* stats,
+    jxl::extras::JXLRowConsumer* row_consumer = nullptr) {
   jxl::extras::JXLDecompressParams dparams;
+  dparams.row_consumer = row_consumer;
   dparams.max_downsampling = args.downsampling;
   dparams.accepted_formats = accepted_formats;
   dparams.display_nits = args.display_nits;
+  dparams.display_headroom = args.display_headroom;
   dparams.color_space = args.color_space;
   dparams.render_spotcolors = args.render_spotcolors;
   dparams.coalescing = args.coalescing;
@@ -412,6 +444,59 @@ static bool DecompressJxlToPackedPixelFile(
   return true;
 }
 
+// Opens the output file when the decoder starts producing rows, so that
+// nothing is written for images that turn out not to be streamable.
+class StreamingOutput : public jxl::extras::JXLRowConsumer {
+ public:
+  StreamingOutput(jxl::extras::StreamingEncoder* encoder, std::string filename)
+      : encoder_(encoder), filename_(std::move(filename)) {}
+
+  jxl::Status Begin(const jxl::extras::PackedPixelFile& ppf,
+                    const JxlPixelFormat& format) override {
+    file_ = jxl::make_unique<jpegxl::tools::FileWrapper>(filename_, "wb");
+    if (!*file_) {
+      fprintf(stderr, "Could not open %s for writing\nError: %s",
+              filename_.c_str(), strerror(errno));
+      return false;
+    }
+    started_ = true;
+    return encoder_->Begin(ppf, format, *file_);
+  }
+
+  jxl::Status WriteRow(const uint8_t* row) override {
+    return encoder_->WriteRow(row);
+  }
+
+  bool started() const { return started_; }
+
+ private:
+  jxl::extras::StreamingEncoder* encoder_;
+  std::string filename_;
+  std::unique_ptr<jpegxl::tools::FileWrapper> file_;
+  bool started_ = false;
+};
+
+// Decodes directly into the output file. If this fails with `*started` left
+// false, nothing was written and the regular path can still be used.
+static bool DecompressJxlToStream(const jpegxl::tools::DecompressArgs& args,
+                                  const std::vector<uint8_t>& compressed,
+                                  const std::string& extension,
+                                  const std::string& filename, void* runner,
+                                  jxl::extras::PackedPixelFile* ppf,
+                                  size_t* decoded_bytes,
+                                  jpegxl::tools::SpeedStats* stats,
+                                  bool* started) {
+  std::unique_ptr<jxl::extras::StreamingEncoder> encoder =
+      jxl::extras::StreamingEncoder::FromExtension(extension);
+  if (!encoder) return false;
+  StreamingOutput output(encoder.get(), filename);
+  bool ok = DecompressJxlToPackedPixelFile(
+      args, compressed, encoder->AcceptedFormats(), /*accepts_cmyk=*/false,
+      runner, ppf, decoded_bytes, stats, &output);
+  *started = output.started();
+  return ok && encoder->End(*ppf);
+}
+
 }  // namespace
 
 
@@ -507,6 +592,11 @@ int main(int argc, const char* argv[]) {
   auto runner = JxlThreadParallelRunnerMake(
       /*memory_manager=*/nullptr, num_worker_threads);
 
+  jpegxl::tools::TraceFile trace_file;
+  if (!args.trace_out.empty() && !trace_file.Start(args.trace_out)) {
+    return EXIT_FAILURE;
+  }
+
   bool decode_to_pixels = (codec != jxl::extras::Codec::kJPG);
   if (args.opt_jpeg_quality_id >= 0 &&
       (args.pixels_to_jpeg ||
@@ -540,7 +630,52 @@ int main(int argc, const char* argv[]) {
       }
     }
   }
-  if (decode_to_pixels) {
+  bool streamed = false;
+  if (decode_to_pixels && args.streaming_output && !filename_out.empty()) {
+    if (args.alpha_blend || args.output_extra_channels || args.output_frames ||
+        !args.coalescing || args.allow_partial_files || args.downsampling > 1 ||
+        !args.preview_out.empty() ||
+        !jxl::extras::StreamingEncoder::FromExtension(extension)) {
+      if (!args.quiet) {
+        fprintf(stderr,
+                "Warning: --streaming_output is not supported for this output "
+                "format or these options, ignoring it.\n");
+      }
+    } else {
+      jxl::extras::PackedPixelFile ppf;
+      size_t decoded_bytes = 0;
+      bool started = false;
+      streamed = true;
+      for (size_t i = 0; i < num_reps && streamed; ++i) {
+        streamed = DecompressJxlToStream(args, compressed, extension,
+                                         filename_out, runner.get(), &ppf,
+                                         &decoded_bytes, &stats, &started);
+      }
+      if (!streamed && started) {
+        fprintf(stderr, "DecompressJxlToStream failed\n");
+        return EXIT_FAILURE;
+      }
+      if (streamed) {
+        if (!args.quiet) {
+          cmdline.VerbosePrintf(0, "Decoded to pixels.\n");
+          cmdline.VerbosePrintf(1, "Wrote output to %s\n",
+                                filename_out.c_str());
+        }
+        if (args.print_read_bytes) {
+          fprintf(stderr, "Decoded bytes: %" PRIuS "\n", decoded_bytes);
+        }
+        if (!WriteOptionalOutput(args.icc_out, ppf.icc) ||
+            !WriteOptionalOutput(args.orig_icc_out, ppf.orig_icc)) {
+          return EXIT_FAILURE;
+        }
+      } else if (!args.quiet) {
+        fprintf(stderr,
+                "Warning: this image cannot be decoded with "
+                "--streaming_output, retrying without it.\n");
+      }
+    }
+  }
+  if (decode_to_pixels && !streamed) {
     std::vector<JxlPixelFormat> accepted_formats;
     std::unique_ptr<jxl::extras::Encoder> encoder;
     bool accepts_cmyk = false;
@@ -641,6 +776,7 @@ int main(int argc, const char* argv[]) {
       }
     }
   }
+  if (!trace_file.Stop()) return EXIT_FAILURE;
   if (!args.quiet) {
     stats.Print(num_worker_threads);
   }
@@ -0,0 +1,174 @@
+// Copyright (c) the JPEG XL Project Authors. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+// Encodes an image with the largest distance that reaches a target
+// SSIMULACRA 2 score or butteraugli distance, by encoding several times.
+
+#include <jxl/encode.h>
+#include <jxl/thread_parallel_runner.h>
+#include <jxl/thread_parallel_runner_cxx.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "lib/extras/dec/color_hints.h"
+#include "lib/extras/dec/decode.h"
+#include "lib/extras/enc/jxl.h"
+#include "lib/extras/packed_image.h"
+#include "lib/jxl/base/printf_macros.h"
+#include "lib/jxl/base/span.h"
+#include "lib/jxl/base/status.h"
+#include "tools/file_io.h"
+#include "tools/target_score.h"
+
+#include "monolithic_examples.h"
+
+namespace {
+
+using ::jpegxl::tools::TargetMetric;
+
+int PrintUsage(const char* name) {
+  fprintf(stderr,
+          "Usage: %s in out (--ssimulacra2 SCORE | --butteraugli DISTANCE)\n"
+          "       [--effort EFFORT] [--num_threads N]\n"
+          "Encodes in to the JPEG XL file out with the largest distance whose\n"
+          "SSIMULACRA 2 score is at least SCORE, or whose (max norm)\n"
+          "butteraugli distance is at most DISTANCE.\n",
+          name);
+  return EXIT_FAILURE;
+}
+
+bool ParseNumber(const char* arg, double* value) {
+  char* end;
+  *value = strtod(arg, &end);
+  return end != arg && *end == '\0';
+}
+
+int EncodeToTarget(int argc, const char** argv) {
+  if (argc < 5 || argc % 2 != 1) return PrintUsage(argv[0]);
+  const std::string pathname_in = argv[1];
+  const std::string pathname_out = argv[2];
+  bool has_metric = false;
+  TargetMetric metric = TargetMetric::kSsimulacra2;
+  double target = 0;
+  double effort = 7;
+  double num_threads = std::thread::hardware_concurrency();
+  for (int i = 3; i < argc; i += 2) {
+    const std::string flag = argv[i];
+    double value;
+    if (!ParseNumber(argv[i + 1], &value)) {
+      fprintf(stderr, "Failed to parse the value of %s: \"%s\".\n",
+              flag.c_str(), argv[i + 1]);
+      return EXIT_FAILURE;
+    }
+    if (flag == "--ssimulacra2" || flag == "--butteraugli") {
+      if (has_metric) return PrintUsage(argv[0]);
+      has_metric = true;
+      metric = flag == "--butteraugli" ? TargetMetric::kButteraugli
+                                       : TargetMetric::kSsimulacra2;
+      target = value;
+    } else if (flag == "--effort") {
+      effort = value;
+    } else if (flag == "--num_threads" && value >= 0) {
+      num_threads = value;
+    } else {
+      return PrintUsage(argv[0]);
+    }
+  }
+  if (!has_metric) return PrintUsage(argv[0]);
+  if (metric == TargetMetric::kButteraugli && !(target > 0)) {
+    fprintf(stderr, "The butteraugli distance must be positive.\n");
+    return EXIT_FAILURE;
+  }
+
+  std::vector<uint8_t> encoded_in;
+  if (!jpegxl::tools::ReadFile(pathname_in, &encoded_in)) {
+    fprintf(stderr, "Failed to read image from %s\n", pathname_in.c_str());
+    return EXIT_FAILURE;
+  }
+  jxl::extras::PackedPixelFile ppf;
+  if (!jxl::extras::DecodeBytes(jxl::Bytes(encoded_in),
+                                jxl::extras::ColorHints(), &ppf)) {
+    fprintf(stderr, "Failed to decode %s\n", pathname_in.c_str());
+    return EXIT_FAILURE;
+  }
+  if (ppf.frames.size() != 1) {
+    fprintf(stderr, "Only single frame images are supported.\n");
+    return EXIT_FAILURE;
+  }
+
+  JxlThreadParallelRunnerPtr runner = JxlThreadParallelRunnerMake(
+      /*memory_manager=*/nullptr, static_cast<size_t>(num_threads));
+  jxl::extras::JXLCompressParams params;
+  params.runner = JxlThreadParallelRunner;
+  params.runner_opaque = runner.get();
+  params.AddOption(JXL_ENC_FRAME_SETTING_EFFORT, static_cast<int64_t>(effort));
+
+  jxl::extras::JXLTargetScoreParams target_params;
+  if (metric == TargetMetric::kSsimulacra2) {
+    target_params.target_score = target;
+  } else {
+    // Scores are negated distances.
+    target_params.target_score = -target;
+    target_params.tolerance = 0.02 * target;
+    // Starting point of the search.
+    params.distance = target;
+  }
+  std::unique_ptr<jpegxl::tools::TargetScorer> scorer;
+  bool ok = [&]() -> jxl::Status {
+    JXL_ASSIGN_OR_RETURN(
+        scorer, jpegxl::tools::TargetScorer::Create(
+                    metric, ppf, params.runner, params.runner_opaque));
+    return true;
+  }();
+  if (!ok) {
+    fprintf(stderr, "Computing the reference of the target metric failed.\n");
+    return EXIT_FAILURE;
+  }
+  const auto score_func = [&](const std::vector<uint8_t>& bytes,
+                              double* score) -> bool {
+    return static_cast<bool>(scorer->Score(bytes, score));
+  };
+
+  std::vector<uint8_t> compressed;
+  jxl::extras::JXLTargetScoreResult result;
+  if (!jxl::extras::EncodeImageJXLToTargetScore(
+          params, ppf, score_func, target_params, &compressed, &result)) {
+    fprintf(stderr, "EncodeImageJXLToTargetScore() failed.\n");
+    return EXIT_FAILURE;
+  }
+  if (!jpegxl::tools::WriteFile(pathname_out, compressed)) {
+    fprintf(stderr, "Failed to write %s\n", pathname_out.c_str());
+    return EXIT_FAILURE;
+  }
+
+  const double reached_score =
+      metric == TargetMetric::kSsimulacra2 ? result.score : -result.score;
+  if (!result.reached) {
+    fprintf(stderr,
+            "Warning: target score not reached, best score %.3f at distance "
+            "%.3f.\n",
+            reached_score, result.distance);
+  }
+  printf("Distance %.3f reached score %.3f after %" PRIuS
+         " encodes, %" PRIuS " bytes.\n",
+         result.distance, reached_score, result.num_probes,
+         compressed.size());
+  return EXIT_SUCCESS;
+}
+
+}  // namespace
+
+#if defined(BUILD_MONOLITHIC)
+#define main(cnt, arr) jpegXL_encode_to_target_main(cnt, arr)
+#endif
+
+int main(int argc, const char** argv) { return EncodeToTarget(argc, argv); }
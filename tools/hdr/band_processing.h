@@ -0,0 +1,338 @@
+// Copyright (c) the JPEG XL Project Authors. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#ifndef TOOLS_HDR_BAND_PROCESSING_H_
+#define TOOLS_HDR_BAND_PROCESSING_H_
+
+// Band-wise conversion of HDR images, shared by the tools in this directory.
+//
+// The image is kept in its decoded, packed form. Bands of rows are then
+// converted to linear Rec. 2020, processed, converted to the output color
+// encoding and packed again, in parallel on the thread pool. This fuses all
+// the passes over the image and only needs float buffers the size of a band
+// per thread, instead of several full-size float copies of the image.
+
+#include <jxl/cms.h>
+#include <jxl/codestream_header.h>
+#include <jxl/types.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "lib/extras/codec.h"
+#include "lib/extras/dec/color_hints.h"
+#include "lib/extras/dec/decode.h"
+#include "lib/extras/packed_image.h"
+#include "lib/jxl/base/common.h"
+#include "lib/jxl/base/data_parallel.h"
+#include "lib/jxl/base/span.h"
+#include "lib/jxl/base/status.h"
+#include "lib/jxl/color_encoding_internal.h"
+#include "lib/jxl/dec_cache.h"  // PixelCallback
+#include "lib/jxl/dec_external_image.h"
+#include "lib/jxl/enc_external_image.h"
+#include "lib/jxl/image.h"
+#include "lib/jxl/image_metadata.h"
+#include "lib/jxl/luminance.h"
+#include "tools/file_io.h"
+#include "tools/no_memory_manager.h"
+
+namespace jpegxl {
+namespace tools {
+
+// Number of rows processed at once by a thread.
+constexpr size_t kHdrBandRows = 64;
+
+struct HdrImage {
+  // The decoded image, of which only the color channels and the alpha channel
+  // are converted.
+  jxl::extras::PackedPixelFile ppf;
+  jxl::ColorEncoding color_encoding;
+  // Luminance of (1, 1, 1), from the image or the default for its transfer
+  // function. Tools may override it before processing.
+  float intensity_target;
+};
+
+// Modifies a band of rows of a frame in place, starting at row `y0`. The band
+// is in linear Rec. 2020 with a D65 white point, scaled so that 1 is the
+// intensity target. Called concurrently for different bands.
+using BandFunction = std::function<jxl::Status(size_t y0, jxl::Image3F* band)>;
+
+// The color encoding of the bands passed to a BandFunction.
+static inline jxl::Status GetLinearRec2020(jxl::ColorEncoding* encoding) {
+  encoding->SetColorSpace(jxl::ColorSpace::kRGB);
+  JXL_RETURN_IF_ERROR(encoding->SetPrimariesType(jxl::Primaries::k2100));
+  JXL_RETURN_IF_ERROR(encoding->SetWhitePointType(jxl::WhitePoint::kD65));
+  encoding->Tf().SetTransferFunction(jxl::TransferFunction::kLinear);
+  return encoding->CreateICC();
+}
+
+static inline jxl::Status ReadHdrImage(
+    const std::string& pathname, const jxl::extras::ColorHints& color_hints,
+    HdrImage* image) {
+  std::vector<uint8_t> encoded;
+  if (!ReadFile(pathname, &encoded)) {
+    return JXL_FAILURE("Failed to read %s", pathname.c_str());
+  }
+  jxl::extras::PackedPixelFile& ppf = image->ppf;
+  JXL_RETURN_IF_ERROR(
+      jxl::extras::DecodeBytes(jxl::Bytes(encoded), color_hints, &ppf));
+  if (ppf.frames.empty()) return JXL_FAILURE("Image has no frames");
+  if (ppf.info.num_color_channels != 3) {
+    return JXL_FAILURE("Only RGB images are supported");
+  }
+  jxl::ImageMetadata metadata;
+  if (ppf.primary_color_representation ==
+      jxl::extras::PackedPixelFile::kIccIsPrimary) {
+    jxl::IccBytes icc = ppf.icc;
+    JXL_RETURN_IF_ERROR(
+        metadata.color_encoding.SetICC(std::move(icc), JxlGetDefaultCms()));
+  } else {
+    JXL_RETURN_IF_ERROR(
+        metadata.color_encoding.FromExternal(ppf.color_encoding));
+  }
+  if (metadata.color_encoding.IsGray() || metadata.color_encoding.IsCMYK()) {
+    return JXL_FAILURE("Only RGB color encodings are supported");
+  }
+  if (ppf.info.intensity_target != 0) {
+    metadata.SetIntensityTarget(ppf.info.intensity_target);
+  } else {
+    jxl::SetIntensityTarget(&metadata);
+  }
+  image->color_encoding = metadata.color_encoding;
+  image->intensity_target = metadata.IntensityTarget();
+  return true;
+}
+
+// Converts the rows of `band` with `transform`, using the buffers of `thread`.
+static inline jxl::Status TransformBand(jxl::ColorSpaceTransform& transform,
+                                        size_t thread, jxl::Image3F* band) {
+  const size_t xsize = band->xsize();
+  for (size_t y = 0; y < band->ysize(); ++y) {
+    float* JXL_RESTRICT rows[3] = {band->PlaneRow(0, y), band->PlaneRow(1, y),
+                                   band->PlaneRow(2, y)};
+    float* JXL_RESTRICT src = transform.BufSrc(thread);
+    for (size_t x = 0; x < xsize; ++x) {
+      for (size_t c = 0; c < 3; ++c) src[3 * x + c] = rows[c][x];
+    }
+    float* JXL_RESTRICT dst = transform.BufDst(thread);
+    JXL_RETURN_IF_ERROR(transform.Run(thread, src, dst, xsize));
+    for (size_t x = 0; x < xsize; ++x) {
+      for (size_t c = 0; c < 3; ++c) rows[c][x] = dst[3 * x + c];
+    }
+  }
+  return true;
+}
+
+// Runs `process` on all bands of the frame `in`, in parallel. If `out` is not
+// null, the processed bands are then converted to `c_out` and stored in `out`,
+// which must have the size of `in` and as many channels. Alpha is copied.
+static inline jxl::Status ProcessFrameInBands(
+    const HdrImage& image, const jxl::extras::PackedImage& in,
+    const BandFunction& process, const jxl::ColorEncoding& c_out,
+    float out_intensity_target, size_t out_bits_per_sample,
+    jxl::extras::PackedImage* out, jxl::ThreadPool* pool) {
+  JxlMemoryManager* memory_manager = NoMemoryManager();
+  const size_t xsize = in.xsize;
+  const size_t ysize = in.ysize;
+  if (in.format.num_channels < 3) {
+    return JXL_FAILURE("Only RGB images are supported");
+  }
+  const bool has_alpha = (in.format.num_channels == 4);
+  JXL_ENSURE(!out || (out->xsize == xsize && out->ysize == ysize &&
+                      out->format.num_channels == in.format.num_channels));
+  const size_t in_bits_per_sample =
+      image.ppf.input_bitdepth.type == JXL_BIT_DEPTH_FROM_PIXEL_FORMAT
+          ? jxl::extras::PackedImage::BitsPerChannel(in.format.data_type)
+          : image.ppf.info.bits_per_sample;
+
+  jxl::ColorEncoding linear_rec2020;
+  JXL_RETURN_IF_ERROR(GetLinearRec2020(&linear_rec2020));
+  const JxlCmsInterface& cms = *JxlGetDefaultCms();
+  const bool to_linear =
+      !image.color_encoding.SameColorEncoding(linear_rec2020);
+  const bool from_linear = out && !c_out.SameColorEncoding(linear_rec2020);
+  jxl::ColorSpaceTransform to_linear_transform(cms);
+  jxl::ColorSpaceTransform from_linear_transform(cms);
+  std::vector<jxl::Image3F> bands;
+  std::vector<jxl::ImageF> alpha_bands;
+  const auto init = [&](size_t num_threads) -> jxl::Status {
+    if (to_linear) {
+      JXL_RETURN_IF_ERROR(to_linear_transform.Init(
+          image.color_encoding, linear_rec2020, image.intensity_target, xsize,
+          num_threads));
+    }
+    if (from_linear) {
+      JXL_RETURN_IF_ERROR(from_linear_transform.Init(
+          linear_rec2020, c_out, out_intensity_target, xsize, num_threads));
+    }
+    for (size_t i = 0; i < num_threads; ++i) {
+      JXL_ASSIGN_OR_RETURN(
+          jxl::Image3F band,
+          jxl::Image3F::Create(memory_manager, xsize, kHdrBandRows));
+      bands.emplace_back(std::move(band));
+      if (has_alpha && out) {
+        JXL_ASSIGN_OR_RETURN(
+            jxl::ImageF alpha,
+            jxl::ImageF::Create(memory_manager, xsize, kHdrBandRows));
+        alpha_bands.emplace_back(std::move(alpha));
+      }
+    }
+    return true;
+  };
+
+  const auto process_band = [&](const uint32_t band_index,
+                                const size_t thread) -> jxl::Status {
+    const size_t y0 = band_index * kHdrBandRows;
+    const size_t num_rows = std::min(kHdrBandRows, ysize - y0);
+    jxl::Image3F& band = bands[thread];
+    JXL_RETURN_IF_ERROR(band.ShrinkTo(xsize, num_rows));
+    const uint8_t* in_pixels =
+        static_cast<const uint8_t*>(in.pixels()) + y0 * in.stride;
+    for (size_t c = 0; c < 3; ++c) {
+      JXL_RETURN_IF_ERROR(jxl::ConvertFromExternalNoSizeCheck(
+          in_pixels, xsize, num_rows, in.stride, in_bits_per_sample, in.format,
+          c, /*pool=*/nullptr, &band.Plane(c)));
+    }
+    if (to_linear) {
+      JXL_RETURN_IF_ERROR(TransformBand(to_linear_transform, thread, &band));
+    }
+    JXL_RETURN_IF_ERROR(process(y0, &band));
+    if (!out) return true;
+
+    if (from_linear) {
+      JXL_RETURN_IF_ERROR(TransformBand(from_linear_transform, thread, &band));
+    }
+    const jxl::ImageF* channels[4] = {&band.Plane(0), &band.Plane(1),
+                                      &band.Plane(2), nullptr};
+    if (has_alpha) {
+      jxl::ImageF& alpha = alpha_bands[thread];
+      JXL_RETURN_IF_ERROR(alpha.ShrinkTo(xsize, num_rows));
+      JXL_RETURN_IF_ERROR(jxl::ConvertFromExternalNoSizeCheck(
+          in_pixels, xsize, num_rows, in.stride, in_bits_per_sample, in.format,
+          3, /*pool=*/nullptr, &alpha));
+      channels[3] = &alpha;
+    }
+    const bool float_out = out->format.data_type == JXL_TYPE_FLOAT ||
+                           out->format.data_type == JXL_TYPE_FLOAT16;
+    return jxl::ConvertChannelsToExternal(
+        channels, out->format.num_channels, out_bits_per_sample, float_out,
+        out->format.endianness, out->stride, /*pool=*/nullptr,
+        out->pixels(y0, 0, 0), num_rows * out->stride, jxl::PixelCallback(),
+        jxl::Orientation::kIdentity);
+  };
+
+  return jxl::RunOnPool(pool, 0, jxl::DivCeil(ysize, kHdrBandRows), init,
+                        process_band, "ProcessFrameInBands");
+}
+
+// Runs `process` on all bands of all frames of `image`, e.g. to gather
+// statistics, without producing an output.
+static inline jxl::Status ForEachBand(const HdrImage& image,
+                                      const BandFunction& process,
+                                      jxl::ThreadPool* pool) {
+  for (const jxl::extras::PackedFrame& frame : image.ppf.frames) {
+    JXL_RETURN_IF_ERROR(ProcessFrameInBands(image, frame.color, process,
+                                            image.color_encoding, 0.f, 0,
+                                            /*out=*/nullptr, pool));
+  }
+  return true;
+}
+
+// Converts all frames of `image` band by band with `process` and stores the
+// result in `c_out` into `ppf`, with samples of `format.data_type`.
+// `bits_per_sample` is only used for integer samples.
+static inline jxl::Status ConvertInBands(
+    const HdrImage& image, const BandFunction& process,
+    const jxl::ColorEncoding& c_out, float out_intensity_target,
+    JxlPixelFormat format, size_t bits_per_sample,
+    jxl::extras::PackedPixelFile* ppf, jxl::ThreadPool* pool) {
+  const bool float_out = format.data_type == JXL_TYPE_FLOAT ||
+                         format.data_type == JXL_TYPE_FLOAT16;
+  if (float_out) {
+    bits_per_sample =
+        jxl::extras::PackedImage::BitsPerChannel(format.data_type);
+  }
+  const bool has_alpha = image.ppf.info.alpha_bits != 0;
+  ppf->info = image.ppf.info;
+  ppf->info.num_color_channels = 3;
+  ppf->info.bits_per_sample = bits_per_sample;
+  ppf->info.exponent_bits_per_sample =
+      float_out ? (format.data_type == JXL_TYPE_FLOAT ? 8 : 5) : 0;
+  ppf->info.alpha_bits = has_alpha ? ppf->info.bits_per_sample : 0;
+  ppf->info.alpha_exponent_bits =
+      has_alpha ? ppf->info.exponent_bits_per_sample : 0;
+  ppf->info.num_extra_channels = has_alpha ? 1 : 0;
+  ppf->info.intensity_target = out_intensity_target;
+  ppf->icc.assign(c_out.ICC().begin(), c_out.ICC().end());
+  ppf->primary_color_representation =
+      c_out.WantICC() ? jxl::extras::PackedPixelFile::kIccIsPrimary
+                      : jxl::extras::PackedPixelFile::kColorEncodingIsPrimary;
+  ppf->color_encoding = c_out.ToExternal();
+
+  ppf->frames.clear();
+  for (const jxl::extras::PackedFrame& frame : image.ppf.frames) {
+    format.num_channels = frame.color.format.num_channels;
+    JXL_ASSIGN_OR_RETURN(
+        jxl::extras::PackedFrame out_frame,
+        jxl::extras::PackedFrame::Create(frame.color.xsize, frame.color.ysize,
+                                         format));
+    out_frame.frame_info = frame.frame_info;
+    out_frame.name = frame.name;
+    JXL_RETURN_IF_ERROR(ProcessFrameInBands(
+        image, frame.color, process, c_out, out_intensity_target,
+        bits_per_sample, &out_frame.color, pool));
+    ppf->frames.emplace_back(std::move(out_frame));
+  }
+  return true;
+}
+
+// Same as ConvertInBands, then encodes the result to `pathname` in the format
+// given by its extension.
+static inline jxl::Status WriteInBands(const HdrImage& image,
+                                       const BandFunction& process,
+                                       const jxl::ColorEncoding& c_out,
+                                       float out_intensity_target,
+                                       size_t bits_per_sample,
+                                       const std::string& pathname,
+                                       jxl::ThreadPool* pool) {
+  std::string extension;
+  const jxl::extras::Codec codec =
+      jxl::extras::CodecFromPath(pathname, &bits_per_sample, &extension);
+  JxlPixelFormat format = {
+      0,  // set for each frame
+      bits_per_sample <= 8 ? JXL_TYPE_UINT8 : JXL_TYPE_UINT16, JXL_BIG_ENDIAN,
+      0};
+  if (codec == jxl::extras::Codec::kJPG) {
+    format.data_type = JXL_TYPE_UINT8;
+    bits_per_sample = 8;
+  } else if (codec == jxl::extras::Codec::kEXR ||
+             (codec == jxl::extras::Codec::kPNM && extension == ".pfm")) {
+    format.data_type = JXL_TYPE_FLOAT;
+    format.endianness = JXL_LITTLE_ENDIAN;
+  } else if (bits_per_sample > 16) {
+    bits_per_sample = 16;
+  }
+  jxl::extras::PackedPixelFile ppf;
+  JXL_RETURN_IF_ERROR(ConvertInBands(image, process, c_out,
+                                     out_intensity_target, format,
+                                     bits_per_sample, &ppf, pool));
+  std::vector<uint8_t> encoded;
+  JXL_RETURN_IF_ERROR(jxl::Encode(ppf, codec, &encoded, pool));
+  if (!WriteFile(pathname, encoded)) {
+    return JXL_FAILURE("Failed to write %s", pathname.c_str());
+  }
+  return true;
+}
+
+}  // namespace tools
+}  // namespace jpegxl
+
+#endif  // TOOLS_HDR_BAND_PROCESSING_H_
@@ -4,28 +4,22 @@
 // license that can be found in the LICENSE file.
 
 #include <algorithm>
-#include <cstdint>
+#include <cstddef>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
-#include <vector>
+#include <mutex>
 
-#include "lib/extras/codec_in_out.h"
-#include "lib/extras/dec/decode.h"
-#include "lib/extras/packed_image.h"
-#include "lib/extras/packed_image_convert.h"
+#include "lib/extras/dec/color_hints.h"
 #include "lib/extras/tone_mapping.h"
-#include "lib/jxl/base/common.h"
 #include "lib/jxl/base/matrix_ops.h"
-#include "lib/jxl/base/span.h"
+#include "lib/jxl/base/status.h"
 #include "lib/jxl/cms/jxl_cms_internal.h"
 #include "lib/jxl/color_encoding_internal.h"
-#include "lib/jxl/image_bundle.h"
+#include "lib/jxl/image.h"
 #include "lib/jxl/image_ops.h"
 #include "tools/cmdline.h"
-#include "tools/file_io.h"
-#include "tools/hdr/image_utils.h"
-#include "tools/no_memory_manager.h"
+#include "tools/hdr/band_processing.h"
 #include "tools/thread_pool_internal.h"
 
 #include "monolithic_examples.h"
@@ -96,62 +90,69 @@ int main(int argc, const char** argv) {
     return EXIT_FAILURE;
   }
 
-  jxl::extras::PackedPixelFile ppf;
-  std::vector<uint8_t> input_bytes;
-  JPEGXL_TOOLS_CHECK(jpegxl::tools::ReadFile(input_filename, &input_bytes));
-  JPEGXL_TOOLS_CHECK(jxl::extras::DecodeBytes(jxl::Bytes(input_bytes),
-                                              jxl::extras::ColorHints(), &ppf));
-
-  auto image =
-      jxl::make_unique<jxl::CodecInOut>(jpegxl::tools::NoMemoryManager());
-  JPEGXL_TOOLS_CHECK(jxl::extras::ConvertPackedPixelFileToCodecInOut(
-      ppf, pool.get(), image.get()));
-  image->metadata.m.bit_depth.exponent_bits_per_sample = 0;
-  jxl::ColorEncoding linear_rec_2020 = image->Main().c_current();
-  JPEGXL_TOOLS_CHECK(linear_rec_2020.SetPrimariesType(jxl::Primaries::k2100));
-  linear_rec_2020.Tf().SetTransferFunction(jxl::TransferFunction::kLinear);
-  JPEGXL_TOOLS_CHECK(linear_rec_2020.CreateICC());
-  JPEGXL_TOOLS_CHECK(jpegxl::tools::TransformCodecInOutTo(
-      *image, linear_rec_2020, pool.get()));
+  jpegxl::tools::HdrImage image;
+  JPEGXL_TOOLS_CHECK(jpegxl::tools::ReadHdrImage(
+      input_filename, jxl::extras::ColorHints(), &image));
 
+  jxl::ColorEncoding linear_rec_2020;
+  JPEGXL_TOOLS_CHECK(jpegxl::tools::GetLinearRec2020(&linear_rec_2020));
   jxl::Matrix3x3 primaries_xyz;
   jxl::PrimariesCIExy p;
-  JPEGXL_TOOLS_CHECK(image->Main().c_current().GetPrimaries(p));
-  const jxl::CIExy wp = image->Main().c_current().GetWhitePoint();
+  JPEGXL_TOOLS_CHECK(linear_rec_2020.GetPrimaries(p));
+  const jxl::CIExy wp = linear_rec_2020.GetWhitePoint();
   JPEGXL_TOOLS_CHECK(jxl::PrimariesToXYZ(p.r.x, p.r.y, p.g.x, p.g.y, p.b.x,
                                          p.b.y, wp.x, wp.y, primaries_xyz));
 
+  // Statistics of the whole image, merged from those of each band.
+  std::mutex stats_mutex;
   float max_value = 0.f;
   float max_relative_luminance = 0.f;
-  float white_luminance = ppf.info.intensity_target != 0 &&
-                                  !parser.GetOption(luminance_option)->matched()
-                              ? ppf.info.intensity_target
-                          : luminance_info.kind == LuminanceInfo::Kind::kWhite
-                              ? luminance_info.luminance
-                              : 0.f;
   bool out_of_gamut = false;
-  for (size_t y = 0; y < image->ysize(); ++y) {
-    const float* const rows[3] = {image->Main().color()->ConstPlaneRow(0, y),
-                                  image->Main().color()->ConstPlaneRow(1, y),
-                                  image->Main().color()->ConstPlaneRow(2, y)};
-    for (size_t x = 0; x < image->xsize(); ++x) {
-      if (!out_of_gamut &&
-          (rows[0][x] < 0 || rows[1][x] < 0 || rows[2][x] < 0)) {
-        out_of_gamut = true;
-        fprintf(stderr,
-                "WARNING: found colors outside of the Rec. 2020 gamut.\n");
-      }
-      max_value = std::max(
-          max_value, std::max(rows[0][x], std::max(rows[1][x], rows[2][x])));
-      const float luminance = primaries_xyz[0][1] * rows[0][x] +
-                              primaries_xyz[1][1] * rows[1][x] +
-                              primaries_xyz[2][1] * rows[2][x];
-      if (luminance_info.kind == LuminanceInfo::Kind::kMaximum &&
-          luminance > max_relative_luminance) {
-        max_relative_luminance = luminance;
-        white_luminance = luminance_info.luminance / luminance;
+  const auto gather_stats = [&](size_t /*y0*/,
+                                jxl::Image3F* band) -> jxl::Status {
+    float band_max_value = 0.f;
+    float band_max_luminance = 0.f;
+    bool band_out_of_gamut = false;
+    for (size_t y = 0; y < band->ysize(); ++y) {
+      const float* const rows[3] = {band->ConstPlaneRow(0, y),
+                                    band->ConstPlaneRow(1, y),
+                                    band->ConstPlaneRow(2, y)};
+      for (size_t x = 0; x < band->xsize(); ++x) {
+        if (rows[0][x] < 0 || rows[1][x] < 0 || rows[2][x] < 0) {
+          band_out_of_gamut = true;
+        }
+        band_max_value =
+            std::max(band_max_value,
+                     std::max(rows[0][x], std::max(rows[1][x], rows[2][x])));
+        const float luminance = primaries_xyz[0][1] * rows[0][x] +
+                                primaries_xyz[1][1] * rows[1][x] +
+                                primaries_xyz[2][1] * rows[2][x];
+        band_max_luminance = std::max(band_max_luminance, luminance);
       }
     }
+    std::lock_guard<std::mutex> lock(stats_mutex);
+    max_value = std::max(max_value, band_max_value);
+    max_relative_luminance =
+        std::max(max_relative_luminance, band_max_luminance);
+    out_of_gamut = out_of_gamut || band_out_of_gamut;
+    return true;
+  };
+  JPEGXL_TOOLS_CHECK(
+      jpegxl::tools::ForEachBand(image, gather_stats, pool.get()));
+  if (out_of_gamut) {
+    fprintf(stderr, "WARNING: found colors outside of the Rec. 2020 gamut.\n");
+  }
+
+  float white_luminance =
+      image.ppf.info.intensity_target != 0 &&
+              !parser.GetOption(luminance_option)->matched()
+          ? image.ppf.info.intensity_target
+      : luminance_info.kind == LuminanceInfo::Kind::kWhite
+          ? luminance_info.luminance
+          : 0.f;
+  if (luminance_info.kind == LuminanceInfo::Kind::kMaximum &&
+      max_relative_luminance > 0.f) {
+    white_luminance = luminance_info.luminance / max_relative_luminance;
   }
 
   bool needs_gamut_mapping = false;
@@ -172,23 +173,21 @@ int main(int argc, const char** argv) {
             "--intensity_target=%g.\n",
             white_luminance);
   }
-  image->metadata.m.SetIntensityTarget(white_luminance);
-
-  jxl::ScaleImage(1.f / max_value, image->Main().color());
 
-  if (needs_gamut_mapping) {
-    JPEGXL_TOOLS_CHECK(jxl::GamutMap(image.get(), 0.f, pool.get()));
-  }
+  const auto scale = [&](size_t /*y0*/, jxl::Image3F* band) -> jxl::Status {
+    jxl::ScaleImage(1.f / max_value, band);
+    if (needs_gamut_mapping) {
+      JXL_RETURN_IF_ERROR(jxl::GamutMapImage(band, 0.f));
+    }
+    return true;
+  };
 
-  jxl::ColorEncoding pq = image->Main().c_current();
+  jxl::ColorEncoding pq = image.color_encoding;
+  JPEGXL_TOOLS_CHECK(pq.SetPrimariesType(jxl::Primaries::k2100));
   pq.Tf().SetTransferFunction(jxl::TransferFunction::kPQ);
   JPEGXL_TOOLS_CHECK(pq.CreateICC());
-  JPEGXL_TOOLS_CHECK(
-      jpegxl::tools::TransformCodecInOutTo(*image, pq, pool.get()));
-  image->metadata.m.color_encoding = pq;
-  std::vector<uint8_t> encoded;
-  JPEGXL_TOOLS_CHECK(
-      jpegxl::tools::Encode(*image, output_filename, &encoded, pool.get()));
-  JPEGXL_TOOLS_CHECK(jpegxl::tools::WriteFile(output_filename, encoded));
+  JPEGXL_TOOLS_CHECK(jpegxl::tools::WriteInBands(
+      image, scale, pq, white_luminance, image.ppf.info.bits_per_sample,
+      output_filename, pool.get()));
   return EXIT_SUCCESS;
 }
@@ -40,6 +40,7 @@
 #include "lib/jxl/convolve.h"
 #include "lib/jxl/image_bundle.h"
 #include "tools/cmdline.h"
+#include "tools/hdr/band_processing.h"
 #include "tools/no_memory_manager.h"
 #include "tools/thread_pool_internal.h"
 
@@ -349,14 +350,17 @@ int main(int argc, const char** argv) {
     return EXIT_FAILURE;
   }
 
-  auto image =
-      jxl::make_unique<jxl::CodecInOut>(jpegxl::tools::NoMemoryManager());
+  // The decoded input is kept for the HDR output, since the tone mapping
+  // modifies the image in place.
+  jpegxl::tools::HdrImage hdr_image;
   jxl::extras::ColorHints color_hints;
   color_hints.Add("color_space", "RGB_D65_202_Rel_PeQ");
-  std::vector<uint8_t> encoded;
-  JPEGXL_TOOLS_CHECK(jpegxl::tools::ReadFile(input_filename, &encoded));
-  JPEGXL_TOOLS_CHECK(jxl::SetFromBytes(jxl::Bytes(encoded), color_hints,
-                                       image.get(), pool.get()));
+  JPEGXL_TOOLS_CHECK(
+      jpegxl::tools::ReadHdrImage(input_filename, color_hints, &hdr_image));
+  auto image =
+      jxl::make_unique<jxl::CodecInOut>(jpegxl::tools::NoMemoryManager());
+  JPEGXL_TOOLS_CHECK(jxl::extras::ConvertPackedPixelFileToCodecInOut(
+      hdr_image.ppf, pool.get(), image.get()));
 
   JPEGXL_TOOLS_CHECK(
       jxl::ProcessFrame(image.get(), preserve_saturation, pool.get()));
@@ -367,40 +371,57 @@ int main(int argc, const char** argv) {
                          *image->Main().color(),
                          image->metadata.m.color_encoding, format, pool.get()),
                      "ConvertImage3FToPackedPixelFile failed.");
+  std::vector<uint8_t> encoded;
   JPEGXL_TOOLS_CHECK(jxl::Encode(ppf, output_filename, &encoded, pool.get()));
   JPEGXL_TOOLS_CHECK(jpegxl::tools::WriteFile(output_filename, encoded));
 
   if (parser.GetOption(output_hdr_filename_option)->matched()) {
-    std::vector<uint8_t> encoded;
-    JPEGXL_TOOLS_CHECK(jpegxl::tools::ReadFile(input_filename, &encoded));
-    JPEGXL_TOOLS_CHECK(jxl::SetFromBytes(jxl::Bytes(encoded), color_hints,
-                                         image.get(), pool.get()));
     jxl::ColorEncoding p3pq;
     JXL_RETURN_IF_ERROR(p3pq.SetWhitePointType(jxl::WhitePoint::kD65));
     JXL_RETURN_IF_ERROR(p3pq.SetPrimariesType(jxl::Primaries::kP3));
     p3pq.Tf().SetTransferFunction(jxl::TransferFunction::kPQ);
     JXL_RETURN_IF_ERROR(p3pq.CreateICC());
-    JXL_RETURN_IF_ERROR(
-        image->Main().TransformTo(p3pq, *JxlGetDefaultCms(), pool.get()));
-    jxl::Image3F color = std::move(*image->Main().color());
-    FILE* out = fopen(output_hdr_filename, "wb");
-    for (size_t y = 0; y < color.ysize(); y++) {
-      float* const JXL_RESTRICT rows[3] = {
-          color.PlaneRow(0, y), color.PlaneRow(1, y), color.PlaneRow(2, y)};
-      for (size_t x = 0; x < color.xsize(); x++) {
-        int R = std::max(0.f, std::min(1023.f, rows[0][x] * 1023.f + 0.5f));
-        int G = std::max(0.f, std::min(1023.f, rows[1][x] * 1023.f + 0.5f));
-        int B = std::max(0.f, std::min(1023.f, rows[2][x] * 1023.f + 0.5f));
-        uint32_t RGB10 = (B << 20) | (G << 10) | R;
-        fwrite(&RGB10, 4, 1, out);
+    const JxlPixelFormat float_format = {3, JXL_TYPE_FLOAT, JXL_NATIVE_ENDIAN,
+                                         0};
+    jxl::extras::PackedPixelFile hdr;
+    JPEGXL_TOOLS_CHECK(jpegxl::tools::ConvertInBands(
+        hdr_image,
+        [](size_t /*y0*/, jxl::Image3F* /*band*/) -> jxl::Status {
+          return true;
+        },
+        p3pq, hdr_image.intensity_target, float_format,
+        /*bits_per_sample=*/32, &hdr, pool.get()));
+    const jxl::extras::PackedImage& color = hdr.frames[0].color;
+    const size_t num_channels = color.format.num_channels;
+    std::vector<uint32_t> rgb10(color.xsize * color.ysize);
+    const auto pack_row = [&](const uint32_t y,
+                              size_t /* thread */) -> jxl::Status {
+      const float* JXL_RESTRICT row =
+          reinterpret_cast<const float*>(color.const_pixels(y, 0, 0));
+      uint32_t* JXL_RESTRICT out_row = rgb10.data() + y * color.xsize;
+      for (size_t x = 0; x < color.xsize; x++) {
+        const float* pixel = row + num_channels * x;
+        int R = std::max(0.f, std::min(1023.f, pixel[0] * 1023.f + 0.5f));
+        int G = std::max(0.f, std::min(1023.f, pixel[1] * 1023.f + 0.5f));
+        int B = std::max(0.f, std::min(1023.f, pixel[2] * 1023.f + 0.5f));
+        out_row[x] = (B << 20) | (G << 10) | R;
       }
-    }
+      return true;
+    };
+    JPEGXL_TOOLS_CHECK(jxl::RunOnPool(pool.get(), 0, color.ysize,
+                                      jxl::ThreadPool::NoInit, pack_row,
+                                      "PackRGB10"));
+    FILE* out = fopen(output_hdr_filename, "wb");
+    JPEGXL_TOOLS_CHECK(out != nullptr);
+    const size_t written =
+        fwrite(rgb10.data(), sizeof(uint32_t), rgb10.size(), out);
     fclose(out);
+    JPEGXL_TOOLS_CHECK(written == rgb10.size());
     printf("cjpegli %s input_sdr.jpg\n", output_filename);
     printf("ultrahdr_app -m 0 -a 5 -t 2 -C 1 -w %" PRIuS " -h %" PRIuS
            " -c 1 -R 1 -s 1 -Q 95 -M 1 -L 2000 -p %s -i input_sdr.jpg -z "
            "output_ultrahdr.jpg\n",
-           color.xsize(), color.ysize(), output_hdr_filename);
+           color.xsize, color.ysize, output_hdr_filename);
   }
 
   return EXIT_SUCCESS;
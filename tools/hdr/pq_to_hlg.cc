@@ -3,23 +3,19 @@
 // Use of this source code is governed by a BSD-style
 // license that can be found in the LICENSE file.
 
-#include <cstdint>
+#include <cstddef>
 #include <cstdio>
 #include <cstdlib>
-#include <vector>
 
-#include "lib/extras/codec.h"
-#include "lib/extras/codec_in_out.h"
 #include "lib/extras/dec/color_hints.h"
 #include "lib/extras/hlg.h"
 #include "lib/extras/tone_mapping.h"
-#include "lib/jxl/base/common.h"
-#include "lib/jxl/base/span.h"
+#include "lib/jxl/base/status.h"
+#include "lib/jxl/cms/tone_mapping.h"
 #include "lib/jxl/color_encoding_internal.h"
+#include "lib/jxl/image.h"
 #include "tools/cmdline.h"
-#include "tools/file_io.h"
-#include "tools/hdr/image_utils.h"
-#include "tools/no_memory_manager.h"
+#include "tools/hdr/band_processing.h"
 #include "tools/thread_pool_internal.h"
 
 #include "monolithic_examples.h"
@@ -70,39 +66,34 @@ int main(int argc, const char** argv) {
     return EXIT_FAILURE;
   }
 
-  auto image =
-      jxl::make_unique<jxl::CodecInOut>(jpegxl::tools::NoMemoryManager());
+  jpegxl::tools::HdrImage image;
   jxl::extras::ColorHints color_hints;
   color_hints.Add("color_space", "RGB_D65_202_Rel_PeQ");
-  std::vector<uint8_t> encoded;
-  JPEGXL_TOOLS_CHECK(jpegxl::tools::ReadFile(input_filename, &encoded));
-  JPEGXL_TOOLS_CHECK(jxl::SetFromBytes(jxl::Bytes(encoded), color_hints,
-                                       image.get(), pool.get()));
+  JPEGXL_TOOLS_CHECK(
+      jpegxl::tools::ReadHdrImage(input_filename, color_hints, &image));
   if (max_nits > 0) {
-    image->metadata.m.SetIntensityTarget(max_nits);
+    image.intensity_target = max_nits;
   }
-  const jxl::Primaries original_primaries =
-      image->Main().c_current().GetPrimariesType();
-  JPEGXL_TOOLS_CHECK(jxl::ToneMapTo({0, 1000}, image.get(), pool.get()));
-  JPEGXL_TOOLS_CHECK(jxl::HlgInverseOOTF(&image->Main(), 1.2f, pool.get()));
-  JPEGXL_TOOLS_CHECK(
-      jxl::GamutMap(image.get(), preserve_saturation, pool.get()));
-  // Peak luminance at which the system gamma is 1, since we are now in scene
-  // light, having applied the inverse OOTF ourselves to control the subsequent
-  // gamut mapping instead of leaving it to JxlCms below.
-  image->metadata.m.SetIntensityTarget(301);
+  const jxl::Range source_nits = {image.ppf.info.min_nits,
+                                  image.intensity_target};
+  const auto process = [&](size_t /*y0*/, jxl::Image3F* band) -> jxl::Status {
+    JXL_RETURN_IF_ERROR(jxl::ToneMapImage(source_nits, {0, 1000}, band));
+    JXL_RETURN_IF_ERROR(jxl::HlgInverseOOTF(band, 1.2f));
+    return jxl::GamutMapImage(band, preserve_saturation);
+  };
 
   jxl::ColorEncoding hlg;
   hlg.SetColorSpace(jxl::ColorSpace::kRGB);
-  JPEGXL_TOOLS_CHECK(hlg.SetPrimariesType(original_primaries));
+  JPEGXL_TOOLS_CHECK(
+      hlg.SetPrimariesType(image.color_encoding.GetPrimariesType()));
   JPEGXL_TOOLS_CHECK(hlg.SetWhitePointType(jxl::WhitePoint::kD65));
   hlg.Tf().SetTransferFunction(jxl::TransferFunction::kHLG);
   JPEGXL_TOOLS_CHECK(hlg.CreateICC());
-  JPEGXL_TOOLS_CHECK(
-      jpegxl::tools::TransformCodecInOutTo(*image, hlg, pool.get()));
-  image->metadata.m.color_encoding = hlg;
-  JPEGXL_TOOLS_CHECK(
-      jpegxl::tools::Encode(*image, output_filename, &encoded, pool.get()));
-  JPEGXL_TOOLS_CHECK(jpegxl::tools::WriteFile(output_filename, encoded));
+  // Peak luminance at which the system gamma is 1, since we are now in scene
+  // light, having applied the inverse OOTF ourselves to control the subsequent
+  // gamut mapping instead of leaving it to JxlCms below.
+  JPEGXL_TOOLS_CHECK(jpegxl::tools::WriteInBands(
+      image, process, hlg, /*out_intensity_target=*/301,
+      image.ppf.info.bits_per_sample, output_filename, pool.get()));
   return EXIT_SUCCESS;
 }
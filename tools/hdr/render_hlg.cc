@@ -3,24 +3,19 @@
 // Use of this source code is governed by a BSD-style
 // license that can be found in the LICENSE file.
 
-#include <cstdint>
+#include <cstddef>
 #include <cstdio>
 #include <cstdlib>
-#include <vector>
 
-#include "lib/extras/codec.h"
-#include "lib/extras/codec_in_out.h"
 #include "lib/extras/dec/color_hints.h"
 #include "lib/extras/hlg.h"
 #include "lib/extras/tone_mapping.h"
-#include "lib/jxl/base/common.h"
-#include "lib/jxl/base/span.h"
+#include "lib/jxl/base/status.h"
 #include "lib/jxl/cms/color_encoding_cms.h"
 #include "lib/jxl/color_encoding_internal.h"
+#include "lib/jxl/image.h"
 #include "tools/cmdline.h"
-#include "tools/file_io.h"
-#include "tools/hdr/image_utils.h"
-#include "tools/no_memory_manager.h"
+#include "tools/hdr/band_processing.h"
 #include "tools/thread_pool_internal.h"
 
 #include "monolithic_examples.h"
@@ -85,34 +80,28 @@ int main(int argc, const char** argv) {
     return EXIT_FAILURE;
   }
 
-  auto image =
-      jxl::make_unique<jxl::CodecInOut>(jpegxl::tools::NoMemoryManager());
+  jpegxl::tools::HdrImage image;
   jxl::extras::ColorHints color_hints;
   color_hints.Add("color_space", "RGB_D65_202_Rel_HLG");
-  std::vector<uint8_t> encoded;
-  JPEGXL_TOOLS_CHECK(jpegxl::tools::ReadFile(input_filename, &encoded));
-  JPEGXL_TOOLS_CHECK(jxl::SetFromBytes(jxl::Bytes(encoded), color_hints,
-                                       image.get(), pool.get()));
+  JPEGXL_TOOLS_CHECK(
+      jpegxl::tools::ReadHdrImage(input_filename, color_hints, &image));
   // Ensures that conversions to linear by JxlCms will not apply the OOTF as we
   // apply it ourselves to control the subsequent gamut mapping.
-  image->metadata.m.SetIntensityTarget(301);
+  image.intensity_target = 301;
   const float gamma = jxl::GetHlgGamma(target_nits, surround_nits);
   fprintf(stderr, "Using a system gamma of %g\n", gamma);
-  JPEGXL_TOOLS_CHECK(jxl::HlgOOTF(&image->Main(), gamma, pool.get()));
-  JPEGXL_TOOLS_CHECK(
-      jxl::GamutMap(image.get(), preserve_saturation, pool.get()));
-  image->metadata.m.SetIntensityTarget(target_nits);
+  const auto process = [&](size_t /*y0*/, jxl::Image3F* band) -> jxl::Status {
+    JXL_RETURN_IF_ERROR(jxl::HlgOOTF(band, gamma));
+    return jxl::GamutMapImage(band, preserve_saturation);
+  };
 
-  jxl::ColorEncoding c_out = image->metadata.m.color_encoding;
+  jxl::ColorEncoding c_out = image.color_encoding;
   jxl::cms::TransferFunction tf =
       pq ? jxl::TransferFunction::kPQ : jxl::TransferFunction::kSRGB;
   c_out.Tf().SetTransferFunction(tf);
   JPEGXL_TOOLS_CHECK(c_out.CreateICC());
-  JPEGXL_TOOLS_CHECK(
-      jpegxl::tools::TransformCodecInOutTo(*image, c_out, pool.get()));
-  image->metadata.m.color_encoding = c_out;
-  JPEGXL_TOOLS_CHECK(
-      jpegxl::tools::Encode(*image, output_filename, &encoded, pool.get()));
-  JPEGXL_TOOLS_CHECK(jpegxl::tools::WriteFile(output_filename, encoded));
+  JPEGXL_TOOLS_CHECK(jpegxl::tools::WriteInBands(
+      image, process, c_out, target_nits, image.ppf.info.bits_per_sample,
+      output_filename, pool.get()));
   return EXIT_SUCCESS;
 }
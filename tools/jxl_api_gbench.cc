@@ -0,0 +1,489 @@
+// Copyright (c) the JPEG XL Project Authors. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+// End-to-end JxlEncoder / JxlDecoder throughput, for regression tracking.
+// Results are reported per benchmark as pixels per second (items_per_second)
+// and compressed bits per pixel ("bpp"); run with
+// --benchmark_out_format=json --benchmark_out=<file> and compare two result
+// files with the compare.py script that ships with Google benchmark.
+
+#include <jxl/codestream_header.h>
+#include <jxl/color_encoding.h>
+#include <jxl/decode.h>
+#include <jxl/decode_cxx.h>
+#include <jxl/encode.h>
+#include <jxl/encode_cxx.h>
+#include <jxl/thread_parallel_runner.h>
+#include <jxl/thread_parallel_runner_cxx.h>
+#include <jxl/types.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "lib/extras/dec/color_hints.h"
+#include "lib/extras/dec/decode.h"
+#include "lib/extras/packed_image.h"
+#include "lib/jxl/base/span.h"
+#include "tools/file_io.h"
+
+namespace jxl {
+namespace {
+
+#define QUIT(M)           \
+  state.SkipWithError(M); \
+  return;
+
+#define BM_CHECK(C) \
+  if (!(C)) {       \
+    QUIT(#C)        \
+  }
+
+struct ImageSize {
+  size_t xsize;
+  size_t ysize;
+};
+
+// From thumbnails to 8K UHD.
+constexpr ImageSize kSizes[] = {
+    {64, 64}, {256, 256}, {1024, 1024}, {3840, 2160}, {7680, 4320},
+};
+constexpr size_t kNumSizes = sizeof(kSizes) / sizeof(kSizes[0]);
+
+constexpr JxlPixelFormat kFormats[] = {
+    {3, JXL_TYPE_UINT8, JXL_NATIVE_ENDIAN, 0},
+    {4, JXL_TYPE_UINT8, JXL_NATIVE_ENDIAN, 0},
+    {1, JXL_TYPE_UINT8, JXL_NATIVE_ENDIAN, 0},
+    {3, JXL_TYPE_UINT16, JXL_NATIVE_ENDIAN, 0},
+    {3, JXL_TYPE_FLOAT, JXL_NATIVE_ENDIAN, 0},
+};
+constexpr size_t kNumFormats = sizeof(kFormats) / sizeof(kFormats[0]);
+
+constexpr const char* kTestImages[] = {
+    "jxl/flower/flower.png",
+    "external/wesaturate/500px/tmshre_riaphotographs_alpha.png",
+    "jxl/grayscale_patches.png",
+};
+constexpr size_t kNumTestImages = sizeof(kTestImages) / sizeof(kTestImages[0]);
+
+struct Settings {
+  int effort = 7;
+  bool lossless = false;
+  // Zero encodes and decodes without a parallel runner.
+  size_t num_threads = 0;
+};
+
+// Interleaved pixels of all frames of an image, in one pixel format.
+struct Image {
+  size_t xsize = 0;
+  size_t ysize = 0;
+  JxlPixelFormat format;
+  // Zero derives the bit depth from the sample type.
+  uint32_t bits_per_sample = 0;
+  std::vector<std::vector<uint8_t>> frames;
+
+  size_t num_pixels() const { return xsize * ysize * frames.size(); }
+};
+
+size_t BytesPerSample(JxlDataType type) {
+  switch (type) {
+    case JXL_TYPE_UINT8:
+      return 1;
+    case JXL_TYPE_UINT16:
+    case JXL_TYPE_FLOAT16:
+      return 2;
+    case JXL_TYPE_FLOAT:
+      return 4;
+  }
+  return 0;
+}
+
+// Smooth gradients with a moving disc and some noise, which is closer to a
+// photo than either a flat or a random image. Frame `t` moves the disc, so
+// that animation frames differ.
+Image SyntheticImage(const ImageSize& size, const JxlPixelFormat& format,
+                     size_t num_frames) {
+  Image image;
+  image.xsize = size.xsize;
+  image.ysize = size.ysize;
+  image.format = format;
+  const size_t bytes_per_sample = BytesPerSample(format.data_type);
+  const size_t row_size = size.xsize * format.num_channels * bytes_per_sample;
+  uint32_t rng = 0x2545F491;
+  for (size_t t = 0; t < num_frames; ++t) {
+    std::vector<uint8_t> pixels(row_size * size.ysize);
+    const float cx = size.xsize * (0.3f + 0.05f * t);
+    const float cy = size.ysize * 0.5f;
+    const float r2 = 0.04f * size.xsize * size.ysize;
+    for (size_t y = 0; y < size.ysize; ++y) {
+      uint8_t* row = pixels.data() + y * row_size;
+      for (size_t x = 0; x < size.xsize; ++x) {
+        const float dx = x - cx;
+        const float dy = y - cy;
+        const bool in_disc = dx * dx + dy * dy < r2;
+        for (size_t c = 0; c < format.num_channels; ++c) {
+          rng = rng * 1664525u + 1013904223u;
+          const float noise = ((rng >> 24) / 255.0f - 0.5f) * 0.02f;
+          float v;
+          if (c == 3) {
+            v = in_disc ? 1.0f : 0.75f;
+          } else {
+            v = (c == 0   ? x * 1.0f / size.xsize
+                 : c == 1 ? y * 1.0f / size.ysize
+                          : 0.5f) *
+                    0.8f +
+                (in_disc ? 0.15f : 0.0f) + noise;
+            v = v < 0.0f ? 0.0f : v > 1.0f ? 1.0f : v;
+          }
+          const size_t i = x * format.num_channels + c;
+          if (format.data_type == JXL_TYPE_UINT8) {
+            row[i] = static_cast<uint8_t>(v * 255.0f + 0.5f);
+          } else if (format.data_type == JXL_TYPE_UINT16) {
+            const uint16_t u = static_cast<uint16_t>(v * 65535.0f + 0.5f);
+            memcpy(row + 2 * i, &u, 2);
+          } else {
+            memcpy(row + 4 * i, &v, 4);
+          }
+        }
+      }
+    }
+    image.frames.emplace_back(std::move(pixels));
+  }
+  return image;
+}
+
+bool LoadTestImage(const char* name, Image* image) {
+  std::vector<uint8_t> bytes;
+  if (!jpegxl::tools::ReadFile(std::string(TEST_DATA_PATH "/") + name,
+                               &bytes)) {
+    return false;
+  }
+  extras::PackedPixelFile ppf;
+  if (!extras::DecodeBytes(Bytes(bytes), extras::ColorHints(), &ppf)) {
+    return false;
+  }
+  if (ppf.frames.empty()) return false;
+  image->xsize = ppf.info.xsize;
+  image->ysize = ppf.info.ysize;
+  image->format = ppf.frames[0].color.format;
+  image->bits_per_sample = ppf.info.bits_per_sample;
+  for (const auto& frame : ppf.frames) {
+    const auto* pixels = static_cast<const uint8_t*>(frame.color.pixels());
+    image->frames.emplace_back(pixels, pixels + frame.color.pixels_size);
+  }
+  return true;
+}
+
+bool Encode(const Image& image, const Settings& settings, void* runner,
+            std::vector<uint8_t>* compressed) {
+  JxlEncoderPtr enc = JxlEncoderMake(/*memory_manager=*/nullptr);
+  if (runner != nullptr &&
+      JXL_ENC_SUCCESS != JxlEncoderSetParallelRunner(
+                             enc.get(), JxlThreadParallelRunner, runner)) {
+    return false;
+  }
+  const JxlPixelFormat& format = image.format;
+  const bool is_float = format.data_type == JXL_TYPE_FLOAT;
+  const bool has_alpha = format.num_channels % 2 == 0;
+  JxlBasicInfo info;
+  JxlEncoderInitBasicInfo(&info);
+  info.xsize = image.xsize;
+  info.ysize = image.ysize;
+  info.bits_per_sample = image.bits_per_sample != 0
+                             ? image.bits_per_sample
+                             : 8 * BytesPerSample(format.data_type);
+  info.exponent_bits_per_sample = is_float ? 8 : 0;
+  info.num_color_channels = format.num_channels < 3 ? 1 : 3;
+  info.num_extra_channels = has_alpha ? 1 : 0;
+  info.alpha_bits = has_alpha ? info.bits_per_sample : 0;
+  info.alpha_exponent_bits = has_alpha ? info.exponent_bits_per_sample : 0;
+  info.uses_original_profile = TO_JXL_BOOL(settings.lossless);
+  if (image.frames.size() > 1) {
+    info.have_animation = JXL_TRUE;
+    info.animation.tps_numerator = 10;
+    info.animation.tps_denominator = 1;
+  }
+  if (JXL_ENC_SUCCESS != JxlEncoderSetBasicInfo(enc.get(), &info)) {
+    return false;
+  }
+  JxlColorEncoding color_encoding;
+  const JXL_BOOL is_gray = TO_JXL_BOOL(info.num_color_channels == 1);
+  if (is_float) {
+    JxlColorEncodingSetToLinearSRGB(&color_encoding, is_gray);
+  } else {
+    JxlColorEncodingSetToSRGB(&color_encoding, is_gray);
+  }
+  if (JXL_ENC_SUCCESS !=
+      JxlEncoderSetColorEncoding(enc.get(), &color_encoding)) {
+    return false;
+  }
+  JxlEncoderFrameSettings* frame_settings =
+      JxlEncoderFrameSettingsCreate(enc.get(), nullptr);
+  if (JXL_ENC_SUCCESS !=
+      JxlEncoderFrameSettingsSetOption(
+          frame_settings, JXL_ENC_FRAME_SETTING_EFFORT, settings.effort)) {
+    return false;
+  }
+  if (settings.lossless) {
+    if (JXL_ENC_SUCCESS !=
+        JxlEncoderSetFrameLossless(frame_settings, JXL_TRUE)) {
+      return false;
+    }
+  } else if (JXL_ENC_SUCCESS !=
+             JxlEncoderSetFrameDistance(frame_settings, 1.0f)) {
+    return false;
+  }
+  for (const auto& pixels : image.frames) {
+    if (info.have_animation) {
+      JxlFrameHeader header;
+      JxlEncoderInitFrameHeader(&header);
+      header.duration = 1;
+      if (JXL_ENC_SUCCESS !=
+          JxlEncoderSetFrameHeader(frame_settings, &header)) {
+        return false;
+      }
+    }
+    if (JXL_ENC_SUCCESS != JxlEncoderAddImageFrame(frame_settings, &format,
+                                                   pixels.data(),
+                                                   pixels.size())) {
+      return false;
+    }
+  }
+  JxlEncoderCloseInput(enc.get());
+
+  compressed->resize(64 << 10);
+  uint8_t* next_out = compressed->data();
+  size_t avail_out = compressed->size();
+  JxlEncoderStatus status = JXL_ENC_NEED_MORE_OUTPUT;
+  while (status == JXL_ENC_NEED_MORE_OUTPUT) {
+    status = JxlEncoderProcessOutput(enc.get(), &next_out, &avail_out);
+    if (status == JXL_ENC_NEED_MORE_OUTPUT) {
+      const size_t offset = next_out - compressed->data();
+      compressed->resize(compressed->size() * 2);
+      next_out = compressed->data() + offset;
+      avail_out = compressed->size() - offset;
+    }
+  }
+  compressed->resize(next_out - compressed->data());
+  return status == JXL_ENC_SUCCESS;
+}
+
+// Decodes all frames to `format`; the pixels of the previous frame are
+// overwritten, as a viewer that only shows the current frame would.
+bool Decode(const std::vector<uint8_t>& compressed,
+            const JxlPixelFormat& format, void* runner,
+            std::vector<uint8_t>* pixels, size_t* num_frames) {
+  JxlDecoderPtr dec = JxlDecoderMake(/*memory_manager=*/nullptr);
+  if (JXL_DEC_SUCCESS !=
+      JxlDecoderSubscribeEvents(dec.get(), JXL_DEC_FULL_IMAGE)) {
+    return false;
+  }
+  if (runner != nullptr &&
+      JXL_DEC_SUCCESS != JxlDecoderSetParallelRunner(
+                             dec.get(), JxlThreadParallelRunner, runner)) {
+    return false;
+  }
+  if (JXL_DEC_SUCCESS !=
+      JxlDecoderSetInput(dec.get(), compressed.data(), compressed.size())) {
+    return false;
+  }
+  JxlDecoderCloseInput(dec.get());
+  *num_frames = 0;
+  for (;;) {
+    JxlDecoderStatus status = JxlDecoderProcessInput(dec.get());
+    if (status == JXL_DEC_NEED_IMAGE_OUT_BUFFER) {
+      size_t buffer_size;
+      if (JXL_DEC_SUCCESS !=
+          JxlDecoderImageOutBufferSize(dec.get(), &format, &buffer_size)) {
+        return false;
+      }
+      pixels->resize(buffer_size);
+      if (JXL_DEC_SUCCESS != JxlDecoderSetImageOutBuffer(dec.get(), &format,
+                                                         pixels->data(),
+                                                         pixels->size())) {
+        return false;
+      }
+    } else if (status == JXL_DEC_FULL_IMAGE) {
+      ++*num_frames;
+    } else if (status == JXL_DEC_SUCCESS) {
+      return true;
+    } else {
+      return false;
+    }
+  }
+}
+
+JxlThreadParallelRunnerPtr MakeRunner(size_t num_threads) {
+  if (num_threads == 0) return JxlThreadParallelRunnerPtr();
+  return JxlThreadParallelRunnerMake(/*memory_manager=*/nullptr, num_threads);
+}
+
+void EncodeBenchmark(benchmark::State& state, const Image& image,
+                     const Settings& settings) {
+  JxlThreadParallelRunnerPtr runner = MakeRunner(settings.num_threads);
+  BM_CHECK(settings.num_threads == 0 || runner);
+  std::vector<uint8_t> compressed;
+  for (auto _ : state) {
+    (void)_;
+    BM_CHECK(Encode(image, settings, runner.get(), &compressed));
+  }
+  state.SetItemsProcessed(state.iterations() * image.num_pixels());
+  state.counters["bpp"] = 8.0 * compressed.size() / image.num_pixels();
+}
+
+void DecodeBenchmark(benchmark::State& state, const Image& image,
+                     const Settings& settings) {
+  JxlThreadParallelRunnerPtr runner = MakeRunner(settings.num_threads);
+  BM_CHECK(settings.num_threads == 0 || runner);
+  std::vector<uint8_t> compressed;
+  BM_CHECK(Encode(image, settings, runner.get(), &compressed));
+  std::vector<uint8_t> pixels;
+  size_t num_frames = 0;
+  for (auto _ : state) {
+    (void)_;
+    BM_CHECK(Decode(compressed, image.format, runner.get(), &pixels,
+                    &num_frames));
+  }
+  BM_CHECK(num_frames == image.frames.size());
+  state.SetItemsProcessed(state.iterations() * image.num_pixels());
+  state.counters["bpp"] = 8.0 * compressed.size() / image.num_pixels();
+}
+
+// Arguments: size index, effort, lossless, threads.
+void BM_ApiEncode(benchmark::State& state) {
+  Settings settings{static_cast<int>(state.range(1)), state.range(2) != 0,
+                    static_cast<size_t>(state.range(3))};
+  Image image = SyntheticImage(kSizes[state.range(0)], kFormats[0], 1);
+  EncodeBenchmark(state, image, settings);
+}
+
+void BM_ApiDecode(benchmark::State& state) {
+  Settings settings{static_cast<int>(state.range(1)), state.range(2) != 0,
+                    static_cast<size_t>(state.range(3))};
+  Image image = SyntheticImage(kSizes[state.range(0)], kFormats[0], 1);
+  DecodeBenchmark(state, image, settings);
+}
+
+// Arguments: format index, lossless.
+void BM_ApiEncodeFormat(benchmark::State& state) {
+  Settings settings{/*effort=*/7, state.range(1) != 0, /*num_threads=*/0};
+  Image image = SyntheticImage(kSizes[2], kFormats[state.range(0)], 1);
+  EncodeBenchmark(state, image, settings);
+}
+
+void BM_ApiDecodeFormat(benchmark::State& state) {
+  Settings settings{/*effort=*/7, state.range(1) != 0, /*num_threads=*/0};
+  Image image = SyntheticImage(kSizes[2], kFormats[state.range(0)], 1);
+  DecodeBenchmark(state, image, settings);
+}
+
+// Arguments: number of frames, lossless.
+void BM_ApiEncodeAnimation(benchmark::State& state) {
+  Settings settings{/*effort=*/7, state.range(1) != 0, /*num_threads=*/0};
+  Image image = SyntheticImage(kSizes[1], kFormats[0], state.range(0));
+  EncodeBenchmark(state, image, settings);
+}
+
+void BM_ApiDecodeAnimation(benchmark::State& state) {
+  Settings settings{/*effort=*/7, state.range(1) != 0, /*num_threads=*/0};
+  Image image = SyntheticImage(kSizes[1], kFormats[0], state.range(0));
+  DecodeBenchmark(state, image, settings);
+}
+
+// Arguments: test image index, lossless.
+void BM_ApiEncodeTestImage(benchmark::State& state) {
+  Settings settings{/*effort=*/7, state.range(1) != 0, /*num_threads=*/0};
+  Image image;
+  BM_CHECK(LoadTestImage(kTestImages[state.range(0)], &image));
+  state.SetLabel(kTestImages[state.range(0)]);
+  EncodeBenchmark(state, image, settings);
+}
+
+void BM_ApiDecodeTestImage(benchmark::State& state) {
+  Settings settings{/*effort=*/7, state.range(1) != 0, /*num_threads=*/0};
+  Image image;
+  BM_CHECK(LoadTestImage(kTestImages[state.range(0)], &image));
+  state.SetLabel(kTestImages[state.range(0)]);
+  DecodeBenchmark(state, image, settings);
+}
+
+// The slow efforts are only run up to 1 megapixel, and 4K and 8K only with
+// threads, to keep the whole suite within minutes.
+void SizeEffortThreadsArgs(benchmark::internal::Benchmark* b) {
+  b->ArgNames({"size", "effort", "lossless", "threads"});
+  for (int64_t size = 0; size < static_cast<int64_t>(kNumSizes); ++size) {
+    for (int64_t effort : {1, 3, 7, 9}) {
+      if (size > 2 && effort > 3) continue;
+      if (size < 2 && effort == 3) continue;
+      for (int64_t lossless : {0, 1}) {
+        for (int64_t threads : {0, 1, 4, 8}) {
+          if (size > 2 && threads < 4) continue;
+          if (size < 2 && threads > 1) continue;
+          b->Args({size, effort, lossless, threads});
+        }
+      }
+    }
+  }
+}
+
+void FormatArgs(benchmark::internal::Benchmark* b) {
+  b->ArgNames({"format", "lossless"});
+  for (int64_t format = 0; format < static_cast<int64_t>(kNumFormats);
+       ++format) {
+    for (int64_t lossless : {0, 1}) b->Args({format, lossless});
+  }
+}
+
+void TestImageArgs(benchmark::internal::Benchmark* b) {
+  b->ArgNames({"image", "lossless"});
+  for (int64_t image = 0; image < static_cast<int64_t>(kNumTestImages);
+       ++image) {
+    for (int64_t lossless : {0, 1}) b->Args({image, lossless});
+  }
+}
+
+// Wall time, since the worker threads do not count towards the CPU time of the
+// benchmark thread.
+BENCHMARK(BM_ApiEncode)
+    ->Apply(SizeEffortThreadsArgs)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ApiDecode)
+    ->Apply(SizeEffortThreadsArgs)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ApiEncodeFormat)
+    ->Apply(FormatArgs)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ApiDecodeFormat)
+    ->Apply(FormatArgs)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ApiEncodeAnimation)
+    ->ArgNames({"frames", "lossless"})
+    ->ArgsProduct({{4, 16}, {0, 1}})
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ApiDecodeAnimation)
+    ->ArgNames({"frames", "lossless"})
+    ->ArgsProduct({{4, 16}, {0, 1}})
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ApiEncodeTestImage)
+    ->Apply(TestImageArgs)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ApiDecodeTestImage)
+    ->Apply(TestImageArgs)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+}  // namespace
+}  // namespace jxl
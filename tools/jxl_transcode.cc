@@ -0,0 +1,341 @@
+// Copyright (c) the JPEG XL Project Authors. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+// Lossless rewriting of a bare codestream, see lib/jxl/enc_transcode.h.
+
+#include <jxl/decode.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>  // NOLINT
+#include <utility>
+#include <vector>
+
+#include "lib/extras/dec/color_hints.h"
+#include "lib/extras/dec/decode.h"
+#include "lib/extras/packed_image.h"
+#include "lib/jxl/base/rect.h"
+#include "lib/jxl/base/span.h"
+#include "lib/jxl/base/status.h"
+#include "lib/jxl/common.h"
+#include "lib/jxl/enc_transcode.h"
+#include "lib/jxl/image.h"
+#include "tools/cmdline.h"
+#include "tools/file_io.h"
+#include "tools/no_memory_manager.h"
+#include "tools/thread_pool_internal.h"
+
+namespace jpegxl {
+namespace tools {
+namespace {
+
+bool ParseRect(const char* arg, jxl::Rect* out) {
+  size_t x0;
+  size_t y0;
+  size_t xsize;
+  size_t ysize;
+  int end = 0;
+  if (sscanf(arg, "%zu,%zu,%zu,%zu%n", &x0, &y0, &xsize, &ysize, &end) != 4 ||
+      arg[end] != '\0') {
+    fprintf(stderr, "Unable to interpret as X,Y,WIDTH,HEIGHT: %s.\n", arg);
+    return false;
+  }
+  *out = jxl::Rect(x0, y0, xsize, ysize);
+  return true;
+}
+
+struct Args {
+  void AddCommandLineOptions(CommandLineParser* cmdline) {
+    cmdline->AddPositionalOption(
+        "INPUT", /* required = */ true,
+        "The JPEG XL codestream input file. The codestream of a container"
+        " file can be extracted with jxltran --extract.",
+        &file_in);
+
+    cmdline->AddPositionalOption("OUTPUT", /* required = */ true,
+                                 "The JPEG XL codestream output file.",
+                                 &file_out);
+
+    cmdline->AddHelpText("\nTranscoding options:", 0);
+
+    cmdline->AddOptionFlag(
+        '\0', "optimize_entropy",
+        "Entropy code the AC coefficients of VarDCT frames again,"
+        " at the effort given with --effort, without changing the decoded"
+        " pixels.",
+        &optimize_entropy, &SetBooleanTrue);
+
+    cmdline->AddOptionValue(
+        '\0', "crop", "X,Y,WIDTH,HEIGHT",
+        "Crop all frames without decoding and encoding them again. The"
+        " rectangle is in pixels of the codestream, before orientation, and"
+        " must be aligned to groups, 256 pixels by default, and to 2048"
+        " pixels for VarDCT frames, except at the right and bottom edges.",
+        &crop, &ParseRect);
+
+    cmdline->AddOptionValue(
+        '\0', "layer", "INDEX",
+        "Extract the layer, or animation frame, with the given index as a"
+        " still image, along with the frames it references. Applied before"
+        " --crop.",
+        &layer, &ParseSigned);
+
+    cmdline->AddOptionFlag(
+        '\0', "center_first",
+        "Move the sections of the groups closest to the center, given with"
+        " --center_x and --center_y, to the front, as the encoder does with"
+        " --group_order=1. Only the table of contents is written again.",
+        &center_first, &SetBooleanTrue);
+
+    cmdline->AddOptionValue('\0', "center_x", "-1..XSIZE",
+                            "X coordinate of the center for --center_first,"
+                            " default = -1, the middle of the image.",
+                            &center_x, &ParseInt64);
+
+    cmdline->AddOptionValue('\0', "center_y", "-1..YSIZE",
+                            "Y coordinate of the center for --center_first,"
+                            " default = -1, the middle of the image.",
+                            &center_y, &ParseInt64);
+
+    cmdline->AddOptionValue(
+        '\0', "saliency", "FILENAME",
+        "Move the sections of the groups with the highest mean saliency to the"
+        " front instead, with the saliency given by the first channel of an"
+        " image, which is stretched to the size of the frames.",
+        &saliency, &ParseString);
+
+    cmdline->AddOptionFlag(
+        '\0', "lf_first",
+        "With --center_first or --saliency, also move the LF (DC) groups and"
+        " the global sections before all groups and order the LF groups in"
+        " the same way, e.g. for codestreams written in streaming mode.",
+        &lf_first, &SetBooleanTrue);
+
+    cmdline->AddOptionValue('e', "effort", "EFFORT",
+                            "Effort of --optimize_entropy, range: 1 .. 10,"
+                            " default = 9.",
+                            &effort, &ParseUnsigned);
+
+    cmdline->AddOptionValue('\0', "num_threads", "THREADS",
+                            "Number of worker threads, default = -1.\n"
+                            "    -1 = use machine default. 0 = do not use "
+                            "multithreading.",
+                            &num_threads, &ParseSigned);
+  }
+
+  const char* file_in = nullptr;
+  const char* file_out = nullptr;
+
+  bool optimize_entropy = false;
+  jxl::Rect crop;
+  int layer = -1;
+  bool center_first = false;
+  int64_t center_x = -1;
+  int64_t center_y = -1;
+  std::string saliency;
+  bool lf_first = false;
+  size_t effort = 9;
+  int num_threads = -1;
+};
+
+bool ValidateArgs(Args const& args) {
+  if (!args.file_out) {
+    fprintf(stderr, "No output file specified.\n");
+    return false;
+  }
+
+  if (args.effort < 1 || args.effort > 10) {
+    fprintf(stderr, "Invalid --effort %zu, valid range is 1 .. 10.\n",
+            args.effort);
+    return false;
+  }
+
+  if (args.layer < -1) {
+    fprintf(stderr, "Invalid --layer %d.\n", args.layer);
+    return false;
+  }
+
+  if (args.center_x < -1 || args.center_y < -1) {
+    fprintf(stderr, "Invalid --center_x or --center_y.\n");
+    return false;
+  }
+
+  if (args.lf_first && !args.center_first && args.saliency.empty()) {
+    fprintf(stderr, "--lf_first needs --center_first or --saliency.\n");
+    return false;
+  }
+
+  if (args.num_threads < -1) {
+    fprintf(stderr, "Invalid --num_threads %d.\n", args.num_threads);
+    return false;
+  }
+
+  return true;
+}
+
+bool WantsReordering(Args const& args) {
+  return args.center_first || !args.saliency.empty();
+}
+
+bool WantsTranscoding(Args const& args) {
+  return args.optimize_entropy || args.layer >= 0 ||
+         args.crop.xsize() != 0 || WantsReordering(args);
+}
+
+// Reads the first channel of the image `filename` into `saliency`.
+bool LoadSaliency(const char* filename, jxl::ImageF* saliency) {
+  std::vector<uint8_t> bytes;
+  jxl::extras::PackedPixelFile ppf;
+  if (!ReadFile(filename, &bytes) ||
+      !jxl::extras::DecodeBytes(jxl::Bytes(bytes), jxl::extras::ColorHints(),
+                                &ppf) ||
+      ppf.frames.empty()) {
+    fprintf(stderr, "Failed to read saliency map %s\n", filename);
+    return false;
+  }
+  const jxl::extras::PackedImage& image = ppf.frames[0].color;
+  auto plane = jxl::ImageF::Create(NoMemoryManager(), image.xsize, image.ysize);
+  if (!plane.ok()) {
+    fprintf(stderr, "Failed to allocate the saliency map\n");
+    return false;
+  }
+  *saliency = std::move(plane).value_();
+  for (size_t y = 0; y < image.ysize; ++y) {
+    float* row = saliency->Row(y);
+    for (size_t x = 0; x < image.xsize; ++x) {
+      row[x] = image.GetPixelValue(y, x, 0);
+    }
+  }
+  return true;
+}
+
+// Applies the transcoding options to the bare `codestream`, in the order
+// --layer, --crop, --optimize_entropy and the reordering of the sections.
+bool Transcode(std::vector<uint8_t> const& codestream,
+               std::vector<uint8_t>* output_bytes, Args const& args) {
+  size_t num_threads = args.num_threads == -1
+                           ? std::thread::hardware_concurrency()
+                           : static_cast<size_t>(args.num_threads);
+  ThreadPoolInternal pool(num_threads);
+  std::vector<uint8_t> current = codestream;
+  if (args.layer >= 0) {
+    std::vector<uint8_t> layer;
+    if (!jxl::ExtractLayer(NoMemoryManager(), jxl::Bytes(current),
+                           args.layer, pool.get(), &layer)) {
+      fprintf(stderr, "Failed to extract layer %d\n", args.layer);
+      return false;
+    }
+    current.swap(layer);
+  }
+  if (args.crop.xsize() != 0) {
+    std::vector<uint8_t> cropped;
+    if (!jxl::CropCodestream(NoMemoryManager(), jxl::Bytes(current),
+                             args.crop, pool.get(), &cropped)) {
+      fprintf(stderr, "Failed to crop the codestream\n");
+      return false;
+    }
+    current.swap(cropped);
+  }
+  if (args.optimize_entropy) {
+    std::vector<uint8_t> optimized;
+    if (!jxl::OptimizeEntropy(NoMemoryManager(), jxl::Bytes(current),
+                              static_cast<jxl::SpeedTier>(10 - args.effort),
+                              pool.get(), &optimized)) {
+      fprintf(stderr, "Failed to optimize the entropy coding\n");
+      return false;
+    }
+    current.swap(optimized);
+  }
+  if (WantsReordering(args)) {
+    jxl::ImageF saliency;
+    jxl::SectionOrder order;
+    order.center_x = static_cast<size_t>(args.center_x);
+    order.center_y = static_cast<size_t>(args.center_y);
+    order.lf_first = args.lf_first;
+    if (!args.saliency.empty()) {
+      if (!LoadSaliency(args.saliency.c_str(), &saliency)) return false;
+      order.saliency = &saliency;
+    }
+    std::vector<uint8_t> reordered;
+    if (!jxl::ReorderSections(NoMemoryManager(), jxl::Bytes(current), order,
+                              &reordered)) {
+      fprintf(stderr, "Failed to reorder the sections\n");
+      return false;
+    }
+    current.swap(reordered);
+  }
+  fprintf(stderr, "Codestream: %zu -> %zu bytes\n", codestream.size(),
+          current.size());
+  output_bytes->swap(current);
+  return true;
+}
+
+}  // namespace
+
+int JxlTranscodeMain(int argc, const char* argv[]) {
+  Args args;
+  CommandLineParser cmdline;
+  args.AddCommandLineOptions(&cmdline);
+
+  if (!cmdline.Parse(argc, const_cast<const char**>(argv))) {
+    // Parse already printed the actual error cause.
+    fprintf(stderr, "Use '%s -h' for more information.\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  if (cmdline.HelpFlagPassed() || !args.file_in) {
+    cmdline.PrintHelp();
+    return EXIT_SUCCESS;
+  }
+
+  if (!ValidateArgs(args)) {
+    return EXIT_FAILURE;
+  }
+
+  if (!WantsTranscoding(args)) {
+    fprintf(stderr, "No transcoding option given.\n");
+    return EXIT_FAILURE;
+  }
+
+  std::vector<uint8_t> codestream;
+  if (!ReadFile(args.file_in, &codestream)) {
+    fprintf(stderr, "Failed to read input image %s\n", args.file_in);
+    return EXIT_FAILURE;
+  }
+
+  const JxlSignature signature =
+      JxlSignatureCheck(codestream.data(), codestream.size());
+  if (signature == JXL_SIG_CONTAINER) {
+    fprintf(stderr,
+            "Input file is a container file, extract the codestream with "
+            "jxltran --extract first.\n");
+    return EXIT_FAILURE;
+  }
+  if (signature != JXL_SIG_CODESTREAM) {
+    fprintf(stderr, "Input file is not a JPEG XL codestream.\n");
+    return EXIT_FAILURE;
+  }
+
+  std::vector<uint8_t> out_file;
+  if (!Transcode(codestream, &out_file, args)) {
+    return EXIT_FAILURE;
+  }
+
+  if (!WriteFile(args.file_out, out_file)) {
+    fprintf(stderr, "Failed to write output file %s\n", args.file_out);
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+}  // namespace tools
+}  // namespace jpegxl
+
+int main(int argc, const char* argv[]) {
+  return jpegxl::tools::JxlTranscodeMain(argc, argv);
+}
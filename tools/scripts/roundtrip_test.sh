@@ -29,6 +29,8 @@ roundtrip_lossless_pnm_test() {
   "${encoder}" "${infn}" "${jxlfn}" -d 0 -e 1
   "${decoder}" "${jxlfn}" "${outfn}"
   diff "${infn}" "${outfn}"
+  "${decoder}" "${jxlfn}" "${outfn}" --streaming_output
+  diff "${infn}" "${outfn}"
 }
 
 roundtrip_test() {
@@ -71,6 +73,11 @@ roundtrip_test() {
       local dist="$("${comparator}" "${infn}" "${outfn}")"
       python3 -c "import sys; sys.exit(not ${dist} <= ${maxdist})"
 
+      # Test streaming decoding to png.
+      "${decoder}" "${jxlfn}" "${outfn}" --streaming_output
+      local dist="$("${comparator}" "${infn}" "${outfn}")"
+      python3 -c "import sys; sys.exit(not ${dist} <= ${maxdist})"
+
       # Test decoding to 16 bit png.
       "${decoder}" "${jxlfn}" "${outfn}" --bits_per_sample 16
       local dist="$("${comparator}" "${infn}" "${outfn}")"
@@ -124,6 +131,8 @@ main() {
 		 "-e 1 --streaming_output" 0.02
   roundtrip_test "jxl/flower/flower_small.rgb.depth8.ppm" \
 		 "-e 1 -d 0.0 --streaming_input --streaming_output" 0.0
+  roundtrip_test "jxl/flower/flower_small.rgb.depth8.ppm" \
+		 "-e 1 -d 0.0 --pipelined" 0.0
   roundtrip_test "jxl/flower/flower_cropped.jpg" "-e 1" 0.0
 
   roundtrip_test "jxl/flower/flower.png" "-e 6" 0.02
@@ -18,9 +18,9 @@
 
 #include "lib/jxl/base/compiler_specific.h"
 #include "lib/jxl/base/status.h"
+#include "lib/jxl/gauss_blur.h"
 #include "lib/jxl/image.h"
 #include "lib/jxl/image_ops.h"
-#include "tools/gauss_blur.h"
 #include "tools/no_memory_manager.h"
 
 namespace ssimulacra {
@@ -29,19 +29,264 @@ Design:
 
 #include <algorithm>
 #include <cmath>
+#include <cstddef>
+#include <cstdint>
 #include <cstdio>
 #include <utility>
+#include <vector>
+
+#undef HWY_TARGET_INCLUDE
+#define HWY_TARGET_INCLUDE "tools/ssimulacra2.cc"
+#include <hwy/foreach_target.h>
+#include <hwy/highway.h>
 
 #include "lib/jxl/base/compiler_specific.h"
+#include "lib/jxl/base/data_parallel.h"
 #include "lib/jxl/base/printf_macros.h"
 #include "lib/jxl/base/status.h"
 #include "lib/jxl/color_encoding_internal.h"
 #include "lib/jxl/enc_xyb.h"
+#include "lib/jxl/gauss_blur.h"
 #include "lib/jxl/image.h"
 #include "lib/jxl/image_bundle.h"
 #include "lib/jxl/image_ops.h"
-#include "tools/gauss_blur.h"
 #include "tools/no_memory_manager.h"
+HWY_BEFORE_NAMESPACE();
+namespace jpegxl {
+namespace tools {
+namespace HWY_NAMESPACE {
+
+// These templates are not found via ADL.
+using hwy::HWY_NAMESPACE::Abs;
+using hwy::HWY_NAMESPACE::Add;
+using hwy::HWY_NAMESPACE::Div;
+using hwy::HWY_NAMESPACE::GetLane;
+using hwy::HWY_NAMESPACE::Max;
+using hwy::HWY_NAMESPACE::Mul;
+using hwy::HWY_NAMESPACE::Neg;
+using hwy::HWY_NAMESPACE::Rebind;
+using hwy::HWY_NAMESPACE::Sub;
+
+constexpr float kC2 = 0.0009f;
+
+double quartic(double x) {
+  x *= x;
+  x *= x;
+  return x;
+}
+
+// Adds the sums of 1 - SSIM' and of its fourth power over one row to sums[0]
+// and sums[1]. Per-pixel values are computed in the same precision as the
+// scalar loop; only the order of summation differs.
+void SSIMRow(const float* JXL_RESTRICT row_m1,
+             const float* JXL_RESTRICT row_m2,
+             const float* JXL_RESTRICT row_s11,
+             const float* JXL_RESTRICT row_s22,
+             const float* JXL_RESTRICT row_s12, size_t xsize, double* sums) {
+  size_t x = 0;
+#if HWY_CAP_FLOAT64
+  const HWY_FULL(double) d;
+  const Rebind<float, HWY_FULL(double)> df;
+  const auto one = Set(d, 1.0);
+  const auto onef = Set(df, 1.0f);
+  const auto twof = Set(df, 2.0f);
+  const auto c2 = Set(df, kC2);
+  auto sum0 = Zero(d);
+  auto sum1 = Zero(d);
+  for (; x + Lanes(d) <= xsize; x += Lanes(d)) {
+    const auto mu1 = Load(df, row_m1 + x);
+    const auto mu2 = Load(df, row_m2 + x);
+    const auto diff = Sub(mu1, mu2);
+    const auto num_m = Sub(onef, Mul(diff, diff));
+    const auto num_s =
+        Add(Mul(twof, Sub(Load(df, row_s12 + x), Mul(mu1, mu2))), c2);
+    const auto denom_s = Add(Add(Sub(Load(df, row_s11 + x), Mul(mu1, mu1)),
+                                 Sub(Load(df, row_s22 + x), Mul(mu2, mu2))),
+                             c2);
+    const auto err = Max(
+        Sub(one, PromoteTo(d, Div(Mul(num_m, num_s), denom_s))), Zero(d));
+    sum0 = Add(sum0, err);
+    const auto err2 = Mul(err, err);
+    sum1 = Add(sum1, Mul(err2, err2));
+  }
+  sums[0] += GetLane(SumOfLanes(d, sum0));
+  sums[1] += GetLane(SumOfLanes(d, sum1));
+#endif
+  for (; x < xsize; ++x) {
+    float mu1 = row_m1[x];
+    float mu2 = row_m2[x];
+    float mu11 = mu1 * mu1;
+    float mu22 = mu2 * mu2;
+    float mu12 = mu1 * mu2;
+    /* Correction applied compared to the original SSIM formula, which has:
+
+         luma_err = 2 * mu1 * mu2 / (mu1^2 + mu2^2)
+                  = 1 - (mu1 - mu2)^2 / (mu1^2 + mu2^2)
+
+       The denominator causes error in the darks (low mu1 and mu2) to weigh
+       more than error in the brights (high mu1 and mu2). This would make
+       sense if values correspond to linear luma. However, the actual values
+       are either gamma-compressed luma (which supposedly is already
+       perceptually uniform) or chroma (where weighing green more than red
+       or blue more than yellow does not make any sense at all). So it is
+       better to simply drop this denominator.
+    */
+    float num_m = 1.0 - (mu1 - mu2) * (mu1 - mu2);
+    float num_s = 2 * (row_s12[x] - mu12) + kC2;
+    float denom_s = (row_s11[x] - mu11) + (row_s22[x] - mu22) + kC2;
+
+    // Use 1 - SSIM' so it becomes an error score instead of a quality
+    // index. This makes it make sense to compute an L_4 norm.
+    double d = 1.0 - (num_m * num_s / denom_s);
+    d = std::max(d, 0.0);
+    sums[0] += d;
+    sums[1] += quartic(d);
+  }
+}
+
+// Adds the sums of artifacts, detail lost and their fourth powers over one
+// row to sums[0..3], in the order expected by EdgeDiffMap.
+void EdgeDiffRow(const float* JXL_RESTRICT row1,
+                 const float* JXL_RESTRICT rowm1,
+                 const float* JXL_RESTRICT row2,
+                 const float* JXL_RESTRICT rowm2, size_t xsize, double* sums) {
+  size_t x = 0;
+#if HWY_CAP_FLOAT64
+  const HWY_FULL(double) d;
+  const Rebind<float, HWY_FULL(double)> df;
+  const auto one = Set(d, 1.0);
+  auto sum0 = Zero(d);
+  auto sum1 = Zero(d);
+  auto sum2 = Zero(d);
+  auto sum3 = Zero(d);
+  for (; x + Lanes(d) <= xsize; x += Lanes(d)) {
+    const auto edge1 = PromoteTo(
+        d, Abs(Sub(Load(df, row1 + x), Load(df, rowm1 + x))));
+    const auto edge2 = PromoteTo(
+        d, Abs(Sub(Load(df, row2 + x), Load(df, rowm2 + x))));
+    const auto d1 = Sub(Div(Add(one, edge2), Add(one, edge1)), one);
+    const auto artifact = Max(d1, Zero(d));
+    sum0 = Add(sum0, artifact);
+    const auto artifact2 = Mul(artifact, artifact);
+    sum1 = Add(sum1, Mul(artifact2, artifact2));
+    const auto detail_lost = Max(Neg(d1), Zero(d));
+    sum2 = Add(sum2, detail_lost);
+    const auto detail_lost2 = Mul(detail_lost, detail_lost);
+    sum3 = Add(sum3, Mul(detail_lost2, detail_lost2));
+  }
+  sums[0] += GetLane(SumOfLanes(d, sum0));
+  sums[1] += GetLane(SumOfLanes(d, sum1));
+  sums[2] += GetLane(SumOfLanes(d, sum2));
+  sums[3] += GetLane(SumOfLanes(d, sum3));
+#endif
+  for (; x < xsize; ++x) {
+    double d1 = (1.0 + std::abs(row2[x] - rowm2[x])) /
+                    (1.0 + std::abs(row1[x] - rowm1[x])) -
+                1.0;
+
+    // d1 > 0: distorted has an edge where original is smooth
+    //         (indicating ringing, color banding, blockiness, etc)
+    double artifact = std::max(d1, 0.0);
+    sums[0] += artifact;
+    sums[1] += quartic(artifact);
+
+    // d1 < 0: original has an edge where distorted is smooth
+    //         (indicating smoothing, blurring, smearing, etc)
+    double detail_lost = std::max(-d1, 0.0);
+    sums[2] += detail_lost;
+    sums[3] += quartic(detail_lost);
+  }
+}
+
+// NOLINTNEXTLINE(google-readability-namespace-comments)
+}  // namespace HWY_NAMESPACE
+}  // namespace tools
+}  // namespace jpegxl
+HWY_AFTER_NAMESPACE();
+
+#if HWY_ONCE
+namespace jpegxl {
+namespace tools {
+
+HWY_EXPORT(SSIMRow);
+HWY_EXPORT(EdgeDiffRow);
+
+namespace {
+
+using ::jxl::Image3F;
+using ::jxl::ImageF;
+using ::jxl::Status;
+using ::jxl::ThreadPool;
+
+// Sums are kept per row and added up in row order afterwards, so that the
+// result does not depend on the number of threads.
+Status SSIMMap(const Image3F& m1, const Image3F& m2, const Image3F& s11,
+               const Image3F& s22, const Image3F& s12, ThreadPool* pool,
+               double* plane_averages) {
+  const size_t xsize = m1.xsize();
+  const size_t ysize = m1.ysize();
+  const double onePerPixels = 1.0 / (ysize * xsize);
+  std::vector<double> row_sums(3 * ysize * 2);
+  const auto process_row = [&](const uint32_t task,
+                               size_t /*thread*/) -> Status {
+    const size_t c = task / ysize;
+    const size_t y = task % ysize;
+    HWY_DYNAMIC_DISPATCH(SSIMRow)
+    (m1.ConstPlaneRow(c, y), m2.ConstPlaneRow(c, y), s11.ConstPlaneRow(c, y),
+     s22.ConstPlaneRow(c, y), s12.ConstPlaneRow(c, y), xsize,
+     &row_sums[task * 2]);
+    return true;
+  };
+  JXL_RETURN_IF_ERROR(RunOnPool(pool, 0, 3 * ysize, ThreadPool::NoInit,
+                                process_row, "SSIMMap"));
+  for (size_t c = 0; c < 3; ++c) {
+    double sum1[2] = {0.0};
+    for (size_t y = 0; y < ysize; ++y) {
+      const double* sums = &row_sums[(c * ysize + y) * 2];
+      for (size_t i = 0; i < 2; ++i) sum1[i] += sums[i];
+    }
+    plane_averages[c * 2] = onePerPixels * sum1[0];
+    plane_averages[c * 2 + 1] = sqrt(sqrt(onePerPixels * sum1[1]));
+  }
+  return true;
+}
+
+Status EdgeDiffMap(const Image3F& img1, const Image3F& mu1, const Image3F& img2,
+                   const Image3F& mu2, ThreadPool* pool,
+                   double* plane_averages) {
+  const size_t xsize = img1.xsize();
+  const size_t ysize = img1.ysize();
+  const double onePerPixels = 1.0 / (ysize * xsize);
+  std::vector<double> row_sums(3 * ysize * 4);
+  const auto process_row = [&](const uint32_t task,
+                               size_t /*thread*/) -> Status {
+    const size_t c = task / ysize;
+    const size_t y = task % ysize;
+    HWY_DYNAMIC_DISPATCH(EdgeDiffRow)
+    (img1.ConstPlaneRow(c, y), mu1.ConstPlaneRow(c, y),
+     img2.ConstPlaneRow(c, y), mu2.ConstPlaneRow(c, y), xsize,
+     &row_sums[task * 4]);
+    return true;
+  };
+  JXL_RETURN_IF_ERROR(RunOnPool(pool, 0, 3 * ysize, ThreadPool::NoInit,
+                                process_row, "EdgeDiffMap"));
+  for (size_t c = 0; c < 3; ++c) {
+    double sum1[4] = {0.0};
+    for (size_t y = 0; y < ysize; ++y) {
+      const double* sums = &row_sums[(c * ysize + y) * 4];
+      for (size_t i = 0; i < 4; ++i) sum1[i] += sums[i];
+    }
+    plane_averages[c * 4] = onePerPixels * sum1[0];
+    plane_averages[c * 4 + 1] = sqrt(sqrt(onePerPixels * sum1[1]));
+    plane_averages[c * 4 + 2] = onePerPixels * sum1[2];
+    plane_averages[c * 4 + 3] = sqrt(sqrt(onePerPixels * sum1[3]));
+  }
+  return true;
+}
+
+}  // namespace
+}  // namespace tools
+}  // namespace jpegxl
 
 namespace {
 
@@ -50,8 +295,8 @@ using ::jxl::ImageBundle;
 using ::jxl::ImageF;
 using ::jxl::Status;
 using ::jxl::StatusOr;
+using ::jxl::ThreadPool;
 
-const float kC2 = 0.0009f;
 const int kNumScales = 6;
 
 StatusOr<Image3F> Downsample(const Image3F& in, size_t fx, size_t fy) {
@@ -80,147 +325,110 @@ StatusOr<Image3F> Downsample(const Image3F& in, size_t fx, size_t fy) {
   return out;
 }
 
-void Multiply(const Image3F& a, const Image3F& b, Image3F* mul) {
-  for (size_t c = 0; c < 3; ++c) {
-    for (size_t y = 0; y < a.ysize(); ++y) {
-      const float* JXL_RESTRICT in1 = a.PlaneRow(c, y);
-      const float* JXL_RESTRICT in2 = b.PlaneRow(c, y);
-      float* JXL_RESTRICT out = mul->PlaneRow(c, y);
-      for (size_t x = 0; x < a.xsize(); ++x) {
-        out[x] = in1[x] * in2[x];
-      }
+void Multiply(const ImageF& a, const ImageF& b, ImageF* mul) {
+  for (size_t y = 0; y < a.ysize(); ++y) {
+    const float* JXL_RESTRICT in1 = a.ConstRow(y);
+    const float* JXL_RESTRICT in2 = b.ConstRow(y);
+    float* JXL_RESTRICT out = mul->Row(y);
+    for (size_t x = 0; x < a.xsize(); ++x) {
+      out[x] = in1[x] * in2[x];
     }
   }
 }
 
-// Temporary storage for Gaussian blur, reused for multiple images.
+// Gaussian blur of all planes of one or more images, one plane per task.
+// Temporary storage is allocated per thread, but not beyond one per plane,
+// and reused for multiple images and scales.
 class Blur {
  public:
+  // Blurs each plane of 'a', or of the per-pixel product of 'a' and 'b' if
+  // 'b' is not null, into 'out'.
+  struct Job {
+    const Image3F* a;
+    const Image3F* b;
+    Image3F* out;
+  };
+
   static StatusOr<Blur> Create(const size_t xsize, const size_t ysize) {
-    JxlMemoryManager* memory_manager = jpegxl::tools::NoMemoryManager();
     Blur result;
-    JXL_ASSIGN_OR_RETURN(result.temp_,
-                         ImageF::Create(memory_manager, xsize, ysize));
+    result.max_xsize_ = result.xsize_ = xsize;
+    result.max_ysize_ = result.ysize_ = ysize;
     return result;
   }
 
-  Status BlurPlane(const ImageF& in, ImageF* JXL_RESTRICT out) {
-    JXL_RETURN_IF_ERROR(FastGaussian(
-        in.memory_manager(), rg_, in.xsize(), in.ysize(),
-        [&](size_t y) { return in.ConstRow(y); },
-        [&](size_t y) { return temp_.Row(y); },
-        [&](size_t y) { return out->Row(y); }));
-    return true;
-  }
-
-  StatusOr<Image3F> operator()(const Image3F& in) {
+  Status operator()(const std::vector<Job>& jobs, ThreadPool* pool) {
     JxlMemoryManager* memory_manager = jpegxl::tools::NoMemoryManager();
-    JXL_ASSIGN_OR_RETURN(
-        Image3F out, Image3F::Create(memory_manager, in.xsize(), in.ysize()));
-    JXL_RETURN_IF_ERROR(BlurPlane(in.Plane(0), &out.Plane(0)));
-    JXL_RETURN_IF_ERROR(BlurPlane(in.Plane(1), &out.Plane(1)));
-    JXL_RETURN_IF_ERROR(BlurPlane(in.Plane(2), &out.Plane(2)));
-    return out;
+    for (const Job& job : jobs) {
+      JXL_ASSIGN_OR_RETURN(*job.out,
+                           Image3F::Create(memory_manager, xsize_, ysize_));
+    }
+    // There is no more scratch than tasks: with fewer threads than tasks,
+    // each thread has its own slot, otherwise each task does.
+    const size_t num_tasks = 3 * jobs.size();
+    bool slot_per_thread = true;
+    const auto init = [&](size_t num_threads) -> Status {
+      slot_per_thread = num_threads <= num_tasks;
+      const size_t num_slots = std::min(num_threads, num_tasks);
+      for (size_t i = temp_.size(); i < num_slots; ++i) {
+        JXL_ASSIGN_OR_RETURN(
+            ImageF temp,
+            ImageF::Create(memory_manager, max_xsize_, max_ysize_));
+        JXL_ASSIGN_OR_RETURN(
+            ImageF mul, ImageF::Create(memory_manager, max_xsize_, max_ysize_));
+        temp_.emplace_back(std::move(temp));
+        mul_.emplace_back(std::move(mul));
+      }
+      for (size_t i = 0; i < num_slots; ++i) {
+        JXL_RETURN_IF_ERROR(temp_[i].ShrinkTo(xsize_, ysize_));
+        JXL_RETURN_IF_ERROR(mul_[i].ShrinkTo(xsize_, ysize_));
+      }
+      return true;
+    };
+    const auto blur_plane = [&](const uint32_t task,
+                                const size_t thread) -> Status {
+      const Job& job = jobs[task / 3];
+      const size_t c = task % 3;
+      const size_t slot = slot_per_thread ? thread : task;
+      const ImageF* in = &job.a->Plane(c);
+      if (job.b != nullptr) {
+        Multiply(*in, job.b->Plane(c), &mul_[slot]);
+        in = &mul_[slot];
+      }
+      ImageF* temp = &temp_[slot];
+      ImageF* out = &job.out->Plane(c);
+      // Planes are already blurred in parallel, so the blur itself must not
+      // use the pool.
+      JXL_RETURN_IF_ERROR(FastGaussian(
+          memory_manager, rg_, xsize_, ysize_,
+          [&](size_t y) { return in->ConstRow(y); },
+          [&](size_t y) { return temp->Row(y); },
+          [&](size_t y) { return out->Row(y); }));
+      return true;
+    };
+    JXL_RETURN_IF_ERROR(RunOnPool(pool, 0, num_tasks, init, blur_plane,
+                                  "Ssimulacra2Blur"));
+    return true;
   }
 
   // Allows reusing across scales.
   Status ShrinkTo(const size_t xsize, const size_t ysize) {
-    return temp_.ShrinkTo(xsize, ysize);
+    JXL_ENSURE(xsize <= max_xsize_ && ysize <= max_ysize_);
+    xsize_ = xsize;
+    ysize_ = ysize;
+    return true;
   }
 
  private:
   Blur() : rg_(jxl::CreateRecursiveGaussian(1.5)) {}
   jxl::RecursiveGaussian rg_;
-  ImageF temp_;
+  size_t max_xsize_ = 0;
+  size_t max_ysize_ = 0;
+  size_t xsize_ = 0;
+  size_t ysize_ = 0;
+  std::vector<ImageF> temp_;
+  std::vector<ImageF> mul_;
 };
 
-double quartic(double x) {
-  x *= x;
-  x *= x;
-  return x;
-}
-void SSIMMap(const Image3F& m1, const Image3F& m2, const Image3F& s11,
-             const Image3F& s22, const Image3F& s12, double* plane_averages) {
-  const double onePerPixels = 1.0 / (m1.ysize() * m1.xsize());
-  for (size_t c = 0; c < 3; ++c) {
-    double sum1[2] = {0.0};
-    for (size_t y = 0; y < m1.ysize(); ++y) {
-      const float* JXL_RESTRICT row_m1 = m1.PlaneRow(c, y);
-      const float* JXL_RESTRICT row_m2 = m2.PlaneRow(c, y);
-      const float* JXL_RESTRICT row_s11 = s11.PlaneRow(c, y);
-      const float* JXL_RESTRICT row_s22 = s22.PlaneRow(c, y);
-      const float* JXL_RESTRICT row_s12 = s12.PlaneRow(c, y);
-      for (size_t x = 0; x < m1.xsize(); ++x) {
-        float mu1 = row_m1[x];
-        float mu2 = row_m2[x];
-        float mu11 = mu1 * mu1;
-        float mu22 = mu2 * mu2;
-        float mu12 = mu1 * mu2;
-        /* Correction applied compared to the original SSIM formula, which has:
-
-             luma_err = 2 * mu1 * mu2 / (mu1^2 + mu2^2)
-                      = 1 - (mu1 - mu2)^2 / (mu1^2 + mu2^2)
-
-           The denominator causes error in the darks (low mu1 and mu2) to weigh
-           more than error in the brights (high mu1 and mu2). This would make
-           sense if values correspond to linear luma. However, the actual values
-           are either gamma-compressed luma (which supposedly is already
-           perceptually uniform) or chroma (where weighing green more than red
-           or blue more than yellow does not make any sense at all). So it is
-           better to simply drop this denominator.
-        */
-        float num_m = 1.0 - (mu1 - mu2) * (mu1 - mu2);
-        float num_s = 2 * (row_s12[x] - mu12) + kC2;
-        float denom_s = (row_s11[x] - mu11) + (row_s22[x] - mu22) + kC2;
-
-        // Use 1 - SSIM' so it becomes an error score instead of a quality
-        // index. This makes it make sense to compute an L_4 norm.
-        double d = 1.0 - (num_m * num_s / denom_s);
-        d = std::max(d, 0.0);
-        sum1[0] += d;
-        sum1[1] += quartic(d);
-      }
-    }
-    plane_averages[c * 2] = onePerPixels * sum1[0];
-    plane_averages[c * 2 + 1] = sqrt(sqrt(onePerPixels * sum1[1]));
-  }
-}
-
-void EdgeDiffMap(const Image3F& img1, const Image3F& mu1, const Image3F& img2,
-                 const Image3F& mu2, double* plane_averages) {
-  const double onePerPixels = 1.0 / (img1.ysize() * img1.xsize());
-  for (size_t c = 0; c < 3; ++c) {
-    double sum1[4] = {0.0};
-    for (size_t y = 0; y < img1.ysize(); ++y) {
-      const float* JXL_RESTRICT row1 = img1.PlaneRow(c, y);
-      const float* JXL_RESTRICT row2 = img2.PlaneRow(c, y);
-      const float* JXL_RESTRICT rowm1 = mu1.PlaneRow(c, y);
-      const float* JXL_RESTRICT rowm2 = mu2.PlaneRow(c, y);
-      for (size_t x = 0; x < img1.xsize(); ++x) {
-        double d1 = (1.0 + std::abs(row2[x] - rowm2[x])) /
-                        (1.0 + std::abs(row1[x] - rowm1[x])) -
-                    1.0;
-
-        // d1 > 0: distorted has an edge where original is smooth
-        //         (indicating ringing, color banding, blockiness, etc)
-        double artifact = std::max(d1, 0.0);
-        sum1[0] += artifact;
-        sum1[1] += quartic(artifact);
-
-        // d1 < 0: original has an edge where distorted is smooth
-        //         (indicating smoothing, blurring, smearing, etc)
-        double detail_lost = std::max(-d1, 0.0);
-        sum1[2] += detail_lost;
-        sum1[3] += quartic(detail_lost);
-      }
-    }
-    plane_averages[c * 4] = onePerPixels * sum1[0];
-    plane_averages[c * 4 + 1] = sqrt(sqrt(onePerPixels * sum1[1]));
-    plane_averages[c * 4 + 2] = onePerPixels * sum1[2];
-    plane_averages[c * 4 + 3] = sqrt(sqrt(onePerPixels * sum1[3]));
-  }
-}
-
 /* Get all components in more or less 0..1 range
    Range of Rec2020 with these adjustments:
     X: 0.017223..0.998838
@@ -260,13 +468,14 @@ void AlphaBlend(ImageBundle& img, float bg) {
   }
 }
 
-Status ToXYB(const ImageBundle& in, Image3F* JXL_RESTRICT xyb) {
+Status ToXYB(const ImageBundle& in, ThreadPool* pool,
+             Image3F* JXL_RESTRICT xyb) {
   JxlMemoryManager* memory_manager = in.memory_manager();
   JXL_ASSIGN_OR_RETURN(*xyb,
                        Image3F::Create(memory_manager, in.xsize(), in.ysize()));
   JXL_RETURN_IF_ERROR(CopyImageTo(in.color(), xyb));
   JXL_RETURN_IF_ERROR(ToXYB(in.c_current(), in.metadata()->IntensityTarget(),
-                            in.black(), nullptr, xyb, *JxlGetDefaultCms(),
+                            in.black(), pool, xyb, *JxlGetDefaultCms(),
                             nullptr));
   return true;
 }
@@ -456,41 +665,28 @@ double Msssim::Score() const {
   return ssim;
 }
 
-StatusOr<Msssim> ComputeSSIMULACRA2(const ImageBundle& orig,
-                                    const ImageBundle& dist, float bg) {
-  JxlMemoryManager* memory_manager = jpegxl::tools::NoMemoryManager();
-  Msssim msssim;
-
-  JXL_ASSIGN_OR_RETURN(
-      Image3F img1,
-      Image3F::Create(memory_manager, orig.xsize(), orig.ysize()));
-  JXL_ASSIGN_OR_RETURN(
-      Image3F img2,
-      Image3F::Create(memory_manager, img1.xsize(), img1.ysize()));
+StatusOr<Ssimulacra2Reference> Ssimulacra2Reference::Create(
+    const ImageBundle& orig, float bg, ThreadPool* pool) {
+  Ssimulacra2Reference reference;
+  reference.xsize_ = orig.xsize();
+  reference.ysize_ = orig.ysize();
+  reference.bg_ = bg;
 
   JXL_ASSIGN_OR_RETURN(ImageBundle orig2, orig.Copy());
-  JXL_ASSIGN_OR_RETURN(ImageBundle dist2, dist.Copy());
-
   if (orig.HasAlpha()) AlphaBlend(orig2, bg);
-  if (dist.HasAlpha()) AlphaBlend(dist2, bg);
   orig2.ClearExtraChannels();
-  dist2.ClearExtraChannels();
-
   JXL_RETURN_IF_ERROR(orig2.TransformTo(
-      jxl::ColorEncoding::LinearSRGB(orig2.IsGray()), *JxlGetDefaultCms()));
-  JXL_RETURN_IF_ERROR(dist2.TransformTo(
-      jxl::ColorEncoding::LinearSRGB(dist2.IsGray()), *JxlGetDefaultCms()));
+      jxl::ColorEncoding::LinearSRGB(orig2.IsGray()), *JxlGetDefaultCms(),
+      pool));
 
-  JXL_RETURN_IF_ERROR(ToXYB(orig2, &img1));
-  JXL_RETURN_IF_ERROR(ToXYB(dist2, &img2));
+  Image3F img1;
+  JXL_RETURN_IF_ERROR(ToXYB(orig2, pool, &img1));
   MakePositiveXYB(img1);
-  MakePositiveXYB(img2);
 
-  JXL_ASSIGN_OR_RETURN(
-      Image3F mul, Image3F::Create(memory_manager, img1.xsize(), img1.ysize()));
   JXL_ASSIGN_OR_RETURN(Blur blur, Blur::Create(img1.xsize(), img1.ysize()));
 
   for (int scale = 0; scale < kNumScales; scale++) {
+    // Checks the size of the previous scale, so the last scale may be smaller.
     if (img1.xsize() < 8 || img1.ysize() < 8) {
       break;
     }
@@ -498,40 +694,84 @@ StatusOr<Msssim> ComputeSSIMULACRA2(const ImageBundle& orig,
       JXL_ASSIGN_OR_RETURN(Image3F tmp, Downsample(*orig2.color(), 2, 2));
       JXL_RETURN_IF_ERROR(orig2.SetFromImage(
           std::move(tmp), jxl::ColorEncoding::LinearSRGB(orig2.IsGray())));
-      JXL_ASSIGN_OR_RETURN(tmp, Downsample(*dist2.color(), 2, 2));
-      JXL_RETURN_IF_ERROR(dist2.SetFromImage(
-          std::move(tmp), jxl::ColorEncoding::LinearSRGB(dist2.IsGray())));
-      JXL_RETURN_IF_ERROR(img1.ShrinkTo(orig2.xsize(), orig2.ysize()));
-      JXL_RETURN_IF_ERROR(img2.ShrinkTo(orig2.xsize(), orig2.ysize()));
-      JXL_RETURN_IF_ERROR(ToXYB(orig2, &img1));
-      JXL_RETURN_IF_ERROR(ToXYB(dist2, &img2));
+      JXL_RETURN_IF_ERROR(ToXYB(orig2, pool, &img1));
       MakePositiveXYB(img1);
-      MakePositiveXYB(img2);
     }
-    JXL_RETURN_IF_ERROR(mul.ShrinkTo(img1.xsize(), img1.ysize()));
     JXL_RETURN_IF_ERROR(blur.ShrinkTo(img1.xsize(), img1.ysize()));
 
-    Multiply(img1, img1, &mul);
-    JXL_ASSIGN_OR_RETURN(Image3F sigma1_sq, blur(mul));
+    Scale s;
+    JXL_RETURN_IF_ERROR(
+        blur({{&img1, &img1, &s.sigma_sq}, {&img1, nullptr, &s.mu}}, pool));
+    JXL_ASSIGN_OR_RETURN(
+        s.xyb, Image3F::Create(jpegxl::tools::NoMemoryManager(), img1.xsize(),
+                               img1.ysize()));
+    JXL_RETURN_IF_ERROR(CopyImageTo(img1, &s.xyb));
+    reference.scales_.push_back(std::move(s));
+  }
+  return reference;
+}
+
+StatusOr<Msssim> Ssimulacra2Reference::Compare(const ImageBundle& dist,
+                                               ThreadPool* pool) const {
+  if (dist.xsize() != xsize_ || dist.ysize() != ysize_) {
+    return JXL_FAILURE("Image size mismatch: %" PRIuS "x%" PRIuS
+                       " vs %" PRIuS "x%" PRIuS,
+                       dist.xsize(), dist.ysize(), xsize_, ysize_);
+  }
+  Msssim msssim;
+  if (scales_.empty()) return msssim;
 
-    Multiply(img2, img2, &mul);
-    JXL_ASSIGN_OR_RETURN(Image3F sigma2_sq, blur(mul));
+  JXL_ASSIGN_OR_RETURN(ImageBundle dist2, dist.Copy());
+  if (dist.HasAlpha()) AlphaBlend(dist2, bg_);
+  dist2.ClearExtraChannels();
+  JXL_RETURN_IF_ERROR(dist2.TransformTo(
+      jxl::ColorEncoding::LinearSRGB(dist2.IsGray()), *JxlGetDefaultCms(),
+      pool));
 
-    Multiply(img1, img2, &mul);
-    JXL_ASSIGN_OR_RETURN(Image3F sigma12, blur(mul));
+  const Image3F& full = scales_[0].xyb;
+  JXL_ASSIGN_OR_RETURN(Blur blur, Blur::Create(full.xsize(), full.ysize()));
 
-    JXL_ASSIGN_OR_RETURN(Image3F mu1, blur(img1));
-    JXL_ASSIGN_OR_RETURN(Image3F mu2, blur(img2));
+  Image3F img2;
+  for (size_t scale = 0; scale < scales_.size(); scale++) {
+    const Scale& ref = scales_[scale];
+    if (scale) {
+      JXL_ASSIGN_OR_RETURN(Image3F tmp, Downsample(*dist2.color(), 2, 2));
+      JXL_RETURN_IF_ERROR(dist2.SetFromImage(
+          std::move(tmp), jxl::ColorEncoding::LinearSRGB(dist2.IsGray())));
+    }
+    JXL_RETURN_IF_ERROR(ToXYB(dist2, pool, &img2));
+    MakePositiveXYB(img2);
+    JXL_RETURN_IF_ERROR(blur.ShrinkTo(img2.xsize(), img2.ysize()));
+
+    Image3F sigma2_sq;
+    Image3F sigma12;
+    Image3F mu2;
+    JXL_RETURN_IF_ERROR(blur({{&img2, &img2, &sigma2_sq},
+                              {&ref.xyb, &img2, &sigma12},
+                              {&img2, nullptr, &mu2}},
+                             pool));
 
     MsssimScale sscale;
-    SSIMMap(mu1, mu2, sigma1_sq, sigma2_sq, sigma12, sscale.avg_ssim);
-    EdgeDiffMap(img1, mu1, img2, mu2, sscale.avg_edgediff);
+    JXL_RETURN_IF_ERROR(jpegxl::tools::SSIMMap(ref.mu, mu2, ref.sigma_sq,
+                                               sigma2_sq, sigma12, pool,
+                                               sscale.avg_ssim));
+    JXL_RETURN_IF_ERROR(jpegxl::tools::EdgeDiffMap(
+        ref.xyb, ref.mu, img2, mu2, pool, sscale.avg_edgediff));
     msssim.scales.push_back(sscale);
   }
   return msssim;
 }
 
+StatusOr<Msssim> ComputeSSIMULACRA2(const ImageBundle& orig,
+                                    const ImageBundle& dist, float bg,
+                                    ThreadPool* pool) {
+  JXL_ASSIGN_OR_RETURN(Ssimulacra2Reference reference,
+                       Ssimulacra2Reference::Create(orig, bg, pool));
+  return reference.Compare(dist, pool);
+}
+
 StatusOr<Msssim> ComputeSSIMULACRA2(const ImageBundle& orig,
                                     const ImageBundle& distorted) {
   return ComputeSSIMULACRA2(orig, distorted, 0.5f);
 }
+#endif  // HWY_ONCE
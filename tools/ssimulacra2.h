@@ -6,9 +6,12 @@
 #ifndef TOOLS_SSIMULACRA2_H_
 #define TOOLS_SSIMULACRA2_H_
 
+#include <cstddef>
 #include <vector>
 
+#include "lib/jxl/base/data_parallel.h"
 #include "lib/jxl/base/status.h"
+#include "lib/jxl/image.h"
 #include "lib/jxl/image_bundle.h"
 
 struct MsssimScale {
@@ -24,11 +27,48 @@ struct Msssim {
 
 // Computes the SSIMULACRA 2 score between reference image 'orig' and
 // distorted image 'distorted'. In case of alpha transparency, assume
-// a gray background if intensity 'bg' (in range 0..1).
+// a gray background if intensity 'bg' (in range 0..1). The result does not
+// depend on the number of threads in 'pool'.
 jxl::StatusOr<Msssim> ComputeSSIMULACRA2(const jxl::ImageBundle &orig,
                                          const jxl::ImageBundle &distorted,
-                                         float bg);
+                                         float bg,
+                                         jxl::ThreadPool *pool = nullptr);
 jxl::StatusOr<Msssim> ComputeSSIMULACRA2(const jxl::ImageBundle &orig,
                                          const jxl::ImageBundle &distorted);
 
+// Reference side of SSIMULACRA 2, precomputed once to score many distorted
+// images (e.g. several codecs or distances) against the same original. Holds
+// the XYB image and its blurred mean and variance at each scale, about four
+// times the memory of the original as float XYB. Compare() is const and may
+// be called concurrently.
+class Ssimulacra2Reference {
+ public:
+  // In case of alpha transparency, 'orig' is blended on a gray background of
+  // intensity 'bg' (in range 0..1).
+  static jxl::StatusOr<Ssimulacra2Reference> Create(
+      const jxl::ImageBundle &orig, float bg = 0.5f,
+      jxl::ThreadPool *pool = nullptr);
+
+  // Same result as ComputeSSIMULACRA2(orig, distorted, bg).
+  jxl::StatusOr<Msssim> Compare(const jxl::ImageBundle &distorted,
+                                jxl::ThreadPool *pool = nullptr) const;
+
+  size_t xsize() const { return xsize_; }
+  size_t ysize() const { return ysize_; }
+
+ private:
+  struct Scale {
+    jxl::Image3F xyb;
+    jxl::Image3F mu;
+    jxl::Image3F sigma_sq;
+  };
+
+  Ssimulacra2Reference() = default;
+
+  size_t xsize_ = 0;
+  size_t ysize_ = 0;
+  float bg_ = 0.5f;
+  std::vector<Scale> scales_;
+};
+
 #endif  // TOOLS_SSIMULACRA2_H_
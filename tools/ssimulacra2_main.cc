@@ -9,6 +9,8 @@
 #include <cstdint>
 #include <cstdio>
 #include <cstdlib>
+#include <string>
+#include <thread>  // NOLINT
 #include <vector>
 
 #include "lib/extras/codec.h"
@@ -19,6 +21,7 @@
 #include "tools/file_io.h"
 #include "tools/no_memory_manager.h"
 #include "tools/ssimulacra2.h"
+#include "tools/thread_pool_internal.h"
 
 #define QUIT(M)               \
   fprintf(stderr, "%s\n", M); \
@@ -27,7 +30,13 @@
 #include "monolithic_examples.h"
 
 static int PrintUsage(const char** argv) {
-  fprintf(stderr, "Usage: %s original.png distorted.png\n", argv[0]);
+  fprintf(stderr,
+          "Usage: %s original.png distorted.png "
+          "[--num_threads <number of worker threads>]\n",
+          argv[0]);
+  fprintf(stderr,
+          "The number of threads defaults to the number of hardware threads; "
+          "with 0 threads, everything runs on the main thread.\n");
   fprintf(stderr,
           "Returns a score in range -inf..100, which correlates to subjective "
           "visual quality:\n");
@@ -80,7 +89,19 @@ static int PrintUsage(const char** argv) {
 #endif
 
 int main(int argc, const char** argv) {
-  if (argc != 3) return PrintUsage(argv);
+  if (argc != 3 && argc != 5) return PrintUsage(argv);
+  size_t num_threads = std::thread::hardware_concurrency();
+  if (argc == 5) {
+    if (std::string(argv[3]) != "--num_threads") return PrintUsage(argv);
+    char* end;
+    const long threads = strtol(argv[4], &end, 10);  // NOLINT
+    if (end == argv[4] || *end != '\0' || threads < 0) {
+      fprintf(stderr, "Failed to parse num_threads \"%s\".\n", argv[4]);
+      return 1;
+    }
+    num_threads = threads;
+  }
+  jpegxl::tools::ThreadPoolInternal pool(num_threads);
   JxlMemoryManager* memory_manager = jpegxl::tools::NoMemoryManager();
 
   auto io1 = jxl::make_unique<jxl::CodecInOut>(memory_manager);
@@ -110,17 +131,20 @@ int main(int argc, const char** argv) {
 
   if (!io1->Main().HasAlpha()) {
     JXL_ASSIGN_OR_QUIT(Msssim msssim,
-                       ComputeSSIMULACRA2(io1->Main(), io2->Main()),
+                       ComputeSSIMULACRA2(io1->Main(), io2->Main(), 0.5f,
+                                          pool.get()),
                        "ComputeSSIMULACRA2 failed.");
     printf("%.8f\n", msssim.Score());
   } else {
     // in case of alpha transparency: blend against dark and bright backgrounds
     // and return the worst of both scores
     JXL_ASSIGN_OR_QUIT(Msssim msssim0,
-                       ComputeSSIMULACRA2(io1->Main(), io2->Main(), 0.1f),
+                       ComputeSSIMULACRA2(io1->Main(), io2->Main(), 0.1f,
+                                          pool.get()),
                        "ComputeSSIMULACRA2 failed.");
     JXL_ASSIGN_OR_QUIT(Msssim msssim1,
-                       ComputeSSIMULACRA2(io1->Main(), io2->Main(), 0.9f),
+                       ComputeSSIMULACRA2(io1->Main(), io2->Main(), 0.9f,
+                                          pool.get()),
                        "ComputeSSIMULACRA2 failed.");
     printf("%.8f\n", std::min(msssim0.Score(), msssim1.Score()));
   }
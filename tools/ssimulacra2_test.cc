@@ -0,0 +1,175 @@
+// Copyright (c) the JPEG XL Project Authors. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#include "tools/ssimulacra2.h"
+
+#include <cstddef>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include "lib/jxl/color_encoding_internal.h"
+#include "lib/jxl/image.h"
+#include "lib/jxl/image_bundle.h"
+#include "lib/jxl/image_metadata.h"
+#include "lib/jxl/test_memory_manager.h"
+#include "lib/jxl/test_utils.h"
+#include "lib/jxl/testing.h"
+
+namespace jxl {
+namespace {
+
+constexpr size_t kXSize = 96;
+constexpr size_t kYSize = 64;
+
+// Sawtooth ramps with sharp edges, in linear sRGB so that no color transform
+// is involved.
+Image3F MakeOriginal() {
+  JXL_TEST_ASSIGN_OR_DIE(
+      Image3F image, Image3F::Create(test::MemoryManager(), kXSize, kYSize));
+  for (size_t c = 0; c < 3; ++c) {
+    for (size_t y = 0; y < kYSize; ++y) {
+      float* JXL_RESTRICT row = image.PlaneRow(c, y);
+      for (size_t x = 0; x < kXSize; ++x) {
+        row[x] = 0.1f +
+                 0.8f * static_cast<float>((x * (c + 1) + y * (3 - c)) % 32) /
+                     31.0f;
+      }
+    }
+  }
+  return image;
+}
+
+// Adds a fixed pattern of amplitude `amplitude`.
+Image3F AddNoise(const Image3F& in, float amplitude) {
+  JXL_TEST_ASSIGN_OR_DIE(Image3F image,
+                         Image3F::Create(test::MemoryManager(), in.xsize(),
+                                         in.ysize()));
+  for (size_t c = 0; c < 3; ++c) {
+    for (size_t y = 0; y < in.ysize(); ++y) {
+      const float* JXL_RESTRICT row_in = in.ConstPlaneRow(c, y);
+      float* JXL_RESTRICT row = image.PlaneRow(c, y);
+      for (size_t x = 0; x < in.xsize(); ++x) {
+        const float noise =
+            static_cast<float>((x * 7 + y * 13 + c * 5) % 11) / 10.0f - 0.5f;
+        row[x] = row_in[x] + amplitude * noise;
+      }
+    }
+  }
+  return image;
+}
+
+// Replaces each block of `block_size` pixels by its average.
+Image3F MakeBlocky(const Image3F& in, size_t block_size) {
+  JXL_TEST_ASSIGN_OR_DIE(Image3F image,
+                         Image3F::Create(test::MemoryManager(), in.xsize(),
+                                         in.ysize()));
+  for (size_t c = 0; c < 3; ++c) {
+    for (size_t y = 0; y < in.ysize(); ++y) {
+      const size_t by = y / block_size * block_size;
+      float* JXL_RESTRICT row = image.PlaneRow(c, y);
+      for (size_t x = 0; x < in.xsize(); ++x) {
+        const size_t bx = x / block_size * block_size;
+        float sum = 0.0f;
+        for (size_t iy = by; iy < by + block_size; ++iy) {
+          for (size_t ix = bx; ix < bx + block_size; ++ix) {
+            sum += in.ConstPlaneRow(c, iy)[ix];
+          }
+        }
+        row[x] = sum / (block_size * block_size);
+      }
+    }
+  }
+  return image;
+}
+
+class Ssimulacra2Test : public ::testing::Test {
+ protected:
+  ImageBundle MakeBundle(Image3F&& image) {
+    ImageBundle ib(test::MemoryManager(), &metadata_);
+    EXPECT_TRUE(
+        ib.SetFromImage(std::move(image), ColorEncoding::LinearSRGB()));
+    return ib;
+  }
+
+  ImageMetadata metadata_;
+};
+
+TEST_F(Ssimulacra2Test, IdenticalImages) {
+  const ImageBundle orig = MakeBundle(MakeOriginal());
+  JXL_TEST_ASSIGN_OR_DIE(Msssim msssim, ComputeSSIMULACRA2(orig, orig));
+  EXPECT_EQ(100.0, msssim.Score());
+}
+
+// Guards the SIMD error maps against changes of the score. The value was
+// computed with a scalar implementation of the metric.
+TEST_F(Ssimulacra2Test, RecordedScore) {
+  const ImageBundle orig = MakeBundle(MakeOriginal());
+  const ImageBundle distorted = MakeBundle(AddNoise(MakeOriginal(), 0.05f));
+  JXL_TEST_ASSIGN_OR_DIE(Msssim msssim, ComputeSSIMULACRA2(orig, distorted));
+  EXPECT_NEAR(83.8433, msssim.Score(), 1e-3);
+}
+
+TEST_F(Ssimulacra2Test, SameScoreWithThreads) {
+  const ImageBundle orig = MakeBundle(MakeOriginal());
+  const ImageBundle distorted = MakeBundle(MakeBlocky(MakeOriginal(), 2));
+  JXL_TEST_ASSIGN_OR_DIE(Msssim single,
+                         ComputeSSIMULACRA2(orig, distorted, 0.5f, nullptr));
+  test::ThreadPoolForTests pool(8);
+  JXL_TEST_ASSIGN_OR_DIE(Msssim threaded,
+                         ComputeSSIMULACRA2(orig, distorted, 0.5f, pool.get()));
+  ASSERT_EQ(single.scales.size(), threaded.scales.size());
+  for (size_t i = 0; i < single.scales.size(); ++i) {
+    for (size_t j = 0; j < 3 * 2; ++j) {
+      EXPECT_EQ(single.scales[i].avg_ssim[j], threaded.scales[i].avg_ssim[j]);
+    }
+    for (size_t j = 0; j < 3 * 4; ++j) {
+      EXPECT_EQ(single.scales[i].avg_edgediff[j],
+                threaded.scales[i].avg_edgediff[j]);
+    }
+  }
+  EXPECT_EQ(single.Score(), threaded.Score());
+}
+
+TEST_F(Ssimulacra2Test, ReferenceMatchesComputeSSIMULACRA2) {
+  const ImageBundle orig = MakeBundle(MakeOriginal());
+  JXL_TEST_ASSIGN_OR_DIE(Ssimulacra2Reference reference,
+                         Ssimulacra2Reference::Create(orig));
+  EXPECT_EQ(kXSize, reference.xsize());
+  EXPECT_EQ(kYSize, reference.ysize());
+  std::vector<ImageBundle> distorted;
+  distorted.push_back(MakeBundle(AddNoise(MakeOriginal(), 0.02f)));
+  distorted.push_back(MakeBundle(AddNoise(MakeOriginal(), 0.1f)));
+  distorted.push_back(MakeBundle(MakeBlocky(MakeOriginal(), 2)));
+  distorted.push_back(MakeBundle(MakeBlocky(MakeOriginal(), 8)));
+  for (const ImageBundle& image : distorted) {
+    JXL_TEST_ASSIGN_OR_DIE(Msssim expected, ComputeSSIMULACRA2(orig, image));
+    JXL_TEST_ASSIGN_OR_DIE(Msssim actual, reference.Compare(image));
+    EXPECT_EQ(expected.Score(), actual.Score());
+  }
+}
+
+TEST_F(Ssimulacra2Test, ReferenceRejectsSizeMismatch) {
+  if (JXL_CRASH_ON_ERROR) {
+    GTEST_SKIP() << "Skipping due to JXL_CRASH_ON_ERROR";
+  }
+  const ImageBundle orig = MakeBundle(MakeOriginal());
+  JXL_TEST_ASSIGN_OR_DIE(Ssimulacra2Reference reference,
+                         Ssimulacra2Reference::Create(orig));
+  JXL_TEST_ASSIGN_OR_DIE(
+      Image3F smaller,
+      Image3F::Create(test::MemoryManager(), kXSize / 2, kYSize));
+  for (size_t c = 0; c < 3; ++c) {
+    for (size_t y = 0; y < kYSize; ++y) {
+      memcpy(smaller.PlaneRow(c, y), orig.color().ConstPlaneRow(c, y),
+             smaller.xsize() * sizeof(float));
+    }
+  }
+  const ImageBundle distorted = MakeBundle(std::move(smaller));
+  EXPECT_FALSE(reference.Compare(distorted).ok());
+}
+
+}  // namespace
+}  // namespace jxl
@@ -0,0 +1,99 @@
+// Copyright (c) the JPEG XL Project Authors. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#include "tools/target_score.h"
+
+#include <jxl/cms.h>
+#include <jxl/types.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "lib/extras/codec_in_out.h"
+#include "lib/extras/dec/jxl.h"
+#include "lib/extras/packed_image.h"
+#include "lib/extras/packed_image_convert.h"
+#include "lib/jxl/base/common.h"
+#include "lib/jxl/base/status.h"
+#include "lib/jxl/butteraugli/butteraugli.h"
+#include "lib/jxl/enc_butteraugli_comparator.h"
+#include "lib/jxl/image.h"
+#include "tools/no_memory_manager.h"
+#include "tools/ssimulacra2.h"
+
+namespace jpegxl {
+namespace tools {
+
+TargetScorer::TargetScorer(TargetMetric metric, JxlParallelRunner runner,
+                           void* runner_opaque)
+    : metric_(metric), pool_(runner, runner_opaque) {
+  dparams_.runner = runner;
+  dparams_.runner_opaque = runner_opaque;
+  for (uint32_t c = 1; c <= 4; ++c) {
+    dparams_.accepted_formats.push_back(
+        {c, JXL_TYPE_FLOAT, JXL_NATIVE_ENDIAN, 0});
+  }
+  // The original is compared as it was read, without applying the orientation.
+  dparams_.keep_orientation = true;
+}
+
+jxl::StatusOr<std::unique_ptr<TargetScorer>> TargetScorer::Create(
+    TargetMetric metric, const jxl::extras::PackedPixelFile& orig,
+    JxlParallelRunner runner, void* runner_opaque) {
+  std::unique_ptr<TargetScorer> scorer(
+      new TargetScorer(metric, runner, runner_opaque));
+  jxl::CodecInOut io(NoMemoryManager());
+  JXL_RETURN_IF_ERROR(jxl::extras::ConvertPackedPixelFileToCodecInOut(
+      orig, &scorer->pool_, &io));
+  if (metric == TargetMetric::kSsimulacra2) {
+    JXL_ASSIGN_OR_RETURN(
+        Ssimulacra2Reference reference,
+        Ssimulacra2Reference::Create(io.Main(), 0.5f, &scorer->pool_));
+    scorer->ssimulacra2_ =
+        jxl::make_unique<Ssimulacra2Reference>(std::move(reference));
+  } else {
+    jxl::ButteraugliParams params;
+    // Same viewing conditions as benchmark_xl.
+    const auto& transfer_function = io.Main().c_current().Tf();
+    params.intensity_target = transfer_function.IsPQ()    ? 10000.f
+                              : transfer_function.IsHLG() ? 1000.f
+                                                          : 80.f;
+    scorer->butteraugli_ = jxl::make_unique<jxl::JxlButteraugliComparator>(
+        params, *JxlGetDefaultCms(), &scorer->pool_);
+    JXL_RETURN_IF_ERROR(scorer->butteraugli_->SetReferenceImage(io.Main()));
+  }
+  return scorer;
+}
+
+jxl::Status TargetScorer::Score(const std::vector<uint8_t>& compressed,
+                                double* score) {
+  jxl::extras::PackedPixelFile ppf;
+  size_t decoded_bytes;
+  if (!jxl::extras::DecodeImageJXL(compressed.data(), compressed.size(),
+                                   dparams_, &decoded_bytes, &ppf)) {
+    return JXL_FAILURE("Decoding the encoded image failed");
+  }
+  jxl::CodecInOut io(NoMemoryManager());
+  JXL_RETURN_IF_ERROR(
+      jxl::extras::ConvertPackedPixelFileToCodecInOut(ppf, &pool_, &io));
+  if (metric_ == TargetMetric::kSsimulacra2) {
+    JXL_ASSIGN_OR_RETURN(Msssim msssim,
+                         ssimulacra2_->Compare(io.Main(), &pool_));
+    *score = msssim.Score();
+  } else {
+    jxl::ImageF diffmap;
+    float distance;
+    JXL_RETURN_IF_ERROR(
+        butteraugli_->CompareWith(io.Main(), &diffmap, &distance));
+    *score = -distance;
+  }
+  return true;
+}
+
+}  // namespace tools
+}  // namespace jpegxl
@@ -0,0 +1,63 @@
+// Copyright (c) the JPEG XL Project Authors. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#ifndef TOOLS_TARGET_SCORE_H_
+#define TOOLS_TARGET_SCORE_H_
+
+// Metric scores of encoded images, for encoding to a target quality with
+// jxl::extras::EncodeImageJXLToTargetScore.
+
+#include <jxl/parallel_runner.h>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "lib/extras/dec/jxl.h"
+#include "lib/extras/packed_image.h"
+#include "lib/jxl/base/data_parallel.h"
+#include "lib/jxl/base/status.h"
+#include "lib/jxl/enc_butteraugli_comparator.h"
+#include "tools/ssimulacra2.h"
+
+namespace jpegxl {
+namespace tools {
+
+enum class TargetMetric {
+  kSsimulacra2,
+  // Max norm of the butteraugli distance.
+  kButteraugli,
+};
+
+// Decodes JPEG XL images and scores them against the original. The reference
+// side of the metric is computed once, at creation, and reused for every
+// probe of the search.
+class TargetScorer {
+ public:
+  // The runner is used for decoding and for the metric, it must outlive the
+  // scorer.
+  static jxl::StatusOr<std::unique_ptr<TargetScorer>> Create(
+      TargetMetric metric, const jxl::extras::PackedPixelFile& orig,
+      JxlParallelRunner runner, void* runner_opaque);
+
+  // Higher is better: the SSIMULACRA 2 score, or the negated butteraugli
+  // distance.
+  jxl::Status Score(const std::vector<uint8_t>& compressed, double* score);
+
+ private:
+  TargetScorer(TargetMetric metric, JxlParallelRunner runner,
+               void* runner_opaque);
+
+  TargetMetric metric_;
+  jxl::ThreadPool pool_;
+  jxl::extras::JXLDecompressParams dparams_;
+  std::unique_ptr<Ssimulacra2Reference> ssimulacra2_;
+  std::unique_ptr<jxl::JxlButteraugliComparator> butteraugli_;
+};
+
+}  // namespace tools
+}  // namespace jpegxl
+
+#endif  // TOOLS_TARGET_SCORE_H_
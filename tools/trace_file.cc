@@ -0,0 +1,53 @@
+// Copyright (c) the JPEG XL Project Authors. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#include "tools/trace_file.h"
+
+#include <jxl/trace.h>
+
+#include <cstddef>
+#include <cstdio>
+#include <string>
+
+namespace jpegxl {
+namespace tools {
+
+bool TraceFile::Start(const std::string& filename) {
+  if (file_ != nullptr) return false;
+  file_ = fopen(filename.c_str(), "wb");
+  if (file_ == nullptr) {
+    fprintf(stderr, "Could not open %s for writing.\n", filename.c_str());
+    return false;
+  }
+  filename_ = filename;
+  ok_ = true;
+  if (!JxlTraceStart(&TraceFile::Write, this)) {
+    fprintf(stderr,
+            "Tracing is not available, the library must be built with "
+            "JPEGXL_ENABLE_TRACING.\n");
+    fclose(file_);
+    file_ = nullptr;
+    remove(filename.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool TraceFile::Stop() {
+  if (file_ == nullptr) return true;
+  JxlTraceStop();
+  if (fclose(file_) != 0) ok_ = false;
+  file_ = nullptr;
+  if (!ok_) fprintf(stderr, "Could not write %s.\n", filename_.c_str());
+  return ok_;
+}
+
+void TraceFile::Write(void* opaque, const char* data, size_t size) {
+  TraceFile* self = static_cast<TraceFile*>(opaque);
+  if (fwrite(data, 1, size, self->file_) != size) self->ok_ = false;
+}
+
+}  // namespace tools
+}  // namespace jpegxl
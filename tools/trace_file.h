@@ -0,0 +1,43 @@
+// Copyright (c) the JPEG XL Project Authors. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#ifndef TOOLS_TRACE_FILE_H_
+#define TOOLS_TRACE_FILE_H_
+
+#include <cstddef>
+#include <cstdio>
+#include <string>
+
+namespace jpegxl {
+namespace tools {
+
+// Writes the library trace (see jxl/trace.h) of everything encoded or decoded
+// between Start and Stop to a Chrome trace JSON file.
+class TraceFile {
+ public:
+  TraceFile() = default;
+  ~TraceFile() { Stop(); }
+  TraceFile(const TraceFile&) = delete;
+  TraceFile& operator=(const TraceFile&) = delete;
+
+  // Prints the reason to stderr and returns false if the file cannot be
+  // created or the library was built without JPEGXL_ENABLE_TRACING.
+  bool Start(const std::string& filename);
+
+  // Returns false if writing the file failed.
+  bool Stop();
+
+ private:
+  static void Write(void* opaque, const char* data, size_t size);
+
+  FILE* file_ = nullptr;
+  std::string filename_;
+  bool ok_ = true;
+};
+
+}  // namespace tools
+}  // namespace jpegxl
+
+#endif  // TOOLS_TRACE_FILE_H_
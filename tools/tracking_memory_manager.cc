@@ -59,6 +59,8 @@ void* TrackingMemoryManager::Alloc(void* opaque, size_t size) {
     self->bytes_in_use_ = new_bytes_in_use;
     self->max_bytes_in_use = std::max(self->max_bytes_in_use, new_bytes_in_use);
     self->total_bytes_allocated = new_total;
+    self->largest_allocation =
+        std::max<uint64_t>(self->largest_allocation, size);
   }
   void* result = self->inner_->_alloc(self->inner_->opaque, size);
   if (result != nullptr) {
@@ -118,8 +120,17 @@ jxl::Status TrackingMemoryManager::Reset() {
   max_bytes_in_use = 0;
   total_allocations = 0;
   total_bytes_allocated = 0;
+  largest_allocation = 0;
   return true;
 }
 
+void TrackingMemoryManager::ResetStats() {
+  std::lock_guard<std::mutex> guard(numbers_mutex_);
+  max_bytes_in_use = bytes_in_use_;
+  total_allocations = 0;
+  total_bytes_allocated = 0;
+  largest_allocation = 0;
+}
+
 }  // namespace tools
 }  // namespace jpegxl
@@ -25,16 +25,23 @@ class TrackingMemoryManager {
  public:
   explicit TrackingMemoryManager(uint64_t cap = 0, uint64_t total_cap = 0);
 
-  // void setInner(JxlMemoryManager* inner) { inner_ = inner; }
+  // Forwards the allocations to another memory manager, e.g. another
+  // TrackingMemoryManager to also account them there.
+  void SetInner(JxlMemoryManager* inner) { inner_ = inner; }
 
   JxlMemoryManager* get() { return &outer_; }
 
   jxl::Status Reset();
 
+  // Restarts the statistics below while allocations may still be live; the
+  // peak then starts from the bytes currently in use.
+  void ResetStats();
+
   bool seen_oom = false;
   uint64_t max_bytes_in_use = 0;
   uint64_t total_allocations = 0;
   uint64_t total_bytes_allocated = 0;
+  uint64_t largest_allocation = 0;
 
  private:
   static void* Alloc(void* opaque, size_t size);